@@ -0,0 +1,3 @@
+@echo off
+rem Stand-in Blender executable for the benchmark, see standin_blender.py
+python "%~dp0standin_blender.py" %*
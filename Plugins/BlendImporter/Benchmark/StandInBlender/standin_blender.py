@@ -0,0 +1,461 @@
+import array
+import hashlib
+import json
+import math
+import os
+import struct
+import sys
+import time
+
+# A stand-in for the Blender executable, for benchmarking the import pipeline without Blender or real art.
+# It takes the same command line the plugin gives Blender, and instead of running the plugin's scripts it writes the same results
+# blender_analyse.py and blender_export.py would, exporting a generated scene as ASCII FBX (or a mesh buffer, for direct mesh transfer).
+#
+# The ".blend" files it reads are scene descriptions, written by the benchmark from Corpus.json: one line of JSON, padded to the
+# requested source size so hashing and reading the source file costs about what it would for a real file of that size.
+#
+#   { "standin": 1, "meshes": 10, "vertices": 5000, "materials": 4, "frames": 0, "collections": [ "Props" ], "sourceBytes": 1048576 }
+
+STANDIN_VERSION = "Blender 3.3.1 (BlendImporter stand-in)"
+PROTOCOL_VERSION = 1
+MESH_BUFFER_MAGIC = b"BLMESH\0\0"
+MESH_BUFFER_VERSION = 3
+WORKER_MARKER = "@@BLENDIMPORTER|"
+FBX_TICKS_PER_FRAME = 46186158000 // 24
+
+# Functions
+
+def WriteResult(message):
+    resultFile = os.getenv("UNREAL_IMPORTER_RESULT_FILE")
+    if not resultFile:
+        return
+
+    with open(resultFile, "a", encoding="utf-8") as f:
+        f.write(json.dumps(message, ensure_ascii=False) + "\n")
+
+def WriteTiming(stage, seconds):
+    WriteResult({ "type": "timing", "stage": stage, "seconds": seconds })
+
+def OpenScene(filename):
+    # Reads the whole file, as Blender would
+    with open(filename, "rb") as f:
+        header = f.readline()
+        while f.read(16 * 1024 * 1024):
+            pass
+
+    scene = json.loads(header.decode("utf-8"))
+    if scene.get("standin") != 1:
+        raise ValueError(filename + " is not a stand-in scene")
+
+    scene.setdefault("meshes", 1)
+    scene.setdefault("vertices", 100)
+    scene.setdefault("materials", 1)
+    scene.setdefault("frames", 0)
+    scene.setdefault("collections", [ "Collection" ])
+    scene["source"] = header
+    return scene
+
+def GetGridSize(scene):
+    return max(2, int(math.ceil(math.sqrt(scene["vertices"]))))
+
+def GetObjects(scene):
+    collections = scene["collections"]
+    objects = []
+    for index in range(scene["meshes"]):
+        objects.append({ "name": "Mesh_%03d" % index, "index": index, "collection": collections[index % len(collections)] })
+    return objects
+
+def GetObjectStats(scene, obj):
+    size = GetGridSize(scene)
+    return { "type": "object", "name": obj["name"], "object_type": "MESH", "collections": [ obj["collection"] ],
+        "vertices": size * size, "triangles": (size - 1) * (size - 1) * 2, "materials": scene["materials"] }
+
+def GetFingerprint(scene, obj, seed):
+    fingerprint = hashlib.sha1()
+    fingerprint.update(scene["source"])
+    fingerprint.update(repr((obj["name"], seed)).encode("utf-8"))
+    return fingerprint.hexdigest()
+
+def GetGridVertices(scene, obj):
+    # A rippled grid, offset per object so no two objects are the same
+    size = GetGridSize(scene)
+    offset = obj["index"] * 0.37
+    vertices = array.array("f", [0.0]) * (size * size * 3)
+    for y in range(size):
+        for x in range(size):
+            i = (y * size + x) * 3
+            vertices[i] = x * 0.1 + obj["index"] * size * 0.1
+            vertices[i + 1] = y * 0.1
+            vertices[i + 2] = 0.05 * math.sin(x * 0.3 + offset) * math.cos(y * 0.3 + offset)
+    return vertices
+
+def FormatArray(values, formatter):
+    # FBX ASCII arrays can be as long as needed, but short lines keep the file readable in an editor
+    lines = []
+    for start in range(0, len(values), 64):
+        lines.append(",".join(formatter(value) for value in values[start:start + 64]))
+    return ",\n".join(lines)
+
+def FormatFloat(value):
+    return "%.5g" % value
+
+def WriteFbxArray(f, name, values, formatter=str, indent="\t\t"):
+    f.write("%s%s: *%d {\n%s\ta: %s\n%s}\n" % (indent, name, len(values), indent, FormatArray(values, formatter), indent))
+
+def WriteFbxGeometry(f, scene, obj, geometryId):
+    size = GetGridSize(scene)
+    vertices = GetGridVertices(scene, obj)
+
+    polygonIndices = array.array("i")
+    for y in range(size - 1):
+        for x in range(size - 1):
+            i = y * size + x
+            # The last index of each polygon is negated and offset by one
+            polygonIndices.extend((i, i + 1, i + size + 1, -(i + size) - 1))
+
+    numPolygons = (size - 1) * (size - 1)
+    uvs = array.array("f", [0.0]) * (size * size * 2)
+    for y in range(size):
+        for x in range(size):
+            i = (y * size + x) * 2
+            uvs[i] = x / (size - 1)
+            uvs[i + 1] = y / (size - 1)
+
+    f.write("\tGeometry: %d, \"Geometry::%s\", \"Mesh\" {\n" % (geometryId, obj["name"]))
+    WriteFbxArray(f, "Vertices", vertices, FormatFloat)
+    WriteFbxArray(f, "PolygonVertexIndex", polygonIndices)
+    f.write("\t\tGeometryVersion: 124\n")
+
+    f.write("\t\tLayerElementNormal: 0 {\n\t\t\tVersion: 101\n\t\t\tName: \"\"\n\t\t\tMappingInformationType: \"ByVertice\"\n\t\t\tReferenceInformationType: \"Direct\"\n")
+    WriteFbxArray(f, "Normals", array.array("f", [0.0, 0.0, 1.0]) * (size * size), FormatFloat, "\t\t\t")
+    f.write("\t\t}\n")
+
+    f.write("\t\tLayerElementSmoothing: 0 {\n\t\t\tVersion: 102\n\t\t\tName: \"\"\n\t\t\tMappingInformationType: \"ByPolygon\"\n\t\t\tReferenceInformationType: \"Direct\"\n")
+    WriteFbxArray(f, "Smoothing", array.array("i", [0]) * numPolygons, str, "\t\t\t")
+    f.write("\t\t}\n")
+
+    f.write("\t\tLayerElementUV: 0 {\n\t\t\tVersion: 101\n\t\t\tName: \"UVMap\"\n\t\t\tMappingInformationType: \"ByPolygonVertex\"\n\t\t\tReferenceInformationType: \"IndexToDirect\"\n")
+    WriteFbxArray(f, "UV", uvs, FormatFloat, "\t\t\t")
+    WriteFbxArray(f, "UVIndex", array.array("i", (i if i >= 0 else -i - 1 for i in polygonIndices)), str, "\t\t\t")
+    f.write("\t\t}\n")
+
+    f.write("\t\tLayerElementMaterial: 0 {\n\t\t\tVersion: 101\n\t\t\tName: \"\"\n\t\t\tMappingInformationType: \"ByPolygon\"\n\t\t\tReferenceInformationType: \"IndexToDirect\"\n")
+    WriteFbxArray(f, "Materials", array.array("i", (i % scene["materials"] for i in range(numPolygons))), str, "\t\t\t")
+    f.write("\t\t}\n")
+
+    f.write("\t\tLayer: 0 {\n\t\t\tVersion: 100\n")
+    for layerElement in ("LayerElementNormal", "LayerElementSmoothing", "LayerElementUV", "LayerElementMaterial"):
+        f.write("\t\t\tLayerElement:  {\n\t\t\t\tType: \"%s\"\n\t\t\t\tTypedIndex: 0\n\t\t\t}\n" % layerElement)
+    f.write("\t\t}\n\t}\n")
+
+def WriteFbxCurve(f, curveId, frames, phase):
+    times = [frame * FBX_TICKS_PER_FRAME for frame in range(frames)]
+    values = array.array("f", (math.sin(frame * 0.1 + phase) for frame in range(frames)))
+    f.write("\tAnimationCurve: %d, \"AnimCurve::\", \"\" {\n\t\tDefault: 0\n\t\tKeyVer: 4008\n" % curveId)
+    WriteFbxArray(f, "KeyTime", times)
+    WriteFbxArray(f, "KeyValueFloat", values, FormatFloat)
+    f.write("\t\tKeyAttrFlags: *1 {\n\t\t\ta: 24840\n\t\t}\n")
+    f.write("\t\tKeyAttrDataFloat: *4 {\n\t\t\ta: 0,0,255013683,0\n\t\t}\n")
+    f.write("\t\tKeyAttrRefCount: *1 {\n\t\t\ta: %d\n\t\t}\n\t}\n" % frames)
+
+def WriteFbx(filename, scene, objects):
+    frames = scene["frames"]
+    numMaterials = scene["materials"]
+    connections = []
+    nextId = [1000000]
+
+    def NewId():
+        nextId[0] += 1
+        return nextId[0]
+
+    tempFilename = filename + ".tmp"
+    with open(tempFilename, "w", encoding="utf-8", newline="\n") as f:
+        f.write("; FBX 7.3.0 project file\n; Written by the BlendImporter stand-in Blender\n\n")
+        f.write("FBXHeaderExtension:  {\n\tFBXHeaderVersion: 1003\n\tFBXVersion: 7300\n\tCreator: \"%s\"\n}\n" % STANDIN_VERSION)
+        f.write("GlobalSettings:  {\n\tVersion: 1000\n\tProperties70:  {\n")
+        for name, value in (("UpAxis", 2), ("UpAxisSign", 1), ("FrontAxis", 1), ("FrontAxisSign", -1), ("CoordAxis", 0), ("CoordAxisSign", 1), ("TimeMode", 11)):
+            f.write("\t\tP: \"%s\", \"int\", \"Integer\", \"\",%d\n" % (name, value))
+        f.write("\t\tP: \"UnitScaleFactor\", \"double\", \"Number\", \"\",100\n\t}\n}\n")
+
+        numAnimated = len(objects) if frames > 0 else 0
+        f.write("Definitions:  {\n\tVersion: 100\n\tCount: %d\n" % (1 + len(objects) * 2 + numMaterials + (2 + numAnimated * 4 if frames > 0 else 0)))
+        definitions = [("GlobalSettings", 1), ("Model", len(objects)), ("Geometry", len(objects)), ("Material", numMaterials)]
+        if frames > 0:
+            definitions += [("AnimationStack", 1), ("AnimationLayer", 1), ("AnimationCurveNode", numAnimated), ("AnimationCurve", numAnimated * 3)]
+        for objectType, count in definitions:
+            f.write("\tObjectType: \"%s\" {\n\t\tCount: %d\n\t}\n" % (objectType, count))
+        f.write("}\n")
+
+        f.write("Objects:  {\n")
+
+        materialIds = []
+        for index in range(numMaterials):
+            materialId = NewId()
+            materialIds.append(materialId)
+            shade = 0.2 + 0.6 * index / max(numMaterials - 1, 1)
+            f.write("\tMaterial: %d, \"Material::Material_%03d\", \"\" {\n\t\tVersion: 102\n\t\tShadingModel: \"phong\"\n\t\tMultiLayer: 0\n\t\tProperties70:  {\n" % (materialId, index))
+            f.write("\t\t\tP: \"DiffuseColor\", \"Color\", \"\", \"A\",%.3f,%.3f,%.3f\n\t\t}\n\t}\n" % (shade, 0.5, 1.0 - shade))
+
+        if frames > 0:
+            stackId = NewId()
+            layerId = NewId()
+            stop = (frames - 1) * FBX_TICKS_PER_FRAME
+            f.write("\tAnimationStack: %d, \"AnimStack::Take 001\", \"\" {\n\t\tProperties70:  {\n" % stackId)
+            f.write("\t\t\tP: \"LocalStop\", \"KTime\", \"Time\", \"\",%d\n\t\t\tP: \"ReferenceStop\", \"KTime\", \"Time\", \"\",%d\n\t\t}\n\t}\n" % (stop, stop))
+            f.write("\tAnimationLayer: %d, \"AnimLayer::BaseLayer\", \"\" {\n\t}\n" % layerId)
+            connections.append(("OO", layerId, stackId, None))
+
+        for obj in objects:
+            modelId = NewId()
+            geometryId = NewId()
+            f.write("\tModel: %d, \"Model::%s\", \"Mesh\" {\n\t\tVersion: 232\n\t\tProperties70:  {\n" % (modelId, obj["name"]))
+            f.write("\t\t\tP: \"Lcl Translation\", \"Lcl Translation\", \"\", \"A\",0,0,0\n\t\t}\n\t\tShading: T\n\t\tCulling: \"CullingOff\"\n\t}\n")
+            WriteFbxGeometry(f, scene, obj, geometryId)
+
+            connections.append(("OO", modelId, 0, None))
+            connections.append(("OO", geometryId, modelId, None))
+            for materialId in materialIds:
+                connections.append(("OO", materialId, modelId, None))
+
+            if frames > 0:
+                curveNodeId = NewId()
+                f.write("\tAnimationCurveNode: %d, \"AnimCurveNode::T\", \"\" {\n\t\tProperties70:  {\n" % curveNodeId)
+                for axis in "XYZ":
+                    f.write("\t\t\tP: \"d|%s\", \"Number\", \"\", \"A\",0\n" % axis)
+                f.write("\t\t}\n\t}\n")
+                connections.append(("OO", curveNodeId, layerId, None))
+                connections.append(("OP", curveNodeId, modelId, "Lcl Translation"))
+                for axisIndex, axis in enumerate("XYZ"):
+                    curveId = NewId()
+                    WriteFbxCurve(f, curveId, frames, obj["index"] + axisIndex)
+                    connections.append(("OP", curveId, curveNodeId, "d|" + axis))
+
+        f.write("}\n")
+
+        f.write("Connections:  {\n")
+        for kind, child, parent, propertyName in connections:
+            if propertyName:
+                f.write("\tC: \"%s\",%d,%d, \"%s\"\n" % (kind, child, parent, propertyName))
+            else:
+                f.write("\tC: \"%s\",%d,%d\n" % (kind, child, parent))
+        f.write("}\n")
+    os.replace(tempFilename, filename)
+
+def WriteString(f, string):
+    data = string.encode("utf-8")
+    f.write(struct.pack("<I", len(data)))
+    f.write(data)
+    f.write(b"\0" * ((4 - len(data) % 4) % 4))
+
+def WriteMeshBuffer(filename, scene, objects):
+    # The same layout blender_export.py writes, with one UV channel and no tangents or colors
+    size = GetGridSize(scene)
+    numVertices = size * size
+    numQuads = (size - 1) * (size - 1)
+
+    cornerVertices = array.array("i")
+    for y in range(size - 1):
+        for x in range(size - 1):
+            i = y * size + x
+            cornerVertices.extend((i, i + 1, i + size + 1, i + size))
+    numCorners = len(cornerVertices)
+
+    triangleCorners = array.array("i")
+    for quad in range(numQuads):
+        c = quad * 4
+        triangleCorners.extend((c, c + 1, c + 2, c, c + 2, c + 3))
+    triangleMaterials = array.array("i", ((quad % scene["materials"]) for quad in range(numQuads) for _ in range(2)))
+
+    normals = array.array("f", [0.0, 0.0, 1.0]) * numCorners
+    uvs = array.array("f", [0.0]) * (numCorners * 2)
+    for corner, vertex in enumerate(cornerVertices):
+        uvs[corner * 2] = (vertex % size) / (size - 1)
+        uvs[corner * 2 + 1] = (vertex // size) / (size - 1)
+
+    materialNames = ["Material_%03d" % index for index in range(scene["materials"])]
+
+    tempFilename = filename + ".tmp"
+    with open(tempFilename, "wb") as f:
+        f.write(MESH_BUFFER_MAGIC)
+        f.write(struct.pack("<2I", MESH_BUFFER_VERSION, len(objects)))
+        for objectIndex, obj in enumerate(objects):
+            f.write(struct.pack("<10I", numVertices, numCorners, numQuads * 2, 1, 0, 0, len(materialNames), 0, 0, objectIndex))
+            WriteString(f, obj["name"])
+            for materialName in materialNames:
+                WriteString(f, materialName)
+            f.write(GetGridVertices(scene, obj).tobytes())
+            f.write(cornerVertices.tobytes())
+            f.write(normals.tobytes())
+            f.write(uvs.tobytes())
+            f.write(triangleCorners.tobytes())
+            f.write(triangleMaterials.tobytes())
+    os.replace(tempFilename, filename)
+
+def RemoveFile(filename):
+    if filename and os.path.exists(filename):
+        os.remove(filename)
+
+def GetEnabledObjects(scene):
+    objects = GetObjects(scene)
+    enabledCollections = os.getenv("UNREAL_IMPORTER_ENABLED_COLLECTIONS")
+    if enabledCollections:
+        enabledCollections = enabledCollections.split(",")
+        if os.getenv("UNREAL_IMPORTER_DEFAULT_COLLECTIONS") == "true":
+            enabledCollections = [col for col in scene["collections"] if col in enabledCollections] or scene["collections"]
+        objects = [obj for obj in objects if obj["collection"] in enabledCollections]
+
+    exportObjects = json.loads(os.getenv("UNREAL_IMPORTER_EXPORT_OBJECTS") or "null")
+    if exportObjects is not None:
+        objects = [obj for obj in objects if obj["name"] in exportObjects]
+    return objects
+
+def Analyse(scene):
+    startTime = time.perf_counter()
+    WriteResult({ "type": "begin", "protocol": PROTOCOL_VERSION, "script": "blender_analyse", "blender": STANDIN_VERSION })
+    WriteResult({ "type": "collections", "names": scene["collections"] })
+    for obj in GetObjects(scene):
+        WriteResult(GetObjectStats(scene, obj))
+    WriteTiming("analyse", time.perf_counter() - startTime)
+    WriteResult({ "type": "end", "script": "blender_analyse" })
+    print ("Analysis Complete", flush=True)
+
+def Export(scene):
+    startTime = time.perf_counter()
+    WriteResult({ "type": "begin", "protocol": PROTOCOL_VERSION, "script": "blender_export", "blender": STANDIN_VERSION })
+
+    outfile = os.getenv("UNREAL_IMPORTER_OUTPUT_FILE")
+    meshBufferFile = os.getenv("UNREAL_IMPORTER_MESH_BUFFER_FILE")
+    directMesh = os.getenv("UNREAL_IMPORTER_DIRECT_MESH") == "true" and meshBufferFile
+    previousFingerprints = json.loads(os.getenv("UNREAL_IMPORTER_PREVIOUS_FINGERPRINTS") or "null")
+    changedOnly = os.getenv("UNREAL_IMPORTER_CHANGED_ONLY") == "true" and previousFingerprints is not None
+
+    print ("OutFile: " + str(outfile))
+    objects = GetEnabledObjects(scene)
+    WriteTiming("prepare", time.perf_counter() - startTime)
+    evaluateStartTime = time.perf_counter()
+
+    seed = (PROTOCOL_VERSION, MESH_BUFFER_VERSION, STANDIN_VERSION, os.getenv("UNREAL_IMPORTER_FIX_MATERIALS"), bool(directMesh))
+    fingerprints = { obj["name"]: GetFingerprint(scene, obj, seed) for obj in objects }
+    unchanged = previousFingerprints is not None and fingerprints == previousFingerprints
+    if changedOnly and not unchanged:
+        objects = [obj for obj in objects if previousFingerprints.get(obj["name"]) != fingerprints[obj["name"]]]
+        unchanged = len(objects) == 0
+
+    for obj in objects:
+        stats = GetObjectStats(scene, obj)
+        stats["fingerprint"] = fingerprints[obj["name"]]
+        WriteResult(stats)
+
+    WriteTiming("evaluate", time.perf_counter() - evaluateStartTime)
+    exportStartTime = time.perf_counter()
+
+    if unchanged:
+        print ("Exported objects are unchanged, skipping export")
+        WriteResult({ "type": "unchanged" })
+        RemoveFile(outfile)
+        RemoveFile(meshBufferFile)
+    elif directMesh and scene["frames"] == 0:
+        print ("Writing mesh buffer: " + meshBufferFile)
+        WriteMeshBuffer(meshBufferFile, scene, objects)
+        RemoveFile(outfile)
+    else:
+        RemoveFile(meshBufferFile)
+        WriteFbx(outfile, scene, objects)
+
+    WriteTiming("export", time.perf_counter() - exportStartTime)
+    WriteResult({ "type": "end", "script": "blender_export" })
+    print ("Export Complete", flush=True)
+
+def LoadEnvironment(filename):
+    with open(filename, encoding="utf-8") as environmentFile:
+        os.environ.update(json.load(environmentFile))
+
+    launchTime = os.getenv("UNREAL_IMPORTER_LAUNCH_TIME")
+    if launchTime:
+        WriteTiming("startup", time.time() - float(launchTime))
+
+def RunScripts(filename, scripts):
+    openStartTime = time.perf_counter()
+    scene = OpenScene(filename)
+    WriteTiming("open", time.perf_counter() - openStartTime)
+
+    for script in scripts:
+        name = os.path.splitext(os.path.basename(script))[0]
+        if name == "blender_analyse":
+            Analyse(scene)
+        elif name == "blender_export":
+            Export(scene)
+
+def SendWorkerMessage(message):
+    sys.stdout.flush()
+    print(WORKER_MARKER + message, flush=True)
+
+def RunWorker():
+    SendWorkerMessage("READY")
+    for line in sys.stdin:
+        line = line.strip()
+        if not line:
+            continue
+        if line == "PING":
+            SendWorkerMessage("PONG")
+            continue
+        if line == "QUIT":
+            break
+
+        try:
+            job = json.loads(line)
+        except ValueError:
+            SendWorkerMessage("ERROR|Malformed job")
+            continue
+
+        SendWorkerMessage("BEGIN|" + str(job["id"]))
+        success = True
+        savedEnvironment = dict(os.environ)
+        try:
+            os.environ.update(job.get("env", {}))
+            RunScripts(job["file"], job["scripts"])
+        except Exception as e:
+            print ("Stand-in job failed: " + str(e))
+            success = False
+        finally:
+            os.environ.clear()
+            os.environ.update(savedEnvironment)
+        SendWorkerMessage("END|" + str(job["id"]) + "|" + ("1" if success else "0"))
+
+# Main
+
+args = sys.argv[1:]
+if "--version" in args or "-v" in args:
+    print (STANDIN_VERSION)
+    sys.exit(0)
+
+# Only the arguments the plugin passes matter: the .blend file, the -P scripts, and after "--" the environment file
+scriptArgs = args[args.index("--") + 1:] if "--" in args else []
+args = args[:args.index("--")] if "--" in args else args
+
+blendFile = None
+scripts = []
+index = 0
+while index < len(args):
+    if args[index] == "-P" and index + 1 < len(args):
+        scripts.append(args[index + 1])
+        index += 2
+        continue
+    if args[index].endswith(".blend"):
+        blendFile = args[index]
+    index += 1
+
+if scriptArgs:
+    LoadEnvironment(scriptArgs[0])
+
+try:
+    if any(os.path.basename(script) == "blender_worker.py" for script in scripts):
+        RunWorker()
+    elif blendFile:
+        RunScripts(blendFile, [script for script in scripts if os.path.basename(script) != "blender_environment.py"])
+    else:
+        print ("Stand-in Blender needs a .blend file")
+        sys.exit(1)
+except Exception as e:
+    print ("Stand-in Blender failed: " + str(e), flush=True)
+    sys.exit(1)
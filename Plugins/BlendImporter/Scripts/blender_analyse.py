@@ -1,4 +1,14 @@
 import bpy
+import hashlib
+import os
+import sys
+import time
+
+scriptDirectory = os.path.dirname(os.path.abspath(__file__))
+if scriptDirectory not in sys.path:
+    sys.path.append(scriptDirectory)
+
+from blender_common import PROTOCOL_VERSION, WriteResult, GetObjectStats
 
 # Functions
 
@@ -72,6 +82,65 @@ def CheckMaterial(mat, output):
         output[mat.name]["Images"][image.name] = {}
         output[mat.name]["Images"][image.name]["IsPacked"] = image.packed_file != None
 
+def GetTemplateTexture(node):
+    if node.type != "TEX_IMAGE" or node.image is None:
+        return None
+    
+    # Packed images are found by their hash in the texture cache, where the export extracts them
+    if node.image.packed_file is not None:
+        return { "packed": hashlib.sha1(node.image.packed_file.data).hexdigest()[:16] }
+    return { "file": os.path.normpath(bpy.path.abspath(node.image.filepath)) }
+
+def GetMaterialTemplate(mat):
+    # A material fits a master material if it's a Principled BSDF straight into the output, with each input used either unlinked
+    # or linked straight to an image texture. FBlendFileAnalysis::AnalyseMaterialTemplate must classify materials the same way.
+    materialOutput = FindMaterialOutput(mat, None)
+    if not materialOutput or not materialOutput.inputs["Surface"].is_linked:
+        return None
+    
+    BSDFNode = materialOutput.inputs["Surface"].links[0].from_node
+    if BSDFNode.type != "BSDF_PRINCIPLED":
+        return None
+    
+    if mat.blend_method == "BLEND":
+        template = "Translucent"
+    elif mat.blend_method in { "CLIP", "HASHED" }:
+        template = "Masked"
+    else:
+        template = "Opaque"
+    result = { "type": "material_template", "material": mat.name, "template": template, "colors": {}, "scalars": {}, "textures": {} }
+    
+    for input in BSDFNode.inputs:
+        parameter = templateParameters.get(input.name)
+        if parameter is None:
+            if input.is_linked:
+                return None
+            continue
+        
+        name, kind, textureSocket = parameter
+        if not input.is_linked:
+            if kind == "color":
+                result["colors"][name] = list(input.default_value)
+            elif kind == "scalar":
+                result["scalars"][name] = input.default_value
+            continue
+        
+        link = input.links[0]
+        if kind == "normal":
+            if link.from_node.type != "NORMAL_MAP" or not link.from_node.inputs["Color"].is_linked:
+                return None
+            link = link.from_node.inputs["Color"].links[0]
+        
+        if textureSocket is None or link.from_socket.name != textureSocket:
+            return None
+        
+        texture = GetTemplateTexture(link.from_node)
+        if texture is None:
+            return None
+        result["textures"][name] = texture
+    
+    return result
+
 def CheckMaterials(output):
     for mat in bpy.data.materials:
         if mat.name == "Dots Stroke":
@@ -80,16 +149,29 @@ def CheckMaterials(output):
         CheckMaterial(mat, output)
 
 # Main
+startTime = time.perf_counter()
+WriteResult({ "type": "begin", "protocol": PROTOCOL_VERSION, "script": "blender_analyse", "blender": bpy.app.version_string })
+
 layerCollections = []
 GetLayerCollections(bpy.context.view_layer.layer_collection, layerCollections)
 
-collections = "C|"
-for col in layerCollections:
-    collections += col.name + ","
-print(collections)
+WriteResult({ "type": "collections", "names": [col.name for col in layerCollections] })
 
 checkInputNames = { "Base Color", "Metallic", "Roughness", "Normal" }
 
+# Principled BSDF inputs used by the master materials: the parameter they set, its kind, and the image texture output it can be linked to.
+# Inputs that aren't listed are ignored while unlinked.
+templateParameters = {
+    "Base Color": ("BaseColor", "color", "Color"),
+    "Metallic": ("Metallic", "scalar", "Color"),
+    "Roughness": ("Roughness", "scalar", "Color"),
+    "Normal": ("Normal", "normal", "Color"),
+    "Emission": ("EmissiveColor", "color", "Color"),
+    "Emission Color": ("EmissiveColor", "color", "Color"),
+    "Emission Strength": ("EmissiveStrength", "scalar", None),
+    "Alpha": ("Opacity", "scalar", "Alpha"),
+}
+
 materialOutput = {}
 CheckMaterials(materialOutput)
 
@@ -102,15 +184,28 @@ for k,v in materialOutput.items():
             break
     
     if len(v["Errors"]) > 0:
-        warningString = "M|" + k + "|";
-        for error in v["Errors"]:
-            warningString += error + ","
-        print (warningString)
+        WriteResult({ "type": "material_issues", "material": k, "issues": v["Errors"] })
 
 if hasPacked:
-    print ("P|True")
+    WriteResult({ "type": "packed_images" })
+
+materials = [mat for mat in bpy.data.materials if mat.name != "Dots Stroke"]
+WriteResult({ "type": "material_count", "count": len(materials) })
+
+for mat in materials:
+    template = GetMaterialTemplate(mat)
+    if template:
+        WriteResult(template)
+
+for obj in bpy.context.view_layer.objects:
+    WriteResult(GetObjectStats(obj))
+
+WriteResult({ "type": "timing", "stage": "analyse", "seconds": time.perf_counter() - startTime })
+WriteResult({ "type": "end", "script": "blender_analyse" })
+
+print ("Analysis Complete", flush=True)
 
-print ("Analysis Complete")
+combined = (os.getenv("UNREAL_IMPORTER_COMBINED") == 'true')
 
-if not bpy.app.background:
-    bpy.ops.wm.quit_blender()
\ No newline at end of file
+if not bpy.app.background and not combined:
+    bpy.ops.wm.quit_blender()
@@ -0,0 +1,30 @@
+import json
+import os
+
+# Shared by the scripts run on a .blend file, which import it after adding this directory to sys.path.
+#
+# Results are written as one JSON object per line to the file in UNREAL_IMPORTER_RESULT_FILE, instead of stdout, so they can't be
+# mixed up with Blender's own output. Bump the protocol version when changing the messages in a way the plugin can't read.
+
+PROTOCOL_VERSION = 1
+
+# Functions
+
+def WriteResult(message):
+    resultFile = os.getenv("UNREAL_IMPORTER_RESULT_FILE")
+    if not resultFile:
+        return
+    
+    # Appended and closed per message, so the plugin can read results while the script carries on
+    with open(resultFile, "a", encoding="utf-8") as f:
+        f.write(json.dumps(message, ensure_ascii=False) + "\n")
+
+def GetObjectStats(obj):
+    stats = { "type": "object", "name": obj.name, "object_type": obj.type, "materials": len(obj.material_slots) }
+    stats["collections"] = [col.name for col in obj.users_collection]
+    if obj.type == "MESH":
+        mesh = obj.data
+        stats["vertices"] = len(mesh.vertices)
+        # Each polygon of n corners makes n - 2 triangles
+        stats["triangles"] = len(mesh.loops) - 2 * len(mesh.polygons)
+    return stats
@@ -0,0 +1,22 @@
+import json
+import os
+import sys
+import time
+
+# Sets up the environment variables for the scripts run after this one. They're read from the file named after Blender's "--"
+# argument, so Blender processes running in parallel each get their own, without changing the editor's environment.
+
+# Main
+
+if "--" in sys.argv:
+    args = sys.argv[sys.argv.index("--") + 1:]
+    if len(args) > 0:
+        with open(args[0], encoding="utf-8") as environmentFile:
+            os.environ.update(json.load(environmentFile))
+
+# How long Blender took to start and load the file, which the plugin can't see from outside
+launchTime = os.getenv("UNREAL_IMPORTER_LAUNCH_TIME")
+resultFile = os.getenv("UNREAL_IMPORTER_RESULT_FILE")
+if launchTime and resultFile:
+    with open(resultFile, "a", encoding="utf-8") as f:
+        f.write(json.dumps({ "type": "timing", "stage": "startup", "seconds": time.time() - float(launchTime) }) + "\n")
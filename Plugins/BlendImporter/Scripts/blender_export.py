@@ -1,9 +1,160 @@
+import array
 import bpy
+import hashlib
+import json
 import os
+import struct
+import sys
+import time
 from mathutils import Vector, Matrix
 
+scriptDirectory = os.path.dirname(os.path.abspath(__file__))
+if scriptDirectory not in sys.path:
+    sys.path.append(scriptDirectory)
+
+from blender_common import PROTOCOL_VERSION, WriteResult, GetObjectStats
+
+# Static meshes can be sent to the plugin as a mesh buffer instead of FBX, which FBlendMeshBuffer reads in place from a memory mapped file.
+# All values are little endian, and every array starts 4 byte aligned.
+#
+#   "BLMESH\0\0", uint32 version, uint32 object count
+#   Per object:
+#     uint32 vertex count, corner count, triangle count, UV channel count, has colors, has tangents, material count, instance count,
+#            LOD index, base object index
+#     string name, string material names[material count]          (uint32 byte length, UTF-8, padded to 4 bytes)
+#     float positions[vertices][3]                                  (world space, or the mesh's own space if instanced, in meters)
+#     int32 corner vertices[corners]
+#     float normals[corners][3]
+#     float tangents[corners][3], bitangent signs[corners]          (if has tangents)
+#     float uvs[UV channels][corners][2]
+#     float colors[corners][4]                                      (if has colors, linear)
+#     int32 triangle corners[triangles][3], triangle materials[triangles]
+#     float instance transforms[instances][4][4]                    (object to world, row major, translation in meters)
+#
+# Objects sharing one mesh (linked duplicates) are written once, named after the mesh, with the transform of each object as an instance.
+# LODs come after all LOD 0 objects, each with the index of the LOD 0 object it reduces. They have no instances of their own, an instanced
+# object's LODs are in its space and use its instances.
+
+MESH_BUFFER_MAGIC = b"BLMESH\0\0"
+MESH_BUFFER_VERSION = 3
+MESH_OBJECT_TYPES = { "MESH", "CURVE", "SURFACE", "FONT", "META" }
+
+# For packed images that weren't loaded from a file, so have no extension of their own
+IMAGE_FORMAT_EXTENSIONS = { "PNG": ".png", "JPEG": ".jpg", "TARGA": ".tga", "TARGA_RAW": ".tga", "BMP": ".bmp", "TIFF": ".tif", "OPEN_EXR": ".exr", "HDR": ".hdr" }
+
 # Functions
 
+def UpdateFingerprint(fingerprint, value):
+    fingerprint.update(repr(value).encode("utf-8"))
+
+def UpdateMaterialFingerprint(fingerprint, mat):
+    UpdateFingerprint(fingerprint, mat.name)
+    if not mat.use_nodes or mat.node_tree is None:
+        UpdateFingerprint(fingerprint, tuple(mat.diffuse_color))
+        return
+
+    for node in mat.node_tree.nodes:
+        UpdateFingerprint(fingerprint, (node.bl_idname, node.name))
+        for input in node.inputs:
+            value = getattr(input, "default_value", None)
+            UpdateFingerprint(fingerprint, tuple(value) if hasattr(value, "__len__") and not isinstance(value, str) else value)
+        if node.type == "TEX_IMAGE" and node.image:
+            UpdateFingerprint(fingerprint, (node.image.filepath, node.image.packed_file is not None))
+            UpdateFingerprint(fingerprint, GetImageFingerprint(node.image))
+    for link in mat.node_tree.links:
+        UpdateFingerprint(fingerprint, (link.from_node.name, link.from_socket.identifier, link.to_node.name, link.to_socket.identifier))
+
+imageFingerprints = {}
+
+def GetImageFingerprint(image):
+    # Image contents can change without the .blend file changing, so external files are checked and packed ones hashed, once per image
+    if image.name in imageFingerprints:
+        return imageFingerprints[image.name]
+
+    if image.packed_file is not None:
+        result = hashlib.sha1(image.packed_file.data).hexdigest()
+    else:
+        try:
+            stat = os.stat(bpy.path.abspath(image.filepath, library=image.library))
+            result = (stat.st_size, stat.st_mtime_ns)
+        except OSError:
+            result = None
+    imageFingerprints[image.name] = result
+    return result
+
+def UpdateArrayFingerprint(fingerprint, collection, attribute, typecode, width):
+    # Some attributes moved between Blender versions
+    if len(collection) > 0 and not hasattr(collection[0], attribute):
+        return
+
+    if typecode == "?":
+        values = [False] * (len(collection) * width)
+        collection.foreach_get(attribute, values)
+        fingerprint.update(bytes(values))
+    else:
+        values = array.array(typecode, [0]) * (len(collection) * width)
+        collection.foreach_get(attribute, values)
+        fingerprint.update(values.tobytes())
+
+def GetObjectFingerprint(obj, depsgraph, seed):
+    # Covers everything the export takes from the object: its evaluated mesh, materials and their images, transform, bones, animation and custom properties
+    fingerprint = hashlib.sha1()
+    UpdateFingerprint(fingerprint, seed)
+    UpdateFingerprint(fingerprint, (obj.type, obj.parent.name if obj.parent else None, obj.parent_bone))
+    fingerprint.update(struct.pack("<16f", *[value for row in obj.matrix_world for value in row]))
+    UpdateFingerprint(fingerprint, sorted((key, str(obj[key])) for key in obj.keys()))
+
+    for slot in obj.material_slots:
+        if slot.material:
+            UpdateMaterialFingerprint(fingerprint, slot.material)
+        else:
+            UpdateFingerprint(fingerprint, None)
+
+    if obj.type in MESH_OBJECT_TYPES:
+        evaluated = obj.evaluated_get(depsgraph)
+        mesh = evaluated.to_mesh()
+        try:
+            UpdateArrayFingerprint(fingerprint, mesh.vertices, "co", "f", 3)
+            UpdateArrayFingerprint(fingerprint, mesh.loops, "vertex_index", "i", 1)
+            UpdateArrayFingerprint(fingerprint, mesh.polygons, "loop_total", "i", 1)
+            UpdateArrayFingerprint(fingerprint, mesh.polygons, "material_index", "i", 1)
+            UpdateArrayFingerprint(fingerprint, mesh.polygons, "use_smooth", "?", 1)
+            UpdateArrayFingerprint(fingerprint, mesh.edges, "use_edge_sharp", "?", 1)
+            for uvLayer in mesh.uv_layers:
+                UpdateFingerprint(fingerprint, uvLayer.name)
+                UpdateArrayFingerprint(fingerprint, uvLayer.data, "uv", "f", 2)
+
+            # Color attributes replaced vertex colors in Blender 3.2
+            colorLayers = mesh.color_attributes if hasattr(mesh, "color_attributes") else mesh.vertex_colors
+            for colorLayer in colorLayers:
+                UpdateFingerprint(fingerprint, (colorLayer.name, getattr(colorLayer, "domain", "CORNER")))
+                UpdateArrayFingerprint(fingerprint, colorLayer.data, "color", "f", 4)
+
+            # The normals the export writes, which covers custom normals and auto smooth
+            if hasattr(mesh, "corner_normals"):
+                UpdateArrayFingerprint(fingerprint, mesh.corner_normals, "vector", "f", 3)
+            else:
+                mesh.calc_normals_split()
+                UpdateArrayFingerprint(fingerprint, mesh.loops, "normal", "f", 3)
+
+            if len(obj.vertex_groups) > 0:
+                UpdateFingerprint(fingerprint, [group.name for group in obj.vertex_groups])
+                fingerprint.update(array.array("i", [len(vertex.groups) for vertex in mesh.vertices]).tobytes())
+                fingerprint.update(array.array("i", [weight.group for vertex in mesh.vertices for weight in vertex.groups]).tobytes())
+                fingerprint.update(array.array("f", [weight.weight for vertex in mesh.vertices for weight in vertex.groups]).tobytes())
+        finally:
+            evaluated.to_mesh_clear()
+    elif obj.type == "ARMATURE":
+        for bone in obj.data.bones:
+            UpdateFingerprint(fingerprint, (bone.name, bone.parent.name if bone.parent else None, [tuple(row) for row in bone.matrix_local]))
+
+    if obj.animation_data and obj.animation_data.action:
+        for fcurve in obj.animation_data.action.fcurves:
+            UpdateFingerprint(fingerprint, (fcurve.data_path, fcurve.array_index))
+            UpdateArrayFingerprint(fingerprint, fcurve.keyframe_points, "co", "f", 2)
+
+    return fingerprint.hexdigest()
+
 def FindBSDFNode(mat):
     if not mat.use_nodes:
         return None
@@ -29,6 +180,252 @@ def FindLinkedTextureImageNode(node, initialInput):
         else:
             return None
 
+def GetLayerCollections(current, layerCollections):
+    for child in current.children:
+        if not child.exclude and not child.hide_viewport:
+            layerCollections.append(child)
+        GetLayerCollections(child, layerCollections)
+
+def GetDefaultEnabledCollections(previousCollections):
+    # Matches the defaults of the import options dialog: keep the previous collections this file shares, otherwise use them all
+    layerCollections = []
+    GetLayerCollections(bpy.context.view_layer.layer_collection, layerCollections)
+    collections = [col.name for col in layerCollections]
+
+    defaultCollections = [col for col in collections if col in (previousCollections or [])]
+    return defaultCollections if defaultCollections else collections
+
+def CanWriteMeshBuffer(objects):
+    # Armatures, skinned meshes and animation still need FBX
+    for obj in objects:
+        if obj.type == "ARMATURE":
+            return False
+        if obj.animation_data and obj.animation_data.action:
+            return False
+        if any(modifier.type == "ARMATURE" for modifier in obj.modifiers):
+            return False
+    return any(obj.type in MESH_OBJECT_TYPES for obj in objects)
+
+def WriteString(f, string):
+    data = string.encode("utf-8")
+    f.write(struct.pack("<I", len(data)))
+    f.write(data)
+    f.write(b"\0" * ((4 - len(data) % 4) % 4))
+
+def GetCornerNormals(mesh):
+    normals = array.array("f", [0.0]) * (len(mesh.loops) * 3)
+    if hasattr(mesh, "corner_normals"):
+        mesh.corner_normals.foreach_get("vector", normals)
+    else:
+        mesh.calc_normals_split()
+        mesh.loops.foreach_get("normal", normals)
+    return normals
+
+def GetCornerColors(mesh, cornerVertices):
+    attributes = getattr(mesh, "color_attributes", None)
+    if attributes is not None:
+        attribute = attributes.active_color
+    else:
+        attribute = mesh.vertex_colors.active
+    if attribute is None:
+        return None
+
+    domain = getattr(attribute, "domain", "CORNER")
+    if domain not in { "CORNER", "POINT" }:
+        return None
+
+    values = array.array("f", [0.0]) * (len(attribute.data) * 4)
+    attribute.data.foreach_get("color", values)
+    if domain == "CORNER":
+        return values
+
+    colors = array.array("f", [0.0]) * (len(cornerVertices) * 4)
+    for corner, vertex in enumerate(cornerVertices):
+        colors[corner * 4:corner * 4 + 4] = values[vertex * 4:vertex * 4 + 4]
+    return colors
+
+def GetLinkedDuplicates(objects):
+    # Only objects whose evaluated meshes are the same, so no modifiers or materials linked to the object instead of the mesh
+    groups = {}
+    for obj in objects:
+        if obj.type != "MESH" or obj.data.users < 2 or len(obj.modifiers) > 0:
+            continue
+        if any(slot.link == "OBJECT" for slot in obj.material_slots):
+            continue
+        groups.setdefault(obj.data, []).append(obj)
+    return [group for group in groups.values() if len(group) > 1]
+
+def WriteMeshObject(f, obj, depsgraph, unitScale, name, localSpace=False, instances=None, lodIndex=0, baseIndex=0):
+    evaluated = obj.evaluated_get(depsgraph)
+    mesh = evaluated.to_mesh()
+    try:
+        if localSpace:
+            mesh.transform(Matrix.Scale(unitScale, 4))
+        else:
+            mesh.transform(Matrix.Scale(unitScale, 4) @ obj.matrix_world)
+            if obj.matrix_world.is_negative:
+                mesh.flip_normals()
+        mesh.calc_loop_triangles()
+
+        hasTangents = len(mesh.uv_layers) > 0
+        if hasTangents:
+            mesh.calc_tangents()
+
+        numVertices = len(mesh.vertices)
+        numCorners = len(mesh.loops)
+        numTriangles = len(mesh.loop_triangles)
+
+        positions = array.array("f", [0.0]) * (numVertices * 3)
+        mesh.vertices.foreach_get("co", positions)
+        cornerVertices = array.array("i", [0]) * numCorners
+        mesh.loops.foreach_get("vertex_index", cornerVertices)
+        normals = GetCornerNormals(mesh)
+        colors = GetCornerColors(mesh, cornerVertices)
+        triangleCorners = array.array("i", [0]) * (numTriangles * 3)
+        mesh.loop_triangles.foreach_get("loops", triangleCorners)
+        triangleMaterials = array.array("i", [0]) * numTriangles
+        mesh.loop_triangles.foreach_get("material_index", triangleMaterials)
+
+        materialNames = [slot.material.name if slot.material else "" for slot in obj.material_slots]
+        if not materialNames:
+            materialNames = [""]
+
+        f.write(struct.pack("<10I", numVertices, numCorners, numTriangles, len(mesh.uv_layers), colors is not None, hasTangents, len(materialNames), len(instances or []), lodIndex, baseIndex))
+        WriteString(f, name)
+        for materialName in materialNames:
+            WriteString(f, materialName)
+
+        f.write(positions.tobytes())
+        f.write(cornerVertices.tobytes())
+        f.write(normals.tobytes())
+        if hasTangents:
+            tangents = array.array("f", [0.0]) * (numCorners * 3)
+            mesh.loops.foreach_get("tangent", tangents)
+            bitangentSigns = array.array("f", [0.0]) * numCorners
+            mesh.loops.foreach_get("bitangent_sign", bitangentSigns)
+            f.write(tangents.tobytes())
+            f.write(bitangentSigns.tobytes())
+        for uvLayer in mesh.uv_layers:
+            uvs = array.array("f", [0.0]) * (numCorners * 2)
+            uvLayer.data.foreach_get("uv", uvs)
+            f.write(uvs.tobytes())
+        if colors is not None:
+            f.write(colors.tobytes())
+        f.write(triangleCorners.tobytes())
+        f.write(triangleMaterials.tobytes())
+        for instance in instances or []:
+            transform = instance.matrix_world.copy()
+            transform.translation *= unitScale
+            f.write(struct.pack("<16f", *[value for row in transform for value in row]))
+    finally:
+        evaluated.to_mesh_clear()
+
+def WriteMeshBuffer(filename, objects, instanceLinkedDuplicates, lods):
+    depsgraph = bpy.context.evaluated_depsgraph_get()
+    unitScale = bpy.context.scene.unit_settings.scale_length
+    meshObjects = [obj for obj in objects if obj.type in MESH_OBJECT_TYPES]
+
+    linkedDuplicates = GetLinkedDuplicates(meshObjects) if instanceLinkedDuplicates else []
+    instancedObjects = set(obj for group in linkedDuplicates for obj in group)
+    meshObjects = [obj for obj in meshObjects if obj not in instancedObjects]
+    for group in linkedDuplicates:
+        print ("Instancing mesh " + group[0].data.name + " for " + str(len(group)) + " objects")
+
+    # LOD 0 objects as (object, name, instances), then each LOD as (object, name, base index)
+    baseObjects = [(obj, obj.name, None) for obj in meshObjects] + [(group[0], group[0].data.name, group) for group in linkedDuplicates]
+    lodObjects = []
+    numLODs = max([len(objectLODs) for objectLODs in lods.values()] + [1])
+    for lodIndex in range(1, numLODs):
+        for baseIndex, (obj, name, instances) in enumerate(baseObjects):
+            objectLODs = lods.get(obj, [])
+            if lodIndex < len(objectLODs):
+                lodObjects.append((objectLODs[lodIndex], name + "_LOD" + str(lodIndex), lodIndex, baseIndex))
+
+    # Written next to the final file and moved into place, so the plugin never maps a partly written buffer
+    tempFilename = filename + ".tmp"
+    with open(tempFilename, "wb") as f:
+        f.write(MESH_BUFFER_MAGIC)
+        f.write(struct.pack("<2I", MESH_BUFFER_VERSION, len(baseObjects) + len(lodObjects)))
+        for baseIndex, (obj, name, instances) in enumerate(baseObjects):
+            WriteMeshObject(f, obj, depsgraph, unitScale, name, instances is not None, instances, 0, baseIndex)
+        for obj, name, lodIndex, baseIndex in lodObjects:
+            WriteMeshObject(f, obj, depsgraph, unitScale, name, baseObjects[baseIndex][2] is not None, None, lodIndex, baseIndex)
+    os.replace(tempFilename, filename)
+
+def AddDecimatedLODs(objects, numLODs, reductionRatio):
+    # Copies sharing each object's mesh, with a decimate modifier for each LOD. Skinned meshes are left alone, decimating would break their weights.
+    lods = {}
+    for obj in objects:
+        if obj.type != "MESH" or any(modifier.type == "ARMATURE" for modifier in obj.modifiers):
+            continue
+
+        objectLODs = [obj]
+        for lodIndex in range(1, numLODs):
+            lod = obj.copy()
+            lod.name = obj.name + "_LOD" + str(lodIndex)
+            lod.animation_data_clear()
+            for collection in obj.users_collection:
+                collection.objects.link(lod)
+
+            modifier = lod.modifiers.new("UnrealLOD", "DECIMATE")
+            modifier.ratio = reductionRatio ** lodIndex
+            objectLODs.append(lod)
+        lods[obj] = objectLODs
+    return lods
+
+def AddLODGroups(lods):
+    # Blender's FBX exporter writes an empty with an "fbx_type" of "LodGroup" as an FBX LOD group, whose children Unreal imports as the LODs in order
+    groups = []
+    for obj, objectLODs in lods.items():
+        group = bpy.data.objects.new(obj.name + "_LODGroup", None)
+        group["fbx_type"] = "LodGroup"
+        for collection in obj.users_collection:
+            collection.objects.link(group)
+        group.parent = obj.parent
+        group.matrix_world = obj.matrix_world.copy()
+        groups.append((group, objectLODs))
+
+    bpy.context.view_layer.update()
+    for group, objectLODs in groups:
+        for lod in objectLODs:
+            matrix = lod.matrix_world.copy()
+            lod.parent = group
+            lod.matrix_world = matrix
+            lod.select_set(True)
+        group.select_set(True)
+
+def RemoveFile(filename):
+    if filename and os.path.exists(filename):
+        os.remove(filename)
+
+def GetPackedImageExtension(image):
+    extension = os.path.splitext(bpy.path.abspath(image.filepath))[1].lower()
+    if extension:
+        return extension
+    return IMAGE_FORMAT_EXTENSIONS.get(image.file_format, ".png")
+
+def ExtractPackedImages(textureCacheDir):
+    # Each image is written once under its content hash, so images shared between .blend files (or exports) are only written and imported once
+    os.makedirs(textureCacheDir, exist_ok=True)
+    for image in bpy.data.images:
+        if image.packed_file is None:
+            continue
+
+        data = image.packed_file.data
+        imageHash = hashlib.sha1(data).hexdigest()[:16]
+        filename = os.path.join(textureCacheDir, "T_" + imageHash + GetPackedImageExtension(image))
+        if not os.path.exists(filename):
+            # Moved into place, as the cache can be shared with other editors extracting the same image
+            tempFilename = filename + "." + str(os.getpid()) + ".tmp"
+            with open(tempFilename, "wb") as f:
+                f.write(data)
+            os.replace(tempFilename, filename)
+
+        print ("Extracted packed image " + image.name + ": " + filename)
+        image.filepath = filename
+        image.unpack(method='REMOVE')
+        WriteResult({ "type": "packed_image", "name": image.name, "hash": imageHash, "file": filename })
+
 def FixMaterials():
     for mat in bpy.data.materials:
         BSDFNode = FindBSDFNode(mat)
@@ -50,11 +447,32 @@ def FixMaterials():
                 mat.node_tree.links.remove(BSDFNode.inputs["Metallic"].links[0])
 
 # Main
+startTime = time.perf_counter()
+WriteResult({ "type": "begin", "protocol": PROTOCOL_VERSION, "script": "blender_export", "blender": bpy.app.version_string })
 
 outfile = os.getenv("UNREAL_IMPORTER_OUTPUT_FILE")
 set_object_pivot = (os.getenv("UNREAL_IMPORTER_EXPORT_OBJECT_PIVOT") == 'true')
 fix_materials = (os.getenv("UNREAL_IMPORTER_FIX_MATERIALS") == 'true')
 unpack = (os.getenv("UNREAL_IMPORTER_UNPACK") == 'true')
+default_collections = (os.getenv("UNREAL_IMPORTER_DEFAULT_COLLECTIONS") == 'true')
+mesh_buffer_file = os.getenv("UNREAL_IMPORTER_MESH_BUFFER_FILE")
+direct_mesh = (os.getenv("UNREAL_IMPORTER_DIRECT_MESH") == 'true') and mesh_buffer_file
+export_objects = json.loads(os.getenv("UNREAL_IMPORTER_EXPORT_OBJECTS") or "null")
+previous_fingerprints = json.loads(os.getenv("UNREAL_IMPORTER_PREVIOUS_FINGERPRINTS") or "null")
+changed_only = (os.getenv("UNREAL_IMPORTER_CHANGED_ONLY") == 'true') and previous_fingerprints is not None
+texture_cache_dir = os.getenv("UNREAL_IMPORTER_TEXTURE_CACHE_DIR")
+instance_linked_duplicates = (os.getenv("UNREAL_IMPORTER_INSTANCE_LINKED_DUPLICATES") == 'true')
+lod_count = min(max(int(os.getenv("UNREAL_IMPORTER_LOD_COUNT") or "1"), 1), 8)
+# The same range as UBlendImportOptions::MinLODReductionRatio and MaxLODReductionRatio
+lod_reduction_ratio = min(max(float(os.getenv("UNREAL_IMPORTER_LOD_REDUCTION_RATIO") or "0.5"), 0.05), 0.95)
+
+# Instances are placed from every object sharing a mesh, so exports of only some objects, or without their transforms, don't instance
+if export_objects is not None or changed_only or set_object_pivot:
+    instance_linked_duplicates = False
+
+# When run straight after analysis, the plugin doesn't know about packed images yet
+if os.getenv("UNREAL_IMPORTER_UNPACK") == 'auto':
+    unpack = any(image.packed_file is not None for image in bpy.data.images)
 
 if outfile is None:
     outfile = bpy.data.filepath + ".fbx"
@@ -65,11 +483,17 @@ if enabled_collections == "":
 if enabled_collections is not None:
     enabled_collections = enabled_collections.split(",")
 
+if default_collections:
+    enabled_collections = GetDefaultEnabledCollections(enabled_collections)
+
 print ("OutFile: " + outfile)
 print ("Set Object Pivot: " + str(set_object_pivot))
 print ("Fix Materials: " + str(fix_materials))
 print ("Unpack: " + str(unpack))
+print ("Texture Cache: " + str(texture_cache_dir))
+print ("Instance Linked Duplicates: " + str(instance_linked_duplicates))
 print ("Enabled Collections: " + str(enabled_collections))
+print ("LODs: " + str(lod_count) + ", Reduction Ratio: " + str(lod_reduction_ratio))
 
 if fix_materials:
     FixMaterials()
@@ -89,28 +513,87 @@ else:
         if obj.visible_get():
             obj.select_set(True)
 
-path_mode="AUTO"
-embed_textures=False
-
-if unpack:
-    path_mode="COPY"
-    embed_textures=True
-
-bpy.ops.export_scene.fbx(filepath=outfile,
-    axis_forward='-Z',
-    axis_up='Y',
-    check_existing=False,
-    object_types={'ARMATURE','CAMERA','LIGHT','MESH','OTHER','EMPTY'},
-    mesh_smooth_type='FACE', # This prevents a warning about undefined smoothing groups in Unreal
-    use_selection=True,
-    use_custom_props=True,
-    apply_scale_options='FBX_SCALE_NONE',
-    bake_anim_use_nla_strips=True,
-    bake_anim_use_all_actions=True,
-    add_leaf_bones=False,
-    use_armature_deform_only=False,
-    path_mode=path_mode,
-    embed_textures=embed_textures)
+# Reimporting one of several meshes made from the file only exports the objects it was made from, and any objects added since
+if export_objects is not None:
+    for obj in bpy.context.selected_objects:
+        if obj.name not in export_objects and not (changed_only and obj.name not in previous_fingerprints):
+            obj.select_set(False)
+
+# Extracted before fingerprinting, so the fingerprints of objects using packed images change with the images' contents
+if unpack and texture_cache_dir:
+    ExtractPackedImages(texture_cache_dir)
+    unpack = False
+
+WriteResult({ "type": "timing", "stage": "prepare", "seconds": time.perf_counter() - startTime })
+evaluateStartTime = time.perf_counter()
+
+# Export settings and versions are part of every fingerprint, as changing them changes the exported objects too
+fingerprintSeed = (PROTOCOL_VERSION, MESH_BUFFER_VERSION, bpy.app.version_string, fix_materials, unpack, bool(direct_mesh), instance_linked_duplicates, lod_count, lod_reduction_ratio)
+depsgraph = bpy.context.evaluated_depsgraph_get()
+fingerprints = { obj.name: GetObjectFingerprint(obj, depsgraph, fingerprintSeed) for obj in bpy.context.selected_objects }
+unchanged = previous_fingerprints is not None and fingerprints == previous_fingerprints
+
+# When each object is its own asset, a grouped reimport only exports the objects that changed
+if changed_only and not unchanged:
+    for obj in bpy.context.selected_objects:
+        if previous_fingerprints.get(obj.name) == fingerprints[obj.name]:
+            obj.select_set(False)
+            del fingerprints[obj.name]
+    unchanged = len(fingerprints) == 0
+
+for obj in bpy.context.selected_objects:
+    stats = GetObjectStats(obj)
+    stats["fingerprint"] = fingerprints[obj.name]
+    WriteResult(stats)
+
+WriteResult({ "type": "timing", "stage": "evaluate", "seconds": time.perf_counter() - evaluateStartTime })
+exportStartTime = time.perf_counter()
+
+# Made after fingerprinting, so the copies aren't fingerprinted or reported as objects of their own
+lods = {}
+if lod_count > 1 and not unchanged:
+    lods = AddDecimatedLODs(bpy.context.selected_objects, lod_count, lod_reduction_ratio)
+    print ("Generated " + str(lod_count - 1) + " LODs for " + str(len(lods)) + " objects")
+
+# Only one of the outputs is left behind, which tells the plugin how to import it
+if unchanged:
+    print ("Exported objects are unchanged, skipping export")
+    WriteResult({ "type": "unchanged" })
+    RemoveFile(outfile)
+    RemoveFile(mesh_buffer_file)
+elif direct_mesh and CanWriteMeshBuffer(bpy.context.selected_objects):
+    print ("Writing mesh buffer: " + mesh_buffer_file)
+    WriteMeshBuffer(mesh_buffer_file, bpy.context.selected_objects, instance_linked_duplicates, lods)
+    RemoveFile(outfile)
+else:
+    RemoveFile(mesh_buffer_file)
+    AddLODGroups(lods)
+
+    path_mode="AUTO"
+    embed_textures=False
+
+    if unpack:
+        path_mode="COPY"
+        embed_textures=True
+
+    bpy.ops.export_scene.fbx(filepath=outfile,
+        axis_forward='-Z',
+        axis_up='Y',
+        check_existing=False,
+        object_types={'ARMATURE','CAMERA','LIGHT','MESH','OTHER','EMPTY'},
+        mesh_smooth_type='FACE', # This prevents a warning about undefined smoothing groups in Unreal
+        use_selection=True,
+        use_custom_props=True,
+        apply_scale_options='FBX_SCALE_NONE',
+        bake_anim_use_nla_strips=True,
+        bake_anim_use_all_actions=True,
+        add_leaf_bones=False,
+        use_armature_deform_only=False,
+        path_mode=path_mode,
+        embed_textures=embed_textures)
+
+WriteResult({ "type": "timing", "stage": "export", "seconds": time.perf_counter() - exportStartTime })
+WriteResult({ "type": "end", "script": "blender_export" })
 
 print ("Export Complete")
 
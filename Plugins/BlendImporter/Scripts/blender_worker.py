@@ -0,0 +1,75 @@
+import bpy
+import json
+import os
+import runpy
+import sys
+import time
+import traceback
+
+# Resident loop for the persistent Blender worker. Jobs arrive on stdin as one JSON object per line,
+# and everything a job prints is bracketed by marker lines so the plugin can tell it apart from Blender's own output.
+
+MARKER = "@@BLENDIMPORTER|"
+
+# Functions
+
+def Send(message):
+    sys.stdout.flush()
+    print(MARKER + message, flush=True)
+
+def WriteTiming(stage, seconds):
+    resultFile = os.getenv("UNREAL_IMPORTER_RESULT_FILE")
+    if resultFile:
+        with open(resultFile, "a", encoding="utf-8") as f:
+            f.write(json.dumps({ "type": "timing", "stage": stage, "seconds": seconds }) + "\n")
+
+def RunJob(job):
+    Send("BEGIN|" + str(job["id"]))
+
+    success = True
+    savedEnvironment = dict(os.environ)
+    try:
+        os.environ.update(job.get("env", {}))
+        openStartTime = time.perf_counter()
+        bpy.ops.wm.open_mainfile(filepath=job["file"])
+        WriteTiming("open", time.perf_counter() - openStartTime)
+        for script in job["scripts"]:
+            runpy.run_path(script, run_name="__main__")
+    except SystemExit as e:
+        success = not e.code
+    except Exception:
+        traceback.print_exc()
+        success = False
+    finally:
+        os.environ.clear()
+        os.environ.update(savedEnvironment)
+
+    Send("END|" + str(job["id"]) + "|" + ("1" if success else "0"))
+
+# Main
+
+Send("READY")
+
+while True:
+    line = sys.stdin.readline()
+    if not line:
+        break
+
+    line = line.strip()
+    if not line:
+        continue
+
+    if line == "PING":
+        Send("PONG")
+        continue
+
+    if line == "QUIT":
+        break
+
+    try:
+        job = json.loads(line)
+    except ValueError:
+        Send("ERROR|Malformed job")
+        continue
+
+    RunJob(job)
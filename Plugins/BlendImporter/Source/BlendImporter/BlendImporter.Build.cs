@@ -1,5 +1,6 @@
 // Copyright 2022 nuclearfriend
 
+using System.IO;
 using UnrealBuildTool;
 
 public class BlendImporter : ModuleRules
@@ -50,12 +51,38 @@ public class BlendImporter : ModuleRules
 			{
 				"CoreUObject",
 				"Engine",
+				"Json",
+				"AssetTools",
+				"MeshDescription",
+				"StaticMeshDescription",
+				"MaterialEditor",
+				"DirectoryWatcher",
 
 				// ... add private dependencies that you statically link with here ...	
 			}
 		);
 		
 
+		// zstd compressed .blend files (Blender 3.0+) can be read without Blender if a zstd library is provided in Source/ThirdParty/zstd
+		string ZstdPath = Path.Combine(PluginDirectory, "Source", "ThirdParty", "zstd");
+		if (Directory.Exists(ZstdPath))
+		{
+			PrivateIncludePaths.Add(Path.Combine(ZstdPath, "include"));
+			if (Target.Platform == UnrealTargetPlatform.Win64)
+			{
+				PublicAdditionalLibraries.Add(Path.Combine(ZstdPath, "lib", "Win64", "zstd_static.lib"));
+			}
+			else
+			{
+				PublicAdditionalLibraries.Add(Path.Combine(ZstdPath, "lib", Target.Platform.ToString(), "libzstd.a"));
+			}
+			PrivateDefinitions.Add("WITH_BLENDIMPORTER_ZSTD=1");
+		}
+		else
+		{
+			PrivateDefinitions.Add("WITH_BLENDIMPORTER_ZSTD=0");
+		}
+
 		DynamicallyLoadedModuleNames.AddRange(
 			new string[]
 			{
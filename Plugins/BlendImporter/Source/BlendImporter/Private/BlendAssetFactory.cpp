@@ -1,20 +1,45 @@
 // Copyright 2022 nuclearfriend
 
 #include "BlendAssetFactory.h"
+#include "BlendExportCache.h"
+#include "BlendFileHashes.h"
+#include "BlendFileAnalysis.h"
 #include "BlendImporter.h"
 #include "BlendImporterSettings.h"
+#include "BlendImportQueue.h"
+#include "BlendInstancedActors.h"
+#include "BlendMasterMaterials.h"
+#include "BlendMeshBuffer.h"
+#include "BlenderJob.h"
+#include "BlenderResultReader.h"
 #include "SBlendAssetImportDialog.h"
 #include "AssetRegistryModule.h"
-#include "DesktopPlatformModule.h"
+#include "Async/Async.h"
+#include "AutoReimport/AssetSourceFilenameCache.h"
+#include "Dom/JsonObject.h"
 #include "EditorFramework/AssetImportData.h"
 #include "Factories/FbxFactory.h"
+#include "Factories/FbxImportUI.h"
+#include "Factories/FbxStaticMeshImportData.h"
+#include "Framework/Application/SlateApplication.h"
 #include "Framework/Notifications/NotificationManager.h"
 #include "IAssetRegistry.h"
 #include "Interfaces/IPluginManager.h"
 #include "ISettingsModule.h"
 #include "Logging/MessageLog.h"
+#include "MeshDescription.h"
+#include "Misc/App.h"
+#include "Misc/PackageName.h"
 #include "Misc/ScopedSlowTask.h"
+#include "Misc/ScopeExit.h"
+#include "ObjectTools.h"
+#include "StaticMeshResources.h"
+#include "Policies/CondensedJsonPrintPolicy.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
 #include "UObject/MetaData.h"
+#include "UObject/StrongObjectPtr.h"
 
 #define LOCTEXT_NAMESPACE "BlendAssetFactory"
 
@@ -30,12 +55,37 @@ bool UBlendImportOptions::LoadMetaData(UObject* Obj)
     return FromString(Data);
 }
 
+void UBlendImportOptions::GetAssetRegistryTags(const UObject* Object, TArray<UObject::FAssetRegistryTag>& OutTags)
+{
+    if (Object == nullptr || !(Object->IsA<UStaticMesh>() || Object->IsA<USkeletalMesh>()))
+    {
+        return;
+    }
+
+    // Found rather than got, which would add metadata to every package saved
+    UMetaData* MetaData = FindObjectFast<UMetaData>(Object->GetOutermost(), FName(NAME_PackageMetaData));
+    const FString* Data = MetaData ? MetaData->FindValue(Object, TEXT("BLEND_IMPORT")) : nullptr;
+    if (Data && !Data->IsEmpty())
+    {
+        OutTags.Add(UObject::FAssetRegistryTag(TEXT("BlendImportOptions"), *Data, UObject::FAssetRegistryTag::TT_Hidden));
+    }
+}
+
+bool UBlendImportOptions::FindAssetRegistryTag(const FAssetData& AssetData, FString& OutString)
+{
+    return AssetData.GetTagValue(TEXT("BlendImportOptions"), OutString);
+}
+
 FString UBlendImportOptions::ToString() const
 {
     FString Data;
     Data.Append(bUseObjectPivot ? TEXT("true") : TEXT("false"));
     Data.Append(TEXT(";"));
     Data.Append(*FString::Join(EnabledCollections, TEXT(",")));
+    Data.Append(TEXT(";"));
+    Data.Append(FString::FromInt(NumLODs));
+    Data.Append(TEXT(";"));
+    Data.Append(FString::SanitizeFloat(LODReductionRatio));
     return Data;
 }
 
@@ -43,13 +93,16 @@ bool UBlendImportOptions::FromString(const FString& Data)
 {
 	TArray<FString> Params;
 	const int32 nArraySize = Data.ParseIntoArray(Params, TEXT(";"), false);
-    if (nArraySize == 2)
+    // Options saved before LODs could be generated only have the first two
+    if (nArraySize == 2 || nArraySize == 4)
     {
         bUseObjectPivot = Params[0].ToBool();
         if (!Params[1].IsEmpty())
         {
             Params[1].ParseIntoArray(EnabledCollections, TEXT(","), true);
         }
+        NumLODs = nArraySize == 4 ? FMath::Clamp(FCString::Atoi(*Params[2]), 1, MaxLODs) : 1;
+        LODReductionRatio = nArraySize == 4 ? FMath::Clamp(FCString::Atof(*Params[3]), MinLODReductionRatio, MaxLODReductionRatio) : 0.5f;
         return true;
     }
     else
@@ -59,6 +112,25 @@ bool UBlendImportOptions::FromString(const FString& Data)
     }
 }
 
+TArray<FString> UBlendImportOptions::GetDefaultEnabledCollections(const TArray<FString>& Collections) const
+{
+    return GetDefaultEnabledCollections(EnabledCollections, Collections);
+}
+
+TArray<FString> UBlendImportOptions::GetDefaultEnabledCollections(const TArray<FString>& PreviousCollections, const TArray<FString>& Collections)
+{
+    // Keep the previously enabled collections if this file shares any, otherwise enable everything
+    TArray<FString> DefaultCollections;
+    for (const FString& Collection : Collections)
+    {
+        if (PreviousCollections.Contains(Collection))
+        {
+            DefaultCollections.Add(Collection);
+        }
+    }
+    return DefaultCollections.Num() > 0 ? DefaultCollections : Collections;
+}
+
 UBlendAssetFactory::UBlendAssetFactory(const FObjectInitializer& ObjectInitializer)
     : Super(ObjectInitializer)
 {
@@ -69,6 +141,10 @@ UBlendAssetFactory::UBlendAssetFactory(const FObjectInitializer& ObjectInitializ
 	SupportedClass = UStaticMesh::StaticClass(); // TODO: Figure out if this is a problem, when this also supports SkeletalMesh etc?
     FbxFactory = NewObject<UFbxFactory>(UFbxFactory::StaticClass());
     ImportOptions = GetMutableDefault<UBlendImportOptions>();
+    PreparedImportOptions = nullptr;
+    bSkippedUnchangedImport = false;
+    bExportChangedOnly = false;
+    NumAnalysedMaterials = 0;
 }
 
 bool UBlendAssetFactory::ConfigureProperties()
@@ -98,15 +174,45 @@ void UBlendAssetFactory::CleanUp()
 
 UObject* UBlendAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InParent, FName InName, EObjectFlags Flags, const FString& Filename, const TCHAR* Parms, FFeedbackContext* Warn, bool& bOutOperationCanceled)
 {
+    BLENDIMPORTER_TRACE_SCOPE(UBlendAssetFactory::FactoryCreateFile);
+    ImportSummary.Reset(Filename);
+    // Failed and cancelled imports are reported too, with however far they got
+    ON_SCOPE_EXIT
+    {
+        ImportSummary.Report();
+    };
+    MaterialTemplates.Reset();
+    NumAnalysedMaterials = 0;
+
 	UObject *ExistingObject = nullptr;
 	if (InParent != nullptr)
 	{
 		ExistingObject = StaticFindObject(UObject::StaticClass(), InParent, *(InName.ToString()));
     }
 
+    // Prepared imports use their own options object, so the options the dialog remembers are left as they were
+    const FBlendPreparedImport* Prepared = PreparedImport.IsValid() && FPaths::IsSamePath(PreparedImport->Filename, Filename) ? PreparedImport.Get() : nullptr;
+    if (Prepared)
+    {
+        if (PreparedImportOptions == nullptr)
+        {
+            PreparedImportOptions = NewObject<UBlendImportOptions>(this);
+        }
+        PreparedImportOptions->bUseObjectPivot = Prepared->Options.bUseObjectPivot;
+        PreparedImportOptions->EnabledCollections = Prepared->Options.EnabledCollections;
+        PreparedImportOptions->NumLODs = Prepared->Options.NumLODs;
+        PreparedImportOptions->LODReductionRatio = Prepared->Options.LODReductionRatio;
+        ImportOptions = PreparedImportOptions;
+    }
+    ON_SCOPE_EXIT
+    {
+        ImportOptions = GetMutableDefault<UBlendImportOptions>();
+    };
+
     bool bLoadedImportOptions = false;
 
-    if (ExistingObject != nullptr)
+    // Prepared imports (the import queue and commandlet) bring their own options, other re-imports use the ones saved with the asset
+    if (ExistingObject != nullptr && Prepared == nullptr)
     {
         if (ImportOptions->LoadMetaData(ExistingObject))
         {        
@@ -118,11 +224,52 @@ UObject* UBlendAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InParen
         }
     }
 
+    UBlendImporterSettings* Settings = GetMutableDefault<UBlendImporterSettings>();
+
     bool IsPacked = false;
 
     TArray<FString> Collections;
     FString MaterialWarnings;
-    if (BlendFileAnalyse(Filename, Collections, MaterialWarnings, IsPacked) == false)
+    FString OutputFilename;
+    bool bExported = false;
+    TUniquePtr<FBlenderJob> SpeculativeExport;
+
+    // Only imports the user chose the options for change the level
+    bool bPlaceInstances = false;
+
+    if (Prepared && Prepared->bExported)
+    {
+        // Exported ahead of the import, which leaves only the analysis, unless Blender did that as part of the export
+        OutputFilename = Prepared->OutputFilename;
+        ExportedFingerprints = Prepared->Fingerprints;
+        bExported = true;
+
+        if (Prepared->bAnalysed)
+        {
+            GetAnalysisResults(Prepared->Analysis, Collections, MaterialWarnings, IsPacked);
+        }
+        else if (BlendFileAnalyse(Filename, Collections, MaterialWarnings, IsPacked) == false)
+        {
+            return nullptr;
+        }
+    }
+    else if (bLoadedImportOptions && !IsExportUpToDate(Filename, GetExportFilename(Filename)))
+    {
+        // Options are already known on re-import, so analyse and export while the file is loaded once
+        if (BlendFileAnalyseAndExport(Filename, Collections, MaterialWarnings, IsPacked, OutputFilename) == false)
+        {
+            return nullptr;
+        }
+        bExported = true;
+    }
+    else if (bLoadedImportOptions == false && Settings->IsSpeculativeExport() && !Settings->IsBackgroundImport() && !IsAutomatedImport())
+    {
+        if (BlendFileBeginSpeculativeExport(Filename, Collections, MaterialWarnings, IsPacked, OutputFilename, SpeculativeExport) == false)
+        {
+            return nullptr;
+        }
+    }
+    else if (BlendFileAnalyse(Filename, Collections, MaterialWarnings, IsPacked) == false)
     {
         return nullptr;
     }
@@ -143,13 +290,15 @@ UObject* UBlendAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InParen
         MessageLog.AddMessage(TokenizedWarning);
     }
 
-    if (IsPacked)
+    // Extracted packed textures are referenced by the FBX like unpacked ones, so only embedding them is worth a warning
+    const bool bWarnPacked = IsPacked && !Settings->IsExtractPackedTextures();
+    if (bWarnPacked)
     {
         MessageLog.Warning(FText::Format(LOCTEXT("PackedTextures", "Packed textures have been detected in '{0}', which will inflate the size of the FBX interchange data and increase import times.\n"
-                                                                    "Consider unpacking those resources from your .blend file before importing."), FText::FromString(Filename)));
+                                                                    "Consider unpacking those resources from your .blend file, or enabling Extract Packed Textures, before importing."), FText::FromString(Filename)));
     }
 
-    if ((!MaterialWarnings.IsEmpty() || IsPacked))
+    if ((!MaterialWarnings.IsEmpty() || bWarnPacked))
     {
         // Don't open message log on re-import, to avoid log spam and at this point they're prolly ignoring these warnings anyway
         if (ExistingObject == nullptr)
@@ -158,8 +307,19 @@ UObject* UBlendAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InParen
         }
     }
     
-    if (bLoadedImportOptions == false)
+    if (bLoadedImportOptions == false && (IsAutomatedImport() || Prepared != nullptr))
+    {
+        // No dialog for automated or prepared imports, which use the options the dialog would default to
+        ImportOptions->EnabledCollections = ImportOptions->GetDefaultEnabledCollections(Collections);
+    }
+    else if (bLoadedImportOptions == false)
     {
+        // The speculative export uses the options the dialog will default to
+        const bool bSpeculativeUseObjectPivot = ImportOptions->bUseObjectPivot;
+        const int32 SpeculativeNumLODs = ImportOptions->NumLODs;
+        const float SpeculativeLODReductionRatio = ImportOptions->LODReductionRatio;
+        const TArray<FString> SpeculativeCollections = ImportOptions->GetDefaultEnabledCollections(Collections);
+
         TSharedRef<SBlendAssetImportDialog> ImportDialog =
             SNew(SBlendAssetImportDialog)
             .Filename(FText::FromString(*Filename))
@@ -167,39 +327,193 @@ UObject* UBlendAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InParen
             .PreviousOptions(ImportOptions)
             .ShowMaterialWarning(!MaterialWarnings.IsEmpty());
 
-        if (ImportDialog->ShowModal() == EAppReturnType::Cancel)
+        // Keep draining Blender's output while the dialog is up, so it can't stall on a full pipe
+        FDelegateHandle PollSpeculativeExportHandle;
+        if (SpeculativeExport.IsValid())
+        {
+            PollSpeculativeExportHandle = FSlateApplication::Get().OnPreTick().AddLambda([&SpeculativeExport](float DeltaTime)
+            {
+                TArray<FString> Lines;
+                SpeculativeExport->Poll(Lines);
+            });
+        }
+
+        EAppReturnType::Type DialogResult;
+        {
+            FBlendImportStageScope StageScope(&ImportSummary, TEXT("Options dialog"));
+            DialogResult = ImportDialog->ShowModal();
+        }
+
+        if (PollSpeculativeExportHandle.IsValid())
+        {
+            FSlateApplication::Get().OnPreTick().Remove(PollSpeculativeExportHandle);
+        }
+
+        if (DialogResult == EAppReturnType::Cancel)
         {
             return nullptr;
         }
 
         ImportOptions->bUseObjectPivot = ImportDialog->IsUseObjectPivot();
         ImportOptions->EnabledCollections = ImportDialog->GetEnabledCollections();
+        ImportOptions->NumLODs = ImportDialog->GetNumLODs();
+        ImportOptions->LODReductionRatio = ImportDialog->GetLODReductionRatio();
+        bPlaceInstances = ExistingObject == nullptr && Settings->IsPlaceInstancesInLevel();
+
+        if (Settings->IsBackgroundImport() && InParent != nullptr)
+        {
+            // The queue imports the file again once exported, as an automated import with these options. Reported as cancelled, so this import doesn't show as failed.
+            FBlendQueuedImportOptions QueuedOptions;
+            QueuedOptions.bUseObjectPivot = ImportOptions->bUseObjectPivot;
+            QueuedOptions.EnabledCollections = ImportOptions->EnabledCollections;
+            QueuedOptions.NumLODs = ImportOptions->NumLODs;
+            QueuedOptions.LODReductionRatio = ImportOptions->LODReductionRatio;
+            FBlendImporterModule::Get().GetImportQueue().Enqueue(Filename, FPackageName::GetLongPackagePath(InParent->GetOutermost()->GetName()), QueuedOptions);
+
+            bOutOperationCanceled = true;
+            return nullptr;
+        }
+
+        if (SpeculativeExport.IsValid())
+        {
+            const bool bOptionsKept = ImportOptions->bUseObjectPivot == bSpeculativeUseObjectPivot
+                && ImportOptions->NumLODs == SpeculativeNumLODs && ImportOptions->LODReductionRatio == SpeculativeLODReductionRatio
+                && ImportOptions->EnabledCollections.Num() == SpeculativeCollections.Num()
+                && ImportOptions->EnabledCollections.FilterByPredicate([&SpeculativeCollections](const FString& Collection) { return SpeculativeCollections.Contains(Collection); }).Num() == SpeculativeCollections.Num();
+
+            if (bOptionsKept)
+            {
+                FString Output;
+                if (SpeculativeExport->Wait(Output) && FPaths::FileExists(*GetExportedFilename(OutputFilename)))
+                {
+                    UE_LOG(LogBlendImporter, Log, TEXT("Using FBX exported while the import options were shown"));
+                    RememberExport(Filename);
+                    ReadExportResult(SpeculativeExport->GetResult());
+                    FBlendImporterModule::Get().GetExportCache().Store(GetExportCacheKey(Filename, ImportOptions->bUseObjectPivot, ImportOptions->EnabledCollections, ImportOptions->NumLODs, ImportOptions->LODReductionRatio), GetExportedFilename(OutputFilename), FingerprintsToString(ExportedFingerprints));
+                    bExported = true;
+                }
+                else
+                {
+                    UE_LOG(LogBlendImporter, Warning, TEXT("Speculative export failed, exporting the FBX again."));
+                }
+            }
+            else
+            {
+                UE_LOG(LogBlendImporter, Log, TEXT("Import options were changed, discarding speculative export"));
+                SpeculativeExport->Cancel();
+            }
+            SpeculativeExport.Reset();
+        }
     }
 
-    FString OutputFilename;
-    if (BlendFileExport(Filename, IsPacked, OutputFilename) == false)
+    FScopedSlowTask SlowTask(2.0f, FText::Format(LOCTEXT("ImportingBlendFile", "Importing '{0}'..."), FText::FromString(FPaths::GetCleanFilename(Filename))));
+
+    SlowTask.EnterProgressFrame(1.0f, LOCTEXT("ExportingFBX", "Exporting FBX from Blender..."));
+    if (bExported == false && BlendFileExport(Filename, IsPacked, OutputFilename) == false)
+    {
+        return nullptr;
+    }
+
+    if (IsExportUnchanged())
     {
+        // Nothing is imported, so the existing assets keep their built data. Reported as cancelled, which the reimport treats as succeeded.
+        UE_LOG(LogBlendImporter, Log, TEXT("None of the objects '%s' was made from changed, skipping import"), *InName.ToString());
+        bSkippedUnchangedImport = true;
+        bOutOperationCanceled = true;
         return nullptr;
     }
 
-    UE_LOG(LogBlendImporter, Log, TEXT("Importing FBX..."));
+    if (ReimportAssets.Num() > 0)
+    {
+        // Name the meshes the way the group was first imported, or import into the asset of the only exported object, so it isn't imported over another asset
+        TArray<FString> ExportedObjectNames;
+        ExportedFingerprints.GetKeys(ExportedObjectNames);
+        const TWeakObjectPtr<UObject>* Asset = ExportedObjectNames.Num() == 1 ? ReimportAssets.Find(ExportedObjectNames[0]) : nullptr;
+        if (Asset && Asset->IsValid())
+        {
+            InParent = (*Asset)->GetOuter();
+            InName = (*Asset)->GetFName();
+        }
+        else
+        {
+            InName = ReimportImportName;
+        }
+    }
+
+    // The FBX importer uses materials that already exist where it imports, so instances made here take the place of the materials it would make
+    TArray<UObject*> MaterialAssets;
+    bool bAllMaterialsInstanced = false;
+    if (Settings->IsUseMasterMaterials() && MaterialTemplates.Num() > 0)
+    {
+        FBlendImportStageScope StageScope(&ImportSummary, TEXT("Materials"));
+        const int32 NumInstanced = FBlendMasterMaterials::CreateInstances(MaterialTemplates, FPackageName::GetLongPackagePath(InParent->GetOutermost()->GetName()), MaterialAssets);
+        bAllMaterialsInstanced = NumInstanced == NumAnalysedMaterials;
+        UE_LOG(LogBlendImporter, Log, TEXT("%d of %d materials are instances of master materials"), NumInstanced, NumAnalysedMaterials);
 
-    // HACK: Temporarily disable notification manager so we don't see the "FBX Imported" double notification as well as the ".blend Imported"
-    FSlateNotificationManager::Get().SetAllowNotifications(false);
-    UObject* MainObject = StaticImportObject(InClass, InParent, InName, Flags, *OutputFilename, nullptr, FbxFactory, Parms, Warn);
-    FSlateNotificationManager::Get().SetAllowNotifications(true);
+        if (AssetImportTask && AssetImportTask->bSave)
+        {
+            FBlendMasterMaterials::SavePackages(MaterialAssets);
+        }
+    }
 
+    UObject* MainObject = nullptr;
 	TArray<UObject*> ImportedObjects;
-    if (MainObject)
+
+    const FString ExportedFilename = GetExportedFilename(OutputFilename);
+    if (ExportedFilename != OutputFilename)
     {
-        ImportedObjects.Add(MainObject);
-    }
+        UE_LOG(LogBlendImporter, Log, TEXT("Importing mesh data..."));
+        SlowTask.EnterProgressFrame(1.0f, LOCTEXT("ImportingMeshData", "Building mesh..."));
 
-    for (UObject* AdditionalObject : FbxFactory->GetAdditionalImportedObjects())
+        ImportSummary.SetExportedFile(ExportedFilename);
+        FBlendImportStageScope StageScope(&ImportSummary, TEXT("Import"));
+        MainObject = ImportMeshBuffer(InParent, InName, Flags, ExportedFilename, bPlaceInstances, ImportedObjects);
+    }
+    else
     {
-        ImportedObjects.Add(AdditionalObject);
+        UE_LOG(LogBlendImporter, Log, TEXT("Importing FBX..."));
+        SlowTask.EnterProgressFrame(1.0f, LOCTEXT("ImportingFBX", "Importing FBX..."));
+
+        if (IsAutomatedImport())
+        {
+            FbxFactory->SetAutomatedAssetImportData(AutomatedImportData);
+            FbxFactory->SetAssetImportTask(AssetImportTask);
+        }
+
+        // HACK: Temporarily disable notification manager so we don't see the "FBX Imported" double notification as well as the ".blend Imported"
+        FSlateNotificationManager::Get().SetAllowNotifications(false);
+        ImportSummary.SetExportedFile(OutputFilename);
+        {
+            BLENDIMPORTER_TRACE_SCOPE(StaticImportObject);
+            FBlendImportStageScope StageScope(&ImportSummary, TEXT("Import"));
+
+            // Every material's textures were imported for its instance, so the FBX importer doesn't need to import them again
+            const bool bImportTextures = FbxFactory->ImportUI->bImportTextures;
+            FbxFactory->ImportUI->bImportTextures = bImportTextures && !bAllMaterialsInstanced;
+
+            // LODs generated by Blender are in LOD groups, which the FBX importer only reads LODs from when asked to
+            const bool bImportMeshLODs = FbxFactory->ImportUI->StaticMeshImportData->bImportMeshLODs;
+            FbxFactory->ImportUI->StaticMeshImportData->bImportMeshLODs = bImportMeshLODs || ImportOptions->NumLODs > 1;
+
+            MainObject = StaticImportObject(InClass, InParent, InName, Flags, *OutputFilename, nullptr, FbxFactory, Parms, Warn);
+            FbxFactory->ImportUI->bImportTextures = bImportTextures;
+            FbxFactory->ImportUI->StaticMeshImportData->bImportMeshLODs = bImportMeshLODs;
+        }
+        FSlateNotificationManager::Get().SetAllowNotifications(true);
+
+        if (MainObject)
+        {
+            ImportedObjects.Add(MainObject);
+        }
+
+        for (UObject* AdditionalObject : FbxFactory->GetAdditionalImportedObjects())
+        {
+            ImportedObjects.Add(AdditionalObject);
+        }
     }
 
+    const int32 NumImportedMeshes = ImportedObjects.FilterByPredicate([](const UObject* Object) { return Object->IsA<UStaticMesh>() || Object->IsA<USkeletalMesh>(); }).Num();
+
     // Update source file metadata for imported meshes
     for (UObject* ImportedObject : ImportedObjects)
     {
@@ -209,6 +523,7 @@ UObject* UBlendAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InParen
             Mesh->AssetImportData->Update(UAssetImportData::SanitizeImportFilename(Filename, Mesh->GetOutermost()));
 
             ImportOptions->SaveMetaData(Mesh);
+            SaveFingerprints(Mesh, NumImportedMeshes, InName);
         }
 
         USkeletalMesh* SkeletalMesh = Cast<USkeletalMesh>(ImportedObject);
@@ -221,6 +536,7 @@ UObject* UBlendAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InParen
             #endif
 
             ImportOptions->SaveMetaData(SkeletalMesh);
+            SaveFingerprints(SkeletalMesh, NumImportedMeshes, InName);
         }
         
     }
@@ -231,7 +547,7 @@ UObject* UBlendAssetFactory::FactoryCreateFile(UClass* InClass, UObject* InParen
         AnimSequence->AssetImportData->Update(UAssetImportData::SanitizeImportFilename(Filename, AnimSequence->GetOutermost()));
     }
     ImportedAnimations.Empty();
-    
+
     return MainObject;
 }
 
@@ -293,21 +609,17 @@ void UBlendAssetFactory::SetReimportPaths(UObject* Obj, const TArray<FString>& N
 
 EReimportResult::Type UBlendAssetFactory::Reimport(UObject* Obj)
 {
-    UStaticMesh* Mesh = Cast<UStaticMesh>(Obj);
-	if (Mesh)
-	{
-		return ReimportBlendAsset(Mesh, Mesh->AssetImportData);
-	}
+    if (CoalescedReimports.Contains(Obj))
+    {
+        UE_LOG(LogBlendImporter, Log, TEXT("'%s' was reimported with the other assets from its .blend file"), *Obj->GetName());
+        return EReimportResult::Succeeded;
+    }
 
-    USkeletalMesh* SkeletalMesh = Cast<USkeletalMesh>(Obj);
-	if (SkeletalMesh)
-	{
-        #if ENGINE_MAJOR_VERSION <= 4 && ENGINE_MINOR_VERSION <= 26
-            return ReimportBlendAsset(SkeletalMesh, SkeletalMesh->AssetImportData);
-        #else
-           return ReimportBlendAsset(SkeletalMesh, SkeletalMesh->GetAssetImportData());
-        #endif
-	}
+    // The other meshes sharing this one's export are reimported along with it, and skipped if the reimport manager gets to them
+    if (Obj->IsA<UStaticMesh>() || Obj->IsA<USkeletalMesh>())
+    {
+        return ReimportFromSource(GetAssetsFromSameImport(Obj));
+    }
 
     UAnimSequence* AnimSequence = Cast<UAnimSequence>(Obj);
 	if (AnimSequence)
@@ -327,245 +639,1158 @@ int32 UBlendAssetFactory::GetPriority() const
 	return UFactory::GetDefaultImportPriority() * 2;
 }
 
-bool UBlendAssetFactory::RunScriptOnBlendFile(const FString& Filename, const FString& ScriptName, FString& Output)
+bool UBlendAssetFactory::RunScriptOnBlendFile(const FString& Filename, const FString& ScriptName, const TMap<FString, FString>& Environment, FString& Output)
 {
-    UBlendImporterSettings* Settings = GetMutableDefault<UBlendImporterSettings>();
-    FFilePath BlenderExePath = Settings->GetBlenderExecutable();
-    if (BlenderExePath.FilePath.IsEmpty())
+    BLENDIMPORTER_TRACE_SCOPE(UBlendAssetFactory::RunScriptOnBlendFile);
+    FBlendImportStageScope StageScope(&ImportSummary, TEXT("Blender"));
+
+    FBlenderJob Job(Filename, { ScriptName }, Environment);
+    if (!Job.Start() || !Job.Wait(Output))
     {
-        UE_LOG(LogBlendImporter, Error, TEXT("Blender executable has not been set."));
         return false;
     }
 
-    FString FullPathFileName = FPaths::ConvertRelativePathToFull(Filename);
-
-    // Create process to execute Blender
-    FString PluginPath = IPluginManager::Get().FindPlugin(TEXT("BlendImporter"))->GetBaseDir();
-    FString BlenderScriptPath = PluginPath + FString::Printf(TEXT("/Scripts/%s.py"), *ScriptName);
+    ReadExportResult(Job.GetResult());
+    return true;
+}
 
-    FString BlenderParameters = TEXT("-noaudio --python-exit-code 1");
+bool UBlendAssetFactory::BlendFileAnalyse(const FString& Filename, TArray<FString>& Collections, FString& MaterialWarnings, bool& IsPacked)
+{
+    BLENDIMPORTER_TRACE_SCOPE(UBlendAssetFactory::BlendFileAnalyse);
+    FBlendImportStageScope StageScope(&ImportSummary, TEXT("Analyse"));
 
-    if (Settings->IsDebug())
+    if (BlendFileAnalyseNative(Filename, Collections, MaterialWarnings, IsPacked))
     {
-        BlenderParameters += TEXT(" -d");
+        return true;
     }
 
-    if (Settings->IsFactoryStartup())
+    FString Output;
+    FBlenderJob Job(Filename, { TEXT("blender_analyse") }, TMap<FString, FString>());
     {
-        BlenderParameters += TEXT(" --factory-startup");
+        FBlendImportStageScope BlenderStageScope(&ImportSummary, TEXT("Blender"));
+        if (!Job.Start() || !Job.Wait(Output) || !Job.GetResult().HasCompleted(TEXT("blender_analyse")))
+        {
+            return false;
+        }
     }
+    ImportSummary.AddBlenderResult(Job.GetResult());
 
-    if (Settings->IsRunInBackground())
-    {
-        BlenderParameters += TEXT(" -b");
-    }
-    else
+    GetAnalysisResults(Job.GetResult().GetAnalysis(), Collections, MaterialWarnings, IsPacked);
+    return true;
+}
+
+bool UBlendAssetFactory::BlendFileAnalyseNative(const FString& Filename, TArray<FString>& Collections, FString& MaterialWarnings, bool& IsPacked)
+{
+    UBlendImporterSettings* Settings = GetMutableDefault<UBlendImporterSettings>();
+    if (!Settings->IsNativeAnalysis())
     {
-        BlenderParameters += TEXT(" -w --no-window-focus");
+        return false;
     }
-    
-    FString BlenderProcessParms = FString::Printf(TEXT("%s \"%s\" -P \"%s\""), *BlenderParameters, *FullPathFileName, *BlenderScriptPath);
-    
-    void* ReadPipe = nullptr;
-	void* WritePipe = nullptr;
-    if (!FPlatformProcess::CreatePipe(ReadPipe, WritePipe))
-	{
-        UE_LOG(LogBlendImporter, Error, TEXT("Failed to create Pipes for Blender process"));
-		return nullptr;
-	}
-	check(ReadPipe);
-	check(WritePipe);
 
-    FProcHandle ProcessHandle = FPlatformProcess::CreateProc(*BlenderExePath.FilePath, *BlenderProcessParms, /* bLaunchDetached = */ false, /* bLaunchHidden = */ true, /* bLaunchReallyHidden = */ true, nullptr, 0, nullptr, WritePipe, ReadPipe);
+    const double StartTime = FPlatformTime::Seconds();
 
-    bool bResult = false;
-    if (ProcessHandle.IsValid())
+    FString Error;
+    FBlendFileAnalysis Analysis;
+    if (!Analysis.Analyse(Filename, Error))
     {
-        UE_LOG(LogBlendImporter, Log, TEXT("Running %s %s"), *BlenderExePath.FilePath, *BlenderProcessParms);
+        UE_LOG(LogBlendImporter, Log, TEXT("Could not read '%s' directly (%s), analysing it in Blender instead"), *Filename, *Error);
+        return false;
+    }
 
-        bool bTerminated = false;
+    GetAnalysisResults(Analysis, Collections, MaterialWarnings, IsPacked);
 
-        double UnresponsiveWarningTime = FPlatformTime::Seconds() + Settings->GetUnresponsiveWarningDuration();
-        while (FPlatformProcess::IsProcRunning(ProcessHandle))
-		{
-            if (FPlatformTime::Seconds() > UnresponsiveWarningTime)
-            {
-                const FText ErrorTitle = LOCTEXT("BlendImporterError", "Blend Importer Error");
-                const FText ErrorMessage = LOCTEXT("BlenderSlow", "Blender does not appear to be responding, or is taking a while to process your file.\n\nIf you are working with particularly large files or utilise a lot of Blender addons, you can try increasing the duration before this warning is triggered in the settings.\n\nAlternatively, if your Blender has become unresponsive, there may be a problem with your Blender setup and you should consult the Blend Importer Plugin documentation for solutions.\n\nEither way, would you like to try waiting a bit more for Blender to complete it's task?");
-                
-                if (FMessageDialog::Open(EAppMsgType::YesNo, ErrorMessage, &ErrorTitle) == EAppReturnType::Yes)
-                {
-                    UnresponsiveWarningTime = FPlatformTime::Seconds() + Settings->GetUnresponsiveWarningDuration();
-                }
-                else
-                {
-                    UE_LOG(LogBlendImporter, Warning, TEXT("Terminating Blender before completion"));
-                    bTerminated = true;
-                    break;
-                }
-            }
-		    Output += FPlatformProcess::ReadPipe(ReadPipe);
-            FPlatformProcess::Sleep(0.1f);
-		}
+    UE_LOG(LogBlendImporter, Log, TEXT("Analysed '%s' in %.1fms"), *Filename, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+    return true;
+}
 
-        // Wait for console process to complete as well
-        if (bTerminated == false)
-        {
-            FPlatformProcess::WaitForProc(ProcessHandle);
-            Output += FPlatformProcess::ReadPipe(ReadPipe);
-        }
-        
-        int32 ReturnCode = 0;
-        FPlatformProcess::GetProcReturnCode(ProcessHandle, &ReturnCode);
-        
-        UE_LOG(LogBlendImporter, Log, TEXT("Blender Output:\n%s\nReturn Code: %d"), *Output, ReturnCode);
-        bResult = !bTerminated;
-    }
-    else
+void UBlendAssetFactory::GetAnalysisResults(const FBlendFileAnalysis& Analysis, TArray<FString>& Collections, FString& MaterialWarnings, bool& IsPacked)
+{
+    Collections = Analysis.Collections;
+    for (const FBlendMaterialIssues& Material : Analysis.MaterialIssues)
     {
-        UE_LOG(LogBlendImporter, Error, TEXT("There was an issue running Blender \"(%s)\". Check the path to the executable in your project settings."), *BlenderExePath.FilePath);
-        bResult = false;
+        MaterialWarnings += FString::Printf(TEXT("\t%s: %s\n"), *Material.MaterialName, *FString::Join(Material.Issues, TEXT(", ")));
     }
+    IsPacked = Analysis.bHasPackedImages;
+    MaterialTemplates = Analysis.MaterialTemplates;
+    NumAnalysedMaterials = Analysis.NumMaterials;
+}
+
+bool UBlendAssetFactory::BlendFileExport(const FString& Filename, const bool& Unpack, FString& OutputFilename)
+{
+    BLENDIMPORTER_TRACE_SCOPE(UBlendAssetFactory::BlendFileExport);
+    FBlendImportStageScope StageScope(&ImportSummary, TEXT("Export"));
+
+    UE_LOG(LogBlendImporter, Log, TEXT("Exporting FBX from Blender..."));
 
-    if (bResult)
+    OutputFilename = GetExportFilename(Filename);
+
+    if (IsExportUpToDate(Filename, OutputFilename))
     {
-        UE_LOG(LogBlendImporter, Log, TEXT("Blender Execution - Complete"));
+        UE_LOG(LogBlendImporter, Log, TEXT("No source file changes detected, skipping export of FBX"));
+        return true;
     }
-    else
+    RememberExport(Filename);
+
+    FBlendExportCache& ExportCache = FBlendImporterModule::Get().GetExportCache();
+    FString CacheKey;
+    if (FindCachedExport(Filename, OutputFilename, CacheKey))
     {
-        UE_LOG(LogBlendImporter, Error, TEXT("Blender Execution - Failed"));
+        return true;
     }
 
-	FPlatformProcess::ClosePipe(ReadPipe, WritePipe);
-    FPlatformProcess::TerminateProc(ProcessHandle);
-    FPlatformProcess::CloseProc(ProcessHandle);
-    return bResult;
-}
+    TMap<FString, FString> Environment = GetExportEnvironment(OutputFilename, Unpack ? TEXT("true") : TEXT("false"));
+    AddReimportEnvironment(Environment);
 
-bool UBlendAssetFactory::BlendFileAnalyse(const FString& Filename, TArray<FString>& Collections, FString& MaterialWarnings, bool& IsPacked)
-{
     FString Output;
-    if (RunScriptOnBlendFile(Filename, "blender_analyse", Output) == false)
+    if (RunScriptOnBlendFile(Filename, "blender_export", Environment, Output) == false)
     {
         return false;
     }
 
-	TArray<FString> OutputLines;
-	const int32 nArraySize = Output.ParseIntoArray(OutputLines, TEXT("\n"), true);
-    for (FString Line : OutputLines)
+    if (IsExportUnchanged())
     {
-	    TArray<FString> Params;
-	    Line.ParseIntoArray(Params, TEXT("|"), true);
-        if (Params.Num() <= 1)
-            continue;
-
-        if (Params[0].Len() != 1)
-            continue;
-        
-        switch ((*Params[0])[0])
-        {
-            case 'C':
-                Params[1].LeftChopInline(2);
-	            Params[1].ParseIntoArray(Collections, TEXT(","), true);
-                break;
+        return true;
+    }
 
-            case 'P':
-                IsPacked = true;
-                break;
-            
-            case 'M':
-                Params[2].LeftChopInline(2);
-                Params[2].ReplaceInline(TEXT(","), TEXT(", "));
-                MaterialWarnings += FString::Printf(TEXT("\t%s: %s\n"), *Params[1], *Params[2]); 
-                break;
-        }
+    if (FPaths::FileExists(*GetExportedFilename(OutputFilename)) == false)
+    {
+        UE_LOG(LogBlendImporter, Error, TEXT("There was an issue while exporting the FBX from Blender."));
+        return false;
     }
 
+    ExportCache.Store(CacheKey, GetExportedFilename(OutputFilename), FingerprintsToString(ExportedFingerprints));
     return true;
 }
 
-bool UBlendAssetFactory::BlendFileExport(const FString& Filename, const bool& Unpack, FString& OutputFilename)
+bool UBlendAssetFactory::BlendFileAnalyseAndExport(const FString& Filename, TArray<FString>& Collections, FString& MaterialWarnings, bool& IsPacked, FString& OutputFilename)
 {
-    UE_LOG(LogBlendImporter, Log, TEXT("Exporting FBX from Blender..."));
+    BLENDIMPORTER_TRACE_SCOPE(UBlendAssetFactory::BlendFileAnalyseAndExport);
+    FBlendImportStageScope StageScope(&ImportSummary, TEXT("Analyse and export"));
 
-	auto UserTempDir = FPaths::ConvertRelativePathToFull(FDesktopPlatformModule::Get()->GetUserTempPath());
-    OutputFilename = UserTempDir + FPaths::GetBaseFilename(Filename) + TEXT(".fbx");
+    UE_LOG(LogBlendImporter, Log, TEXT("Analysing and exporting FBX from Blender..."));
 
-    // HACK: We cache the last file, timestamp and hash, to prevent Blender from exporting the same
-    //  file multiple times when processing a re-import for a modified file. Might be a better way to work around this..
-    FDateTime TimeStamp = IFileManager::Get().GetTimeStamp(*Filename);
-    FMD5Hash Hash = FMD5Hash::HashFile(*Filename);
-    FString ImportOptionsString = ImportOptions->ToString();
-    if (Filename == PreviousImportedFilename)
+    OutputFilename = GetExportFilename(Filename);
+    RememberExport(Filename);
+
+    FBlendExportCache& ExportCache = FBlendImporterModule::Get().GetExportCache();
+    FString CacheKey;
+    if (FindCachedExport(Filename, OutputFilename, CacheKey))
+    {
+        return BlendFileAnalyse(Filename, Collections, MaterialWarnings, IsPacked);
+    }
+
+    if (BlendFileAnalyseNative(Filename, Collections, MaterialWarnings, IsPacked))
     {
-        if (TimeStamp == PreviousImportedTimeStamp)
+        TMap<FString, FString> Environment = GetExportEnvironment(OutputFilename, IsPacked ? TEXT("true") : TEXT("false"));
+        AddReimportEnvironment(Environment);
+
+        FString Output;
+        if (RunScriptOnBlendFile(Filename, "blender_export", Environment, Output) == false)
         {
-            if (Hash == PreviousImportedHash)
-            {
-                if (ImportOptionsString == PreviousImportOptionsString)
-                {
-                    UE_LOG(LogBlendImporter, Log, TEXT("No source file changes detected, skipping export of FBX"));
-                }
-                return true;
-            }
+            return false;
         }
     }
+    else
+    {
+        // Packed textures are only known once analysed, so the export script checks for them itself
+        TMap<FString, FString> Environment = GetExportEnvironment(OutputFilename, TEXT("auto"));
+        Environment.Add(TEXT("UNREAL_IMPORTER_COMBINED"), TEXT("true"));
+        AddReimportEnvironment(Environment);
 
-    PreviousImportedFilename = Filename;
-    PreviousImportedTimeStamp = TimeStamp;
-    PreviousImportedHash = Hash;
-    PreviousImportOptionsString = ImportOptionsString;
+        FString Output;
+        FBlenderJob Job(Filename, { TEXT("blender_analyse"), TEXT("blender_export") }, Environment);
+        {
+            FBlendImportStageScope BlenderStageScope(&ImportSummary, TEXT("Blender"));
+            if (!Job.Start() || !Job.Wait(Output) || !Job.GetResult().HasCompleted(TEXT("blender_analyse")))
+            {
+                return false;
+            }
+        }
 
-    UBlendImporterSettings* Settings = GetMutableDefault<UBlendImporterSettings>();
-    
-    // Set envvar for export python script
-    FPlatformMisc::SetEnvironmentVar(TEXT("UNREAL_IMPORTER_OUTPUT_FILE"), *OutputFilename);
-    FPlatformMisc::SetEnvironmentVar(TEXT("UNREAL_IMPORTER_EXPORT_OBJECT_PIVOT"), ImportOptions->bUseObjectPivot ? TEXT("true") : TEXT("false"));
-    FPlatformMisc::SetEnvironmentVar(TEXT("UNREAL_IMPORTER_FIX_MATERIALS"), Settings->IsFixMaterials() ? TEXT("true") : TEXT("false"));
-    FPlatformMisc::SetEnvironmentVar(TEXT("UNREAL_IMPORTER_ENABLED_COLLECTIONS"), *FString::Join(ImportOptions->EnabledCollections, TEXT(",")));
-    FPlatformMisc::SetEnvironmentVar(TEXT("UNREAL_IMPORTER_UNPACK"), Unpack ? TEXT("true") : TEXT("false"));
+        GetAnalysisResults(Job.GetResult().GetAnalysis(), Collections, MaterialWarnings, IsPacked);
+        ReadExportResult(Job.GetResult());
+    }
 
-    FString Output;
-    if (RunScriptOnBlendFile(Filename, "blender_export", Output) == false)
+    if (IsExportUnchanged())
     {
-        return false;
+        return true;
     }
 
-    if (FPaths::FileExists(*OutputFilename) == false)
+    if (FPaths::FileExists(*GetExportedFilename(OutputFilename)) == false)
     {
         UE_LOG(LogBlendImporter, Error, TEXT("There was an issue while exporting the FBX from Blender."));
         return false;
     }
 
+    ExportCache.Store(CacheKey, GetExportedFilename(OutputFilename), FingerprintsToString(ExportedFingerprints));
     return true;
 }
 
-bool UBlendAssetFactory::CanReimportBlendAsset(UAssetImportData* AssetImportData, TArray<FString>& OutFilenames)
+bool UBlendAssetFactory::BlendFileBeginSpeculativeExport(const FString& Filename, TArray<FString>& Collections, FString& MaterialWarnings, bool& IsPacked, FString& OutputFilename, TUniquePtr<FBlenderJob>& OutJob)
 {
-    if (AssetImportData)
+    UE_LOG(LogBlendImporter, Log, TEXT("Analysing and speculatively exporting FBX from Blender..."));
+
+    OutputFilename = GetExportFilename(Filename);
+
+    // Export with the current options, resolved against the file's collections the same way the import dialog defaults them
+    if (BlendFileAnalyseNative(Filename, Collections, MaterialWarnings, IsPacked))
     {
-        FString FileExtension = FPaths::GetExtension(AssetImportData->GetFirstFilename());
-        const bool bIsValidFile = FileExtension.Equals(TEXT("blend"), ESearchCase::IgnoreCase);
-        if (!bIsValidFile)
+        // Nothing to speculate about if the default options were exported before, the export after the dialog will use the cache
+        const TArray<FString> DefaultCollections = ImportOptions->GetDefaultEnabledCollections(Collections);
+        if (FBlendImporterModule::Get().GetExportCache().Contains(GetExportCacheKey(Filename, ImportOptions->bUseObjectPivot, DefaultCollections, ImportOptions->NumLODs, ImportOptions->LODReductionRatio)))
         {
-            return false;
+            return true;
         }
-        AssetImportData->ExtractFilenames(OutFilenames);
+
+        TMap<FString, FString> Environment = GetExportEnvironment(OutputFilename, IsPacked ? TEXT("true") : TEXT("false"));
+        Environment.Add(TEXT("UNREAL_IMPORTER_ENABLED_COLLECTIONS"), FString::Join(DefaultCollections, TEXT(",")));
+
+        OutJob = MakeUnique<FBlenderJob>(Filename, TArray<FString>{ TEXT("blender_export") }, Environment);
+        return OutJob->Start();
+    }
+
+    TMap<FString, FString> Environment = GetExportEnvironment(OutputFilename, TEXT("auto"));
+    Environment.Add(TEXT("UNREAL_IMPORTER_COMBINED"), TEXT("true"));
+    Environment.Add(TEXT("UNREAL_IMPORTER_DEFAULT_COLLECTIONS"), TEXT("true"));
+
+    OutJob = MakeUnique<FBlenderJob>(Filename, TArray<FString>{ TEXT("blender_analyse"), TEXT("blender_export") }, Environment);
+    if (!OutJob->Start() || !OutJob->WaitForResult(TEXT("blender_analyse")) || !OutJob->GetResult().HasCompleted(TEXT("blender_analyse")))
+    {
+        return false;
     }
+
+    GetAnalysisResults(OutJob->GetResult().GetAnalysis(), Collections, MaterialWarnings, IsPacked);
     return true;
 }
 
-EReimportResult::Type UBlendAssetFactory::ReimportBlendAsset(UObject* Obj, UAssetImportData* AssetImportData)
+bool UBlendAssetFactory::BeginQueuedExport(FBlendPreparedImport& Import, TUniquePtr<FBlenderJob>& OutJob, FString& OutCacheKey)
 {
-    UE_LOG(LogBlendImporter, Log, TEXT("Re-importing Blend Asset: %s (%s)"), *Obj->GetName(), *Obj->GetClass()->GetName());
-
-    if (!AssetImportData)
+    // This can run off the game thread, so everything comes from the prepared import rather than a factory
+    FBlendQueuedImportOptions& Options = Import.Options;
+    FString Error;
+    FBlendFileAnalysis Analysis;
+    const bool bAnalysedNatively = GetDefault<UBlendImporterSettings>()->IsNativeAnalysis() && Analysis.Analyse(Import.Filename, Error);
+    if (bAnalysedNatively && Options.bDefaultCollections)
     {
-        return EReimportResult::Failed;
+        Options.EnabledCollections = UBlendImportOptions::GetDefaultEnabledCollections(Options.EnabledCollections, Analysis.Collections);
+        Options.bDefaultCollections = false;
     }
-
+    if (bAnalysedNatively)
+    {
+        Import.bAnalysed = true;
+        Import.Analysis = Analysis;
+    }
+
+    // Default collections resolved by Blender aren't known here, so those exports aren't cached
+    Import.OutputFilename = GetExportFilename(Import.Filename);
+    OutCacheKey = Options.bDefaultCollections ? FString() : GetExportCacheKey(Import.Filename, Options);
+    if (RetrieveCachedExport(OutCacheKey, Import.OutputFilename, Import.Fingerprints))
+    {
+        Import.bExported = true;
+        return true;
+    }
+
+    TMap<FString, FString> Environment = GetExportEnvironment(Import.OutputFilename, bAnalysedNatively ? (Analysis.bHasPackedImages ? TEXT("true") : TEXT("false")) : TEXT("auto"), Options);
+
+    if (bAnalysedNatively)
+    {
+        OutJob = MakeUnique<FBlenderJob>(Import.Filename, TArray<FString>{ TEXT("blender_export") }, Environment);
+    }
+    else
+    {
+        // Analysed by Blender in the same job, and the analysis is handed to the import so it doesn't need Blender either
+        Environment.Add(TEXT("UNREAL_IMPORTER_COMBINED"), TEXT("true"));
+        if (Options.bDefaultCollections)
+        {
+            Environment.Add(TEXT("UNREAL_IMPORTER_DEFAULT_COLLECTIONS"), TEXT("true"));
+        }
+        OutJob = MakeUnique<FBlenderJob>(Import.Filename, TArray<FString>{ TEXT("blender_analyse"), TEXT("blender_export") }, Environment);
+    }
+    return true;
+}
+
+bool UBlendAssetFactory::FinishQueuedExport(FBlendPreparedImport& Import, const FBlenderJob& Job, bool bSucceeded, const FString& CacheKey)
+{
+    const FString ExportedFilename = GetExportedFilename(Import.OutputFilename);
+    if (!bSucceeded || !FPaths::FileExists(*ExportedFilename))
+    {
+        return false;
+    }
+
+    Import.bExported = true;
+    Import.Fingerprints = Job.GetResult().GetExportedFingerprints();
+    if (Job.GetResult().HasCompleted(TEXT("blender_analyse")))
+    {
+        Import.bAnalysed = true;
+        Import.Analysis = Job.GetResult().GetAnalysis();
+    }
+
+    FBlendImporterModule::Get().GetExportCache().Store(CacheKey, ExportedFilename, FingerprintsToString(Import.Fingerprints));
+    return true;
+}
+
+FString UBlendAssetFactory::GetExportFilename(const FString& Filename)
+{
+    // Each source file gets its own folder, so files with the same name (and parallel exports) don't overwrite each other's FBX
+    // The same directory the desktop platform module gives, without looking up a module, as queued exports call this from other threads
+	auto UserTempDir = FPaths::ConvertRelativePathToFull(FPlatformProcess::UserTempDir());
+    const FString SourceId = FMD5::HashAnsiString(*FPaths::ConvertRelativePathToFull(Filename));
+    return FPaths::Combine(UserTempDir, TEXT("BlendImporter"), SourceId, FPaths::GetBaseFilename(Filename) + TEXT(".fbx"));
+}
+
+FString UBlendAssetFactory::GetMeshBufferFilename(const FString& OutputFilename)
+{
+    return FPaths::ChangeExtension(OutputFilename, TEXT("blmesh"));
+}
+
+FString UBlendAssetFactory::GetExportedFilename(const FString& OutputFilename)
+{
+    // The export script leaves a mesh buffer instead of the FBX for files it could transfer directly
+    const FString MeshBufferFilename = GetMeshBufferFilename(OutputFilename);
+    if (GetDefault<UBlendImporterSettings>()->IsDirectMeshTransfer() && FPaths::FileExists(*MeshBufferFilename))
+    {
+        return MeshBufferFilename;
+    }
+    return OutputFilename;
+}
+
+bool UBlendAssetFactory::FindCachedExport(const FString& Filename, const FString& OutputFilename, FString& OutCacheKey)
+{
+    if (!bExportChangedOnly)
+    {
+        OutCacheKey = GetExportCacheKey(Filename, ImportOptions->bUseObjectPivot, ImportOptions->EnabledCollections, ImportOptions->NumLODs, ImportOptions->LODReductionRatio, ExportObjects);
+        return RetrieveCachedExport(OutCacheKey, OutputFilename);
+    }
+
+    // Exports of only the changed objects depend on the previous fingerprints, so aren't cached. A cached export of the whole file,
+    // like the source watcher makes, can stand in, as objects that aren't one of the reimported assets were added since and are imported too.
+    OutCacheKey.Empty();
+    const FString FileCacheKey = GetExportCacheKey(Filename, ImportOptions->bUseObjectPivot, ImportOptions->EnabledCollections, ImportOptions->NumLODs, ImportOptions->LODReductionRatio);
+    FString ObjectFingerprints;
+    if (!FBlendImporterModule::Get().GetExportCache().GetObjectFingerprints(FileCacheKey, ObjectFingerprints))
+    {
+        return false;
+    }
+
+    const TMap<FString, FString> FileFingerprints = FingerprintsFromString(ObjectFingerprints);
+    if (FileFingerprints.OrderIndependentCompareEqual(PreviousFingerprints))
+    {
+        UE_LOG(LogBlendImporter, Log, TEXT("The cached export of the whole file shows none of the objects changed"));
+        ExportedFingerprints.Empty();
+        return true;
+    }
+    return FileFingerprints.Num() > 0 && RetrieveCachedExport(FileCacheKey, OutputFilename);
+}
+
+bool UBlendAssetFactory::RetrieveCachedExport(const FString& CacheKey, const FString& OutputFilename)
+{
+    return RetrieveCachedExport(CacheKey, OutputFilename, ExportedFingerprints);
+}
+
+bool UBlendAssetFactory::RetrieveCachedExport(const FString& CacheKey, const FString& OutputFilename, TMap<FString, FString>& OutFingerprints)
+{
+    const FString MeshBufferFilename = GetMeshBufferFilename(OutputFilename);
+    FString ObjectFingerprints;
+    if (!FBlendImporterModule::Get().GetExportCache().Retrieve(CacheKey, OutputFilename, &ObjectFingerprints))
+    {
+        return false;
+    }
+    OutFingerprints = FingerprintsFromString(ObjectFingerprints);
+
+    // Cache entries hold either kind of export, so a mesh buffer is moved to where the export script would have written it
+    IFileManager::Get().Delete(*MeshBufferFilename, false, false, true);
+    if (FBlendMeshBuffer::IsMeshBuffer(OutputFilename))
+    {
+        return IFileManager::Get().Move(*MeshBufferFilename, *OutputFilename);
+    }
+    return true;
+}
+
+void UBlendAssetFactory::ReadExportResult(const FBlenderResultReader& Result)
+{
+    ExportedFingerprints = Result.GetExportedFingerprints();
+    ImportSummary.AddBlenderResult(Result);
+    if (Result.IsUnchanged())
+    {
+        UE_LOG(LogBlendImporter, Log, TEXT("Blender skipped the export, as none of the objects changed"));
+    }
+}
+
+void UBlendAssetFactory::AddReimportEnvironment(TMap<FString, FString>& Environment) const
+{
+    // The script skips the export if none of the objects changed, and only exports the given objects
+    if (PreviousFingerprints.Num() > 0)
+    {
+        Environment.Add(TEXT("UNREAL_IMPORTER_PREVIOUS_FINGERPRINTS"), FingerprintsToString(PreviousFingerprints));
+    }
+
+    if (ExportObjects.Num() > 0)
+    {
+        FString ObjectsJson;
+        TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> Writer = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&ObjectsJson);
+        Writer->WriteArrayStart();
+        for (const FString& Object : ExportObjects)
+        {
+            Writer->WriteValue(Object);
+        }
+        Writer->WriteArrayEnd();
+        Writer->Close();
+        Environment.Add(TEXT("UNREAL_IMPORTER_EXPORT_OBJECTS"), ObjectsJson);
+    }
+
+    if (bExportChangedOnly)
+    {
+        Environment.Add(TEXT("UNREAL_IMPORTER_CHANGED_ONLY"), TEXT("true"));
+    }
+}
+
+bool UBlendAssetFactory::IsExportUnchanged() const
+{
+    if (bExportChangedOnly)
+    {
+        return ExportedFingerprints.Num() == 0;
+    }
+    return PreviousFingerprints.Num() > 0 && ExportedFingerprints.OrderIndependentCompareEqual(PreviousFingerprints);
+}
+
+FString UBlendAssetFactory::FingerprintsToString(const TMap<FString, FString>& Fingerprints)
+{
+    if (Fingerprints.Num() == 0)
+    {
+        return FString();
+    }
+
+    FString Json;
+    TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> Writer = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&Json);
+    Writer->WriteObjectStart();
+    for (const TPair<FString, FString>& Fingerprint : Fingerprints)
+    {
+        Writer->WriteValue(Fingerprint.Key, Fingerprint.Value);
+    }
+    Writer->WriteObjectEnd();
+    Writer->Close();
+    return Json;
+}
+
+TMap<FString, FString> UBlendAssetFactory::FingerprintsFromString(const FString& String)
+{
+    TMap<FString, FString> Fingerprints;
+    TSharedPtr<FJsonObject> Object;
+    if (!String.IsEmpty() && FJsonSerializer::Deserialize(TJsonReaderFactory<TCHAR>::Create(String), Object) && Object.IsValid())
+    {
+        for (const TPair<FString, TSharedPtr<FJsonValue>>& Field : Object->Values)
+        {
+            Fingerprints.Add(Field.Key, Field.Value->AsString());
+        }
+    }
+    return Fingerprints;
+}
+
+const FBlendImportSummary& UBlendAssetFactory::GetImportSummary() const
+{
+    return ImportSummary;
+}
+
+void UBlendAssetFactory::SetPreparedImport(TSharedPtr<const FBlendPreparedImport> InPreparedImport)
+{
+    PreparedImport = InPreparedImport;
+}
+
+void UBlendAssetFactory::SaveFingerprints(UObject* Asset, int32 NumImportedMeshes, FName ImportName) const
+{
+    // Static meshes imported separately are matched to their objects by name, so reimporting one only exports its objects
+    TMap<FString, FString> AssetFingerprints;
+    if (NumImportedMeshes > 1 && Asset->IsA<UStaticMesh>())
+    {
+        for (const TPair<FString, FString>& Fingerprint : ExportedFingerprints)
+        {
+            const FString ObjectName = ObjectTools::SanitizeObjectName(Fingerprint.Key);
+            if (Asset->GetName() == ObjectName || Asset->GetName() == ImportName.ToString() + TEXT("_") + ObjectName)
+            {
+                AssetFingerprints.Add(Fingerprint.Key, Fingerprint.Value);
+            }
+        }
+    }
+
+    const bool bPartial = ExportObjects.Num() > 0 || AssetFingerprints.Num() > 0;
+    if (AssetFingerprints.Num() == 0)
+    {
+        AssetFingerprints = ExportedFingerprints;
+    }
+
+    UMetaData* MetaData = Asset->GetPackage()->GetMetaData();
+    MetaData->SetValue(Asset, TEXT("BLEND_FINGERPRINTS"), *FingerprintsToString(AssetFingerprints));
+    MetaData->SetValue(Asset, TEXT("BLEND_PARTIAL"), bPartial ? TEXT("true") : TEXT("false"));
+    if (ExportObjects.Num() == 0)
+    {
+        MetaData->SetValue(Asset, TEXT("BLEND_IMPORT_NAME"), *ImportName.ToString());
+    }
+}
+
+TMap<FString, FString> UBlendAssetFactory::GetExportEnvironment(const FString& OutputFilename, const FString& Unpack) const
+{
+    return GetExportEnvironment(OutputFilename, Unpack, GetExportOptions(ImportOptions->bUseObjectPivot, ImportOptions->EnabledCollections, ImportOptions->NumLODs, ImportOptions->LODReductionRatio));
+}
+
+TMap<FString, FString> UBlendAssetFactory::GetExportEnvironment(const FString& OutputFilename, const FString& Unpack, const FBlendQueuedImportOptions& Options)
+{
+    const UBlendImporterSettings* Settings = GetDefault<UBlendImporterSettings>();
+
+    TMap<FString, FString> Environment;
+    Environment.Add(TEXT("UNREAL_IMPORTER_OUTPUT_FILE"), OutputFilename);
+    Environment.Add(TEXT("UNREAL_IMPORTER_EXPORT_OBJECT_PIVOT"), Options.bUseObjectPivot ? TEXT("true") : TEXT("false"));
+    Environment.Add(TEXT("UNREAL_IMPORTER_FIX_MATERIALS"), Settings->IsFixMaterials() ? TEXT("true") : TEXT("false"));
+    Environment.Add(TEXT("UNREAL_IMPORTER_ENABLED_COLLECTIONS"), FString::Join(Options.EnabledCollections, TEXT(",")));
+    Environment.Add(TEXT("UNREAL_IMPORTER_LOD_COUNT"), FString::FromInt(Options.NumLODs));
+    Environment.Add(TEXT("UNREAL_IMPORTER_LOD_REDUCTION_RATIO"), FString::SanitizeFloat(Options.LODReductionRatio));
+    Environment.Add(TEXT("UNREAL_IMPORTER_UNPACK"), Unpack);
+    if (Settings->IsExtractPackedTextures())
+    {
+        Environment.Add(TEXT("UNREAL_IMPORTER_TEXTURE_CACHE_DIR"), Settings->GetTextureCacheDirectory());
+    }
+    Environment.Add(TEXT("UNREAL_IMPORTER_MESH_BUFFER_FILE"), GetMeshBufferFilename(OutputFilename));
+    Environment.Add(TEXT("UNREAL_IMPORTER_DIRECT_MESH"), Options.bDirectMeshTransfer ? TEXT("true") : TEXT("false"));
+    Environment.Add(TEXT("UNREAL_IMPORTER_INSTANCE_LINKED_DUPLICATES"), Settings->IsInstanceLinkedDuplicates() ? TEXT("true") : TEXT("false"));
+    return Environment;
+}
+
+bool UBlendAssetFactory::IsDirectMeshTransfer() const
+{
+    // The mesh buffer is always imported as one combined mesh, so FBX is used when the FBX import options keep meshes separate
+    return GetDefault<UBlendImporterSettings>()->IsDirectMeshTransfer() && FbxFactory->ImportUI->StaticMeshImportData->bCombineMeshes;
+}
+
+FBlendQueuedImportOptions UBlendAssetFactory::GetExportOptions(bool bUseObjectPivot, const TArray<FString>& EnabledCollections, int32 NumLODs, float LODReductionRatio) const
+{
+    FBlendQueuedImportOptions Options;
+    Options.bUseObjectPivot = bUseObjectPivot;
+    Options.EnabledCollections = EnabledCollections;
+    Options.NumLODs = NumLODs;
+    Options.LODReductionRatio = LODReductionRatio;
+    Options.bDirectMeshTransfer = IsDirectMeshTransfer();
+    return Options;
+}
+
+FString UBlendAssetFactory::GetExportCacheKey(const FString& Filename, bool bUseObjectPivot, const TArray<FString>& EnabledCollections, int32 NumLODs, float LODReductionRatio, const TArray<FString>& Objects) const
+{
+    return GetExportCacheKey(Filename, GetExportOptions(bUseObjectPivot, EnabledCollections, NumLODs, LODReductionRatio), Objects);
+}
+
+FString UBlendAssetFactory::GetExportCacheKey(const FString& Filename, const FBlendQueuedImportOptions& Options, const TArray<FString>& Objects)
+{
+    const UBlendImporterSettings* Settings = GetDefault<UBlendImporterSettings>();
+
+    // Everything passed to the export script, with the collections sorted as their order doesn't change the export
+    TArray<FString> SortedCollections = Options.EnabledCollections;
+    SortedCollections.Sort();
+    TArray<FString> SortedObjects = Objects;
+    SortedObjects.Sort();
+    const FString OptionsString = FString::Printf(TEXT("%s;%s;%s;%s;%s;%s;%s;%d;%s"),
+        Options.bUseObjectPivot ? TEXT("true") : TEXT("false"), *FString::Join(SortedCollections, TEXT(",")), Settings->IsFixMaterials() ? TEXT("true") : TEXT("false"),
+        Options.bDirectMeshTransfer ? TEXT("true") : TEXT("false"), *FString::Join(SortedObjects, TEXT(",")),
+        Settings->IsExtractPackedTextures() ? *Settings->GetTextureCacheDirectory() : TEXT(""),
+        Settings->IsInstanceLinkedDuplicates() ? TEXT("true") : TEXT("false"), Options.NumLODs, *FString::SanitizeFloat(Options.LODReductionRatio));
+
+    return FBlendImporterModule::Get().GetExportCache().GetKey(Filename, OptionsString, Settings->GetBlenderExecutable(false).FilePath);
+}
+
+bool UBlendAssetFactory::IsExportUpToDate(const FString& Filename, const FString& OutputFilename)
+{
+    // HACK: We cache the last file and hash, to prevent Blender from exporting the same
+    //  file multiple times when processing a re-import for a modified file. Might be a better way to work around this..
+    // Exports of only the changed objects depend on the previous fingerprints too, so are never reused
+    if (bExportChangedOnly || Filename != PreviousImportedFilename || FPaths::FileExists(*GetExportedFilename(OutputFilename)) == false)
+    {
+        return false;
+    }
+
+    // The hash is only recalculated if the file's size or modification time changed
+    return FBlendImporterModule::Get().GetFileHashes().GetHash(Filename) == PreviousImportedHash
+        && ImportOptions->ToString() + FString::Join(ExportObjects, TEXT(",")) == PreviousImportOptionsString;
+}
+
+void UBlendAssetFactory::RememberExport(const FString& Filename)
+{
+    PreviousImportedFilename = Filename;
+    PreviousImportedHash = FBlendImporterModule::Get().GetFileHashes().GetHash(Filename);
+    PreviousImportOptionsString = ImportOptions->ToString() + FString::Join(ExportObjects, TEXT(","));
+}
+
+UObject* UBlendAssetFactory::ImportMeshBuffer(UObject* InParent, FName InName, EObjectFlags Flags, const FString& MeshBufferFilename, bool bPlaceInstances, TArray<UObject*>& OutImportedObjects)
+{
+    FString Error;
+    FBlendMeshBuffer MeshBuffer;
+    if (!MeshBuffer.Open(MeshBufferFilename, Error))
+    {
+        UE_LOG(LogBlendImporter, Error, TEXT("Could not read the mesh data exported from Blender (%s)"), *Error);
+        return nullptr;
+    }
+
+    UStaticMesh* MainMesh = nullptr;
+    TArray<UStaticMesh*> MeshesToBuild;
+    if (MeshBuffer.HasUninstancedObjects())
+    {
+        MainMesh = BuildMeshBufferMesh(InParent, InName, Flags, MeshBuffer, nullptr, MeshesToBuild);
+        if (MainMesh == nullptr)
+        {
+            return nullptr;
+        }
+        OutImportedObjects.Add(MainMesh);
+    }
+
+    // Each mesh shared by linked duplicates is its own asset next to the imported one, or is the imported one if every object was instanced
+    const FString PackagePath = FPackageName::GetLongPackagePath(InParent->GetOutermost()->GetName());
+    TArray<FBlendInstancedMesh> InstancedMeshes;
+    for (const FBlendMeshBufferObject& Object : MeshBuffer.GetObjects())
+    {
+        if (Object.InstanceTransforms.Num() == 0)
+        {
+            continue;
+        }
+
+        UStaticMesh* Mesh = nullptr;
+        if (MainMesh == nullptr)
+        {
+            Mesh = MainMesh = BuildMeshBufferMesh(InParent, InName, Flags, MeshBuffer, &Object, MeshesToBuild);
+        }
+        else
+        {
+            const FString MeshName = ObjectTools::SanitizeObjectName(InName.ToString() + TEXT("_") + Object.Name);
+            UPackage* Package = CreatePackage(*(PackagePath / MeshName));
+            Package->FullyLoad();
+            Mesh = BuildMeshBufferMesh(Package, FName(*MeshName), Flags, MeshBuffer, &Object, MeshesToBuild);
+        }
+
+        if (Mesh)
+        {
+            OutImportedObjects.Add(Mesh);
+            InstancedMeshes.Add({ Mesh, FBlendMeshBuffer::GetInstanceTransforms(Object) });
+        }
+    }
+
+    // Built in one batch, which spreads the builds over worker threads. With asynchronous static mesh compiling (UE5) the import doesn't wait for them,
+    // the meshes show as compiling until they're done.
+    if (MeshesToBuild.Num() > 0)
+    {
+        BLENDIMPORTER_TRACE_SCOPE(UStaticMesh::BatchBuild);
+        FBlendImportStageScope StageScope(&ImportSummary, TEXT("Build"));
+        UStaticMesh::BatchBuild(MeshesToBuild);
+
+        #if ENGINE_MAJOR_VERSION <= 4
+            // Open editors refresh on a property change, which PostEditChange would have followed with a second build
+            for (UStaticMesh* Mesh : MeshesToBuild)
+            {
+                FPropertyChangedEvent PropertyChangedEvent(nullptr);
+                FCoreUObjectDelegates::OnObjectPropertyChanged.Broadcast(Mesh, PropertyChangedEvent);
+            }
+        #endif
+    }
+
+    // There's no level to place them in when importing on a build machine, the meshes are still imported
+    if (bPlaceInstances && InstancedMeshes.Num() > 0 && !IsRunningCommandlet())
+    {
+        FBlendInstancedActors::PlaceInstances(PackagePath / InName.ToString(), InName.ToString(), InstancedMeshes);
+    }
+
+    return MainMesh;
+}
+
+UStaticMesh* UBlendAssetFactory::BuildMeshBufferMesh(UObject* InParent, FName InName, EObjectFlags Flags, const FBlendMeshBuffer& MeshBuffer, const FBlendMeshBufferObject* InstancedObject, TArray<UStaticMesh*>& OutMeshesToBuild)
+{
+    UObject* ExistingObject = StaticFindObject(UObject::StaticClass(), InParent, *InName.ToString());
+    if (ExistingObject != nullptr && !ExistingObject->IsA<UStaticMesh>())
+    {
+        UE_LOG(LogBlendImporter, Error, TEXT("Can't import '%s' as a static mesh, an asset of type %s already exists with that name"), *InName.ToString(), *ExistingObject->GetClass()->GetName());
+        return nullptr;
+    }
+
+    UStaticMesh* Mesh = Cast<UStaticMesh>(ExistingObject);
+    if (Mesh)
+    {
+        Mesh->Modify();
+    }
+    else
+    {
+        Mesh = NewObject<UStaticMesh>(InParent, InName, Flags);
+    }
+
+    // LODs generated in Blender replace the mesh's source models, otherwise any LODs set up in the editor are kept
+    UMetaData* MetaData = Mesh->GetOutermost()->GetMetaData();
+    const int32 NumLODs = InstancedObject ? FBlendMeshBuffer::GetNumInstancedLODs(*InstancedObject) : MeshBuffer.GetNumLODs();
+    const bool bHadBlendLODs = FCString::Atoi(*MetaData->GetValue(Mesh, TEXT("BLEND_NUM_LODS"))) > 1;
+    const bool bSetLODs = NumLODs > 1 || bHadBlendLODs;
+
+    #if ENGINE_MAJOR_VERSION <= 4 && ENGINE_MINOR_VERSION <= 26
+        const TArray<FStaticMaterial> PreviousMaterials = Mesh->StaticMaterials;
+    #else
+        const TArray<FStaticMaterial> PreviousMaterials = Mesh->GetStaticMaterials();
+    #endif
+
+    // Building is the slow part of a reimport, and often only materials or properties changed, so the existing render data is kept if the geometry is the same
+    const FString MeshHash = InstancedObject ? MeshBuffer.GetInstancedMeshHash(*InstancedObject) : MeshBuffer.GetMeshHash();
+    // The hash covers every LOD, earlier imports stored it as BLEND_MESH_HASH_LOD0
+    FString PreviousMeshHash = MetaData->GetValue(Mesh, TEXT("BLEND_MESH_HASH"));
+    if (PreviousMeshHash.IsEmpty())
+    {
+        PreviousMeshHash = MetaData->GetValue(Mesh, TEXT("BLEND_MESH_HASH_LOD0"));
+    }
+    bool bGeometryUnchanged = ExistingObject != nullptr && PreviousMeshHash == MeshHash && (!bSetLODs || Mesh->GetNumSourceModels() == NumLODs);
+    for (int32 LODIndex = 0; bGeometryUnchanged && LODIndex < NumLODs; LODIndex++)
+    {
+        bGeometryUnchanged = Mesh->IsMeshDescriptionValid(LODIndex);
+    }
+
+    TArray<FName> MaterialSlotNames;
+    TOptional<FStaticMeshComponentRecreateRenderStateContext> RecreateRenderStateContext;
+    if (bGeometryUnchanged)
+    {
+        // The same mesh description makes the same material slots
+        for (const FStaticMaterial& PreviousMaterial : PreviousMaterials)
+        {
+            MaterialSlotNames.Add(PreviousMaterial.MaterialSlotName);
+        }
+
+        // Components using the mesh pick up its materials when their render state is recreated
+        RecreateRenderStateContext.Emplace(Mesh, false);
+    }
+    else
+    {
+        if (bSetLODs)
+        {
+            Mesh->SetNumSourceModels(NumLODs);
+        }
+        else if (Mesh->GetNumSourceModels() == 0)
+        {
+            Mesh->AddSourceModel();
+        }
+
+        for (int32 LODIndex = 0; LODIndex < NumLODs; LODIndex++)
+        {
+            // Normals always come from Blender, tangents too unless a mesh had no UVs to calculate them from
+            FStaticMeshSourceModel& SourceModel = Mesh->GetSourceModel(LODIndex);
+            SourceModel.BuildSettings.bRecomputeNormals = false;
+            SourceModel.BuildSettings.bRecomputeTangents = !MeshBuffer.HasTangents();
+
+            // Decimating can remove every triangle using a material, so each LOD's slots are added to those of the LODs before it
+            TArray<FName> LODMaterialSlotNames;
+            FMeshDescription* MeshDescription = Mesh->CreateMeshDescription(LODIndex);
+            if (InstancedObject)
+            {
+                MeshBuffer.BuildInstancedMeshDescription(*InstancedObject, *MeshDescription, LODMaterialSlotNames, LODIndex);
+            }
+            else
+            {
+                MeshBuffer.BuildMeshDescription(*MeshDescription, LODMaterialSlotNames, LODIndex);
+            }
+            Mesh->CommitMeshDescription(LODIndex);
+
+            for (const FName& SlotName : LODMaterialSlotNames)
+            {
+                MaterialSlotNames.AddUnique(SlotName);
+            }
+        }
+    }
+
+    // Materials assigned on a previous import are kept, otherwise a material with the same name next to the mesh is used
+    const FString PackagePath = FPackageName::GetLongPackagePath(Mesh->GetOutermost()->GetName());
+    TArray<FStaticMaterial> StaticMaterials;
+    for (const FName& SlotName : MaterialSlotNames)
+    {
+        const FStaticMaterial* PreviousMaterial = PreviousMaterials.FindByPredicate([&SlotName](const FStaticMaterial& Material) { return Material.MaterialSlotName == SlotName; });
+        UMaterialInterface* Material = PreviousMaterial ? PreviousMaterial->MaterialInterface : nullptr;
+        if (Material == nullptr)
+        {
+            const FString MaterialPath = PackagePath / SlotName.ToString() + TEXT(".") + SlotName.ToString();
+            Material = LoadObject<UMaterialInterface>(nullptr, *MaterialPath, nullptr, LOAD_NoWarn | LOAD_Quiet);
+        }
+        StaticMaterials.Add(FStaticMaterial(Material, SlotName, SlotName));
+    }
+
+    #if ENGINE_MAJOR_VERSION <= 4 && ENGINE_MINOR_VERSION <= 26
+        Mesh->StaticMaterials = StaticMaterials;
+    #else
+        Mesh->SetStaticMaterials(StaticMaterials);
+    #endif
+
+    if (bGeometryUnchanged)
+    {
+        UE_LOG(LogBlendImporter, Log, TEXT("Geometry of '%s' is unchanged, updated its materials without building it"), *Mesh->GetName());
+        Mesh->MarkPackageDirty();
+        return Mesh;
+    }
+
+    OutMeshesToBuild.Add(Mesh);
+    MetaData->SetValue(Mesh, TEXT("BLEND_MESH_HASH"), *MeshHash);
+    MetaData->RemoveValue(Mesh, TEXT("BLEND_MESH_HASH_LOD0"));
+    MetaData->SetValue(Mesh, TEXT("BLEND_NUM_LODS"), *FString::FromInt(NumLODs));
+
+    if (ExistingObject == nullptr)
+    {
+        FAssetRegistryModule::AssetCreated(Mesh);
+    }
+    Mesh->MarkPackageDirty();
+
+    if (InstancedObject)
+    {
+        UE_LOG(LogBlendImporter, Log, TEXT("Made '%s' with %d LODs from mesh '%s' without FBX, for %d instances"), *Mesh->GetName(), NumLODs, *InstancedObject->Name, InstancedObject->InstanceTransforms.Num() / 16);
+    }
+    else
+    {
+        UE_LOG(LogBlendImporter, Log, TEXT("Made '%s' with %d LODs from %d objects without FBX"), *Mesh->GetName(), NumLODs, MeshBuffer.GetObjects().Num());
+    }
+    return Mesh;
+}
+
+bool UBlendAssetFactory::CanReimportBlendAsset(UAssetImportData* AssetImportData, TArray<FString>& OutFilenames)
+{
+    if (AssetImportData)
+    {
+        FString FileExtension = FPaths::GetExtension(AssetImportData->GetFirstFilename());
+        const bool bIsValidFile = FileExtension.Equals(TEXT("blend"), ESearchCase::IgnoreCase);
+        if (!bIsValidFile)
+        {
+            return false;
+        }
+        AssetImportData->ExtractFilenames(OutFilenames);
+    }
+    return true;
+}
+
+TMap<FString, TArray<UObject*>> UBlendAssetFactory::GroupAssetsByImport(const TArray<UObject*>& Assets)
+{
+    // Assets imported into different folders or with different options each need their own export
+    TMap<FString, TArray<UObject*>> Groups;
+    for (UObject* Asset : Assets)
+    {
+        UAssetImportData* AssetImportData = GetAssetImportData(Asset);
+        if (AssetImportData == nullptr)
+        {
+            continue;
+        }
+
+        // Meshes imported separately share the name they were imported with, each combined mesh is an import of its own
+        UMetaData* MetaData = Asset->GetPackage()->GetMetaData();
+        FString ImportName = MetaData->GetValue(Asset, TEXT("BLEND_IMPORT_NAME"));
+        if (ImportName.IsEmpty() || MetaData->GetValue(Asset, TEXT("BLEND_PARTIAL")) != TEXT("true"))
+        {
+            ImportName = Asset->GetName();
+        }
+
+        const FString GroupKey = FString::Printf(TEXT("%s|%s|%s|%s"),
+            *FPaths::ConvertRelativePathToFull(AssetImportData->GetFirstFilename()),
+            *FPackageName::GetLongPackagePath(Asset->GetOutermost()->GetName()),
+            *MetaData->GetValue(Asset, TEXT("BLEND_IMPORT")), *ImportName);
+        Groups.FindOrAdd(GroupKey).Add(Asset);
+    }
+    return Groups;
+}
+
+EReimportResult::Type UBlendAssetFactory::ReimportFromSource(const TArray<UObject*>& Assets)
+{
+    const TMap<FString, TArray<UObject*>> Groups = GroupAssetsByImport(Assets);
+
+    // Groups exported ahead of their reimport are imported straight away
+    const bool bInBackground = PreparedImport == nullptr && CanReimportInBackground();
+
+    EReimportResult::Type Result = Groups.Num() > 0 ? EReimportResult::Succeeded : EReimportResult::Failed;
+    for (const TPair<FString, TArray<UObject*>>& Group : Groups)
+    {
+        const EReimportResult::Type GroupResult = bInBackground ? ReimportGroupInBackground(Group.Value) : ReimportGroup(Group.Value);
+        if (GroupResult != EReimportResult::Succeeded)
+        {
+            Result = EReimportResult::Failed;
+        }
+
+        for (UObject* Asset : Group.Value)
+        {
+            CoalescedReimports.Add(Asset);
+        }
+    }
+
+    // The reimport manager goes through the selected assets within a frame, so later reimports of these assets do their own exports again
+    TWeakObjectPtr<UBlendAssetFactory> WeakThis(this);
+    #if ENGINE_MAJOR_VERSION >= 5
+        FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([WeakThis](float DeltaTime)
+    #else
+        FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([WeakThis](float DeltaTime)
+    #endif
+    {
+        if (WeakThis.IsValid())
+        {
+            WeakThis->CoalescedReimports.Empty();
+        }
+        return false;
+    }));
+
+    return Result;
+}
+
+EReimportResult::Type UBlendAssetFactory::ReimportGroup(const TArray<UObject*>& Assets)
+{
+    UObject* FirstAsset = Assets[0];
+
+    // Exported once for all the assets, with the fingerprints of all the objects they were made from
+    bool bAllPartial = true;
+    bool bAllFingerprinted = true;
+    for (UObject* Asset : Assets)
+    {
+        UMetaData* MetaData = Asset->GetPackage()->GetMetaData();
+        const TMap<FString, FString> Fingerprints = FingerprintsFromString(MetaData->GetValue(Asset, TEXT("BLEND_FINGERPRINTS")));
+        bAllFingerprinted &= Fingerprints.Num() > 0;
+        bAllPartial &= Fingerprints.Num() > 0 && MetaData->GetValue(Asset, TEXT("BLEND_PARTIAL")) == TEXT("true");
+
+        for (const TPair<FString, FString>& Fingerprint : Fingerprints)
+        {
+            // One object can't be reimported into two assets, the export would only update one of them
+            const TWeakObjectPtr<UObject>* OtherAsset = ReimportAssets.Find(Fingerprint.Key);
+            if (OtherAsset && OtherAsset->Get() != Asset)
+            {
+                UE_LOG(LogBlendImporter, Error, TEXT("Can't reimport '%s' and '%s' together, both were made from object '%s'"), *Asset->GetName(), OtherAsset->IsValid() ? *(*OtherAsset)->GetName() : TEXT("?"), *Fingerprint.Key);
+                PreviousFingerprints.Empty();
+                ReimportAssets.Empty();
+                return EReimportResult::Failed;
+            }
+
+            PreviousFingerprints.Add(Fingerprint.Key, Fingerprint.Value);
+            ReimportAssets.Add(Fingerprint.Key, Asset);
+        }
+    }
+
+    // Unchanged objects can only be left out when no asset combines them with changed ones
+    if (bAllPartial)
+    {
+        PreviousFingerprints.GetKeys(ExportObjects);
+        bExportChangedOnly = true;
+    }
+    else if (!bAllFingerprinted)
+    {
+        PreviousFingerprints.Empty();
+    }
+
+    // Separately imported meshes are named after the name the file was imported with, and their object
+    const FString ImportName = FirstAsset->GetPackage()->GetMetaData()->GetValue(FirstAsset, TEXT("BLEND_IMPORT_NAME"));
+    ReimportImportName = bAllPartial && !ImportName.IsEmpty() ? FName(*ImportName) : FirstAsset->GetFName();
+
+    UE_LOG(LogBlendImporter, Log, TEXT("Reimporting %d assets from '%s' with one export"), Assets.Num(), *GetAssetImportData(FirstAsset)->GetFirstFilename());
+    const EReimportResult::Type Result = ReimportBlendAsset(FirstAsset, GetAssetImportData(FirstAsset));
+
+    bExportChangedOnly = false;
+    ReimportAssets.Empty();
+    ReimportImportName = NAME_None;
+    return Result;
+}
+
+bool UBlendAssetFactory::CanReimportInBackground()
+{
+    // Scripts, tests and commandlets expect the assets to be reimported once the reimport returns
+    return GetDefault<UBlendImporterSettings>()->IsBackgroundImport() && GIsEditor && !IsRunningCommandlet() && !GIsAutomationTesting && !FApp::IsUnattended();
+}
+
+EReimportResult::Type UBlendAssetFactory::ReimportGroupInBackground(const TArray<UObject*>& Assets)
+{
+    UObject* FirstAsset = Assets[0];
+    UBlendImportOptions* SavedOptions = NewObject<UBlendImportOptions>();
+    if (!SavedOptions->LoadMetaData(FirstAsset))
+    {
+        return ReimportGroup(Assets);
+    }
+
+    TSharedRef<FBlendPreparedImport> Prepared = MakeShared<FBlendPreparedImport>();
+    Prepared->Filename = GetAssetImportData(FirstAsset)->GetFirstFilename();
+    Prepared->Options.bUseObjectPivot = SavedOptions->bUseObjectPivot;
+    Prepared->Options.EnabledCollections = SavedOptions->EnabledCollections;
+    Prepared->Options.NumLODs = SavedOptions->NumLODs;
+    Prepared->Options.LODReductionRatio = SavedOptions->LODReductionRatio;
+    Prepared->Options.bDirectMeshTransfer = IsDirectMeshTransfer();
+
+    TUniquePtr<FBlenderJob> Job;
+    FString CacheKey;
+    if (!BeginQueuedExport(*Prepared, Job, CacheKey))
+    {
+        return ReimportGroup(Assets);
+    }
+
+    if (!Job.IsValid())
+    {
+        // Cached, so there's no Blender to wait for
+        SetPreparedImport(Prepared);
+        const EReimportResult::Type Result = ReimportGroup(Assets);
+        SetPreparedImport(nullptr);
+        return Result;
+    }
+
+    TArray<TWeakObjectPtr<UObject>> WeakAssets;
+    for (UObject* Asset : Assets)
+    {
+        WeakAssets.Add(Asset);
+    }
+
+    UE_LOG(LogBlendImporter, Log, TEXT("Exporting '%s' in the background, %d assets are reimported once it's done"), *Prepared->Filename, Assets.Num());
+
+    TSharedPtr<FBlenderJob> SharedJob(Job.Release());
+    SharedJob->Run().Next([SharedJob, Prepared, CacheKey, WeakAssets](bool bSucceeded)
+    {
+        // Continued from the job's own tick, so it's released from the next one
+        AsyncTask(ENamedThreads::GameThread, [SharedJob, Prepared, CacheKey, WeakAssets, bSucceeded]()
+        {
+            if (!FinishQueuedExport(*Prepared, *SharedJob, bSucceeded, CacheKey))
+            {
+                UE_LOG(LogBlendImporter, Error, TEXT("Background export of '%s' failed, its assets weren't reimported"), *Prepared->Filename);
+                return;
+            }
+
+            TArray<UObject*> ReimportedAssets;
+            for (const TWeakObjectPtr<UObject>& Asset : WeakAssets)
+            {
+                if (Asset.IsValid())
+                {
+                    ReimportedAssets.Add(Asset.Get());
+                }
+            }
+            if (ReimportedAssets.Num() == 0)
+            {
+                return;
+            }
+
+            TStrongObjectPtr<UBlendAssetFactory> Factory(NewObject<UBlendAssetFactory>());
+            Factory->SetPreparedImport(Prepared);
+            Factory->ReimportFromSource(ReimportedAssets);
+            Factory->SetPreparedImport(nullptr);
+        });
+    });
+    return EReimportResult::Succeeded;
+}
+
+TArray<UObject*> UBlendAssetFactory::GetAssetsFromSameImport(UObject* Obj) const
+{
+    TArray<UObject*> Assets = { Obj };
+    const FString Filename = FPaths::ConvertRelativePathToFull(GetAssetImportData(Obj)->GetFirstFilename());
+    const FName PackagePath = *FPackageName::GetLongPackagePath(Obj->GetOutermost()->GetName());
+    const FString ImportOptionsString = Obj->GetPackage()->GetMetaData()->GetValue(Obj, TEXT("BLEND_IMPORT"));
+
+    IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>(AssetRegistryConstants::ModuleName).Get();
+    for (const FAssetData& AssetData : FAssetSourceFilenameCache::Get().GetAssetsPertainingToFile(AssetRegistry, Filename))
+    {
+        UClass* AssetClass = AssetData.GetClass();
+        if (AssetData.PackagePath != PackagePath || !AssetClass || !(AssetClass->IsChildOf<UStaticMesh>() || AssetClass->IsChildOf<USkeletalMesh>()))
+        {
+            continue;
+        }
+
+        // Assets saved with their options tagged aren't loaded when they were imported with other options
+        FString TaggedOptionsString;
+        if (UBlendImportOptions::FindAssetRegistryTag(AssetData, TaggedOptionsString) && TaggedOptionsString != ImportOptionsString)
+        {
+            continue;
+        }
+
+        UObject* Asset = AssetData.GetAsset();
+        if (Asset && Asset != Obj && Asset->GetPackage()->GetMetaData()->GetValue(Asset, TEXT("BLEND_IMPORT")) == ImportOptionsString)
+        {
+            Assets.Add(Asset);
+        }
+    }
+    return Assets;
+}
+
+TArray<UObject*> UBlendAssetFactory::FindAssetsFromSource(const FString& Filename)
+{
+    IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>(AssetRegistryConstants::ModuleName).Get();
+
+    TArray<UObject*> Assets;
+    for (const FAssetData& AssetData : FAssetSourceFilenameCache::Get().GetAssetsPertainingToFile(AssetRegistry, FPaths::ConvertRelativePathToFull(Filename)))
+    {
+        UClass* AssetClass = AssetData.GetClass();
+        if (AssetClass && (AssetClass->IsChildOf<UStaticMesh>() || AssetClass->IsChildOf<USkeletalMesh>()))
+        {
+            if (UObject* Asset = AssetData.GetAsset())
+            {
+                Assets.Add(Asset);
+            }
+        }
+    }
+    return Assets;
+}
+
+TArray<FString> UBlendAssetFactory::GetSourceFiles(const FAssetData& AssetData)
+{
+    TArray<FString> Filenames;
+
+    const TOptional<FAssetImportInfo> ImportInfo = FAssetSourceFilenameCache::ExtractAssetImportInfo(AssetData);
+    if (!ImportInfo.IsSet())
+    {
+        return Filenames;
+    }
+
+    for (const FAssetImportInfo::FSourceFile& SourceFile : ImportInfo->SourceFiles)
+    {
+        if (!FPaths::GetExtension(SourceFile.RelativeFilename).Equals(TEXT("blend"), ESearchCase::IgnoreCase))
+        {
+            continue;
+        }
+
+        // Relative to the package first, then to the working directory, the same as UAssetImportData::ResolveImportFilename
+        FString Filename = SourceFile.RelativeFilename;
+        if (FPaths::IsRelative(Filename))
+        {
+            FString PackageFilename;
+            if (FPackageName::TryConvertLongPackageNameToFilename(AssetData.PackageName.ToString(), PackageFilename))
+            {
+                const FString PackageRelativeFilename = FPaths::ConvertRelativePathToFull(FPaths::GetPath(PackageFilename), Filename);
+                Filename = FPaths::FileExists(PackageRelativeFilename) ? PackageRelativeFilename : FPaths::ConvertRelativePathToFull(Filename);
+            }
+            else
+            {
+                Filename = FPaths::ConvertRelativePathToFull(Filename);
+            }
+        }
+        FPaths::NormalizeFilename(Filename);
+        Filenames.Add(Filename);
+    }
+    return Filenames;
+}
+
+UAssetImportData* UBlendAssetFactory::GetAssetImportData(UObject* Asset)
+{
+    if (UStaticMesh* Mesh = Cast<UStaticMesh>(Asset))
+    {
+        return Mesh->AssetImportData;
+    }
+
+    if (USkeletalMesh* SkeletalMesh = Cast<USkeletalMesh>(Asset))
+    {
+        #if ENGINE_MAJOR_VERSION <= 4 && ENGINE_MINOR_VERSION <= 26
+            return SkeletalMesh->AssetImportData;
+        #else
+            return SkeletalMesh->GetAssetImportData();
+        #endif
+    }
+    return nullptr;
+}
+
+EReimportResult::Type UBlendAssetFactory::ReimportBlendAsset(UObject* Obj, UAssetImportData* AssetImportData)
+{
+    UE_LOG(LogBlendImporter, Log, TEXT("Re-importing Blend Asset: %s (%s)"), *Obj->GetName(), *Obj->GetClass()->GetName());
+
+    if (!AssetImportData)
+    {
+        return EReimportResult::Failed;
+    }
+
+    bSkippedUnchangedImport = false;
+
 	bool OutCanceled = false;
-    if (ImportObject(Obj->GetClass(), Obj->GetOuter(), *Obj->GetName(), RF_Public | RF_Standalone, *AssetImportData->GetFirstFilename(), *AssetImportData->GetFirstFilename(), OutCanceled) != nullptr)
+    UObject* Result = ImportObject(Obj->GetClass(), Obj->GetOuter(), *Obj->GetName(), RF_Public | RF_Standalone, *AssetImportData->GetFirstFilename(), *AssetImportData->GetFirstFilename(), OutCanceled);
+
+    PreviousFingerprints.Empty();
+    ExportObjects.Empty();
+
+    if (bSkippedUnchangedImport)
+    {
+        bSkippedUnchangedImport = false;
+        return EReimportResult::Succeeded;
+    }
+    else if (Result != nullptr)
 	{
         Obj->MarkPackageDirty();
 		return EReimportResult::Succeeded;
@@ -5,8 +5,15 @@
 #include "CoreMinimal.h"
 #include "EditorReimportHandler.h"
 #include "Factories/Factory.h"
+#include "BlendFileAnalysis.h"
+#include "BlendImportStats.h"
 #include "BlendAssetFactory.generated.h"
 
+struct FAssetData;
+class FBlenderJob;
+class FBlenderResultReader;
+class FBlendMeshBuffer;
+struct FBlendMeshBufferObject;
 class UFbxFactory;
 
 UCLASS()
@@ -18,11 +25,64 @@ public:
 	bool bUseObjectPivot = false;
 	TArray<FString> EnabledCollections;
 
+	/** How many LODs Blender makes for each mesh, including the mesh itself. Each LOD after the first keeps LODReductionRatio of the previous LOD's triangles. */
+	int32 NumLODs = 1;
+	float LODReductionRatio = 0.5f;
+
+	/** The most LODs a static mesh can have (MAX_STATIC_MESH_LODS) */
+	static const int32 MaxLODs = 8;
+
+	/** The range LODReductionRatio is kept in, wherever it's set */
+	static constexpr float MinLODReductionRatio = 0.05f;
+	static constexpr float MaxLODReductionRatio = 0.95f;
+
 	void SaveMetaData(UObject* Object) const;
 	bool LoadMetaData(UObject* Object);
 
+	/** The saved options are also an asset registry tag, so they can be read without loading the asset. Only set once the asset is saved again. */
+	static void GetAssetRegistryTags(const UObject* Object, TArray<UObject::FAssetRegistryTag>& OutTags);
+	static bool FindAssetRegistryTag(const FAssetData& AssetData, FString& OutString);
+
 	FString ToString() const;
 	bool FromString(const FString& String);
+
+	/** The collections enabled by default when importing a file with the given collections, based on these (previous) options */
+	TArray<FString> GetDefaultEnabledCollections(const TArray<FString>& Collections) const;
+	static TArray<FString> GetDefaultEnabledCollections(const TArray<FString>& PreviousCollections, const TArray<FString>& Collections);
+};
+
+/** A copy of the import options for an import running in the background, as the options object is changed by later imports */
+struct FBlendQueuedImportOptions
+{
+	bool bUseObjectPivot = false;
+	TArray<FString> EnabledCollections;
+	int32 NumLODs = 1;
+	float LODReductionRatio = 0.5f;
+
+	/** EnabledCollections are the previous options, to be resolved against the file's collections the way the import dialog defaults them */
+	bool bDefaultCollections = false;
+
+	/** Whether the meshes are transferred directly, decided on the game thread when queued as it depends on the factory's FBX options */
+	bool bDirectMeshTransfer = false;
+};
+
+/**
+ * An import whose options were settled ahead of it, by the import queue or commandlet. The import uses them instead of the options saved
+ * with existing assets, without showing the dialog, and leaves the options the dialog remembers as they were.
+ * Once exported ahead of the import, the import uses the export rather than running Blender itself.
+ */
+struct FBlendPreparedImport
+{
+	FString Filename;
+	FBlendQueuedImportOptions Options;
+
+	FString OutputFilename;
+	bool bExported = false;
+	TMap<FString, FString> Fingerprints;
+
+	/** The file's analysis, when it was analysed natively before the export, or by Blender as part of it */
+	bool bAnalysed = false;
+	FBlendFileAnalysis Analysis;
 };
 
 UCLASS()
@@ -47,10 +107,85 @@ public:
 	virtual int32 GetPriority() const override;
 	// End FReimportHandler Interface
 
+	/**
+	 * Creates a job exporting the file of a prepared import, returning false if the file can't be exported. Safe to call off the game thread.
+	 * Default collections in the options are resolved against the file, or by Blender if the file can't be analysed natively.
+	 * If the export is cached, it's retrieved instead and OutJob is left empty. Otherwise FinishQueuedExport completes the import once the job is done.
+	 */
+	static bool BeginQueuedExport(FBlendPreparedImport& Import, TUniquePtr<FBlenderJob>& OutJob, FString& OutCacheKey);
+
+	/** Stores a finished export job in the prepared import, and in the export cache. Returns false if the export failed. */
+	static bool FinishQueuedExport(FBlendPreparedImport& Import, const FBlenderJob& Job, bool bSucceeded, const FString& CacheKey);
+
+	/** The file an export to OutputFilename actually wrote, which is a mesh buffer instead of the FBX when the meshes were transferred directly */
+	static FString GetExportedFilename(const FString& OutputFilename);
+
+	/**
+	 * Reimports meshes with one Blender export and one import for each .blend file, folder and set of import options they were imported with,
+	 * rather than once per asset. Only the changed objects are exported when each mesh was made from its own objects.
+	 * In the editor with Import In Background, groups that need Blender are reimported once it finishes rather than before this returns.
+	 */
+	EReimportResult::Type ReimportFromSource(const TArray<UObject*>& Assets);
+
+	/** The static and skeletal meshes imported from the given .blend file, loaded */
+	static TArray<UObject*> FindAssetsFromSource(const FString& Filename);
+
+	/** The .blend files an asset was imported from, as full paths, read from its asset registry tags so the asset isn't loaded */
+	static TArray<FString> GetSourceFiles(const FAssetData& AssetData);
+
+	/** Object fingerprints as stored in asset metadata and the export cache */
+	static FString FingerprintsToString(const TMap<FString, FString>& Fingerprints);
+	static TMap<FString, FString> FingerprintsFromString(const FString& String);
+
+	/** Timings and sizes of the last import */
+	const FBlendImportSummary& GetImportSummary() const;
+
+	/** Makes imports of the prepared import's file use it, until it's cleared with nullptr */
+	void SetPreparedImport(TSharedPtr<const FBlendPreparedImport> InPreparedImport);
+
+	/** Whether this factory transfers meshes directly, rather than through FBX. Only call on the game thread. */
+	bool IsDirectMeshTransfer() const;
+
 private:
-	bool RunScriptOnBlendFile(const FString& Filename, const FString& ScriptName, FString& Output);
+	bool RunScriptOnBlendFile(const FString& Filename, const FString& ScriptName, const TMap<FString, FString>& Environment, FString& Output);
 	bool BlendFileAnalyse(const FString& Filename, TArray<FString>& Collections, FString& MaterialWarnings, bool& IsPacked);
+	bool BlendFileAnalyseNative(const FString& Filename, TArray<FString>& Collections, FString& MaterialWarnings, bool& IsPacked);
 	bool BlendFileExport(const FString& Filename, const bool& Unpack, FString& OutputFilename);
+	bool BlendFileAnalyseAndExport(const FString& Filename, TArray<FString>& Collections, FString& MaterialWarnings, bool& IsPacked, FString& OutputFilename);
+	bool BlendFileBeginSpeculativeExport(const FString& Filename, TArray<FString>& Collections, FString& MaterialWarnings, bool& IsPacked, FString& OutputFilename, TUniquePtr<FBlenderJob>& OutJob);
+	void GetAnalysisResults(const FBlendFileAnalysis& Analysis, TArray<FString>& Collections, FString& MaterialWarnings, bool& IsPacked);
+
+	static FString GetExportFilename(const FString& Filename);
+	static FString GetMeshBufferFilename(const FString& OutputFilename);
+	bool RetrieveCachedExport(const FString& CacheKey, const FString& OutputFilename);
+
+	/** Retrieves a cached export for importing the file with the current options, setting OutCacheKey to the key a new export is stored with */
+	bool FindCachedExport(const FString& Filename, const FString& OutputFilename, FString& OutCacheKey);
+	static bool RetrieveCachedExport(const FString& CacheKey, const FString& OutputFilename, TMap<FString, FString>& OutFingerprints);
+	void ReadExportResult(const FBlenderResultReader& Result);
+	void AddReimportEnvironment(TMap<FString, FString>& Environment) const;
+	bool IsExportUnchanged() const;
+	void SaveFingerprints(UObject* Asset, int32 NumImportedMeshes, FName ImportName) const;
+	EReimportResult::Type ReimportGroup(const TArray<UObject*>& Assets);
+	static TMap<FString, TArray<UObject*>> GroupAssetsByImport(const TArray<UObject*>& Assets);
+
+	/** Interactive reimports export in the background, with a notification that can cancel them, and reimport once Blender is done */
+	static bool CanReimportInBackground();
+	EReimportResult::Type ReimportGroupInBackground(const TArray<UObject*>& Assets);
+	/** The meshes imported from the same .blend file as the asset, into the same folder with the same options, which share an export */
+	TArray<UObject*> GetAssetsFromSameImport(UObject* Obj) const;
+	static UAssetImportData* GetAssetImportData(UObject* Asset);
+	TMap<FString, FString> GetExportEnvironment(const FString& OutputFilename, const FString& Unpack) const;
+	FString GetExportCacheKey(const FString& Filename, bool bUseObjectPivot, const TArray<FString>& EnabledCollections, int32 NumLODs, float LODReductionRatio, const TArray<FString>& Objects = TArray<FString>()) const;
+
+	/** The export environment and cache key for the given options, without reading the factory, so queued exports can make them off the game thread */
+	static TMap<FString, FString> GetExportEnvironment(const FString& OutputFilename, const FString& Unpack, const FBlendQueuedImportOptions& Options);
+	static FString GetExportCacheKey(const FString& Filename, const FBlendQueuedImportOptions& Options, const TArray<FString>& Objects = TArray<FString>());
+	FBlendQueuedImportOptions GetExportOptions(bool bUseObjectPivot, const TArray<FString>& EnabledCollections, int32 NumLODs, float LODReductionRatio) const;
+	bool IsExportUpToDate(const FString& Filename, const FString& OutputFilename);
+	void RememberExport(const FString& Filename);
+	UObject* ImportMeshBuffer(UObject* InParent, FName InName, EObjectFlags Flags, const FString& MeshBufferFilename, bool bPlaceInstances, TArray<UObject*>& OutImportedObjects);
+	static UStaticMesh* BuildMeshBufferMesh(UObject* InParent, FName InName, EObjectFlags Flags, const FBlendMeshBuffer& MeshBuffer, const FBlendMeshBufferObject* InstancedObject, TArray<UStaticMesh*>& OutMeshesToBuild);
 	bool CanReimportBlendAsset(UAssetImportData* AssetImportData, TArray<FString>& OutFilenames);
 	EReimportResult::Type ReimportBlendAsset(UObject* Obj, UAssetImportData* AssetImportData);
 	
@@ -65,8 +200,37 @@ private:
 
     UBlendImportOptions* ImportOptions;
 
+	/** Set by the import queue and commandlet around their imports, with the options object the import uses in place of the remembered one */
+	TSharedPtr<const FBlendPreparedImport> PreparedImport;
+	UPROPERTY()
+	UBlendImportOptions* PreparedImportOptions;
+
 	FString PreviousImportedFilename;
 	FString PreviousImportOptionsString;
-	FDateTime PreviousImportedTimeStamp;
-	FMD5Hash PreviousImportedHash;
+	FString PreviousImportedHash;
+
+	/** While reimporting, the fingerprints of the objects the asset was made from, and those objects if it was made from only some of the exported objects */
+	TMap<FString, FString> PreviousFingerprints;
+	TArray<FString> ExportObjects;
+
+	/** Fingerprints of the objects in the last export */
+	TMap<FString, FString> ExportedFingerprints;
+	bool bSkippedUnchangedImport;
+
+	/** While reimporting a group, only export objects that changed from PreviousFingerprints or were added since, which are each their own asset */
+	bool bExportChangedOnly;
+
+	/** While reimporting a group, the asset made from each object, and the name the group was first imported with */
+	TMap<FString, TWeakObjectPtr<UObject>> ReimportAssets;
+	FName ReimportImportName;
+
+	/** Assets updated by a grouped reimport, which succeed without doing anything when the reimport manager gets to them this frame */
+	TSet<TWeakObjectPtr<UObject>> CoalescedReimports;
+
+	/** Materials of the analysed file that fit a master material, and how many materials it has in all */
+	TArray<FBlendMaterialTemplate> MaterialTemplates;
+	int32 NumAnalysedMaterials;
+
+	/** Timings and sizes of the current import, reported when it's done */
+	FBlendImportSummary ImportSummary;
 };
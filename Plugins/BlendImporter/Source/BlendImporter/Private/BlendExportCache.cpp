@@ -0,0 +1,212 @@
+// Copyright 2022 nuclearfriend
+
+#include "BlendExportCache.h"
+#include "BlendFileHashes.h"
+#include "BlendImporter.h"
+#include "BlendImporterSettings.h"
+#include "HAL/PlatformFileManager.h"
+#include "Interfaces/IPluginManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/SecureHash.h"
+
+FString FBlendExportCache::GetKey(const FString& Filename, const FString& OptionsString, const FString& BlenderExecutable)
+{
+    UBlendImporterSettings* Settings = GetMutableDefault<UBlendImporterSettings>();
+    if (!Settings->IsUseExportCache())
+    {
+        return FString();
+    }
+
+    const FString SourceHash = FBlendImporterModule::Get().GetFileHashes().GetHash(Filename);
+    const FString BlenderVersion = UBlendImporterSettings::GetBlenderVersion(BlenderExecutable);
+    if (SourceHash.IsEmpty() || BlenderVersion.IsEmpty())
+    {
+        return FString();
+    }
+
+    const FPluginDescriptor& Plugin = IPluginManager::Get().FindPlugin(TEXT("BlendImporter"))->GetDescriptor();
+
+    const FString KeySource = FString::Printf(TEXT("%s|%s|%d|%s|%s|%s"),
+        *SourceHash, *OptionsString, Plugin.Version, *Plugin.VersionName, *GetScriptVersion(), *BlenderVersion);
+
+    FTCHARToUTF8 KeySourceUTF8(*KeySource);
+    FSHAHash KeyHash;
+    FSHA1::HashBuffer(KeySourceUTF8.Get(), KeySourceUTF8.Length(), KeyHash.Hash);
+    return KeyHash.ToString();
+}
+
+bool FBlendExportCache::Retrieve(const FString& Key, const FString& OutputFilename, FString* OutObjectFingerprints)
+{
+    if (Key.IsEmpty())
+    {
+        return false;
+    }
+
+    const FString CachedFilename = GetEntryFilename(Key, TEXT("fbx"));
+    FString Integrity;
+    if (!FFileHelper::LoadFileToString(Integrity, *GetEntryFilename(Key, TEXT("meta"))))
+    {
+        return false;
+    }
+
+    // The entry stores the export's size and hash, so truncated or corrupted files in a shared cache aren't used
+    FString ExpectedSize;
+    FString ExpectedHash;
+    if (!Integrity.TrimStartAndEnd().Split(TEXT("|"), &ExpectedSize, &ExpectedHash)
+        || IFileManager::Get().FileSize(*CachedFilename) != FCString::Atoi64(*ExpectedSize)
+        || LexToString(FMD5Hash::HashFile(*CachedFilename)) != ExpectedHash)
+    {
+        UE_LOG(LogBlendImporter, Warning, TEXT("Cached export %s failed its integrity check, removing it"), *Key);
+        RemoveEntry(Key);
+        return false;
+    }
+
+    if (IFileManager::Get().Copy(*OutputFilename, *CachedFilename) != COPY_OK)
+    {
+        return false;
+    }
+
+    // Entries are evicted least recently used first
+    IFileManager::Get().SetTimeStamp(*CachedFilename, FDateTime::UtcNow());
+
+    if (OutObjectFingerprints)
+    {
+        OutObjectFingerprints->Empty();
+        FFileHelper::LoadFileToString(*OutObjectFingerprints, *GetEntryFilename(Key, TEXT("objects")));
+    }
+
+    UE_LOG(LogBlendImporter, Log, TEXT("Using cached export %s"), *Key);
+    return true;
+}
+
+bool FBlendExportCache::Contains(const FString& Key) const
+{
+    return !Key.IsEmpty() && FPaths::FileExists(GetEntryFilename(Key, TEXT("fbx"))) && FPaths::FileExists(GetEntryFilename(Key, TEXT("meta")));
+}
+
+bool FBlendExportCache::GetObjectFingerprints(const FString& Key, FString& OutObjectFingerprints) const
+{
+    return Contains(Key) && FFileHelper::LoadFileToString(OutObjectFingerprints, *GetEntryFilename(Key, TEXT("objects")));
+}
+
+void FBlendExportCache::Store(const FString& Key, const FString& ExportedFilename, const FString& ObjectFingerprints)
+{
+    if (Key.IsEmpty())
+    {
+        return;
+    }
+
+    const int64 Size = IFileManager::Get().FileSize(*ExportedFilename);
+    const FMD5Hash Hash = FMD5Hash::HashFile(*ExportedFilename);
+    if (Size < 0 || !Hash.IsValid())
+    {
+        return;
+    }
+
+    // The fingerprints are written first, as the entry is only used once its meta file exists
+    const bool bStored = (ObjectFingerprints.IsEmpty() || WriteAtomically(GetEntryFilename(Key, TEXT("objects")), [&ObjectFingerprints](const FString& TempFilename)
+    {
+        return FFileHelper::SaveStringToFile(ObjectFingerprints, *TempFilename, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM);
+    }))
+    && WriteAtomically(GetEntryFilename(Key, TEXT("fbx")), [&ExportedFilename](const FString& TempFilename)
+    {
+        return IFileManager::Get().Copy(*TempFilename, *ExportedFilename) == COPY_OK;
+    })
+    && WriteAtomically(GetEntryFilename(Key, TEXT("meta")), [Size, &Hash](const FString& TempFilename)
+    {
+        return FFileHelper::SaveStringToFile(FString::Printf(TEXT("%lld|%s"), Size, *LexToString(Hash)), *TempFilename);
+    });
+
+    if (!bStored)
+    {
+        UE_LOG(LogBlendImporter, Warning, TEXT("Failed to store export in the cache at \"%s\""), *GetCacheDirectory());
+        RemoveEntry(Key);
+        return;
+    }
+
+    EvictLeastRecentlyUsed();
+}
+
+FString FBlendExportCache::GetCacheDirectory() const
+{
+    UBlendImporterSettings* Settings = GetMutableDefault<UBlendImporterSettings>();
+    return Settings->GetExportCacheDirectory();
+}
+
+FString FBlendExportCache::GetEntryFilename(const FString& Key, const TCHAR* Extension) const
+{
+    return FPaths::Combine(GetCacheDirectory(), FString::Printf(TEXT("%s.%s"), *Key, Extension));
+}
+
+FString FBlendExportCache::GetScriptVersion()
+{
+    FScopeLock Lock(&VersionLock);
+    if (ScriptVersion.IsEmpty())
+    {
+        FString PluginPath = IPluginManager::Get().FindPlugin(TEXT("BlendImporter"))->GetBaseDir();
+        ScriptVersion = LexToString(FMD5Hash::HashFile(*(PluginPath + TEXT("/Scripts/blender_export.py"))))
+            + LexToString(FMD5Hash::HashFile(*(PluginPath + TEXT("/Scripts/blender_common.py"))));
+    }
+    return ScriptVersion;
+}
+
+void FBlendExportCache::RemoveEntry(const FString& Key)
+{
+    IFileManager::Get().Delete(*GetEntryFilename(Key, TEXT("fbx")), false, false, true);
+    IFileManager::Get().Delete(*GetEntryFilename(Key, TEXT("meta")), false, false, true);
+    IFileManager::Get().Delete(*GetEntryFilename(Key, TEXT("objects")), false, false, true);
+}
+
+void FBlendExportCache::EvictLeastRecentlyUsed()
+{
+    UBlendImporterSettings* Settings = GetMutableDefault<UBlendImporterSettings>();
+    const int64 SizeLimit = Settings->GetExportCacheSizeLimit();
+
+    struct FEntry
+    {
+        FString Key;
+        int64 Size;
+        FDateTime LastUsed;
+    };
+    TArray<FEntry> Entries;
+    int64 TotalSize = 0;
+
+    FPlatformFileManager::Get().GetPlatformFile().IterateDirectoryStat(*GetCacheDirectory(), [&Entries, &TotalSize](const TCHAR* Path, const FFileStatData& StatData)
+    {
+        if (!StatData.bIsDirectory && FPaths::GetExtension(Path) == TEXT("fbx"))
+        {
+            Entries.Add({ FPaths::GetBaseFilename(Path), StatData.FileSize, StatData.ModificationTime });
+            TotalSize += StatData.FileSize;
+        }
+        return true;
+    });
+
+    if (TotalSize <= SizeLimit)
+    {
+        return;
+    }
+
+    Entries.Sort([](const FEntry& A, const FEntry& B) { return A.LastUsed < B.LastUsed; });
+    for (const FEntry& Entry : Entries)
+    {
+        if (TotalSize <= SizeLimit)
+        {
+            break;
+        }
+
+        UE_LOG(LogBlendImporter, Verbose, TEXT("Evicting cached export %s"), *Entry.Key);
+        RemoveEntry(Entry.Key);
+        TotalSize -= Entry.Size;
+    }
+}
+
+bool FBlendExportCache::WriteAtomically(const FString& Filename, TFunctionRef<bool(const FString&)> Write)
+{
+    const FString TempFilename = FString::Printf(TEXT("%s.%s.tmp"), *Filename, *FGuid::NewGuid().ToString());
+    if (!Write(TempFilename) || !IFileManager::Get().Move(*Filename, *TempFilename, true, true, false, true))
+    {
+        IFileManager::Get().Delete(*TempFilename, false, false, true);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,41 @@
+// Copyright 2022 nuclearfriend
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * On-disk cache of exported FBX files, keyed by everything that affects the export: the .blend file's contents, the import options,
+ * the plugin and export script versions, and the Blender version. The cache directory can be shared between workstations.
+ */
+class FBlendExportCache
+{
+public:
+	/** Returns an empty key if the cache is disabled, or the key can't be determined */
+	FString GetKey(const FString& Filename, const FString& OptionsString, const FString& BlenderExecutable);
+
+	/** Copies the cached export to OutputFilename, returning false if there isn't a valid one. Also returns the fingerprints stored with it, if any. */
+	bool Retrieve(const FString& Key, const FString& OutputFilename, FString* OutObjectFingerprints = nullptr);
+
+	bool Contains(const FString& Key) const;
+
+	/** The fingerprints stored with a cached export, without retrieving it. Returns false if there isn't one. */
+	bool GetObjectFingerprints(const FString& Key, FString& OutObjectFingerprints) const;
+
+	void Store(const FString& Key, const FString& ExportedFilename, const FString& ObjectFingerprints = FString());
+
+private:
+	FString GetCacheDirectory() const;
+	FString GetEntryFilename(const FString& Key, const TCHAR* Extension) const;
+	FString GetScriptVersion();
+	void RemoveEntry(const FString& Key);
+	void EvictLeastRecentlyUsed();
+
+	/** Write to a temporary file and move it into place, so other editors sharing the cache never see a partial file */
+	bool WriteAtomically(const FString& Filename, TFunctionRef<bool(const FString&)> Write);
+
+private:
+	/** Keys are made on background threads by queued imports */
+	FCriticalSection VersionLock;
+	FString ScriptVersion;
+};
@@ -0,0 +1,459 @@
+// Copyright 2022 nuclearfriend
+
+#include "BlendFileAnalysis.h"
+#include "BlendFileReader.h"
+#include "Algo/Find.h"
+#include "Misc/SecureHash.h"
+
+// DNA_layer_types.h
+static const int64 ViewLayerRender = 1 << 0;
+static const int64 LayerCollectionExclude = 1 << 4;
+static const int64 LayerCollectionHide = 1 << 7;
+
+// DNA_object_enums.h
+static const int64 ObjectTypeMesh = 1;
+
+// DNA_material_types.h
+static const int64 MaterialBlendClip = 3;
+static const int64 MaterialBlendHashed = 4;
+static const int64 MaterialBlendBlend = 5;
+
+static const TCHAR* CheckInputNames[] = { TEXT("Base Color"), TEXT("Metallic"), TEXT("Roughness"), TEXT("Normal") };
+
+enum class ETemplateParameterKind
+{
+    Color,
+    Scalar,
+    Normal
+};
+
+/** Principled BSDF inputs used by the master materials, matching templateParameters in blender_analyse.py */
+struct FTemplateParameter
+{
+    const TCHAR* InputName;
+    const TCHAR* ParameterName;
+    ETemplateParameterKind Kind;
+    /** The image texture output the input can be linked to, if any */
+    const TCHAR* TextureSocket;
+};
+
+static const FTemplateParameter TemplateParameters[] =
+{
+    { TEXT("Base Color"), TEXT("BaseColor"), ETemplateParameterKind::Color, TEXT("Color") },
+    { TEXT("Metallic"), TEXT("Metallic"), ETemplateParameterKind::Scalar, TEXT("Color") },
+    { TEXT("Roughness"), TEXT("Roughness"), ETemplateParameterKind::Scalar, TEXT("Color") },
+    { TEXT("Normal"), TEXT("Normal"), ETemplateParameterKind::Normal, TEXT("Color") },
+    { TEXT("Emission"), TEXT("EmissiveColor"), ETemplateParameterKind::Color, TEXT("Color") },
+    { TEXT("Emission Color"), TEXT("EmissiveColor"), ETemplateParameterKind::Color, TEXT("Color") },
+    { TEXT("Emission Strength"), TEXT("EmissiveStrength"), ETemplateParameterKind::Scalar, nullptr },
+    { TEXT("Alpha"), TEXT("Opacity"), ETemplateParameterKind::Scalar, TEXT("Alpha") },
+};
+
+static FBlendStructView FindNode(const TArray<FBlendStructView>& Nodes, const TCHAR* IdName)
+{
+    for (const FBlendStructView& Node : Nodes)
+    {
+        if (Node.GetString(TEXT("idname")) == IdName)
+        {
+            return Node;
+        }
+    }
+    return FBlendStructView();
+}
+
+static FBlendStructView FindInput(const FBlendStructView& Node, const TCHAR* Name)
+{
+    for (const FBlendStructView& Socket : Node.GetList(TEXT("inputs")))
+    {
+        if (Socket.GetString(TEXT("name")) == Name)
+        {
+            return Socket;
+        }
+    }
+    return FBlendStructView();
+}
+
+/** The link into the given input socket, if any */
+static FBlendStructView GetLink(const TArray<FBlendStructView>& Links, const FBlendStructView& Socket)
+{
+    if (Socket.IsValid())
+    {
+        for (const FBlendStructView& Link : Links)
+        {
+            if (Link.GetPointer(TEXT("tosock")) == Socket.GetAddress())
+            {
+                return Link;
+            }
+        }
+    }
+    return FBlendStructView();
+}
+
+/** The node linked to the given input socket, if any */
+static FBlendStructView GetLinkedNode(const TArray<FBlendStructView>& Links, const FBlendStructView& Socket)
+{
+    return GetLink(Links, Socket).Dereference(TEXT("fromnode"));
+}
+
+static bool IsImagePacked(const FBlendStructView& Image)
+{
+    // Images have a list of packed files (one per tile/view) since 2.83, a single packed file before that
+    if (Image.HasField(TEXT("packedfiles")) && Image.GetStruct(TEXT("packedfiles")).GetPointer(TEXT("first")) != 0)
+    {
+        return true;
+    }
+    return Image.GetPointer(TEXT("packedfile")) != 0;
+}
+
+/** The first of the image's packed files, which is the one Blender's Image.packed_file returns */
+static FBlendStructView GetImagePackedFile(const FBlendStructView& Image)
+{
+    if (Image.HasField(TEXT("packedfiles")))
+    {
+        const TArray<FBlendStructView> PackedFiles = Image.GetList(TEXT("packedfiles"));
+        return PackedFiles.Num() > 0 ? PackedFiles[0].Dereference(TEXT("packedfile")) : FBlendStructView();
+    }
+    return Image.Dereference(TEXT("packedfile"));
+}
+
+/** The hash the export names the image's file after in the texture cache, see ExtractPackedImages in blender_export.py */
+static FString GetPackedImageHash(const FBlendFileReader& Reader, const FBlendStructView& PackedFile)
+{
+    const int64 Size = PackedFile.GetInt(TEXT("size"));
+    const uint64 DataAddress = PackedFile.GetPointer(TEXT("data"));
+    const FBlendFileBlock* Block = Reader.FindBlock(DataAddress);
+    if (!Block || Size < 0 || DataAddress - Block->Address + Size > static_cast<uint64>(Block->Length))
+    {
+        return FString();
+    }
+
+    FSHAHash Hash;
+    FSHA1::HashBuffer(Block->Data + (DataAddress - Block->Address), Size, Hash.Hash);
+    return Hash.ToString().ToLower().Left(16);
+}
+
+bool FBlendFileAnalysis::Analyse(const FString& Filename, FString& OutError)
+{
+    FBlendFileReader Reader;
+    if (!Reader.Open(Filename, OutError))
+    {
+        return false;
+    }
+
+    // Collections and view layers were added in 2.80, older files are converted by Blender on load
+    if (Reader.GetVersion() < 280)
+    {
+        OutError = FString::Printf(TEXT("File was saved with Blender %d.%02d"), Reader.GetVersion() / 100, Reader.GetVersion() % 100);
+        return false;
+    }
+
+    // Data linked from other files isn't in this one
+    TArray<const FBlendFileBlock*> Libraries;
+    Reader.GetBlocks("LI", Libraries);
+    if (Libraries.Num() > 0)
+    {
+        OutError = TEXT("File links data from other .blend files");
+        return false;
+    }
+
+    if (!AnalyseCollections(Reader, OutError))
+    {
+        return false;
+    }
+    AnalyseMaterials(Reader, Filename);
+    AnalyseObjects(Reader);
+    return true;
+}
+
+bool FBlendFileAnalysis::AnalyseCollections(const FBlendFileReader& Reader, FString& OutError)
+{
+    TArray<const FBlendFileBlock*> GlobalBlocks;
+    Reader.GetBlocks("GLOB", GlobalBlocks);
+    if (GlobalBlocks.Num() == 0)
+    {
+        OutError = TEXT("No file globals found");
+        return false;
+    }
+
+    const FBlendStructView Global = Reader.GetBlockView(*GlobalBlocks[0]);
+    const FBlendStructView Scene = Global.Dereference(TEXT("curscene"));
+    if (!Scene.IsValid())
+    {
+        OutError = TEXT("No current scene found");
+        return false;
+    }
+
+    // Use the view layer Blender would make active on load: the one the file was saved with, else the first one used for rendering
+    FBlendStructView ViewLayer = Global.Dereference(TEXT("cur_view_layer"));
+    if (!ViewLayer.IsValid())
+    {
+        const TArray<FBlendStructView> ViewLayers = Scene.GetList(TEXT("view_layers"));
+        for (const FBlendStructView& Candidate : ViewLayers)
+        {
+            if (Candidate.GetInt(TEXT("flag")) & ViewLayerRender)
+            {
+                ViewLayer = Candidate;
+                break;
+            }
+        }
+        if (!ViewLayer.IsValid() && ViewLayers.Num() > 0)
+        {
+            ViewLayer = ViewLayers[0];
+        }
+    }
+
+    const TArray<FBlendStructView> SceneLayerCollections = ViewLayer.GetList(TEXT("layer_collections"));
+    if (SceneLayerCollections.Num() == 0)
+    {
+        OutError = TEXT("No view layer found");
+        return false;
+    }
+
+    TFunction<void(const FBlendStructView&)> GetLayerCollections = [this, &GetLayerCollections](const FBlendStructView& Current)
+    {
+        for (const FBlendStructView& Child : Current.GetList(TEXT("layer_collections")))
+        {
+            const int64 Flag = Child.GetInt(TEXT("flag"));
+            if (!(Flag & LayerCollectionExclude) && !(Flag & LayerCollectionHide))
+            {
+                Collections.Add(Child.Dereference(TEXT("collection")).GetIDName());
+            }
+            GetLayerCollections(Child);
+        }
+    };
+    GetLayerCollections(SceneLayerCollections[0]);
+
+    return true;
+}
+
+void FBlendFileAnalysis::AnalyseMaterials(const FBlendFileReader& Reader, const FString& Filename)
+{
+    TArray<const FBlendFileBlock*> MaterialBlocks;
+    Reader.GetBlocks("MA", MaterialBlocks);
+
+    // Blender keeps its data sorted by name
+    TArray<FBlendStructView> Materials;
+    for (const FBlendFileBlock* Block : MaterialBlocks)
+    {
+        FBlendStructView Material = Reader.GetBlockView(*Block);
+        if (Material.IsValid() && Material.GetIDName() != TEXT("Dots Stroke"))
+        {
+            Materials.Add(Material);
+        }
+    }
+    Materials.Sort([](const FBlendStructView& A, const FBlendStructView& B) { return A.GetIDName().Compare(B.GetIDName(), ESearchCase::CaseSensitive) < 0; });
+    NumMaterials = Materials.Num();
+
+    for (const FBlendStructView& Material : Materials)
+    {
+        FBlendMaterialIssues Issues;
+        Issues.MaterialName = Material.GetIDName();
+        AnalyseMaterial(Material, Issues);
+        if (Issues.Issues.Num() > 0)
+        {
+            MaterialIssues.Add(MoveTemp(Issues));
+        }
+
+        FBlendMaterialTemplate Template;
+        if (AnalyseMaterialTemplate(Reader, Material, Filename, Template))
+        {
+            MaterialTemplates.Add(MoveTemp(Template));
+        }
+    }
+}
+
+void FBlendFileAnalysis::AnalyseObjects(const FBlendFileReader& Reader)
+{
+    TArray<const FBlendFileBlock*> ObjectBlocks;
+    Reader.GetBlocks("OB", ObjectBlocks);
+    NumObjects = ObjectBlocks.Num();
+
+    // Counted per object like GetObjectStats in blender_common.py, so meshes shared by several objects count once for each
+    for (const FBlendFileBlock* Block : ObjectBlocks)
+    {
+        const FBlendStructView Object = Reader.GetBlockView(*Block);
+        if (!Object.IsValid() || Object.GetInt(TEXT("type")) != ObjectTypeMesh)
+        {
+            continue;
+        }
+
+        // Renamed in Blender 4.0
+        const FBlendStructView Mesh = Object.Dereference(TEXT("data"), TEXT("Mesh"));
+        const bool bRenamed = Mesh.HasField(TEXT("faces_num"));
+        const int64 NumCorners = Mesh.GetInt(bRenamed ? TEXT("corners_num") : TEXT("totloop"));
+        const int64 NumFaces = Mesh.GetInt(bRenamed ? TEXT("faces_num") : TEXT("totpoly"));
+        NumTriangles += FMath::Max<int64>(NumCorners - 2 * NumFaces, 0);
+    }
+}
+
+void FBlendFileAnalysis::AnalyseMaterial(const FBlendStructView& Material, FBlendMaterialIssues& OutIssues)
+{
+    const FBlendStructView NodeTree = Material.GetInt(TEXT("use_nodes")) ? Material.Dereference(TEXT("nodetree")) : FBlendStructView();
+    const TArray<FBlendStructView> Nodes = NodeTree.GetList(TEXT("nodes"));
+    const TArray<FBlendStructView> Links = NodeTree.GetList(TEXT("links"));
+
+    const FBlendStructView MaterialOutput = FindNode(Nodes, TEXT("ShaderNodeOutputMaterial"));
+    if (!MaterialOutput.IsValid())
+    {
+        OutIssues.Issues.Add(TEXT("NO_MATERIAL_OUTPUT"));
+        return;
+    }
+
+    const FBlendStructView BSDFNode = GetLinkedNode(Links, FindInput(MaterialOutput, TEXT("Surface")));
+    if (!BSDFNode.IsValid())
+    {
+        OutIssues.Issues.Add(TEXT("MATERIAL_OUTPUT_SURFACE_INPUT_NOT_CONNECTED"));
+        return;
+    }
+
+    if (BSDFNode.GetString(TEXT("idname")) != TEXT("ShaderNodeBsdfPrincipled"))
+    {
+        OutIssues.Issues.Add(TEXT("MATERIAL_OUTPUT_SURFACE_INPUT_NOT_BSDF"));
+        return;
+    }
+
+    for (const TCHAR* InputName : CheckInputNames)
+    {
+        const FString SafeInputName = FString(InputName).ToUpper().Replace(TEXT(" "), TEXT("_"));
+
+        FBlendStructView TextureNode = GetLinkedNode(Links, FindInput(BSDFNode, InputName));
+        if (!TextureNode.IsValid())
+        {
+            continue;
+        }
+
+        if (FCString::Strcmp(InputName, TEXT("Normal")) == 0)
+        {
+            if (TextureNode.GetString(TEXT("idname")) != TEXT("ShaderNodeNormalMap"))
+            {
+                OutIssues.Issues.Add(FString::Printf(TEXT("BSDF_%s_INPUT_NOT_NORMAL_MAP"), *SafeInputName));
+                continue;
+            }
+
+            TextureNode = GetLinkedNode(Links, FindInput(TextureNode, TEXT("Color")));
+            if (!TextureNode.IsValid())
+            {
+                OutIssues.Issues.Add(TEXT("NORMAL_MAP_COLOR_INPUT_NOT_CONNECTED"));
+                continue;
+            }
+        }
+
+        if (TextureNode.GetString(TEXT("idname")) != TEXT("ShaderNodeTexImage"))
+        {
+            OutIssues.Issues.Add(FString::Printf(TEXT("BSDF_%s_INPUT_NOT_TEXTURE"), *SafeInputName));
+            continue;
+        }
+
+        const FBlendStructView Image = TextureNode.Dereference(TEXT("id"), TEXT("Image"));
+        if (Image.IsValid() && IsImagePacked(Image))
+        {
+            bHasPackedImages = true;
+        }
+    }
+}
+
+bool FBlendFileAnalysis::AnalyseMaterialTemplate(const FBlendFileReader& Reader, const FBlendStructView& Material, const FString& Filename, FBlendMaterialTemplate& OutTemplate) const
+{
+    const FBlendStructView NodeTree = Material.GetInt(TEXT("use_nodes")) ? Material.Dereference(TEXT("nodetree")) : FBlendStructView();
+    const TArray<FBlendStructView> Nodes = NodeTree.GetList(TEXT("nodes"));
+    const TArray<FBlendStructView> Links = NodeTree.GetList(TEXT("links"));
+
+    const FBlendStructView BSDFNode = GetLinkedNode(Links, FindInput(FindNode(Nodes, TEXT("ShaderNodeOutputMaterial")), TEXT("Surface")));
+    if (!BSDFNode.IsValid() || BSDFNode.GetString(TEXT("idname")) != TEXT("ShaderNodeBsdfPrincipled"))
+    {
+        return false;
+    }
+
+    OutTemplate.MaterialName = Material.GetIDName();
+    switch (Material.GetInt(TEXT("blend_method")))
+    {
+        case MaterialBlendBlend:
+            OutTemplate.Template = TEXT("Translucent");
+            break;
+
+        case MaterialBlendClip:
+        case MaterialBlendHashed:
+            OutTemplate.Template = TEXT("Masked");
+            break;
+
+        default:
+            OutTemplate.Template = TEXT("Opaque");
+            break;
+    }
+
+    for (const FBlendStructView& Input : BSDFNode.GetList(TEXT("inputs")))
+    {
+        const FString InputName = Input.GetString(TEXT("name"));
+        const FTemplateParameter* Parameter = Algo::FindByPredicate(TemplateParameters, [&InputName](const FTemplateParameter& Candidate) { return InputName == Candidate.InputName; });
+        FBlendStructView Link = GetLink(Links, Input);
+        if (!Parameter)
+        {
+            if (Link.IsValid())
+            {
+                return false;
+            }
+            continue;
+        }
+
+        if (!Link.IsValid())
+        {
+            if (Parameter->Kind == ETemplateParameterKind::Color)
+            {
+                const FBlendStructView Value = Input.Dereference(TEXT("default_value"), TEXT("bNodeSocketValueRGBA"));
+                OutTemplate.Colors.Add(Parameter->ParameterName, FLinearColor(Value.GetFloat(TEXT("value"), 0), Value.GetFloat(TEXT("value"), 1), Value.GetFloat(TEXT("value"), 2), Value.GetFloat(TEXT("value"), 3)));
+            }
+            else if (Parameter->Kind == ETemplateParameterKind::Scalar)
+            {
+                OutTemplate.Scalars.Add(Parameter->ParameterName, Input.Dereference(TEXT("default_value"), TEXT("bNodeSocketValueFloat")).GetFloat(TEXT("value")));
+            }
+            continue;
+        }
+
+        if (Parameter->Kind == ETemplateParameterKind::Normal)
+        {
+            const FBlendStructView NormalMap = Link.Dereference(TEXT("fromnode"));
+            if (NormalMap.GetString(TEXT("idname")) != TEXT("ShaderNodeNormalMap"))
+            {
+                return false;
+            }
+            Link = GetLink(Links, FindInput(NormalMap, TEXT("Color")));
+        }
+
+        const FBlendStructView TextureNode = Link.Dereference(TEXT("fromnode"));
+        if (!Parameter->TextureSocket || TextureNode.GetString(TEXT("idname")) != TEXT("ShaderNodeTexImage")
+            || Link.Dereference(TEXT("fromsock")).GetString(TEXT("name")) != Parameter->TextureSocket)
+        {
+            return false;
+        }
+
+        const FBlendStructView Image = TextureNode.Dereference(TEXT("id"), TEXT("Image"));
+        if (!Image.IsValid())
+        {
+            return false;
+        }
+
+        FBlendTemplateTexture Texture;
+        if (IsImagePacked(Image))
+        {
+            Texture.PackedHash = GetPackedImageHash(Reader, GetImagePackedFile(Image));
+            if (Texture.PackedHash.IsEmpty())
+            {
+                return false;
+            }
+        }
+        else
+        {
+            // Paths starting with // are relative to the .blend file
+            FString ImagePath = Image.GetString(Image.HasField(TEXT("filepath")) ? TEXT("filepath") : TEXT("name"));
+            if (ImagePath.RemoveFromStart(TEXT("//")))
+            {
+                ImagePath = FPaths::Combine(FPaths::GetPath(Filename), ImagePath);
+            }
+            FPaths::NormalizeFilename(ImagePath);
+            FPaths::CollapseRelativeDirectories(ImagePath);
+            Texture.Filename = ImagePath;
+        }
+        OutTemplate.Textures.Add(Parameter->ParameterName, Texture);
+    }
+    return true;
+}
@@ -0,0 +1,67 @@
+// Copyright 2022 nuclearfriend
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FBlendFileReader;
+class FBlendStructView;
+
+/** A material with issues that may make it not display properly in Unreal, using the same issue names as blender_analyse.py */
+struct FBlendMaterialIssues
+{
+	FString MaterialName;
+	TArray<FString> Issues;
+};
+
+/** An image used by a material template: a file, or a packed image found by its hash in the texture cache once the export has extracted it */
+struct FBlendTemplateTexture
+{
+	FString Filename;
+	FString PackedHash;
+};
+
+/**
+ * A material that fits one of the plugin's master materials, so it can be imported as an instance of it instead of a material of its own.
+ * Parameters are named after the master material's parameters (BaseColor, Metallic, Roughness, Normal, EmissiveColor, EmissiveStrength and Opacity).
+ */
+struct FBlendMaterialTemplate
+{
+	FString MaterialName;
+
+	/** Opaque, Masked or Translucent, from the material's blend mode */
+	FString Template;
+
+	TMap<FString, FLinearColor> Colors;
+	TMap<FString, float> Scalars;
+	TMap<FString, FBlendTemplateTexture> Textures;
+};
+
+/**
+ * The same analysis as blender_analyse.py (visible collections, material node issues, packed textures and material templates), read directly from the .blend
+ * file with FBlendFileReader instead of launching Blender.
+ */
+struct FBlendFileAnalysis
+{
+	TArray<FString> Collections;
+	TArray<FBlendMaterialIssues> MaterialIssues;
+	TArray<FBlendMaterialTemplate> MaterialTemplates;
+	int32 NumMaterials = 0;
+	bool bHasPackedImages = false;
+
+	/** Objects in the file, and the triangles of the meshes they use, for estimating how much Blender needs to export it */
+	int32 NumObjects = 0;
+	int64 NumTriangles = 0;
+
+	/** Returns false with the reason if the file can't be analysed natively, in which case blender_analyse.py should be used instead */
+	bool Analyse(const FString& Filename, FString& OutError);
+
+private:
+	bool AnalyseCollections(const FBlendFileReader& Reader, FString& OutError);
+	void AnalyseMaterials(const FBlendFileReader& Reader, const FString& Filename);
+	void AnalyseObjects(const FBlendFileReader& Reader);
+	void AnalyseMaterial(const FBlendStructView& Material, FBlendMaterialIssues& OutIssues);
+
+	/** Classifies the material the way GetMaterialTemplate in blender_analyse.py does, returning false if it doesn't fit a master material */
+	bool AnalyseMaterialTemplate(const FBlendFileReader& Reader, const FBlendStructView& Material, const FString& Filename, FBlendMaterialTemplate& OutTemplate) const;
+};
@@ -0,0 +1,168 @@
+// Copyright 2022 nuclearfriend
+
+#include "BlendFileHashes.h"
+#include "BlendImporter.h"
+#include "Async/MappedFileHandle.h"
+#include "Async/ParallelFor.h"
+#include "HAL/PlatformFileManager.h"
+#include "Hash/CityHash.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+
+// Large enough that hashing a chunk outweighs scheduling it
+static const int64 HashChunkSize = 4 * 1024 * 1024;
+
+FBlendFileHashes::FBlendFileHashes()
+    : bLoaded(false)
+{
+}
+
+FString FBlendFileHashes::GetHash(const FString& Filename)
+{
+    const FString FullFilename = FPaths::ConvertRelativePathToFull(Filename);
+    const FFileStatData Stat = IFileManager::Get().GetStatData(*FullFilename);
+    if (!Stat.bIsValid || Stat.bIsDirectory)
+    {
+        return FString();
+    }
+
+    {
+        FScopeLock ScopeLock(&Lock);
+        if (!bLoaded)
+        {
+            Load();
+        }
+
+        const FEntry* Entry = Entries.Find(FullFilename);
+        if (Entry && Entry->Size == Stat.FileSize && Entry->TimeStamp == Stat.ModificationTime)
+        {
+            return Entry->Hash;
+        }
+    }
+
+    // Hashed outside the lock, so checking other files doesn't wait for a large one
+    const double StartTime = FPlatformTime::Seconds();
+    const FString Hash = HashFile(FullFilename);
+    if (Hash.IsEmpty())
+    {
+        return Hash;
+    }
+    UE_LOG(LogBlendImporter, Log, TEXT("Hashed '%s' (%.1f MB) in %.1fms"), *FullFilename, Stat.FileSize / (1024.0 * 1024.0), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+
+    // Stored with the size and time from before hashing, so a file changed while it was hashed is hashed again next time
+    FScopeLock ScopeLock(&Lock);
+    FEntry& Entry = Entries.FindOrAdd(FullFilename);
+    Entry.Size = Stat.FileSize;
+    Entry.TimeStamp = Stat.ModificationTime;
+    Entry.Hash = Hash;
+    Save();
+    return Hash;
+}
+
+FString FBlendFileHashes::HashFile(const FString& Filename)
+{
+    IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+    const int64 FileSize = PlatformFile.FileSize(*Filename);
+    if (FileSize < 0)
+    {
+        return FString();
+    }
+
+    const int32 NumChunks = static_cast<int32>(FMath::DivideAndRoundUp(FileSize, HashChunkSize));
+    TArray<uint64> ChunkHashes;
+    ChunkHashes.SetNumZeroed(NumChunks);
+
+    // The mapped region must be released before the file handle it belongs to
+    TUniquePtr<IMappedFileHandle> MappedHandle(FileSize > 0 ? PlatformFile.OpenMapped(*Filename) : nullptr);
+    TUniquePtr<IMappedFileRegion> MappedRegion(MappedHandle.IsValid() ? MappedHandle->MapRegion(0, FileSize) : nullptr);
+    if (MappedRegion.IsValid())
+    {
+        const uint8* Data = MappedRegion->GetMappedPtr();
+        ParallelFor(NumChunks, [Data, FileSize, &ChunkHashes](int32 Chunk)
+        {
+            const int64 Offset = Chunk * HashChunkSize;
+            const int64 Size = FMath::Min(HashChunkSize, FileSize - Offset);
+            ChunkHashes[Chunk] = CityHash64(reinterpret_cast<const char*>(Data + Offset), static_cast<uint32>(Size));
+        });
+    }
+    else
+    {
+        // Not every platform supports memory mapping files
+        TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*Filename, FILEREAD_Silent));
+        if (!Reader.IsValid())
+        {
+            return FString();
+        }
+
+        TArray<uint8> Buffer;
+        Buffer.SetNumUninitialized(static_cast<int32>(FMath::Min(HashChunkSize, FileSize)));
+        for (int32 Chunk = 0; Chunk < NumChunks; Chunk++)
+        {
+            const int64 Size = FMath::Min(HashChunkSize, FileSize - Chunk * HashChunkSize);
+            Reader->Serialize(Buffer.GetData(), Size);
+            ChunkHashes[Chunk] = CityHash64(reinterpret_cast<const char*>(Buffer.GetData()), static_cast<uint32>(Size));
+        }
+
+        if (Reader->IsError())
+        {
+            return FString();
+        }
+    }
+    MappedRegion.Reset();
+    MappedHandle.Reset();
+
+    const uint64 Hash = CityHash64WithSeed(reinterpret_cast<const char*>(ChunkHashes.GetData()), ChunkHashes.Num() * sizeof(uint64), FileSize);
+    return FString::Printf(TEXT("%016llx"), Hash);
+}
+
+FString FBlendFileHashes::GetIndexFilename() const
+{
+    return FPaths::ProjectSavedDir() / TEXT("BlendImporter") / TEXT("FileHashes.txt");
+}
+
+void FBlendFileHashes::Load()
+{
+    bLoaded = true;
+
+    TArray<FString> Lines;
+    if (!FFileHelper::LoadFileToStringArray(Lines, *GetIndexFilename()))
+    {
+        return;
+    }
+
+    // One file per line, "size|time|hash|filename", the filename last as it's the only part that can contain the separator
+    for (const FString& Line : Lines)
+    {
+        FString Size, AfterSize, TimeStamp, AfterTimeStamp, Hash, Filename;
+        if (!Line.Split(TEXT("|"), &Size, &AfterSize) || !AfterSize.Split(TEXT("|"), &TimeStamp, &AfterTimeStamp) || !AfterTimeStamp.Split(TEXT("|"), &Hash, &Filename))
+        {
+            continue;
+        }
+
+        // Files that are gone are dropped, so the index doesn't keep growing
+        if (!FPaths::FileExists(Filename))
+        {
+            continue;
+        }
+
+        FEntry& Entry = Entries.FindOrAdd(Filename);
+        Entry.Size = FCString::Atoi64(*Size);
+        Entry.TimeStamp = FDateTime(FCString::Atoi64(*TimeStamp));
+        Entry.Hash = Hash;
+    }
+}
+
+void FBlendFileHashes::Save() const
+{
+    TArray<FString> Lines;
+    for (const TPair<FString, FEntry>& Entry : Entries)
+    {
+        Lines.Add(FString::Printf(TEXT("%lld|%lld|%s|%s"), Entry.Value.Size, Entry.Value.TimeStamp.GetTicks(), *Entry.Value.Hash, *Entry.Key));
+    }
+
+    if (!FFileHelper::SaveStringArrayToFile(Lines, *GetIndexFilename()))
+    {
+        UE_LOG(LogBlendImporter, Warning, TEXT("Could not save the file hash index to '%s'"), *GetIndexFilename());
+    }
+}
@@ -0,0 +1,38 @@
+// Copyright 2022 nuclearfriend
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Hashes of source files, kept with each file's size and modification time so a file is only hashed again once those change.
+ * The index is saved in the project's Saved directory, so unchanged files aren't hashed again after restarting the editor either.
+ */
+class FBlendFileHashes
+{
+public:
+	FBlendFileHashes();
+
+	/** Returns an empty string if the file can't be read. Can be called from any thread. */
+	FString GetHash(const FString& Filename);
+
+	/** Hashes the file in chunks on all cores, from a memory mapped view where the platform supports it */
+	static FString HashFile(const FString& Filename);
+
+private:
+	struct FEntry
+	{
+		int64 Size = 0;
+		FDateTime TimeStamp;
+		FString Hash;
+	};
+
+	FString GetIndexFilename() const;
+	void Load();
+	void Save() const;
+
+private:
+	FCriticalSection Lock;
+	TMap<FString, FEntry> Entries;
+	bool bLoaded;
+};
@@ -0,0 +1,689 @@
+// Copyright 2022 nuclearfriend
+
+#include "BlendFileReader.h"
+#include "Algo/BinarySearch.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/ByteSwap.h"
+#include "Misc/Compression.h"
+#include "Misc/FileHelper.h"
+
+#if WITH_BLENDIMPORTER_ZSTD
+	THIRD_PARTY_INCLUDES_START
+	#include "zstd.h"
+	THIRD_PARTY_INCLUDES_END
+#endif
+
+static const int32 BlendHeaderSize = 12;
+
+uint32 FBlendFileBlock::MakeCode(const ANSICHAR* Code)
+{
+    uint8 Bytes[4] = { 0, 0, 0, 0 };
+    for (int32 i = 0; i < 4 && Code[i] != '\0'; i++)
+    {
+        Bytes[i] = Code[i];
+    }
+    uint32 Result;
+    FMemory::Memcpy(&Result, Bytes, 4);
+    return Result;
+}
+
+const FBlendStructField* FBlendStruct::FindField(const TCHAR* Name) const
+{
+    return Fields.FindByPredicate([Name](const FBlendStructField& Field) { return Field.Name.Equals(Name, ESearchCase::CaseSensitive); });
+}
+
+FBlendStructView::FBlendStructView()
+    : Reader(nullptr)
+    , Struct(nullptr)
+    , Data(nullptr)
+    , Address(0)
+{
+}
+
+FBlendStructView::FBlendStructView(const FBlendFileReader* InReader, const FBlendStruct* InStruct, const uint8* InData, uint64 InAddress)
+    : Reader(InReader)
+    , Struct(InStruct)
+    , Data(InData)
+    , Address(InAddress)
+{
+}
+
+bool FBlendStructView::IsValid() const
+{
+    return Reader != nullptr && Struct != nullptr && Data != nullptr;
+}
+
+bool FBlendStructView::HasField(const TCHAR* Name) const
+{
+    return IsValid() && Struct->FindField(Name) != nullptr;
+}
+
+uint64 FBlendStructView::GetAddress() const
+{
+    return Address;
+}
+
+const FBlendStruct* FBlendStructView::GetStructType() const
+{
+    return Struct;
+}
+
+int64 FBlendStructView::GetInt(const TCHAR* Name) const
+{
+    const FBlendStructField* Field = IsValid() ? Struct->FindField(Name) : nullptr;
+    if (!Field || Field->bPointer)
+    {
+        return 0;
+    }
+    return Reader->ReadInt(Data + Field->Offset, Field->Size / Field->ArrayLength);
+}
+
+float FBlendStructView::GetFloat(const TCHAR* Name, int32 Index) const
+{
+    const FBlendStructField* Field = IsValid() ? Struct->FindField(Name) : nullptr;
+    if (!Field || Field->bPointer || Field->TypeName != TEXT("float") || Index < 0 || Index >= Field->ArrayLength)
+    {
+        return 0.0f;
+    }
+
+    // Read as an int so it's byte swapped like any other field
+    const uint32 Bits = static_cast<uint32>(Reader->ReadInt(Data + Field->Offset + Index * sizeof(float), sizeof(float)));
+    float Value;
+    FMemory::Memcpy(&Value, &Bits, sizeof(Value));
+    return Value;
+}
+
+uint64 FBlendStructView::GetPointer(const TCHAR* Name) const
+{
+    const FBlendStructField* Field = IsValid() ? Struct->FindField(Name) : nullptr;
+    if (!Field || !Field->bPointer)
+    {
+        return 0;
+    }
+    return Reader->ReadPointer(Data + Field->Offset);
+}
+
+FString FBlendStructView::GetString(const TCHAR* Name) const
+{
+    const FBlendStructField* Field = IsValid() ? Struct->FindField(Name) : nullptr;
+    if (!Field || Field->bPointer || Field->TypeName != TEXT("char"))
+    {
+        return FString();
+    }
+
+    const ANSICHAR* Chars = reinterpret_cast<const ANSICHAR*>(Data + Field->Offset);
+    int32 Length = 0;
+    while (Length < Field->Size && Chars[Length] != '\0')
+    {
+        Length++;
+    }
+
+    FUTF8ToTCHAR Converted(Chars, Length);
+    return FString(Converted.Length(), Converted.Get());
+}
+
+FBlendStructView FBlendStructView::GetStruct(const TCHAR* Name) const
+{
+    const FBlendStructField* Field = IsValid() ? Struct->FindField(Name) : nullptr;
+    if (!Field || Field->bPointer)
+    {
+        return FBlendStructView();
+    }
+    return FBlendStructView(Reader, Reader->FindStruct(*Field->TypeName), Data + Field->Offset, Address + Field->Offset);
+}
+
+FBlendStructView FBlendStructView::Dereference(const TCHAR* Name, const TCHAR* AsType) const
+{
+    const FBlendStructField* Field = IsValid() ? Struct->FindField(Name) : nullptr;
+    if (!Field || !Field->bPointer)
+    {
+        return FBlendStructView();
+    }
+
+    // void pointers are viewed as whatever struct the block they point into holds
+    const TCHAR* TypeName = AsType ? AsType : *Field->TypeName;
+    const FBlendStruct* TargetStruct = FCString::Strcmp(TypeName, TEXT("void")) != 0 ? Reader->FindStruct(TypeName) : nullptr;
+    return Reader->Resolve(Reader->ReadPointer(Data + Field->Offset), TargetStruct);
+}
+
+TArray<FBlendStructView> FBlendStructView::GetList(const TCHAR* Name) const
+{
+    TArray<FBlendStructView> Elements;
+
+    FBlendStructView ListBase = GetStruct(Name);
+    if (!ListBase.IsValid())
+    {
+        return Elements;
+    }
+
+    // Guard against cycles in corrupt files
+    TSet<uint64> Visited;
+    uint64 ElementAddress = ListBase.GetPointer(TEXT("first"));
+    while (ElementAddress != 0 && !Visited.Contains(ElementAddress))
+    {
+        Visited.Add(ElementAddress);
+
+        FBlendStructView Element = Reader->Resolve(ElementAddress);
+        if (!Element.IsValid())
+        {
+            break;
+        }
+        Elements.Add(Element);
+        ElementAddress = Element.GetPointer(TEXT("next"));
+    }
+    return Elements;
+}
+
+FString FBlendStructView::GetIDName() const
+{
+    return GetStruct(TEXT("id")).GetString(TEXT("name")).RightChop(2);
+}
+
+FBlendFileReader::FBlendFileReader()
+    : FileData(nullptr)
+    , FileSize(0)
+    , Version(0)
+    , PointerSize(0)
+    , bSwapBytes(false)
+{
+}
+
+FBlendFileReader::~FBlendFileReader()
+{
+    // The mapped region must be released before the file handle it belongs to
+    MappedRegion.Reset();
+    MappedHandle.Reset();
+}
+
+bool FBlendFileReader::Open(const FString& Filename, FString& OutError)
+{
+    MappedHandle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*Filename));
+    if (MappedHandle.IsValid())
+    {
+        MappedRegion.Reset(MappedHandle->MapRegion(0, MappedHandle->GetFileSize()));
+    }
+
+    if (MappedRegion.IsValid())
+    {
+        FileData = MappedRegion->GetMappedPtr();
+        FileSize = MappedRegion->GetMappedSize();
+    }
+    else if (FFileHelper::LoadFileToArray(OwnedData, *Filename))
+    {
+        // Not every platform supports memory mapping files
+        FileData = OwnedData.GetData();
+        FileSize = OwnedData.Num();
+    }
+    else
+    {
+        OutError = TEXT("Could not open file");
+        return false;
+    }
+
+    if (FileSize >= 2 && FileData[0] == 0x1F && FileData[1] == 0x8B)
+    {
+        if (!Decompress(FileData, FileSize, OutError))
+        {
+            return false;
+        }
+    }
+    else if (FileSize >= 4 && FileData[0] == 0x28 && FileData[1] == 0xB5 && FileData[2] == 0x2F && FileData[3] == 0xFD)
+    {
+        if (!Decompress(FileData, FileSize, OutError))
+        {
+            return false;
+        }
+    }
+
+    // Only the original 12 byte header is supported: "BLENDER", pointer size ('_' 32 bit, '-' 64 bit), endianness ('v' little, 'V' big), version
+    if (FileSize < BlendHeaderSize || FMemory::Memcmp(FileData, "BLENDER", 7) != 0)
+    {
+        OutError = TEXT("Not an uncompressed, gzip or zstd .blend file");
+        return false;
+    }
+
+    const ANSICHAR PointerSizeChar = FileData[7];
+    const ANSICHAR EndianChar = FileData[8];
+    if ((PointerSizeChar != '_' && PointerSizeChar != '-') || (EndianChar != 'v' && EndianChar != 'V')
+        || !FChar::IsDigit(FileData[9]) || !FChar::IsDigit(FileData[10]) || !FChar::IsDigit(FileData[11]))
+    {
+        OutError = TEXT("Unsupported .blend file header (saved by a newer version of Blender?)");
+        return false;
+    }
+
+    PointerSize = PointerSizeChar == '_' ? 4 : 8;
+    bSwapBytes = (EndianChar == 'V') == !!PLATFORM_LITTLE_ENDIAN;
+    Version = (FileData[9] - '0') * 100 + (FileData[10] - '0') * 10 + (FileData[11] - '0');
+
+    return ParseBlocks(OutError);
+}
+
+int32 FBlendFileReader::GetVersion() const
+{
+    return Version;
+}
+
+int32 FBlendFileReader::GetPointerSize() const
+{
+    return PointerSize;
+}
+
+const TArray<FBlendFileBlock>& FBlendFileReader::GetBlocks() const
+{
+    return Blocks;
+}
+
+void FBlendFileReader::GetBlocks(const ANSICHAR* Code, TArray<const FBlendFileBlock*>& OutBlocks) const
+{
+    const uint32 BlockCode = FBlendFileBlock::MakeCode(Code);
+    for (const FBlendFileBlock& Block : Blocks)
+    {
+        if (Block.Code == BlockCode)
+        {
+            OutBlocks.Add(&Block);
+        }
+    }
+}
+
+const FBlendFileBlock* FBlendFileReader::FindBlock(uint64 Address) const
+{
+    if (Address == 0)
+    {
+        return nullptr;
+    }
+
+    // Find the last block starting at or before the address, then check the address falls inside it
+    const int32 Index = Algo::UpperBoundBy(BlocksByAddress, Address, [this](int32 BlockIndex) { return Blocks[BlockIndex].Address; }) - 1;
+    if (Index < 0)
+    {
+        return nullptr;
+    }
+
+    const FBlendFileBlock& Block = Blocks[BlocksByAddress[Index]];
+    return Address < Block.Address + FMath::Max<int64>(Block.Length, 1) ? &Block : nullptr;
+}
+
+const FBlendStruct* FBlendFileReader::FindStruct(const TCHAR* TypeName) const
+{
+    const int32* Index = StructsByName.Find(TypeName);
+    return Index ? &Structs[*Index] : nullptr;
+}
+
+const FBlendStruct* FBlendFileReader::GetStruct(int32 StructIndex) const
+{
+    return Structs.IsValidIndex(StructIndex) ? &Structs[StructIndex] : nullptr;
+}
+
+FBlendStructView FBlendFileReader::GetBlockView(const FBlendFileBlock& Block) const
+{
+    const FBlendStruct* Struct = GetStruct(Block.StructIndex);
+    if (!Struct || Struct->Size > Block.Length)
+    {
+        return FBlendStructView();
+    }
+    return FBlendStructView(this, Struct, Block.Data, Block.Address);
+}
+
+FBlendStructView FBlendFileReader::Resolve(uint64 Address, const FBlendStruct* Struct) const
+{
+    const FBlendFileBlock* Block = FindBlock(Address);
+    if (!Block)
+    {
+        return FBlendStructView();
+    }
+
+    if (!Struct)
+    {
+        Struct = GetStruct(Block->StructIndex);
+    }
+
+    const int64 Offset = Address - Block->Address;
+    if (!Struct || Offset + Struct->Size > Block->Length)
+    {
+        return FBlendStructView();
+    }
+    return FBlendStructView(this, Struct, Block->Data + Offset, Address);
+}
+
+int64 FBlendFileReader::ReadInt(const uint8* Ptr, int32 Size) const
+{
+    switch (Size)
+    {
+        case 1:
+            return *Ptr;
+
+        case 2:
+        {
+            uint16 Value;
+            FMemory::Memcpy(&Value, Ptr, sizeof(Value));
+            return static_cast<int16>(bSwapBytes ? BYTESWAP_ORDER16(Value) : Value);
+        }
+
+        case 4:
+        {
+            uint32 Value;
+            FMemory::Memcpy(&Value, Ptr, sizeof(Value));
+            return static_cast<int32>(bSwapBytes ? BYTESWAP_ORDER32(Value) : Value);
+        }
+
+        case 8:
+        {
+            uint64 Value;
+            FMemory::Memcpy(&Value, Ptr, sizeof(Value));
+            return static_cast<int64>(bSwapBytes ? BYTESWAP_ORDER64(Value) : Value);
+        }
+    }
+    return 0;
+}
+
+uint64 FBlendFileReader::ReadPointer(const uint8* Ptr) const
+{
+    return PointerSize == 4 ? static_cast<uint32>(ReadInt(Ptr, 4)) : static_cast<uint64>(ReadInt(Ptr, 8));
+}
+
+bool FBlendFileReader::Decompress(const uint8* Compressed, int64 CompressedSize, FString& OutError)
+{
+    TArray64<uint8> Decompressed;
+
+    if (Compressed[0] == 0x1F)
+    {
+        // The gzip trailer holds the uncompressed size (modulo 4GB)
+        uint32 UncompressedSize;
+        FMemory::Memcpy(&UncompressedSize, Compressed + CompressedSize - 4, sizeof(UncompressedSize));
+        #if !PLATFORM_LITTLE_ENDIAN
+            UncompressedSize = BYTESWAP_ORDER32(UncompressedSize);
+        #endif
+
+        if (CompressedSize > MAX_int32 || UncompressedSize > MAX_int32)
+        {
+            OutError = TEXT("gzip compressed .blend file is too large");
+            return false;
+        }
+
+        Decompressed.SetNumUninitialized(UncompressedSize);
+        if (!FCompression::UncompressMemory(NAME_Gzip, Decompressed.GetData(), static_cast<int32>(UncompressedSize), Compressed, static_cast<int32>(CompressedSize)))
+        {
+            OutError = TEXT("Failed to decompress gzip compressed .blend file");
+            return false;
+        }
+    }
+    else
+    {
+        #if WITH_BLENDIMPORTER_ZSTD
+            // Blender writes multiple frames plus a skippable seek table frame, which streaming decompression handles
+            ZSTD_DCtx* Context = ZSTD_createDCtx();
+            ZSTD_inBuffer Input = { Compressed, static_cast<size_t>(CompressedSize), 0 };
+
+            TArray<uint8> Chunk;
+            Chunk.SetNumUninitialized(ZSTD_DStreamOutSize());
+
+            bool bError = false;
+            while (Input.pos < Input.size)
+            {
+                ZSTD_outBuffer Output = { Chunk.GetData(), static_cast<size_t>(Chunk.Num()), 0 };
+                const size_t Result = ZSTD_decompressStream(Context, &Output, &Input);
+                if (ZSTD_isError(Result))
+                {
+                    bError = true;
+                    break;
+                }
+                Decompressed.Append(Chunk.GetData(), Output.pos);
+            }
+            ZSTD_freeDCtx(Context);
+
+            if (bError)
+            {
+                OutError = TEXT("Failed to decompress zstd compressed .blend file");
+                return false;
+            }
+        #else
+            OutError = TEXT("zstd compressed .blend files need the plugin to be built with zstd");
+            return false;
+        #endif
+    }
+
+    // The compressed data is no longer needed
+    MappedRegion.Reset();
+    MappedHandle.Reset();
+    OwnedData = MoveTemp(Decompressed);
+    FileData = OwnedData.GetData();
+    FileSize = OwnedData.Num();
+    return true;
+}
+
+bool FBlendFileReader::ParseBlocks(FString& OutError)
+{
+    const int32 BlockHeaderSize = PointerSize == 4 ? 20 : 24;
+    const uint32 EndCode = FBlendFileBlock::MakeCode("ENDB");
+    const uint32 SDNACode = FBlendFileBlock::MakeCode("DNA1");
+
+    int64 Offset = BlendHeaderSize;
+    while (Offset + BlockHeaderSize <= FileSize)
+    {
+        const uint8* Header = FileData + Offset;
+
+        // Two character ID codes are written as an int, so are zero padded at the front on big endian files
+        uint8 CodeBytes[4];
+        FMemory::Memcpy(CodeBytes, Header, 4);
+        if (CodeBytes[0] == 0 && CodeBytes[1] == 0)
+        {
+            CodeBytes[0] = CodeBytes[2];
+            CodeBytes[1] = CodeBytes[3];
+            CodeBytes[2] = CodeBytes[3] = 0;
+        }
+
+        FBlendFileBlock Block;
+        FMemory::Memcpy(&Block.Code, CodeBytes, 4);
+        Block.Length = ReadInt(Header + 4, 4);
+        Block.Address = ReadPointer(Header + 8);
+        Block.StructIndex = static_cast<int32>(ReadInt(Header + 8 + PointerSize, 4));
+        Block.Count = static_cast<int32>(ReadInt(Header + 12 + PointerSize, 4));
+        Block.Data = Header + BlockHeaderSize;
+
+        if (Block.Code == EndCode)
+        {
+            break;
+        }
+
+        if (Block.Length < 0 || Offset + BlockHeaderSize + Block.Length > FileSize)
+        {
+            OutError = TEXT("Truncated or corrupt file block");
+            return false;
+        }
+
+        Blocks.Add(Block);
+        Offset += BlockHeaderSize + Block.Length;
+    }
+
+    const FBlendFileBlock* SDNABlock = Blocks.FindByPredicate([SDNACode](const FBlendFileBlock& Block) { return Block.Code == SDNACode; });
+    if (!SDNABlock || !ParseSDNA(*SDNABlock, OutError))
+    {
+        if (OutError.IsEmpty())
+        {
+            OutError = TEXT("No SDNA found");
+        }
+        return false;
+    }
+
+    BlocksByAddress.Reserve(Blocks.Num());
+    for (int32 i = 0; i < Blocks.Num(); i++)
+    {
+        if (Blocks[i].Address != 0)
+        {
+            BlocksByAddress.Add(i);
+        }
+    }
+    BlocksByAddress.Sort([this](int32 A, int32 B) { return Blocks[A].Address < Blocks[B].Address; });
+
+    return true;
+}
+
+bool FBlendFileReader::ParseSDNA(const FBlendFileBlock& Block, FString& OutError)
+{
+    const uint8* Start = Block.Data;
+    const uint8* End = Block.Data + Block.Length;
+    const uint8* Ptr = Start;
+
+    auto ExpectTag = [&Ptr, End](const ANSICHAR* Tag)
+    {
+        if (Ptr + 4 > End || FMemory::Memcmp(Ptr, Tag, 4) != 0)
+        {
+            return false;
+        }
+        Ptr += 4;
+        return true;
+    };
+    auto ReadCount = [this, &Ptr, End](int32 Size, int64& OutValue)
+    {
+        if (Ptr + Size > End)
+        {
+            return false;
+        }
+        OutValue = ReadInt(Ptr, Size);
+        Ptr += Size;
+        return OutValue >= 0;
+    };
+    auto ReadStrings = [&Ptr, End](int64 Count, TArray<FString>& OutStrings)
+    {
+        for (int64 i = 0; i < Count; i++)
+        {
+            const uint8* StringStart = Ptr;
+            while (Ptr < End && *Ptr != '\0')
+            {
+                Ptr++;
+            }
+            if (Ptr >= End)
+            {
+                return false;
+            }
+            OutStrings.Add(FString(static_cast<int32>(Ptr - StringStart), reinterpret_cast<const ANSICHAR*>(StringStart)));
+            Ptr++;
+        }
+        return true;
+    };
+    auto AlignTo4 = [&Ptr, Start]()
+    {
+        Ptr = Start + Align(Ptr - Start, 4);
+    };
+
+    TArray<FString> Names;
+    TArray<FString> Types;
+    TArray<int32> TypeLengths;
+    int64 Count = 0;
+
+    if (!ExpectTag("SDNA") || !ExpectTag("NAME") || !ReadCount(4, Count) || !ReadStrings(Count, Names))
+    {
+        OutError = TEXT("Corrupt SDNA names");
+        return false;
+    }
+    AlignTo4();
+
+    if (!ExpectTag("TYPE") || !ReadCount(4, Count) || !ReadStrings(Count, Types))
+    {
+        OutError = TEXT("Corrupt SDNA types");
+        return false;
+    }
+    AlignTo4();
+
+    if (!ExpectTag("TLEN"))
+    {
+        OutError = TEXT("Corrupt SDNA type lengths");
+        return false;
+    }
+    for (int32 i = 0; i < Types.Num(); i++)
+    {
+        int64 Length = 0;
+        if (!ReadCount(2, Length))
+        {
+            OutError = TEXT("Corrupt SDNA type lengths");
+            return false;
+        }
+        TypeLengths.Add(static_cast<int32>(Length));
+    }
+    AlignTo4();
+
+    if (!ExpectTag("STRC") || !ReadCount(4, Count))
+    {
+        OutError = TEXT("Corrupt SDNA structs");
+        return false;
+    }
+
+    for (int64 StructIdx = 0; StructIdx < Count; StructIdx++)
+    {
+        int64 TypeIndex = 0;
+        int64 FieldCount = 0;
+        if (!ReadCount(2, TypeIndex) || !ReadCount(2, FieldCount) || !Types.IsValidIndex(TypeIndex))
+        {
+            OutError = TEXT("Corrupt SDNA structs");
+            return false;
+        }
+
+        FBlendStruct& Struct = Structs.AddDefaulted_GetRef();
+        Struct.TypeName = Types[TypeIndex];
+        Struct.Size = TypeLengths[TypeIndex];
+
+        int32 Offset = 0;
+        for (int64 FieldIdx = 0; FieldIdx < FieldCount; FieldIdx++)
+        {
+            int64 FieldType = 0;
+            int64 FieldName = 0;
+            if (!ReadCount(2, FieldType) || !ReadCount(2, FieldName) || !Types.IsValidIndex(FieldType) || !Names.IsValidIndex(FieldName))
+            {
+                OutError = TEXT("Corrupt SDNA struct fields");
+                return false;
+            }
+
+            // Names carry the declaration syntax, e.g. "*next", "name[64]", "mat[4][4]" or "(*func)()"
+            const FString& Declaration = Names[FieldName];
+
+            FBlendStructField& Field = Struct.Fields.AddDefaulted_GetRef();
+            Field.TypeName = Types[FieldType];
+            Field.Offset = Offset;
+            Field.bPointer = Declaration.Contains(TEXT("*"));
+
+            int32 Index = 0;
+            for (; Index < Declaration.Len() && Declaration[Index] != TEXT('['); Index++)
+            {
+                const TCHAR Char = Declaration[Index];
+                if (Char != TEXT('*') && Char != TEXT('(') && Char != TEXT(')'))
+                {
+                    Field.Name.AppendChar(Char);
+                }
+            }
+            // Every field has to fit in its struct, or views of it would read past the blocks they were checked against
+            int64 ArrayLength = 1;
+            while (Index < Declaration.Len())
+            {
+                int32 CloseIndex = Declaration.Find(TEXT("]"), ESearchCase::CaseSensitive, ESearchDir::FromStart, Index);
+                if (Declaration[Index] != TEXT('[') || CloseIndex == INDEX_NONE)
+                {
+                    break;
+                }
+                const int64 Dimension = FCString::Atoi64(*Declaration.Mid(Index + 1, CloseIndex - Index - 1));
+                if (Dimension < 1 || Dimension > Struct.Size || ArrayLength * Dimension > Struct.Size)
+                {
+                    OutError = FString::Printf(TEXT("Corrupt SDNA array length for %s.%s"), *Struct.TypeName, *Declaration);
+                    return false;
+                }
+                ArrayLength *= Dimension;
+                Index = CloseIndex + 1;
+            }
+
+            const int64 FieldSize = static_cast<int64>(Field.bPointer ? PointerSize : TypeLengths[FieldType]) * ArrayLength;
+            if (Offset + FieldSize > Struct.Size)
+            {
+                OutError = FString::Printf(TEXT("Corrupt SDNA field %s.%s, which overruns its struct"), *Struct.TypeName, *Declaration);
+                return false;
+            }
+
+            Field.ArrayLength = static_cast<int32>(ArrayLength);
+            Field.Size = static_cast<int32>(FieldSize);
+            Offset += Field.Size;
+        }
+
+        StructsByName.Add(Struct.TypeName, Structs.Num() - 1);
+    }
+
+    return true;
+}
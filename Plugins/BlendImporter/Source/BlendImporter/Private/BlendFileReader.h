@@ -0,0 +1,131 @@
+// Copyright 2022 nuclearfriend
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FBlendFileReader;
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/** A file block ("BHead" and its data), addressed by the pointer it had in memory when the file was saved */
+struct FBlendFileBlock
+{
+	/** Block code, with two character ID codes (e.g. "MA") zero padded */
+	uint32 Code;
+	int32 StructIndex;
+	uint64 Address;
+	int64 Length;
+	int32 Count;
+	const uint8* Data;
+
+	static uint32 MakeCode(const ANSICHAR* Code);
+};
+
+struct FBlendStructField
+{
+	FString Name;
+	FString TypeName;
+	int32 Offset;
+	int32 Size;
+	int32 ArrayLength;
+	bool bPointer;
+};
+
+struct FBlendStruct
+{
+	FString TypeName;
+	int32 Size;
+	TArray<FBlendStructField> Fields;
+
+	const FBlendStructField* FindField(const TCHAR* Name) const;
+};
+
+/** A struct stored in a file block, with its fields looked up by name through the file's SDNA */
+class FBlendStructView
+{
+public:
+	FBlendStructView();
+	FBlendStructView(const FBlendFileReader* InReader, const FBlendStruct* InStruct, const uint8* InData, uint64 InAddress);
+
+	bool IsValid() const;
+	bool HasField(const TCHAR* Name) const;
+	uint64 GetAddress() const;
+	const FBlendStruct* GetStructType() const;
+
+	int64 GetInt(const TCHAR* Name) const;
+	float GetFloat(const TCHAR* Name, int32 Index = 0) const;
+	uint64 GetPointer(const TCHAR* Name) const;
+	FString GetString(const TCHAR* Name) const;
+
+	/** Views a struct embedded in this one */
+	FBlendStructView GetStruct(const TCHAR* Name) const;
+
+	/** Follows a pointer field, viewing the target as the pointer's type, or as AsType if given (e.g. for ID pointers) */
+	FBlendStructView Dereference(const TCHAR* Name, const TCHAR* AsType = nullptr) const;
+
+	/** Follows a ListBase field, returning each linked element */
+	TArray<FBlendStructView> GetList(const TCHAR* Name) const;
+
+	/** The ID name without its two character type prefix, for ID datablocks */
+	FString GetIDName() const;
+
+private:
+	const FBlendFileReader* Reader;
+	const FBlendStruct* Struct;
+	const uint8* Data;
+	uint64 Address;
+};
+
+/**
+ * Reads the structure of a .blend file directly, without Blender: the file header, file blocks and the SDNA describing their structs.
+ * Handles either endianness and pointer size, and gzip compressed files. zstd compressed files (Blender 3.0+) are only read if the
+ * plugin was built with a zstd library (WITH_BLENDIMPORTER_ZSTD).
+ */
+class FBlendFileReader
+{
+public:
+	FBlendFileReader();
+	~FBlendFileReader();
+
+	/** Returns false with the reason if the file isn't one this reader understands, in which case Blender should be used instead */
+	bool Open(const FString& Filename, FString& OutError);
+
+	int32 GetVersion() const;
+	int32 GetPointerSize() const;
+
+	const TArray<FBlendFileBlock>& GetBlocks() const;
+	void GetBlocks(const ANSICHAR* Code, TArray<const FBlendFileBlock*>& OutBlocks) const;
+	const FBlendFileBlock* FindBlock(uint64 Address) const;
+
+	const FBlendStruct* FindStruct(const TCHAR* TypeName) const;
+	const FBlendStruct* GetStruct(int32 StructIndex) const;
+
+	FBlendStructView GetBlockView(const FBlendFileBlock& Block) const;
+	FBlendStructView Resolve(uint64 Address, const FBlendStruct* Struct = nullptr) const;
+
+	int64 ReadInt(const uint8* Ptr, int32 Size) const;
+	uint64 ReadPointer(const uint8* Ptr) const;
+
+private:
+	bool Decompress(const uint8* Compressed, int64 CompressedSize, FString& OutError);
+	bool ParseBlocks(FString& OutError);
+	bool ParseSDNA(const FBlendFileBlock& Block, FString& OutError);
+
+private:
+	TUniquePtr<IMappedFileHandle> MappedHandle;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	TArray64<uint8> OwnedData;
+
+	const uint8* FileData;
+	int64 FileSize;
+
+	int32 Version;
+	int32 PointerSize;
+	bool bSwapBytes;
+
+	TArray<FBlendFileBlock> Blocks;
+	TArray<int32> BlocksByAddress;
+	TArray<FBlendStruct> Structs;
+	TMap<FString, int32> StructsByName;
+};
@@ -0,0 +1,345 @@
+// Copyright 2022 nuclearfriend
+
+#include "BlendImportCommandlet.h"
+#include "AssetImportTask.h"
+#include "AssetToolsModule.h"
+#include "BlendAssetFactory.h"
+#include "BlendExportCache.h"
+#include "BlendImporter.h"
+#include "BlendImporterSettings.h"
+#include "BlenderJob.h"
+#include "BlenderJobPool.h"
+#include "BlenderResultReader.h"
+#include "Dom/JsonObject.h"
+#include "Misc/PackageName.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+UBlendImportCommandlet::UBlendImportCommandlet(const FObjectInitializer& ObjectInitializer)
+    : Super(ObjectInitializer)
+{
+    IsClient = false;
+    IsEditor = true;
+    IsServer = false;
+    LogToConsole = true;
+    ShowErrorCount = true;
+}
+
+int32 UBlendImportCommandlet::Main(const FString& Params)
+{
+    TArray<FString> Tokens;
+    TArray<FString> Switches;
+    TMap<FString, FString> ParamValues;
+    ParseCommandLine(*Params, Tokens, Switches, ParamValues);
+
+    const FString* ManifestFilename = ParamValues.Find(TEXT("Manifest"));
+    if (ManifestFilename == nullptr)
+    {
+        UE_LOG(LogBlendImporter, Error, TEXT("Usage: -run=BlendImport -Manifest=<manifest.json> [-Report=<report.json>]"));
+        return InvalidArguments;
+    }
+    const FString* ReportFilename = ParamValues.Find(TEXT("Report"));
+
+    // Would otherwise prompt to open the project settings
+    if (GetDefault<UBlendImporterSettings>()->GetBlenderExecutable(false).FilePath.IsEmpty())
+    {
+        UE_LOG(LogBlendImporter, Error, TEXT("The path to Blender isn't set, or isn't a Blender executable. Set it in the project's Blend Importer settings."));
+        return BlenderNotFound;
+    }
+
+    TArray<TSharedRef<FFileImport>> Imports;
+    if (!ReadManifest(FPaths::ConvertRelativePathToFull(*ManifestFilename), Imports))
+    {
+        return InvalidManifest;
+    }
+
+    const double StartTime = FPlatformTime::Seconds();
+
+    // The commandlet's own factory, so imports don't share state with anything else importing
+    UBlendAssetFactory* Factory = NewObject<UBlendAssetFactory>();
+    Factory->AddToRoot();
+
+    ExportAll(Imports, Factory);
+    for (const TSharedRef<FFileImport>& FileImport : Imports)
+    {
+        Import(*FileImport, Factory);
+    }
+
+    Factory->RemoveFromRoot();
+
+    const double TotalSeconds = FPlatformTime::Seconds() - StartTime;
+    const int32 NumFailed = Imports.FilterByPredicate([](const TSharedRef<FFileImport>& FileImport) { return FileImport->Outcome != TEXT("imported"); }).Num();
+    UE_LOG(LogBlendImporter, Display, TEXT("Imported %d of %d .blend files in %.1fs"), Imports.Num() - NumFailed, Imports.Num(), TotalSeconds);
+
+    const bool bReportWritten = ReportFilename == nullptr || WriteReport(FPaths::ConvertRelativePathToFull(*ReportFilename), Imports, TotalSeconds);
+    if (NumFailed > 0)
+    {
+        return ImportFailed;
+    }
+    return bReportWritten ? Success : ReportFailed;
+}
+
+bool UBlendImportCommandlet::ReadManifest(const FString& ManifestFilename, TArray<TSharedRef<FFileImport>>& OutImports) const
+{
+    FString ManifestJson;
+    if (!FFileHelper::LoadFileToString(ManifestJson, *ManifestFilename))
+    {
+        UE_LOG(LogBlendImporter, Error, TEXT("Could not read the manifest '%s'"), *ManifestFilename);
+        return false;
+    }
+
+    TSharedPtr<FJsonObject> Manifest;
+    const TArray<TSharedPtr<FJsonValue>>* Entries = nullptr;
+    TSharedRef<TJsonReader<TCHAR>> Reader = TJsonReaderFactory<TCHAR>::Create(ManifestJson);
+    if (!FJsonSerializer::Deserialize(Reader, Manifest) || !Manifest.IsValid() || !Manifest->TryGetArrayField(TEXT("imports"), Entries))
+    {
+        UE_LOG(LogBlendImporter, Error, TEXT("The manifest '%s' must be a JSON object with an \"imports\" array"), *ManifestFilename);
+        return false;
+    }
+
+    const FString ManifestDir = FPaths::GetPath(ManifestFilename);
+    for (int32 Index = 0; Index < Entries->Num(); Index++)
+    {
+        const TSharedPtr<FJsonObject>* Entry = nullptr;
+        FString Source;
+        FString DestinationPath;
+        if (!(*Entries)[Index]->TryGetObject(Entry) || !(*Entry)->TryGetStringField(TEXT("source"), Source) || !(*Entry)->TryGetStringField(TEXT("destination"), DestinationPath))
+        {
+            UE_LOG(LogBlendImporter, Error, TEXT("Manifest import %d needs a \"source\" and a \"destination\""), Index);
+            return false;
+        }
+
+        DestinationPath.RemoveFromEnd(TEXT("/"));
+        if (!FPackageName::IsValidLongPackageName(DestinationPath))
+        {
+            UE_LOG(LogBlendImporter, Error, TEXT("Manifest import %d has an invalid destination '%s', which should be a content path such as /Game/Meshes"), Index, *DestinationPath);
+            return false;
+        }
+
+        TArray<FString> Filenames;
+        FindSourceFiles(FPaths::ConvertRelativePathToFull(ManifestDir, Source), Filenames);
+        if (Filenames.Num() == 0)
+        {
+            // Most likely a mistake in the manifest, rather than something to quietly skip every night
+            UE_LOG(LogBlendImporter, Error, TEXT("Manifest import %d ('%s') didn't match any .blend files"), Index, *Source);
+            return false;
+        }
+
+        bool bUseObjectPivot = false;
+        (*Entry)->TryGetBoolField(TEXT("useObjectPivot"), bUseObjectPivot);
+
+        TArray<FString> EnabledCollections;
+        const bool bDefaultCollections = !(*Entry)->TryGetStringArrayField(TEXT("collections"), EnabledCollections);
+
+        int32 NumLODs = 1;
+        (*Entry)->TryGetNumberField(TEXT("lods"), NumLODs);
+        double LODReductionRatio = 0.5;
+        (*Entry)->TryGetNumberField(TEXT("lodReductionRatio"), LODReductionRatio);
+
+        for (const FString& Filename : Filenames)
+        {
+            if (OutImports.ContainsByPredicate([&Filename](const TSharedRef<FFileImport>& FileImport) { return FileImport->Filename == Filename; }))
+            {
+                UE_LOG(LogBlendImporter, Warning, TEXT("'%s' is matched by more than one manifest import, only the first is used"), *Filename);
+                continue;
+            }
+
+            TSharedRef<FFileImport> FileImport = MakeShared<FFileImport>();
+            FileImport->Filename = Filename;
+            FileImport->DestinationPath = DestinationPath;
+            FileImport->bUseObjectPivot = bUseObjectPivot;
+            FileImport->EnabledCollections = EnabledCollections;
+            FileImport->bDefaultCollections = bDefaultCollections;
+            FileImport->NumLODs = FMath::Clamp(NumLODs, 1, UBlendImportOptions::MaxLODs);
+            FileImport->LODReductionRatio = FMath::Clamp(static_cast<float>(LODReductionRatio), UBlendImportOptions::MinLODReductionRatio, UBlendImportOptions::MaxLODReductionRatio);
+            OutImports.Add(FileImport);
+        }
+    }
+
+    UE_LOG(LogBlendImporter, Display, TEXT("Importing %d .blend files from '%s'"), OutImports.Num(), *ManifestFilename);
+    return true;
+}
+
+void UBlendImportCommandlet::FindSourceFiles(const FString& Pattern, TArray<FString>& OutFilenames)
+{
+    FString NormalizedPattern = Pattern;
+    FPaths::NormalizeFilename(NormalizedPattern);
+
+    int32 WildcardIndex = INDEX_NONE;
+    for (int32 Index = 0; Index < NormalizedPattern.Len() && WildcardIndex == INDEX_NONE; Index++)
+    {
+        if (NormalizedPattern[Index] == TEXT('*') || NormalizedPattern[Index] == TEXT('?'))
+        {
+            WildcardIndex = Index;
+        }
+    }
+
+    if (WildcardIndex == INDEX_NONE)
+    {
+        if (FPaths::FileExists(NormalizedPattern))
+        {
+            OutFilenames.Add(NormalizedPattern);
+        }
+        return;
+    }
+
+    // Search below the last folder before the wildcard, matching the whole path so wildcards can cover folders too
+    const FString SearchDir = FPaths::GetPath(NormalizedPattern.Left(WildcardIndex + 1));
+    TArray<FString> Found;
+    IFileManager::Get().FindFilesRecursive(Found, *SearchDir, TEXT("*.blend"), true, false);
+    for (FString& Filename : Found)
+    {
+        FPaths::NormalizeFilename(Filename);
+        if (Filename.MatchesWildcard(NormalizedPattern))
+        {
+            OutFilenames.Add(Filename);
+        }
+    }
+
+    // Imported in a stable order, so reports can be compared between runs
+    OutFilenames.Sort();
+}
+
+void UBlendImportCommandlet::ExportAll(const TArray<TSharedRef<FFileImport>>& Imports, UBlendAssetFactory* Factory)
+{
+    FBlenderJobPool Pool;
+
+    for (const TSharedRef<FFileImport>& FileImport : Imports)
+    {
+        FBlendPreparedImport& Prepared = *FileImport->Prepared;
+        Prepared.Filename = FileImport->Filename;
+        FBlendQueuedImportOptions& Options = Prepared.Options;
+        Options.bUseObjectPivot = FileImport->bUseObjectPivot;
+        Options.EnabledCollections = FileImport->bDefaultCollections ? GetDefault<UBlendImportOptions>()->EnabledCollections : FileImport->EnabledCollections;
+        Options.bDefaultCollections = FileImport->bDefaultCollections;
+        Options.NumLODs = FileImport->NumLODs;
+        Options.LODReductionRatio = FileImport->LODReductionRatio;
+        Options.bDirectMeshTransfer = Factory->IsDirectMeshTransfer();
+
+        const bool bCanExport = UBlendAssetFactory::BeginQueuedExport(Prepared, FileImport->Job, FileImport->CacheKey);
+        FileImport->EnabledCollections = Options.EnabledCollections;
+        FileImport->bDefaultCollections = Options.bDefaultCollections;
+        if (!bCanExport || !FileImport->Job.IsValid())
+        {
+            continue;
+        }
+
+        const double QueuedTime = FPlatformTime::Seconds();
+        Pool.Add(MoveTemp(FileImport->Job), FBlenderJobPool::EstimateJobMemory(FileImport->Filename, Prepared.Analysis.NumObjects, Prepared.Analysis.NumTriangles),
+            FBlenderJobPool::FOnJobFinished::CreateLambda([FileImport, QueuedTime](FBlenderJob& FinishedJob, bool bSucceeded)
+            {
+                FileImport->ExportSeconds = FPlatformTime::Seconds() - QueuedTime;
+                FileImport->BlenderTimings = FinishedJob.GetResult().GetTimings();
+
+                if (UBlendAssetFactory::FinishQueuedExport(*FileImport->Prepared, FinishedJob, bSucceeded, FileImport->CacheKey))
+                {
+                    UE_LOG(LogBlendImporter, Display, TEXT("Exported '%s' in %.1fs"), *FileImport->Filename, FileImport->ExportSeconds);
+                }
+                else
+                {
+                    UE_LOG(LogBlendImporter, Error, TEXT("Failed to export '%s'"), *FileImport->Filename);
+                }
+            }));
+    }
+
+    UE_LOG(LogBlendImporter, Display, TEXT("Exporting %d .blend files with Blender..."), Pool.GetNumPending());
+    while (Pool.Tick())
+    {
+        FPlatformProcess::Sleep(0.05f);
+    }
+}
+
+void UBlendImportCommandlet::Import(FFileImport& FileImport, UBlendAssetFactory* Factory)
+{
+    if (!FileImport.Prepared->bExported)
+    {
+        // Running Blender again here would only fail the same way, one file at a time
+        FileImport.Outcome = TEXT("failed");
+        FileImport.Error = TEXT("Blender failed to export the file, see the log for details");
+        return;
+    }
+
+    UE_LOG(LogBlendImporter, Display, TEXT("Importing '%s' to %s"), *FileImport.Filename, *FileImport.DestinationPath);
+    const double StartTime = FPlatformTime::Seconds();
+
+    // Imported with the manifest's options and the export made for them, rather than the options saved with existing assets
+    Factory->SetPreparedImport(FileImport.Prepared);
+
+    IAssetTools& AssetTools = FModuleManager::LoadModuleChecked<FAssetToolsModule>("AssetTools").Get();
+
+    UAssetImportTask* ImportTask = NewObject<UAssetImportTask>();
+    ImportTask->Filename = FileImport.Filename;
+    ImportTask->DestinationPath = FileImport.DestinationPath;
+    ImportTask->Factory = Factory;
+    ImportTask->bAutomated = true;
+    ImportTask->bReplaceExisting = true;
+    ImportTask->bSave = true;
+    AssetTools.ImportAssetTasks({ ImportTask });
+    Factory->SetPreparedImport(nullptr);
+
+    FileImport.ImportSeconds = FPlatformTime::Seconds() - StartTime;
+    FileImport.ImportedObjectPaths = ImportTask->ImportedObjectPaths;
+
+    if (FileImport.ImportedObjectPaths.Num() > 0)
+    {
+        FileImport.Outcome = TEXT("imported");
+        UE_LOG(LogBlendImporter, Display, TEXT("Imported '%s' in %.1fs"), *FileImport.Filename, FileImport.ImportSeconds);
+    }
+    else
+    {
+        FileImport.Outcome = TEXT("failed");
+        FileImport.Error = TEXT("Nothing was imported, see the log for details");
+        UE_LOG(LogBlendImporter, Error, TEXT("Failed to import '%s'"), *FileImport.Filename);
+    }
+}
+
+bool UBlendImportCommandlet::WriteReport(const FString& ReportFilename, const TArray<TSharedRef<FFileImport>>& Imports, double TotalSeconds) const
+{
+    FString ReportJson;
+    TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&ReportJson);
+    Writer->WriteObjectStart();
+    Writer->WriteValue(TEXT("seconds"), TotalSeconds);
+    Writer->WriteValue(TEXT("imported"), Imports.FilterByPredicate([](const TSharedRef<FFileImport>& FileImport) { return FileImport->Outcome == TEXT("imported"); }).Num());
+    Writer->WriteValue(TEXT("failed"), Imports.FilterByPredicate([](const TSharedRef<FFileImport>& FileImport) { return FileImport->Outcome != TEXT("imported"); }).Num());
+
+    Writer->WriteArrayStart(TEXT("files"));
+    for (const TSharedRef<FFileImport>& FileImport : Imports)
+    {
+        Writer->WriteObjectStart();
+        Writer->WriteValue(TEXT("source"), FileImport->Filename);
+        Writer->WriteValue(TEXT("destination"), FileImport->DestinationPath);
+        Writer->WriteValue(TEXT("outcome"), FileImport->Outcome);
+        if (!FileImport->Error.IsEmpty())
+        {
+            Writer->WriteValue(TEXT("error"), FileImport->Error);
+        }
+        Writer->WriteValue(TEXT("collections"), FileImport->EnabledCollections);
+        Writer->WriteValue(TEXT("exportSeconds"), FileImport->ExportSeconds);
+        Writer->WriteValue(TEXT("importSeconds"), FileImport->ImportSeconds);
+
+        // Empty when the export was cached
+        Writer->WriteObjectStart(TEXT("blenderSeconds"));
+        for (const TPair<FString, double>& Timing : FileImport->BlenderTimings)
+        {
+            Writer->WriteValue(Timing.Key, Timing.Value);
+        }
+        Writer->WriteObjectEnd();
+
+        Writer->WriteValue(TEXT("assets"), FileImport->ImportedObjectPaths);
+        Writer->WriteObjectEnd();
+    }
+    Writer->WriteArrayEnd();
+
+    Writer->WriteObjectEnd();
+    Writer->Close();
+
+    if (!FFileHelper::SaveStringToFile(ReportJson, *ReportFilename, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM))
+    {
+        UE_LOG(LogBlendImporter, Error, TEXT("Failed to write the report to '%s'"), *ReportFilename);
+        return false;
+    }
+
+    UE_LOG(LogBlendImporter, Display, TEXT("Wrote the import report to '%s'"), *ReportFilename);
+    return true;
+}
@@ -0,0 +1,80 @@
+// Copyright 2022 nuclearfriend
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BlendAssetFactory.h"
+#include "Commandlets/Commandlet.h"
+#include "BlendImportCommandlet.generated.h"
+
+class FBlenderJob;
+
+/**
+ * Imports .blend files without any dialogs, for build machines. The files and where they go are listed in a JSON manifest:
+ *
+ *   UnrealEditor-Cmd Project.uproject -run=BlendImport -Manifest=Imports.json [-Report=Report.json] -unattended
+ *
+ *   {
+ *       "imports": [
+ *           { "source": "Art/Environment/*.blend", "destination": "/Game/Environment", "useObjectPivot": true, "collections": [ "Props" ], "lods": 3, "lodReductionRatio": 0.5 }
+ *       ]
+ *   }
+ *
+ * Sources are relative to the manifest and may use wildcards, where * also matches across folders. Without "collections", the collections the import dialog would enable are imported.
+ * "lods" is how many LODs Blender generates for each static mesh, including the mesh itself (1 by default).
+ * All files are exported by Blender in parallel before they're imported one at a time, and saved. The report lists each file's outcome and timings.
+ */
+UCLASS()
+class UBlendImportCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	/** Returned by Main. ReportFailed means every file was imported but the report couldn't be written, failed imports take precedence. */
+	enum EExitCode
+	{
+		Success = 0,
+		ImportFailed = 1,
+		InvalidArguments = 2,
+		InvalidManifest = 3,
+		BlenderNotFound = 4,
+		ReportFailed = 5,
+	};
+
+	UBlendImportCommandlet(const FObjectInitializer& ObjectInitializer);
+
+	// Begin UCommandlet Interface
+	virtual int32 Main(const FString& Params) override;
+	// End UCommandlet Interface
+
+private:
+	struct FFileImport
+	{
+		FString Filename;
+		FString DestinationPath;
+		bool bUseObjectPivot = false;
+		TArray<FString> EnabledCollections;
+		bool bDefaultCollections = false;
+		int32 NumLODs = 1;
+		float LODReductionRatio = 0.5f;
+
+		TSharedRef<FBlendPreparedImport> Prepared = MakeShared<FBlendPreparedImport>();
+		TUniquePtr<FBlenderJob> Job;
+		FString CacheKey;
+		TMap<FString, double> BlenderTimings;
+
+		FString Outcome;
+		FString Error;
+		TArray<FString> ImportedObjectPaths;
+		double ExportSeconds = 0.0;
+		double ImportSeconds = 0.0;
+	};
+
+	bool ReadManifest(const FString& ManifestFilename, TArray<TSharedRef<FFileImport>>& OutImports) const;
+	static void FindSourceFiles(const FString& Pattern, TArray<FString>& OutFilenames);
+
+	void ExportAll(const TArray<TSharedRef<FFileImport>>& Imports, UBlendAssetFactory* Factory);
+	void Import(FFileImport& FileImport, UBlendAssetFactory* Factory);
+
+	bool WriteReport(const FString& ReportFilename, const TArray<TSharedRef<FFileImport>>& Imports, double TotalSeconds) const;
+};
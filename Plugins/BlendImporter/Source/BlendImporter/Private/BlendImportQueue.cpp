@@ -0,0 +1,397 @@
+// Copyright 2022 nuclearfriend
+
+#include "BlendImportQueue.h"
+#include "AssetImportTask.h"
+#include "AssetToolsModule.h"
+#include "Async/Async.h"
+#include "BlendExportCache.h"
+#include "BlendImporter.h"
+#include "BlenderJob.h"
+#include "BlenderResultReader.h"
+#include "Framework/Application/SlateApplication.h"
+#include "Framework/Notifications/NotificationManager.h"
+#include "Widgets/Notifications/SNotificationList.h"
+
+#define LOCTEXT_NAMESPACE "BlendImportQueue"
+
+// How many queued files are listed on the notification
+static const int32 MaxNotificationLines = 5;
+
+FBlendImportQueue::FBlendImportQueue()
+    : Factory(NewObject<UBlendAssetFactory>())
+    , bCancelRequested(MakeShared<bool>(false))
+    , NumImported(0)
+    , NumExported(0)
+    , NumFailed(0)
+    , NumExportsFailed(0)
+{
+}
+
+FBlendImportQueue::~FBlendImportQueue()
+{
+    CancelAll();
+}
+
+int32 FBlendImportQueue::Enqueue(const FString& Filename, const FString& DestinationPath, const FBlendQueuedImportOptions& Options)
+{
+    TSharedRef<FRequest> Request = MakeShared<FRequest>();
+    Request->Filename = Filename;
+    Request->DestinationPath = DestinationPath;
+    Request->Prepared->Filename = Filename;
+    Request->Prepared->Options = Options;
+    Request->Status = LOCTEXT("StatusQueued", "Queued").ToString();
+
+    const int32 Position = AddRequest(Request);
+    UE_LOG(LogBlendImporter, Log, TEXT("Queued '%s' for import to %s (position %d in the queue)"), *Filename, *DestinationPath, Position);
+    return Position;
+}
+
+int32 FBlendImportQueue::Enqueue(const FString& Filename, const FString& DestinationPath)
+{
+    const UBlendImportOptions* ImportOptions = GetDefault<UBlendImportOptions>();
+
+    FBlendQueuedImportOptions Options;
+    Options.bUseObjectPivot = ImportOptions->bUseObjectPivot;
+    Options.EnabledCollections = ImportOptions->EnabledCollections;
+    Options.NumLODs = ImportOptions->NumLODs;
+    Options.LODReductionRatio = ImportOptions->LODReductionRatio;
+    Options.bDefaultCollections = true;
+    return Enqueue(Filename, DestinationPath, Options);
+}
+
+int32 FBlendImportQueue::EnqueueExport(const FString& Filename, const FBlendQueuedImportOptions& Options, FOnExported OnExported)
+{
+    TSharedRef<FRequest> Request = MakeShared<FRequest>();
+    Request->Filename = Filename;
+    Request->Prepared->Filename = Filename;
+    Request->Prepared->Options = Options;
+    Request->Status = LOCTEXT("StatusQueued", "Queued").ToString();
+    Request->bExportOnly = true;
+    Request->OnExported = MoveTemp(OnExported);
+
+    const int32 Position = AddRequest(Request);
+    UE_LOG(LogBlendImporter, Log, TEXT("Queued '%s' for export (position %d in the queue)"), *Filename, Position);
+    return Position;
+}
+
+int32 FBlendImportQueue::AddRequest(const TSharedRef<FRequest>& Request)
+{
+    // The preparation task can't ask the factory, as it's used by imports on the game thread meanwhile
+    Request->Prepared->Options.bDirectMeshTransfer = Factory->IsDirectMeshTransfer();
+    Requests.Add(Request);
+
+    if (!TickerHandle.IsValid())
+    {
+        *bCancelRequested = false;
+        #if ENGINE_MAJOR_VERSION >= 5
+            TickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FBlendImportQueue::Tick));
+        #else
+            TickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FBlendImportQueue::Tick));
+        #endif
+    }
+
+    UpdateNotification();
+    return Requests.Num();
+}
+
+void FBlendImportQueue::CancelAll()
+{
+    if (TickerHandle.IsValid())
+    {
+        #if ENGINE_MAJOR_VERSION >= 5
+            FTSTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+        #else
+            FTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+        #endif
+        TickerHandle.Reset();
+    }
+
+    if (Requests.Num() > 0)
+    {
+        UE_LOG(LogBlendImporter, Warning, TEXT("Import queue cancelled, %d files were not imported"), Requests.Num());
+    }
+
+    WaitForPreparations();
+    Pool.CancelAll();
+    for (const TSharedRef<FRequest>& Request : Requests)
+    {
+        if (Request->bExportOnly)
+        {
+            NumExportsFailed++;
+            Request->OnExported.ExecuteIfBound(false);
+        }
+        else
+        {
+            NumFailed++;
+        }
+    }
+    Requests.Empty();
+
+    FinishNotification();
+}
+
+int32 FBlendImportQueue::Num() const
+{
+    return Requests.Num();
+}
+
+bool FBlendImportQueue::Tick(float DeltaTime)
+{
+    if (*bCancelRequested)
+    {
+        CancelAll();
+        return false;
+    }
+
+    for (const TSharedRef<FRequest>& Request : Requests)
+    {
+        if (Request->State == EState::Pending)
+        {
+            Prepare(Request);
+        }
+        else if (Request->State == EState::Preparing && Request->Preparation.IsReady())
+        {
+            StartExport(Request);
+        }
+    }
+
+    Pool.Tick();
+
+    // Only one import per tick, so the editor stays responsive between them
+    for (const TSharedRef<FRequest>& Request : Requests)
+    {
+        if (Request->State == EState::ReadyToImport)
+        {
+            Import(*Request);
+            break;
+        }
+    }
+
+    Requests.RemoveAll([](const TSharedRef<FRequest>& Request) { return Request->State == EState::Done; });
+
+    if (Requests.Num() == 0)
+    {
+        TickerHandle.Reset();
+        FinishNotification();
+        return false;
+    }
+
+    UpdateNotification();
+    return true;
+}
+
+void FBlendImportQueue::Prepare(const TSharedRef<FRequest>& Request)
+{
+    Request->State = EState::Preparing;
+    Request->Status = LOCTEXT("StatusPreparing", "Analysing").ToString();
+
+    // Reading and hashing the file can take a while for large files, so it's done off the game thread
+    Request->Preparation = Async(EAsyncExecution::ThreadPool, [Request]()
+    {
+        Request->bCanExport = UBlendAssetFactory::BeginQueuedExport(*Request->Prepared, Request->Job, Request->CacheKey);
+    });
+}
+
+void FBlendImportQueue::StartExport(const TSharedRef<FRequest>& Request)
+{
+    Request->Preparation.Reset();
+
+    if (!Request->bCanExport)
+    {
+        Request->bFailed = true;
+        Request->State = EState::ReadyToImport;
+        return;
+    }
+
+    if (!Request->Job.IsValid())
+    {
+        Request->State = EState::ReadyToImport;
+        Request->Status = LOCTEXT("StatusCached", "Waiting to import (cached)").ToString();
+        return;
+    }
+
+    Request->State = EState::Exporting;
+    Request->Status = LOCTEXT("StatusWaitingForBlender", "Waiting for Blender").ToString();
+
+    const FBlendFileAnalysis& Analysis = Request->Prepared->Analysis;
+    Pool.Add(MoveTemp(Request->Job), FBlenderJobPool::EstimateJobMemory(Request->Filename, Analysis.NumObjects, Analysis.NumTriangles),
+        FBlenderJobPool::FOnJobFinished::CreateLambda([Request](FBlenderJob& FinishedJob, bool bSucceeded)
+        {
+            Request->bFailed = !UBlendAssetFactory::FinishQueuedExport(*Request->Prepared, FinishedJob, bSucceeded, Request->CacheKey);
+            Request->State = EState::ReadyToImport;
+            Request->Status = LOCTEXT("StatusWaitingToImport", "Waiting to import").ToString();
+        }),
+        FBlenderJobPool::FOnJobOutput::CreateLambda([Request](const TArray<FString>& Lines)
+        {
+            Request->Status = Lines.Last().TrimStartAndEnd().Left(100);
+        }),
+        Request->bExportOnly ? FBlenderJobPool::EPriority::Background : FBlenderJobPool::EPriority::Interactive);
+}
+
+void FBlendImportQueue::Import(FRequest& Request)
+{
+    Request.State = EState::Done;
+
+    if (Request.bExportOnly)
+    {
+        if (Request.bFailed)
+        {
+            UE_LOG(LogBlendImporter, Warning, TEXT("Failed to export '%s' in the background"), *Request.Filename);
+            NumExportsFailed++;
+        }
+        else
+        {
+            NumExported++;
+        }
+        Request.OnExported.ExecuteIfBound(!Request.bFailed);
+        return;
+    }
+
+    if (Request.bFailed)
+    {
+        // Exporting it again on the game thread would only block the editor to fail the same way
+        UE_LOG(LogBlendImporter, Error, TEXT("Failed to export '%s', it was not imported"), *Request.Filename);
+        NumFailed++;
+        return;
+    }
+
+    Request.Status = LOCTEXT("StatusImporting", "Importing").ToString();
+    UpdateNotification();
+
+    // Only this import uses the request's options and export, the import dialog keeps defaulting to the options it remembers
+    Factory->SetPreparedImport(Request.Prepared);
+
+    IAssetTools& AssetTools = FModuleManager::LoadModuleChecked<FAssetToolsModule>("AssetTools").Get();
+
+    UAssetImportTask* ImportTask = NewObject<UAssetImportTask>();
+    ImportTask->Filename = Request.Filename;
+    ImportTask->DestinationPath = Request.DestinationPath;
+    ImportTask->Factory = Factory.Get();
+    ImportTask->bAutomated = true;
+    ImportTask->bReplaceExisting = true;
+    ImportTask->bSave = false;
+    AssetTools.ImportAssetTasks({ ImportTask });
+    Factory->SetPreparedImport(nullptr);
+
+    if (ImportTask->ImportedObjectPaths.Num() > 0)
+    {
+        NumImported++;
+    }
+    else
+    {
+        UE_LOG(LogBlendImporter, Error, TEXT("Failed to import '%s'"), *Request.Filename);
+        NumFailed++;
+    }
+}
+
+void FBlendImportQueue::UpdateNotification()
+{
+    if (!FSlateApplication::IsInitialized())
+    {
+        return;
+    }
+
+    const int32 NumFinished = NumImported + NumExported + NumFailed + NumExportsFailed;
+    const bool bExportOnly = NumImported == 0 && !Requests.ContainsByPredicate([](const TSharedRef<FRequest>& Request) { return !Request->bExportOnly; });
+    const FText Title = bExportOnly
+        ? FText::Format(LOCTEXT("Exporting", "Exporting changed .blend files ({0} of {1})"), NumFinished + 1, NumFinished + Requests.Num())
+        : FText::Format(LOCTEXT("Importing", "Importing .blend files ({0} of {1})"), NumFinished + 1, NumFinished + Requests.Num());
+
+    // Each file's place in the queue, and what it's waiting on
+    FString Details;
+    for (int32 Index = 0; Index < Requests.Num() && Index < MaxNotificationLines; Index++)
+    {
+        Details += FString::Printf(TEXT("%d. %s: %s\n"), Index + 1, *FPaths::GetCleanFilename(Requests[Index]->Filename), *Requests[Index]->Status);
+    }
+    if (Requests.Num() > MaxNotificationLines)
+    {
+        Details += FText::Format(LOCTEXT("MoreQueued", "{0} more queued"), Requests.Num() - MaxNotificationLines).ToString() + TEXT("\n");
+    }
+    if (Pool.GetNumPending() > 0 && Pool.IsWaitingForMemory())
+    {
+        Details += FText::Format(LOCTEXT("WaitingForMemory", "{0} Blender exports running, {1} waiting for free memory"), Pool.GetNumRunning(), Pool.GetNumPending()).ToString();
+    }
+    Details.TrimEndInline();
+
+    if (!Notification.IsValid())
+    {
+        FNotificationInfo Info(Title);
+        Info.bFireAndForget = false;
+        Info.bUseThrobber = true;
+        Info.FadeOutDuration = 0.5f;
+        Info.ExpireDuration = 0.0f;
+
+        TSharedRef<bool> CancelRequested = bCancelRequested;
+        Info.ButtonDetails.Add(FNotificationButtonInfo(
+            LOCTEXT("Cancel", "Cancel"),
+            LOCTEXT("CancelTooltip", "Stop Blender and cancel the queued imports. Files that were already imported are kept."),
+            FSimpleDelegate::CreateLambda([CancelRequested]() { *CancelRequested = true; }),
+            SNotificationItem::CS_Pending));
+
+        Notification = FSlateNotificationManager::Get().AddNotification(Info);
+        if (!Notification.IsValid())
+        {
+            return;
+        }
+        Notification->SetCompletionState(SNotificationItem::CS_Pending);
+    }
+
+    #if ENGINE_MAJOR_VERSION >= 5
+        Notification->SetText(Title);
+        Notification->SetSubText(FText::FromString(Details));
+    #else
+        Notification->SetText(FText::FromString(Title.ToString() + TEXT("\n") + Details));
+    #endif
+}
+
+void FBlendImportQueue::FinishNotification()
+{
+    if (!Notification.IsValid())
+    {
+        NumImported = NumExported = NumFailed = NumExportsFailed = 0;
+        return;
+    }
+
+    if (NumFailed > 0)
+    {
+        Notification->SetText(FText::Format(LOCTEXT("ImportedWithFailures", "Imported {0} .blend files, {1} were not imported"), NumImported, NumFailed));
+        Notification->SetCompletionState(SNotificationItem::CS_Fail);
+    }
+    else if (NumImported == 0 && NumExportsFailed > 0)
+    {
+        Notification->SetText(FText::Format(LOCTEXT("ExportedWithFailures", "Exported {0} changed .blend files, {1} failed"), NumExported, NumExportsFailed));
+        Notification->SetCompletionState(SNotificationItem::CS_Fail);
+    }
+    else if (NumImported == 0)
+    {
+        Notification->SetText(FText::Format(LOCTEXT("Exported", "Exported {0} changed .blend files"), NumExported));
+        Notification->SetCompletionState(SNotificationItem::CS_Success);
+    }
+    else
+    {
+        Notification->SetText(FText::Format(LOCTEXT("Imported", "Imported {0} .blend files"), NumImported));
+        Notification->SetCompletionState(SNotificationItem::CS_Success);
+    }
+    #if ENGINE_MAJOR_VERSION >= 5
+        Notification->SetSubText(FText::GetEmpty());
+    #endif
+    Notification->SetExpireDuration(3.0f);
+    Notification->ExpireAndFadeout();
+    Notification.Reset();
+
+    NumImported = NumExported = NumFailed = NumExportsFailed = 0;
+}
+
+void FBlendImportQueue::WaitForPreparations()
+{
+    // Preparation only reads the file, so this doesn't take long
+    for (const TSharedRef<FRequest>& Request : Requests)
+    {
+        if (Request->Preparation.IsValid())
+        {
+            Request->Preparation.Wait();
+        }
+    }
+}
+
+#undef LOCTEXT_NAMESPACE
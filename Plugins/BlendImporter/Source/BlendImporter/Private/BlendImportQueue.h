@@ -0,0 +1,97 @@
+// Copyright 2022 nuclearfriend
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BlendAssetFactory.h"
+#include "BlenderJobPool.h"
+#include "Containers/Ticker.h"
+#include "UObject/StrongObjectPtr.h"
+
+class FBlenderJob;
+class SNotificationItem;
+
+/**
+ * Imports .blend files without blocking the editor. Analysing and hashing each file runs on a background task, and the Blender exports run
+ * in parallel through a FBlenderJobPool, with their progress shown in a notification. Only the final import of each exported FBX runs on
+ * the game thread, one file per tick, using the export made for it so Blender doesn't run again.
+ */
+class FBlendImportQueue
+{
+public:
+	DECLARE_DELEGATE_OneParam(FOnExported, bool /* bSucceeded */);
+
+	FBlendImportQueue();
+	~FBlendImportQueue();
+
+	/** Queues a file to be imported into DestinationPath, returning its place in the queue */
+	int32 Enqueue(const FString& Filename, const FString& DestinationPath, const FBlendQueuedImportOptions& Options);
+
+	/** Queues a file with the options the import dialog would default to */
+	int32 Enqueue(const FString& Filename, const FString& DestinationPath);
+
+	/** Queues a file to only be exported into the export cache, calling OnExported once it's there, or once the export failed */
+	int32 EnqueueExport(const FString& Filename, const FBlendQueuedImportOptions& Options, FOnExported OnExported);
+
+	void CancelAll();
+
+	/** Files queued or being imported */
+	int32 Num() const;
+
+private:
+	enum class EState : uint8
+	{
+		Pending,
+		Preparing,
+		Exporting,
+		ReadyToImport,
+		Done,
+	};
+
+	struct FRequest
+	{
+		FString Filename;
+		FString DestinationPath;
+		TSharedRef<FBlendPreparedImport> Prepared = MakeShared<FBlendPreparedImport>();
+		EState State = EState::Pending;
+		FString Status;
+
+		/** Set by the preparation task, and only read once it's done */
+		TFuture<void> Preparation;
+		bool bCanExport = false;
+		TUniquePtr<FBlenderJob> Job;
+		FString CacheKey;
+		bool bFailed = false;
+
+		bool bExportOnly = false;
+		FOnExported OnExported;
+	};
+
+	int32 AddRequest(const TSharedRef<FRequest>& Request);
+	bool Tick(float DeltaTime);
+	void Prepare(const TSharedRef<FRequest>& Request);
+	void StartExport(const TSharedRef<FRequest>& Request);
+	void Import(FRequest& Request);
+
+	void UpdateNotification();
+	void FinishNotification();
+	void WaitForPreparations();
+
+private:
+	TArray<TSharedRef<FRequest>> Requests;
+	FBlenderJobPool Pool;
+	TStrongObjectPtr<UBlendAssetFactory> Factory;
+
+	#if ENGINE_MAJOR_VERSION >= 5
+		FTSTicker::FDelegateHandle TickerHandle;
+	#else
+		FDelegateHandle TickerHandle;
+	#endif
+
+	TSharedPtr<SNotificationItem> Notification;
+	TSharedRef<bool> bCancelRequested;
+	int32 NumImported;
+	int32 NumExported;
+	int32 NumFailed;
+	int32 NumExportsFailed;
+};
@@ -0,0 +1,144 @@
+// Copyright 2022 nuclearfriend
+
+#include "BlendImportStats.h"
+#include "BlendImporter.h"
+#include "BlenderResultReader.h"
+#include "Logging/MessageLog.h"
+
+#define LOCTEXT_NAMESPACE "BlendImportStats"
+
+UE_TRACE_CHANNEL_DEFINE(BlendImporterChannel);
+
+DEFINE_STAT(STAT_BlendImporter_TotalTime);
+DEFINE_STAT(STAT_BlendImporter_BlenderTime);
+DEFINE_STAT(STAT_BlendImporter_ImportTime);
+DEFINE_STAT(STAT_BlendImporter_ExportedMB);
+DEFINE_STAT(STAT_BlendImporter_Objects);
+DEFINE_STAT(STAT_BlendImporter_Triangles);
+DEFINE_STAT(STAT_BlendImporter_Imports);
+
+void FBlendImportSummary::Reset(const FString& InFilename)
+{
+    Filename = InFilename;
+    StartTime = FPlatformTime::Seconds();
+    Stages.Empty();
+    TotalMilliseconds = 0.0;
+    ExportedBytes = 0;
+    NumObjects = 0;
+    NumTriangles = 0;
+}
+
+void FBlendImportSummary::AddStage(const FString& Stage, double Milliseconds)
+{
+    // Stages can run more than once, e.g. analysis falling back to Blender
+    for (TPair<FString, double>& Existing : Stages)
+    {
+        if (Existing.Key == Stage)
+        {
+            Existing.Value += Milliseconds;
+            return;
+        }
+    }
+    Stages.Emplace(Stage, Milliseconds);
+}
+
+void FBlendImportSummary::AddBlenderResult(const FBlenderResultReader& Result)
+{
+    for (const TPair<FString, double>& Timing : Result.GetTimings())
+    {
+        AddStage(TEXT("Blender ") + Timing.Key, Timing.Value * 1000.0);
+    }
+
+    if (Result.GetExportedObjects().Num() > 0)
+    {
+        NumObjects = Result.GetExportedObjects().Num();
+        NumTriangles = 0;
+        for (const FBlendObjectStats& Object : Result.GetExportedObjects())
+        {
+            NumTriangles += Object.NumTriangles;
+        }
+    }
+}
+
+void FBlendImportSummary::SetExportedFile(const FString& ExportedFilename)
+{
+    ExportedBytes = FMath::Max<int64>(IFileManager::Get().FileSize(*ExportedFilename), 0);
+}
+
+void FBlendImportSummary::Report()
+{
+    TotalMilliseconds = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+    FString StageSummary;
+    double BlenderMilliseconds = 0.0;
+    double ImportMilliseconds = 0.0;
+    for (const TPair<FString, double>& Stage : Stages)
+    {
+        StageSummary += FString::Printf(TEXT("\n\t%s: %.0fms"), *Stage.Key, Stage.Value);
+        if (Stage.Key == TEXT("Blender"))
+        {
+            BlenderMilliseconds += Stage.Value;
+        }
+        else if (Stage.Key == TEXT("Import"))
+        {
+            ImportMilliseconds += Stage.Value;
+        }
+    }
+
+    const FText Summary = FText::Format(LOCTEXT("ImportSummary", "Import of '{0}' took {1}ms: {2} objects, {3} triangles, {4} exported{5}"),
+        FText::FromString(FPaths::GetCleanFilename(Filename)), FText::AsNumber(FMath::RoundToInt(TotalMilliseconds)), FText::AsNumber(NumObjects),
+        FText::AsNumber(NumTriangles), FText::AsMemory(ExportedBytes), FText::FromString(StageSummary));
+
+    UE_LOG(LogBlendImporter, Verbose, TEXT("%s"), *Summary.ToString());
+    FMessageLog(FName("LogBlendImporter")).Info(Summary);
+
+    SET_FLOAT_STAT(STAT_BlendImporter_TotalTime, TotalMilliseconds);
+    SET_FLOAT_STAT(STAT_BlendImporter_BlenderTime, BlenderMilliseconds);
+    SET_FLOAT_STAT(STAT_BlendImporter_ImportTime, ImportMilliseconds);
+    SET_FLOAT_STAT(STAT_BlendImporter_ExportedMB, ExportedBytes / (1024.0 * 1024.0));
+    SET_DWORD_STAT(STAT_BlendImporter_Objects, NumObjects);
+    SET_DWORD_STAT(STAT_BlendImporter_Triangles, NumTriangles);
+    INC_DWORD_STAT(STAT_BlendImporter_Imports);
+}
+
+const TArray<TPair<FString, double>>& FBlendImportSummary::GetStages() const
+{
+    return Stages;
+}
+
+double FBlendImportSummary::GetTotalMilliseconds() const
+{
+    return TotalMilliseconds;
+}
+
+int64 FBlendImportSummary::GetExportedBytes() const
+{
+    return ExportedBytes;
+}
+
+int32 FBlendImportSummary::GetNumObjects() const
+{
+    return NumObjects;
+}
+
+int64 FBlendImportSummary::GetNumTriangles() const
+{
+    return NumTriangles;
+}
+
+FBlendImportStageScope::FBlendImportStageScope(FBlendImportSummary* InSummary, const TCHAR* InStage)
+    : Summary(InSummary)
+    , Stage(InStage)
+    , StartTime(FPlatformTime::Seconds())
+{
+}
+
+FBlendImportStageScope::~FBlendImportStageScope()
+{
+    if (Summary)
+    {
+        Summary->AddStage(Stage, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+    }
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,71 @@
+// Copyright 2022 nuclearfriend
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Stats/Stats.h"
+#include "Trace/Trace.h"
+
+class FBlenderResultReader;
+
+/** Enable with -trace=cpu,BlendImporter to see each import stage in Unreal Insights */
+UE_TRACE_CHANNEL_EXTERN(BlendImporterChannel);
+
+#define BLENDIMPORTER_TRACE_SCOPE(Name) TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(Name, BlendImporterChannel)
+
+/** The last import's summary, see "stat BlendImporter" */
+DECLARE_STATS_GROUP(TEXT("BlendImporter"), STATGROUP_BlendImporter, STATCAT_Advanced);
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Last Import Total (ms)"), STAT_BlendImporter_TotalTime, STATGROUP_BlendImporter, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Last Import Blender (ms)"), STAT_BlendImporter_BlenderTime, STATGROUP_BlendImporter, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Last Import Unreal Import (ms)"), STAT_BlendImporter_ImportTime, STATGROUP_BlendImporter, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Last Import Exported (MB)"), STAT_BlendImporter_ExportedMB, STATGROUP_BlendImporter, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Last Import Objects"), STAT_BlendImporter_Objects, STATGROUP_BlendImporter, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Last Import Triangles"), STAT_BlendImporter_Triangles, STATGROUP_BlendImporter, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Imports"), STAT_BlendImporter_Imports, STATGROUP_BlendImporter, );
+
+/** How long each stage of an import took, and how much was exported, reported once the import is done */
+class FBlendImportSummary
+{
+public:
+	void Reset(const FString& InFilename);
+
+	void AddStage(const FString& Stage, double Milliseconds);
+
+	/** Adds the stages Blender timed itself (startup, file open, evaluation, export...) and the exported objects */
+	void AddBlenderResult(const FBlenderResultReader& Result);
+
+	void SetExportedFile(const FString& ExportedFilename);
+
+	/** Writes the summary to the Blend Importer message log and sets the stats */
+	void Report();
+
+	/** Milliseconds per stage, in the order they first ran. Stages can overlap, e.g. "Blender" runs within "Export". */
+	const TArray<TPair<FString, double>>& GetStages() const;
+	double GetTotalMilliseconds() const;
+	int64 GetExportedBytes() const;
+	int32 GetNumObjects() const;
+	int64 GetNumTriangles() const;
+
+private:
+	FString Filename;
+	double StartTime = 0.0;
+	double TotalMilliseconds = 0.0;
+	TArray<TPair<FString, double>> Stages;
+	int64 ExportedBytes = 0;
+	int32 NumObjects = 0;
+	int64 NumTriangles = 0;
+};
+
+/** Times a stage of an import for the summary, if there is one */
+class FBlendImportStageScope
+{
+public:
+	FBlendImportStageScope(FBlendImportSummary* InSummary, const TCHAR* InStage);
+	~FBlendImportStageScope();
+
+private:
+	FBlendImportSummary* Summary;
+	const TCHAR* Stage;
+	double StartTime;
+};
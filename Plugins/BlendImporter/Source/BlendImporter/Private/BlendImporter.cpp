@@ -1,11 +1,22 @@
 // Copyright 2022 nuclearfriend
 
 #include "BlendImporter.h"
+#include "BlendAssetFactory.h"
+#include "BlendExportCache.h"
+#include "BlendFileHashes.h"
+#include "BlendImportQueue.h"
 #include "BlendImporterSettings.h"
+#include "BlendSourceWatcher.h"
+#include "BlenderWorker.h"
 #include "ContentBrowserModule.h"
+#include "DesktopPlatformModule.h"
+#include "Framework/Application/SlateApplication.h"
+#include "Framework/Notifications/NotificationManager.h"
 #include "ISettingsModule.h"
 #include "MessageLogInitializationOptions.h"
 #include "MessageLogModule.h"
+#include "UObject/StrongObjectPtr.h"
+#include "Widgets/Notifications/SNotificationList.h"
 
 #if ENGINE_MAJOR_VERSION < 5
     #include "EditorStyleSet.h"
@@ -15,11 +26,26 @@ DEFINE_LOG_CATEGORY(LogBlendImporter);
 
 #define LOCTEXT_NAMESPACE "BlendImporterModule"
 
+FBlendImporterModule* FBlendImporterModule::Instance = nullptr;
+
 void FBlendImporterModule::StartupModule()
 {
+    Instance = this;
+
     RegisterSettings();
     RegisterContentBrowserAssetMenuExtender();
     RegisterMessageLog();
+    RegisterAssetRegistryTags();
+
+    // Created up front, as queued imports use them from other threads
+    ExportCache = MakeShared<FBlendExportCache>();
+    FileHashes = MakeShared<FBlendFileHashes>();
+
+    if (!IsRunningCommandlet())
+    {
+        SourceWatcher = MakeShared<FBlendSourceWatcher>();
+        SourceWatcher->Refresh();
+    }
 }
 
 void FBlendImporterModule::ShutdownModule()
@@ -27,6 +53,62 @@ void FBlendImporterModule::ShutdownModule()
     UnregisterSettings();
     UnregisterContentBrowserAssetMenuExtender();
     UnregisterMessageLog();
+    UnregisterAssetRegistryTags();
+
+    SourceWatcher.Reset();
+    ImportQueue.Reset();
+
+    if (BlenderWorker.IsValid())
+    {
+        BlenderWorker->Shutdown();
+        BlenderWorker.Reset();
+    }
+
+    Instance = nullptr;
+}
+
+FBlendImporterModule& FBlendImporterModule::Get()
+{
+    if (Instance == nullptr)
+    {
+        // Loading the module sets the instance, which can only be done on the game thread
+        check(IsInGameThread());
+        FModuleManager::LoadModuleChecked<FBlendImporterModule>("BlendImporter");
+    }
+    return *Instance;
+}
+
+FBlenderWorker& FBlendImporterModule::GetBlenderWorker()
+{
+    if (!BlenderWorker.IsValid())
+    {
+        BlenderWorker = MakeShared<FBlenderWorker>();
+    }
+    return *BlenderWorker;
+}
+
+FBlendExportCache& FBlendImporterModule::GetExportCache()
+{
+    return *ExportCache;
+}
+
+FBlendFileHashes& FBlendImporterModule::GetFileHashes()
+{
+    return *FileHashes;
+}
+
+FBlendImportQueue& FBlendImporterModule::GetImportQueue()
+{
+    if (!ImportQueue.IsValid())
+    {
+        ImportQueue = MakeShared<FBlendImportQueue>();
+    }
+    return *ImportQueue;
+}
+
+FBlendSourceWatcher* FBlendImporterModule::GetSourceWatcher()
+{
+    return SourceWatcher.Get();
 }
 
 void FBlendImporterModule::RegisterSettings()
@@ -53,6 +135,10 @@ void FBlendImporterModule::RegisterContentBrowserAssetMenuExtender()
     TArray<FContentBrowserMenuExtender_SelectedAssets>& CBAssetMenuExtenderDelegates = ContentBrowserModule.GetAllAssetViewContextMenuExtenders();
     CBAssetMenuExtenderDelegates.Add(FContentBrowserMenuExtender_SelectedAssets::CreateRaw(this, &FBlendImporterModule::OnExtendContentBrowserAssetSelectionMenu));
     ContentBrowserExtenderDelegateHandle = CBAssetMenuExtenderDelegates.Last().GetHandle();
+
+    TArray<FContentBrowserMenuExtender_SelectedPaths>& CBPathMenuExtenderDelegates = ContentBrowserModule.GetAllPathViewContextMenuExtenders();
+    CBPathMenuExtenderDelegates.Add(FContentBrowserMenuExtender_SelectedPaths::CreateRaw(this, &FBlendImporterModule::OnExtendContentBrowserPathSelectionMenu));
+    ContentBrowserPathExtenderDelegateHandle = CBPathMenuExtenderDelegates.Last().GetHandle();
 }
 
 void FBlendImporterModule::UnregisterContentBrowserAssetMenuExtender()
@@ -60,6 +146,9 @@ void FBlendImporterModule::UnregisterContentBrowserAssetMenuExtender()
     FContentBrowserModule& ContentBrowserModule = FModuleManager::LoadModuleChecked<FContentBrowserModule>(TEXT("ContentBrowser"));
     TArray<FContentBrowserMenuExtender_SelectedAssets>& CBAssetMenuExtenderDelegates = ContentBrowserModule.GetAllAssetViewContextMenuExtenders();
     CBAssetMenuExtenderDelegates.RemoveAll([this](const FContentBrowserMenuExtender_SelectedAssets& Delegate) { return Delegate.GetHandle() == ContentBrowserExtenderDelegateHandle; });
+
+    TArray<FContentBrowserMenuExtender_SelectedPaths>& CBPathMenuExtenderDelegates = ContentBrowserModule.GetAllPathViewContextMenuExtenders();
+    CBPathMenuExtenderDelegates.RemoveAll([this](const FContentBrowserMenuExtender_SelectedPaths& Delegate) { return Delegate.GetHandle() == ContentBrowserPathExtenderDelegateHandle; });
 }
 
 void FBlendImporterModule::RegisterMessageLog()
@@ -85,6 +174,34 @@ void FBlendImporterModule::UnregisterMessageLog()
 	}
 }
 
+void FBlendImporterModule::RegisterAssetRegistryTags()
+{
+    // Lets the source watcher read how assets were imported without loading them
+    #if ENGINE_MAJOR_VERSION >= 5 && ENGINE_MINOR_VERSION >= 4
+        AssetRegistryTagsDelegateHandle = UObject::FAssetRegistryTag::OnGetExtraObjectTagsWithContext.AddLambda([](FAssetRegistryTagsContext Context)
+        {
+            TArray<UObject::FAssetRegistryTag> Tags;
+            UBlendImportOptions::GetAssetRegistryTags(Context.GetObject(), Tags);
+            for (const UObject::FAssetRegistryTag& Tag : Tags)
+            {
+                Context.AddTag(Tag);
+            }
+        });
+    #else
+        AssetRegistryTagsDelegateHandle = UObject::FAssetRegistryTag::OnGetExtraObjectTags.AddStatic(&UBlendImportOptions::GetAssetRegistryTags);
+    #endif
+}
+
+void FBlendImporterModule::UnregisterAssetRegistryTags()
+{
+    #if ENGINE_MAJOR_VERSION >= 5 && ENGINE_MINOR_VERSION >= 4
+        UObject::FAssetRegistryTag::OnGetExtraObjectTagsWithContext.Remove(AssetRegistryTagsDelegateHandle);
+    #else
+        UObject::FAssetRegistryTag::OnGetExtraObjectTags.Remove(AssetRegistryTagsDelegateHandle);
+    #endif
+    AssetRegistryTagsDelegateHandle.Reset();
+}
+
 TSharedRef<FExtender> FBlendImporterModule::OnExtendContentBrowserAssetSelectionMenu(const TArray<FAssetData>& SelectedAssets)
 {
 	TSharedRef<FExtender> Extender = MakeShared<FExtender>();
@@ -97,56 +214,69 @@ TSharedRef<FExtender> FBlendImporterModule::OnExtendContentBrowserAssetSelection
 	return Extender;
 }
 
-bool CheckAssetImportDataIsBlend(UAssetImportData* AssetImportData)
+TSharedRef<FExtender> FBlendImporterModule::OnExtendContentBrowserPathSelectionMenu(const TArray<FString>& SelectedPaths)
 {
-    FString FileExtension = FPaths::GetExtension(AssetImportData->GetFirstFilename());
-    return FileExtension.Equals(TEXT("blend"), ESearchCase::IgnoreCase);
+	TSharedRef<FExtender> Extender = MakeShared<FExtender>();
+	Extender->AddMenuExtension(
+		"PathContextBulkOperations",
+		EExtensionHook::After,
+		nullptr,
+		FMenuExtensionDelegate::CreateStatic(&FBlendImporterModule::AddMenuExtenderBatchImport, SelectedPaths)
+	);
+	return Extender;
 }
 
-FString GetAssetImportDataAbsoluteFilePath(UAssetImportData* AssetImportData, const UPackage* Outermost)
+void FBlendImporterModule::AddMenuExtenderBatchImport(FMenuBuilder& MenuBuilder, const TArray<FString> SelectedPaths)
 {
-    return UAssetImportData::ResolveImportFilename(AssetImportData->GetFirstFilename(), Outermost);
+    if (SelectedPaths.Num() != 1)
+    {
+        return;
+    }
+
+    MenuBuilder.BeginSection("BlenderBatchImport", FText::FromString("Blender Source"));
+    {
+        MenuBuilder.AddMenuEntry(
+            FText::FromString("Import .blend Files in Parallel..."),
+            FText::FromString("Imports multiple .blend files into this folder with the default import options, running the Blender exports in parallel in the background"),
+            #if ENGINE_MAJOR_VERSION < 5
+                FSlateIcon(FEditorStyle::GetStyleSetName(), "ContentBrowser.ImportIcon"),
+            #else
+                FSlateIcon(FAppStyle::GetAppStyleSetName(), "Icons.Import"),
+            #endif
+            FUIAction(FExecuteAction::CreateLambda([DestinationPath = SelectedPaths[0]]()
+            {
+                BatchImportFiles(DestinationPath);
+            })));
+    }
+    MenuBuilder.EndSection();
 }
 
-void FBlendImporterModule::AddMenuExtenderBlendAssetImported(FMenuBuilder& MenuBuilder, const TArray<FAssetData> SelectedAssets)
+void FBlendImporterModule::BatchImportFiles(const FString& DestinationPath)
 {
-    TSet<FString> FilePaths;
-
-    for (const FAssetData& SelectedAsset : SelectedAssets)
+    IDesktopPlatform* DesktopPlatform = FDesktopPlatformModule::Get();
+    if (!DesktopPlatform)
     {
-        if (SelectedAsset.GetClass()->IsChildOf<UStaticMesh>())
-        {
-            UStaticMesh* Mesh = Cast<UStaticMesh>(SelectedAsset.GetAsset());
-            if (Mesh && CheckAssetImportDataIsBlend(Mesh->AssetImportData))
-            {
-                FilePaths.Add(GetAssetImportDataAbsoluteFilePath(Mesh->AssetImportData, Mesh->GetOutermost()));
-            }
-        }
+        return;
+    }
 
-        if (SelectedAsset.GetClass()->IsChildOf<USkeletalMesh>())
+    TArray<FString> Filenames;
+    const void* ParentWindowHandle = FSlateApplication::Get().FindBestParentWindowHandleForDialogs(nullptr);
+    if (DesktopPlatform->OpenFileDialog(ParentWindowHandle, TEXT("Import .blend Files"), TEXT(""), TEXT(""), TEXT("Blend File (*.blend)|*.blend"), EFileDialogFlags::Multiple, Filenames))
+    {
+        for (const FString& Filename : Filenames)
         {
-            USkeletalMesh* SkeletalMesh = Cast<USkeletalMesh>(SelectedAsset.GetAsset());
-            #if ENGINE_MAJOR_VERSION <= 4 && ENGINE_MINOR_VERSION <= 26
-                if (SkeletalMesh && CheckAssetImportDataIsBlend(SkeletalMesh->AssetImportData))
-                {
-                    FilePaths.Add(GetAssetImportDataAbsoluteFilePath(SkeletalMesh->AssetImportData, SkeletalMesh->GetOutermost()));
-                }
-            #else
-                if (SkeletalMesh && CheckAssetImportDataIsBlend(SkeletalMesh->GetAssetImportData()))
-                {
-                    FilePaths.Add(GetAssetImportDataAbsoluteFilePath(SkeletalMesh->GetAssetImportData(), SkeletalMesh->GetOutermost()));
-                }
-            #endif
+            Get().GetImportQueue().Enqueue(Filename, DestinationPath);
         }
+    }
+}
 
-        if (SelectedAsset.GetClass()->IsChildOf<UAnimSequence>())
-        {
-            UAnimSequence* AnimSequence = Cast<UAnimSequence>(SelectedAsset.GetAsset());
-            if (AnimSequence && CheckAssetImportDataIsBlend(AnimSequence->AssetImportData))
-            {
-                FilePaths.Add(GetAssetImportDataAbsoluteFilePath(AnimSequence->AssetImportData, AnimSequence->GetOutermost()));
-            }
-        }
+void FBlendImporterModule::AddMenuExtenderBlendAssetImported(FMenuBuilder& MenuBuilder, const TArray<FAssetData> SelectedAssets)
+{
+    // Only the registry tags are read, loading every selected asset could take a long time for large selections
+    TSet<FString> FilePaths;
+    for (const FAssetData& SelectedAsset : SelectedAssets)
+    {
+        FilePaths.Append(UBlendAssetFactory::GetSourceFiles(SelectedAsset));
     }
 
     if (FilePaths.Num() > 0)
@@ -165,6 +295,19 @@ void FBlendImporterModule::AddMenuExtenderBlendAssetImported(FMenuBuilder& MenuB
                 {
                     OpenFilesInBlender(FilePaths.Array());
                 })));
+
+            MenuBuilder.AddMenuEntry(
+                FText::FromString("Reimport All From .blend"),
+                FText::FromString("Reimports every mesh imported from the same .blend file, with one Blender export for all of them"),
+                #if ENGINE_MAJOR_VERSION < 5
+                    FSlateIcon(FEditorStyle::GetStyleSetName(), "ContentBrowser.AssetActions.ReimportAsset"),
+                #else
+                    FSlateIcon(FAppStyle::GetAppStyleSetName(), "Icons.Refresh"),
+                #endif
+                FUIAction(FExecuteAction::CreateLambda([FilePaths]()
+                {
+                    ReimportAllFromFiles(FilePaths.Array());
+                })));
         }
         MenuBuilder.EndSection();
     }
@@ -178,6 +321,27 @@ void FBlendImporterModule::OpenFilesInBlender(const TArray<FString>& Filenames)
     }
 }
 
+void FBlendImporterModule::ReimportAllFromFiles(const TArray<FString>& Filenames)
+{
+    // Its own factory, so the reimports don't share state with other imports
+    TStrongObjectPtr<UBlendAssetFactory> Factory(NewObject<UBlendAssetFactory>());
+    for (const FString& Filename : Filenames)
+    {
+        const TArray<UObject*> Assets = UBlendAssetFactory::FindAssetsFromSource(Filename);
+        const bool bSucceeded = Assets.Num() > 0 && Factory->ReimportFromSource(Assets) == EReimportResult::Succeeded;
+
+        FNotificationInfo Info(bSucceeded
+            ? FText::Format(LOCTEXT("ReimportedAll", "Reimported {0} assets from '{1}'"), Assets.Num(), FText::FromString(FPaths::GetCleanFilename(Filename)))
+            : FText::Format(LOCTEXT("ReimportAllFailed", "Failed to reimport assets from '{0}'"), FText::FromString(FPaths::GetCleanFilename(Filename))));
+        Info.ExpireDuration = 3.0f;
+        TSharedPtr<SNotificationItem> Notification = FSlateNotificationManager::Get().AddNotification(Info);
+        if (Notification.IsValid())
+        {
+            Notification->SetCompletionState(bSucceeded ? SNotificationItem::CS_Success : SNotificationItem::CS_Fail);
+        }
+    }
+}
+
 void FBlendImporterModule::OpenFileInBlender(const FString& Filename)
 {
     UBlendImporterSettings* Settings = GetMutableDefault<UBlendImporterSettings>();
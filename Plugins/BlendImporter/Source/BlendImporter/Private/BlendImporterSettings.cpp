@@ -1,6 +1,12 @@
 // Copyright 2022 nuclearfriend
 
 #include "BlendImporterSettings.h"
+#include "BlendImporter.h"
+#include "BlendSourceWatcher.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/ScopeLock.h"
+#include "Misc/SecureHash.h"
 
 #define LOCTEXT_NAMESPACE "BlendImporterSettings"
 
@@ -34,22 +40,110 @@
 
 #endif
 
+#if PLATFORM_WINDOWS
+    static const TCHAR* BlenderExecutableName = TEXT("blender.exe");
+#elif PLATFORM_MAC
+    static const TCHAR* BlenderExecutableName = TEXT("Blender");
+#else
+    static const TCHAR* BlenderExecutableName = TEXT("blender");
+#endif
+
+// Blender installed through a package manager or unpacked from the release archive, in the order they're tried after PATH
+static TArray<FString> GetCommonBlenderLocations()
+{
+    TArray<FString> Locations;
+
+    #if PLATFORM_WINDOWS
+        const FString ProgramFiles = FPlatformMisc::GetEnvironmentVariable(TEXT("ProgramFiles"));
+        if (!ProgramFiles.IsEmpty())
+        {
+            // One folder per version, e.g. "Blender 3.3", the newest first
+            const FString FoundationDir = FPaths::Combine(ProgramFiles, TEXT("Blender Foundation"));
+            TArray<FString> VersionDirs;
+            IFileManager::Get().FindFiles(VersionDirs, *FPaths::Combine(FoundationDir, TEXT("*")), false, true);
+            VersionDirs.Sort([](const FString& A, const FString& B) { return A > B; });
+            for (const FString& VersionDir : VersionDirs)
+            {
+                Locations.Add(FPaths::Combine(FoundationDir, VersionDir, BlenderExecutableName));
+            }
+        }
+    #elif PLATFORM_MAC
+        Locations.Add(TEXT("/Applications/Blender.app/Contents/MacOS/Blender"));
+        Locations.Add(FPaths::Combine(FPlatformProcess::UserHomeDir(), TEXT("Applications/Blender.app/Contents/MacOS/Blender")));
+    #else
+        Locations.Add(TEXT("/usr/bin/blender"));
+        Locations.Add(TEXT("/usr/local/bin/blender"));
+        Locations.Add(TEXT("/snap/bin/blender"));
+
+        TArray<FString> OptDirs;
+        IFileManager::Get().FindFiles(OptDirs, TEXT("/opt/blender*"), false, true);
+        OptDirs.Sort([](const FString& A, const FString& B) { return A > B; });
+        for (const FString& OptDir : OptDirs)
+        {
+            Locations.Add(FPaths::Combine(TEXT("/opt"), OptDir, BlenderExecutableName));
+        }
+    #endif
+
+    return Locations;
+}
+
+static FString FindBlenderExecutable()
+{
+    // On Windows, attempt to use registry to find the default Blender installation
+    #if PLATFORM_WINDOWS
+        FString RegistryPath;
+        if (ReadRegistryValue(HKEY_LOCAL_MACHINE, TEXT("SOFTWARE\\Classes\\blendfile\\shell\\open\\command"), TEXT(""), RegistryPath))
+        {
+            return RegistryPath;
+        }
+    #endif
+
+    TArray<FString> PathDirs;
+    FPlatformMisc::GetEnvironmentVariable(TEXT("PATH")).ParseIntoArray(PathDirs, FPlatformMisc::GetPathVarDelimiter());
+    for (const FString& PathDir : PathDirs)
+    {
+        const FString Candidate = FPaths::Combine(PathDir, BlenderExecutableName);
+        if (FPaths::FileExists(Candidate))
+        {
+            return Candidate;
+        }
+    }
+
+    for (const FString& Candidate : GetCommonBlenderLocations())
+    {
+        if (FPaths::FileExists(Candidate))
+        {
+            return Candidate;
+        }
+    }
+
+    return FString();
+}
 
 UBlendImporterSettings::UBlendImporterSettings(const FObjectInitializer& obj)
 {
     //
 }
 
-FFilePath UBlendImporterSettings::GetBlenderExecutable() const
+FFilePath UBlendImporterSettings::GetBlenderExecutable(bool bPromptIfInvalid) const
 {
     FText ErrorMessage;
     if (BlenderExecutable.FilePath.IsEmpty())
     {
         ErrorMessage = LOCTEXT("BlenderPathNotSet", "Your path to Blender is not set. Would you like to be taken to the project settings to set it now?");
     }
-    else if (!BlenderExecutable.FilePath.EndsWith(TEXT("blender.exe")))
+    else if (!FPaths::FileExists(BlenderExecutable.FilePath))
+    {
+        ErrorMessage = FText::Format(LOCTEXT("BlenderPathNotFound", "Blender wasn't found at '{0}'. Would you like to be taken to your project settings to fix it now?"), FText::FromString(BlenderExecutable.FilePath));
+    }
+    else if (GetBlenderVersion().IsEmpty())
     {
-        ErrorMessage = LOCTEXT("BlenderPathNotExe", "You must set a path to a valid Blender executable (blender.exe). Would you like to be taken to your project settings to fix it now?");
+        ErrorMessage = FText::Format(LOCTEXT("BlenderPathNotExe", "You must set a path to a valid Blender executable ({0}). Would you like to be taken to your project settings to fix it now?"), FText::FromString(BlenderExecutableName));
+    }
+
+    if (!ErrorMessage.IsEmpty() && !bPromptIfInvalid)
+    {
+        return FFilePath();
     }
 
     if (!ErrorMessage.IsEmpty())
@@ -69,6 +163,78 @@ FFilePath UBlendImporterSettings::GetBlenderExecutable() const
     return BlenderExecutable;
 }
 
+FString UBlendImporterSettings::GetBlenderVersion() const
+{
+    return GetBlenderVersion(BlenderExecutable.FilePath);
+}
+
+FString UBlendImporterSettings::GetBlenderVersion(const FString& ExecutablePath)
+{
+    static FCriticalSection VersionLock;
+    static TMap<FString, FString> BlenderVersions;
+
+    if (ExecutablePath.IsEmpty())
+    {
+        return FString();
+    }
+
+    // Blender is only asked for its version once per executable, which is remembered across editor sessions.
+    //  Replacing Blender in place changes its size or time stamp, so it's asked again.
+    const FFileStatData ExecutableStat = IFileManager::Get().GetStatData(*ExecutablePath);
+    if (!ExecutableStat.bIsValid)
+    {
+        return FString();
+    }
+    const FString ExecutableId = FString::Printf(TEXT("%s|%lld|%s"), *FPaths::ConvertRelativePathToFull(ExecutablePath), ExecutableStat.FileSize, *ExecutableStat.ModificationTime.ToString());
+
+    {
+        // Failures are remembered too (as an empty version), so a broken executable isn't run again on every check
+        FScopeLock Lock(&VersionLock);
+        if (const FString* Version = BlenderVersions.Find(ExecutableId))
+        {
+            return *Version;
+        }
+    }
+
+    FTCHARToUTF8 ExecutableIdUTF8(*ExecutableId);
+    FSHAHash ExecutableHash;
+    FSHA1::HashBuffer(ExecutableIdUTF8.Get(), ExecutableIdUTF8.Length(), ExecutableHash.Hash);
+    const FString VersionFilename = FPaths::Combine(FPaths::ProjectIntermediateDir(), TEXT("BlendImporter"), FString::Printf(TEXT("Blender-%s.version"), *ExecutableHash.ToString()));
+
+    // Run without holding the lock, so other threads checking other executables aren't held up by Blender starting.
+    //  Threads asking about the same executable at once may each run it, and get the same answer.
+    FString Version;
+    if (!FFileHelper::LoadFileToString(Version, *VersionFilename))
+    {
+        // Only Blender prints "Blender x.y.z" first, which also checks the binary runs on this machine
+        int32 ReturnCode = -1;
+        FString StdOut;
+        FString StdErr;
+        TArray<FString> Lines;
+        if (FPlatformProcess::ExecProcess(*ExecutablePath, TEXT("--version"), &ReturnCode, &StdOut, &StdErr) && ReturnCode == 0)
+        {
+            StdOut.ParseIntoArrayLines(Lines);
+        }
+
+        if (Lines.Num() > 0 && Lines[0].StartsWith(TEXT("Blender ")))
+        {
+            Version = Lines[0].TrimStartAndEnd();
+            UE_LOG(LogBlendImporter, Log, TEXT("Using %s from \"%s\""), *Version, *ExecutablePath);
+            FFileHelper::SaveStringToFile(Version, *VersionFilename);
+        }
+        else
+        {
+            // Only remembered for this session, so a fixed install is picked up next time even if the executable itself is unchanged
+            UE_LOG(LogBlendImporter, Warning, TEXT("\"%s\" doesn't appear to be Blender, running it with --version returned %d: %s"), *ExecutablePath, ReturnCode, *StdOut.Left(200));
+        }
+    }
+
+    Version.TrimStartAndEndInline();
+    FScopeLock Lock(&VersionLock);
+    BlenderVersions.Add(ExecutableId, Version);
+    return Version;
+}
+
 bool UBlendImporterSettings::IsRunInBackground() const
 {
     return bRunInBackground;
@@ -94,21 +260,115 @@ bool UBlendImporterSettings::IsFixMaterials() const
     return bFixMaterials;
 }
 
+bool UBlendImporterSettings::IsUsePersistentWorker() const
+{
+    // The worker is driven over stdin, which isn't possible with Blender's UI open
+    return bUsePersistentWorker && bRunInBackground;
+}
+
+bool UBlendImporterSettings::IsSpeculativeExport() const
+{
+    return bSpeculativeExport;
+}
+
+bool UBlendImporterSettings::IsBackgroundImport() const
+{
+    return bBackgroundImport;
+}
+
+bool UBlendImporterSettings::IsNativeAnalysis() const
+{
+    return bNativeAnalysis;
+}
+
+bool UBlendImporterSettings::IsDirectMeshTransfer() const
+{
+    return bDirectMeshTransfer;
+}
+
+bool UBlendImporterSettings::IsInstanceLinkedDuplicates() const
+{
+    return bDirectMeshTransfer && bInstanceLinkedDuplicates;
+}
+
+bool UBlendImporterSettings::IsPlaceInstancesInLevel() const
+{
+    return IsInstanceLinkedDuplicates() && bPlaceInstancesInLevel;
+}
+
+bool UBlendImporterSettings::IsExtractPackedTextures() const
+{
+    return bExtractPackedTextures;
+}
+
+FString UBlendImporterSettings::GetTextureCacheDirectory() const
+{
+    return FPaths::Combine(GetExportCacheDirectory(), TEXT("Textures"));
+}
+
+bool UBlendImporterSettings::IsUseMasterMaterials() const
+{
+    return bUseMasterMaterials;
+}
+
+FString UBlendImporterSettings::GetMasterMaterialDirectory() const
+{
+    if (MasterMaterialDirectory.Path.IsEmpty())
+    {
+        return TEXT("/Game/BlendImporter/Materials");
+    }
+    return MasterMaterialDirectory.Path;
+}
+
+bool UBlendImporterSettings::IsUseExportCache() const
+{
+    return bUseExportCache;
+}
+
+FString UBlendImporterSettings::GetExportCacheDirectory() const
+{
+    if (ExportCacheDirectory.Path.IsEmpty())
+    {
+        return FPaths::ConvertRelativePathToFull(FPaths::Combine(FPaths::ProjectDir(), TEXT("DerivedDataCache"), TEXT("BlendImporter")));
+    }
+    return FPaths::ConvertRelativePathToFull(FPaths::ProjectDir(), ExportCacheDirectory.Path);
+}
+
+int64 UBlendImporterSettings::GetExportCacheSizeLimit() const
+{
+    return static_cast<int64>(FMath::Max(ExportCacheSizeLimitMB, 0)) * 1024 * 1024;
+}
+
+int32 UBlendImporterSettings::GetMaxConcurrentBlenderProcesses() const
+{
+    return MaxConcurrentBlenderProcesses;
+}
+
+bool UBlendImporterSettings::IsWatchSourceFiles() const
+{
+    // Without the cache, the exports would be thrown away before anything imported them
+    return bWatchSourceFiles && bUseExportCache;
+}
+
+bool UBlendImporterSettings::IsReimportChangedSourceFiles() const
+{
+    return IsWatchSourceFiles() && bReimportChangedSourceFiles;
+}
+
+double UBlendImporterSettings::GetSourceFileSettleTime() const
+{
+    return FMath::Max(SourceFileSettleTime, 0.0);
+}
+
 void UBlendImporterSettings::PostInitProperties()
 {
     Super::PostInitProperties();
 
-    // On Windows, attempt to use registry to find the default Blender installation. If this fails, user can just set manually later.
-    #if PLATFORM_WINDOWS
-        if (BlenderExecutable.FilePath.IsEmpty())
-        {
-            FString BlenderPath;
-            if (ReadRegistryValue(HKEY_LOCAL_MACHINE, TEXT("SOFTWARE\\Classes\\blendfile\\shell\\open\\command"), TEXT(""), BlenderPath))
-            {
-                BlenderExecutable.FilePath = BlenderPath;
-            }
-        }
-    #endif
+    // Attempt to find the default Blender installation. If this fails, user can just set manually later.
+    if (BlenderExecutable.FilePath.IsEmpty())
+    {
+        BlenderExecutable.FilePath = FindBlenderExecutable();
+    }
 
     SanitizeBlenderPathInline(BlenderExecutable.FilePath);
 }
@@ -117,17 +377,33 @@ void UBlendImporterSettings::PostEditChangeProperty( struct FPropertyChangedEven
 {
     Super::PostEditChangeProperty(PropertyChangedEvent);
     SanitizeBlenderPathInline(BlenderExecutable.FilePath);
+
+    if (FBlendSourceWatcher* SourceWatcher = FBlendImporterModule::Get().GetSourceWatcher())
+    {
+        SourceWatcher->Refresh();
+    }
 }
 
 void UBlendImporterSettings::SanitizeBlenderPathInline(FString& Path)
 {
+    // The registry's open command has arguments after the executable
     int exeIdx = Path.Find(TEXT(".exe"));
-    Path.LeftInline(exeIdx + 4);
+    if (exeIdx != INDEX_NONE)
+    {
+        Path.LeftInline(exeIdx + 4);
+    }
 
     Path.TrimStartAndEndInline();
     Path.TrimQuotesInline();
     Path.TrimStartAndEndInline();
 
+    // The app bundle is what gets picked on macOS, but the executable is inside it
+    Path.RemoveFromEnd(TEXT("/"));
+    if (Path.EndsWith(TEXT(".app")))
+    {
+        Path = FPaths::Combine(Path, TEXT("Contents/MacOS/Blender"));
+    }
+
     if (Path.EndsWith(TEXT("-launcher.exe")))
     {
         UE_LOG(LogBlendImporter, Log, TEXT("Tried to set executable path to blender-launcher.exe, automatically modifying to blender.exe."));
@@ -14,12 +14,35 @@ class UBlendImporterSettings : public UObject
 public:
 	UBlendImporterSettings(const FObjectInitializer& obj);
 
-	FFilePath GetBlenderExecutable() const;
+	FFilePath GetBlenderExecutable(bool bPromptIfInvalid = true) const;
+
+	/** The version Blender reports, e.g. "Blender 3.3.1", or empty if the executable isn't Blender. Blender is only run once per executable to find out. */
+	FString GetBlenderVersion() const;
+	static FString GetBlenderVersion(const FString& ExecutablePath);
+
 	bool IsRunInBackground() const;
 	bool IsDebug() const;
 	bool IsFactoryStartup() const;
 	bool IsFixMaterials() const;
+	bool IsUsePersistentWorker() const;
+	bool IsSpeculativeExport() const;
+	bool IsBackgroundImport() const;
+	bool IsNativeAnalysis() const;
+	bool IsDirectMeshTransfer() const;
+	bool IsInstanceLinkedDuplicates() const;
+	bool IsPlaceInstancesInLevel() const;
+	bool IsExtractPackedTextures() const;
+	bool IsUseMasterMaterials() const;
+	FString GetMasterMaterialDirectory() const;
+	FString GetTextureCacheDirectory() const;
+	bool IsUseExportCache() const;
+	FString GetExportCacheDirectory() const;
+	int64 GetExportCacheSizeLimit() const;
+	int32 GetMaxConcurrentBlenderProcesses() const;
 	double GetUnresponsiveWarningDuration() const;
+	bool IsWatchSourceFiles() const;
+	bool IsReimportChangedSourceFiles() const;
+	double GetSourceFileSettleTime() const;
 
 	virtual void PostInitProperties() override;
 	virtual void PostEditChangeProperty( struct FPropertyChangedEvent& PropertyChangedEvent) override;
@@ -28,8 +51,8 @@ private:
 	void SanitizeBlenderPathInline(FString& Path);
 
 private:
-	/** Path to your Blender executable. */
-	UPROPERTY(Config, EditAnywhere, Category="External Tools", meta=(FilePathFilter = "exe", DisplayName = "Blender Executable Path"))
+	/** Path to your Blender executable (blender.exe on Windows, blender on Linux, or Blender.app on macOS). Found from PATH and the usual install locations if not set. */
+	UPROPERTY(Config, EditAnywhere, Category="External Tools", meta=(DisplayName = "Blender Executable Path"))
 	FFilePath BlenderExecutable;
 
 	/** Run Blender in background mode (no-UI)? This is preferred but may cause issues with some Blender setups. */
@@ -40,10 +63,78 @@ private:
 	UPROPERTY(Config, EditAnywhere, Category="Options", meta=(DisplayName = "Fix Materials"))
 	bool bFixMaterials = true;
 
-	/** How long (in seconds) before considering a running Blender process unresponsive? */
+	/** Keep a Blender process running between imports, avoiding Blender's startup time on every import. Requires running Blender in background. */
+	UPROPERTY(Config, EditAnywhere, Category="Options", meta=(DisplayName = "Use Persistent Blender Worker", EditCondition = "bRunInBackground"))
+	bool bUsePersistentWorker = true;
+
+	/** Start exporting with the default options while the import options dialog is open, which is used if those options are kept. */
+	UPROPERTY(Config, EditAnywhere, Category="Options", meta=(DisplayName = "Export While Showing Import Options"))
+	bool bSpeculativeExport = true;
+
+	/** Export new imports in the background once their options are chosen, so the editor can be used while Blender runs. The imported assets appear when each export finishes. */
+	UPROPERTY(Config, EditAnywhere, Category="Options", meta=(DisplayName = "Import In Background"))
+	bool bBackgroundImport = true;
+
+	/** Read collections and materials directly from the .blend file instead of launching Blender to analyse it. Blender is still used for files this can't read. */
+	UPROPERTY(Config, EditAnywhere, Category="Options", meta=(DisplayName = "Analyse Without Blender"))
+	bool bNativeAnalysis = true;
+
+	/** Transfer static meshes from Blender as raw mesh data instead of FBX, building them directly. Materials aren't created this way, existing materials with matching names are used. Files with armatures or animations still use FBX, as do imports with the FBX import option Combine Meshes turned off. */
+	UPROPERTY(Config, EditAnywhere, Category="Options", meta=(DisplayName = "Direct Mesh Transfer (Experimental)"))
+	bool bDirectMeshTransfer = false;
+
+	/** With direct mesh transfer, objects sharing a mesh (linked duplicates) are imported as one static mesh per shared mesh, instead of being merged into the imported mesh. */
+	UPROPERTY(Config, EditAnywhere, Category="Options", meta=(DisplayName = "Instance Linked Duplicates", EditCondition = "bDirectMeshTransfer"))
+	bool bInstanceLinkedDuplicates = true;
+
+	/** Also place the instances of linked duplicates in the current level, as one actor per import. Only for imports through the import dialog, reimports leave the level as it is. */
+	UPROPERTY(Config, EditAnywhere, Category="Options", meta=(DisplayName = "Place Instances In Level", EditCondition = "bDirectMeshTransfer && bInstanceLinkedDuplicates"))
+	bool bPlaceInstancesInLevel = false;
+
+	/** Write packed textures to files named by their contents in the export cache directory, for the FBX to reference instead of embedding them. Identical textures in several .blend files are only written once. */
+	UPROPERTY(Config, EditAnywhere, Category="Options", meta=(DisplayName = "Extract Packed Textures"))
+	bool bExtractPackedTextures = true;
+
+	/** Import materials made of a Principled BSDF with image textures as instances of a few master materials, so importing them doesn't compile new shaders. Other materials are imported from the FBX as before. */
+	UPROPERTY(Config, EditAnywhere, Category="Materials", meta=(DisplayName = "Use Master Materials"))
+	bool bUseMasterMaterials = true;
+
+	/** Where the master materials are created the first time they're needed. They're kept in the project so the instances can be cooked. */
+	UPROPERTY(Config, EditAnywhere, Category="Materials", meta=(DisplayName = "Master Material Directory", ContentDir, EditCondition = "bUseMasterMaterials"))
+	FDirectoryPath MasterMaterialDirectory;
+
+	/** Keep exported FBX files in a cache, so unchanged files are imported without running Blender, including after restarting the editor. */
+	UPROPERTY(Config, EditAnywhere, Category="Export Cache", meta=(DisplayName = "Use Export Cache"))
+	bool bUseExportCache = true;
+
+	/** Where to keep cached exports. Defaults to the project's DerivedDataCache folder. Can be a directory shared between workstations. */
+	UPROPERTY(Config, EditAnywhere, Category="Export Cache", meta=(DisplayName = "Export Cache Directory", EditCondition = "bUseExportCache"))
+	FDirectoryPath ExportCacheDirectory;
+
+	/** The least recently used exports are removed once the cache grows beyond this size (in MB). */
+	UPROPERTY(Config, EditAnywhere, Category="Export Cache", meta=(DisplayName = "Export Cache Size Limit (MB)", EditCondition = "bUseExportCache", ClampMin = "0"))
+	int32 ExportCacheSizeLimitMB = 4096;
+
+	/** How many Blender processes to run at once when importing multiple files. 0 picks based on the number of CPU cores, memory permitting. */
+	UPROPERTY(Config, EditAnywhere, Category="Options", meta=(DisplayName = "Max Concurrent Blender Processes", ClampMin = "0"))
+	int32 MaxConcurrentBlenderProcesses = 0;
+
+	/** How long (in seconds) a Blender process runs before the import shows a progress dialog that can cancel it */
 	UPROPERTY(Config, EditAnywhere, Category="Options", meta=(DisplayName = "Unresponsive Warning Duration (s)"))
 	double UnresponsiveWarningDuration = 15.0;
 
+	/** Watch the .blend files assets were imported from, and export them into the export cache when they're saved, so reimporting them doesn't wait for Blender. Needs the export cache. */
+	UPROPERTY(Config, EditAnywhere, Category="Auto Reimport", meta=(DisplayName = "Export Changed Source Files", EditCondition = "bUseExportCache"))
+	bool bWatchSourceFiles = false;
+
+	/** Also reimport the assets from a changed .blend file once it's exported. Not while playing in the editor. */
+	UPROPERTY(Config, EditAnywhere, Category="Auto Reimport", meta=(DisplayName = "Reimport Changed Source Files", EditCondition = "bWatchSourceFiles && bUseExportCache"))
+	bool bReimportChangedSourceFiles = false;
+
+	/** How long (in seconds) a .blend file must go unchanged before it's exported, so several saves in a row only export it once. */
+	UPROPERTY(Config, EditAnywhere, Category="Auto Reimport", meta=(DisplayName = "Settle Time (s)", EditCondition = "bWatchSourceFiles", ClampMin = "0"))
+	double SourceFileSettleTime = 2.0;
+
 	/** Runs Blender in debug mode, increasing debug output for problems. Enable this is if you are having issues. */
 	UPROPERTY(Config, EditAnywhere, Category="Debug", meta=(DisplayName = "Blender - Debug mode"))
 	bool bDebug = false;
@@ -0,0 +1,89 @@
+// Copyright 2022 nuclearfriend
+
+#include "BlendInstancedActors.h"
+#include "BlendImporter.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Editor.h"
+#include "Engine/StaticMesh.h"
+#include "EngineUtils.h"
+#include "ScopedTransaction.h"
+
+#define LOCTEXT_NAMESPACE "BlendInstancedActors"
+
+AActor* FBlendInstancedActors::PlaceInstances(const FString& ImportPath, const FString& Label, const TArray<FBlendInstancedMesh>& Meshes)
+{
+    UWorld* World = GEditor ? GEditor->GetEditorWorldContext().World() : nullptr;
+    if (World == nullptr)
+    {
+        return nullptr;
+    }
+
+    const FScopedTransaction Transaction(FText::Format(LOCTEXT("PlaceInstances", "Place Instances of {0}"), FText::FromString(Label)));
+
+    const FName Tag(*(TEXT("BlendImport:") + ImportPath));
+    AActor* Actor = FindActor(World, Tag);
+    if (Actor)
+    {
+        // Rebuilt from scratch, as meshes can have been added or removed, and instances moved
+        Actor->Modify();
+        TInlineComponentArray<UHierarchicalInstancedStaticMeshComponent*> Components(Actor);
+        for (UHierarchicalInstancedStaticMeshComponent* Component : Components)
+        {
+            Actor->RemoveInstanceComponent(Component);
+            Component->DestroyComponent();
+        }
+    }
+    else
+    {
+        Actor = World->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity);
+        if (Actor == nullptr)
+        {
+            UE_LOG(LogBlendImporter, Warning, TEXT("Could not add an actor for the instances of '%s' to the level"), *Label);
+            return nullptr;
+        }
+
+        USceneComponent* Root = NewObject<USceneComponent>(Actor, TEXT("Root"), RF_Transactional);
+        Actor->SetRootComponent(Root);
+        Actor->AddInstanceComponent(Root);
+        Root->RegisterComponent();
+
+        Actor->SetActorLabel(Label);
+        Actor->Tags.Add(Tag);
+    }
+
+    int32 NumInstances = 0;
+    for (const FBlendInstancedMesh& InstancedMesh : Meshes)
+    {
+        const FName ComponentName = MakeUniqueObjectName(Actor, UHierarchicalInstancedStaticMeshComponent::StaticClass(), InstancedMesh.Mesh->GetFName());
+        UHierarchicalInstancedStaticMeshComponent* Component = NewObject<UHierarchicalInstancedStaticMeshComponent>(Actor, ComponentName, RF_Transactional);
+        Component->SetStaticMesh(InstancedMesh.Mesh);
+        Component->SetupAttachment(Actor->GetRootComponent());
+        Actor->AddInstanceComponent(Component);
+        Component->RegisterComponent();
+
+        for (const FTransform& Transform : InstancedMesh.Transforms)
+        {
+            Component->AddInstance(Transform);
+        }
+        NumInstances += InstancedMesh.Transforms.Num();
+    }
+
+    Actor->MarkPackageDirty();
+
+    UE_LOG(LogBlendImporter, Log, TEXT("Placed %d instances of %d meshes in '%s'"), NumInstances, Meshes.Num(), *Actor->GetActorLabel());
+    return Actor;
+}
+
+AActor* FBlendInstancedActors::FindActor(UWorld* World, FName Tag)
+{
+    for (TActorIterator<AActor> It(World); It; ++It)
+    {
+        if (It->ActorHasTag(Tag))
+        {
+            return *It;
+        }
+    }
+    return nullptr;
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,30 @@
+// Copyright 2022 nuclearfriend
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class AActor;
+class UStaticMesh;
+class UWorld;
+
+/** A static mesh made from a mesh shared by several Blender objects (linked duplicates), and the transform of each of those objects */
+struct FBlendInstancedMesh
+{
+	UStaticMesh* Mesh = nullptr;
+	TArray<FTransform> Transforms;
+};
+
+/**
+ * Places linked duplicates in the editor's level as instances, instead of a static mesh per object. Can be undone.
+ * Each import gets one actor, with a hierarchical instanced static mesh component per shared mesh, found again by a tag when the file is imported to the same place again.
+ */
+class FBlendInstancedActors
+{
+public:
+	/** Creates or rebuilds the actor for the import. ImportPath identifies the import, Label names a new actor. */
+	static AActor* PlaceInstances(const FString& ImportPath, const FString& Label, const TArray<FBlendInstancedMesh>& Meshes);
+
+private:
+	static AActor* FindActor(UWorld* World, FName Tag);
+};
@@ -0,0 +1,386 @@
+// Copyright 2022 nuclearfriend
+
+#include "BlendMasterMaterials.h"
+#include "BlendFileAnalysis.h"
+#include "BlendImporter.h"
+#include "BlendImporterSettings.h"
+#include "Algo/Find.h"
+#include "AssetImportTask.h"
+#include "AssetRegistryModule.h"
+#include "AssetToolsModule.h"
+#include "Engine/Texture2D.h"
+#include "Factories/MaterialFactoryNew.h"
+#include "Factories/MaterialInstanceConstantFactoryNew.h"
+#include "FileHelpers.h"
+#include "MaterialEditingLibrary.h"
+#include "Materials/Material.h"
+#include "Materials/MaterialExpressionLinearInterpolate.h"
+#include "Materials/MaterialExpressionMultiply.h"
+#include "Materials/MaterialExpressionScalarParameter.h"
+#include "Materials/MaterialExpressionTextureSampleParameter2D.h"
+#include "Materials/MaterialExpressionVectorParameter.h"
+#include "Materials/MaterialInstanceConstant.h"
+#include "ObjectTools.h"
+
+/** A master material parameter, set from the Principled BSDF input of the same name in FBlendMaterialTemplate */
+struct FMasterParameter
+{
+    const TCHAR* Name;
+    bool bColor;
+    FLinearColor DefaultValue;
+    /** The texture channel(s) blended with the value */
+    const TCHAR* TextureOutput;
+    EMaterialProperty Property;
+};
+
+static const FMasterParameter MasterParameters[] =
+{
+    { TEXT("BaseColor"), true, FLinearColor::White, TEXT("RGB"), MP_BaseColor },
+    { TEXT("Metallic"), false, FLinearColor(0.0f, 0.0f, 0.0f), TEXT("R"), MP_Metallic },
+    { TEXT("Roughness"), false, FLinearColor(0.5f, 0.5f, 0.5f), TEXT("R"), MP_Roughness },
+    { TEXT("Normal"), true, FLinearColor(0.0f, 0.0f, 1.0f), TEXT("RGB"), MP_Normal },
+    { TEXT("EmissiveColor"), true, FLinearColor::Black, TEXT("RGB"), MP_EmissiveColor },
+    { TEXT("Opacity"), false, FLinearColor::White, TEXT("A"), MP_Opacity },
+};
+
+template<typename ObjectType>
+static ObjectType* LoadAsset(const FString& PackagePath, const FString& Name)
+{
+    return LoadObject<ObjectType>(nullptr, *(PackagePath / Name + TEXT(".") + Name), nullptr, LOAD_NoWarn | LOAD_Quiet);
+}
+
+int32 FBlendMasterMaterials::CreateInstances(const TArray<FBlendMaterialTemplate>& Templates, const FString& PackagePath, TArray<UObject*>& OutCreatedAssets)
+{
+    int32 NumInPackage = 0;
+
+    // Textures for all the new instances are imported in one go
+    TArray<const FBlendMaterialTemplate*> NewTemplates;
+    TMap<FString, ETextureUsage> TextureFilenames;
+    for (const FBlendMaterialTemplate& Template : Templates)
+    {
+        const FString Name = ObjectTools::SanitizeObjectName(Template.MaterialName);
+        if (UObject* Existing = LoadAsset<UObject>(PackagePath, Name))
+        {
+            NumInPackage += Existing->IsA<UMaterialInterface>() ? 1 : 0;
+            continue;
+        }
+
+        TMap<FString, ETextureUsage> Filenames;
+        bool bFoundTextures = true;
+        for (const TPair<FString, FBlendTemplateTexture>& Texture : Template.Textures)
+        {
+            const FString Filename = ResolveTextureFilename(Texture.Value);
+            if (Filename.IsEmpty())
+            {
+                UE_LOG(LogBlendImporter, Log, TEXT("Importing material %s from the FBX, as its %s texture wasn't found"), *Template.MaterialName, *Texture.Key);
+                bFoundTextures = false;
+                break;
+            }
+            Filenames.Add(Filename, GetTextureUsage(Texture.Key));
+        }
+
+        if (bFoundTextures)
+        {
+            NewTemplates.Add(&Template);
+            for (const TPair<FString, ETextureUsage>& Filename : Filenames)
+            {
+                if (!TextureFilenames.Contains(Filename.Key))
+                {
+                    TextureFilenames.Add(Filename.Key, Filename.Value);
+                }
+            }
+        }
+    }
+
+    const TMap<FString, UTexture*> Textures = FindOrImportTextures(TextureFilenames, PackagePath, OutCreatedAssets);
+
+    IAssetTools& AssetTools = FModuleManager::LoadModuleChecked<FAssetToolsModule>("AssetTools").Get();
+    for (const FBlendMaterialTemplate* Template : NewTemplates)
+    {
+        UMaterial* Master = FindOrCreateMaster(Template->Template);
+        if (!Master)
+        {
+            continue;
+        }
+
+        UMaterialInstanceConstantFactoryNew* Factory = NewObject<UMaterialInstanceConstantFactoryNew>();
+        Factory->InitialParent = Master;
+        UMaterialInstanceConstant* Instance = Cast<UMaterialInstanceConstant>(AssetTools.CreateAsset(ObjectTools::SanitizeObjectName(Template->MaterialName), PackagePath, UMaterialInstanceConstant::StaticClass(), Factory));
+        if (!Instance)
+        {
+            continue;
+        }
+
+        for (const TPair<FString, FLinearColor>& Color : Template->Colors)
+        {
+            UMaterialEditingLibrary::SetMaterialInstanceVectorParameterValue(Instance, *Color.Key, Color.Value);
+        }
+        for (const TPair<FString, float>& Scalar : Template->Scalars)
+        {
+            UMaterialEditingLibrary::SetMaterialInstanceScalarParameterValue(Instance, *Scalar.Key, Scalar.Value);
+        }
+        for (const TPair<FString, FBlendTemplateTexture>& Texture : Template->Textures)
+        {
+            UTexture* const* ImportedTexture = Textures.Find(ResolveTextureFilename(Texture.Value));
+            if (ImportedTexture && *ImportedTexture)
+            {
+                UMaterialEditingLibrary::SetMaterialInstanceTextureParameterValue(Instance, *(Texture.Key + TEXT("Texture")), *ImportedTexture);
+                UMaterialEditingLibrary::SetMaterialInstanceScalarParameterValue(Instance, *(Texture.Key + TEXT("TextureAmount")), 1.0f);
+            }
+        }
+        UMaterialEditingLibrary::UpdateMaterialInstance(Instance);
+
+        OutCreatedAssets.Add(Instance);
+        NumInPackage++;
+    }
+
+    return NumInPackage;
+}
+
+UMaterial* FBlendMasterMaterials::FindOrCreateMaster(const FString& Template)
+{
+    const FString Directory = GetDefault<UBlendImporterSettings>()->GetMasterMaterialDirectory();
+    const FString Name = TEXT("M_Blend") + Template;
+    if (UMaterial* Existing = LoadAsset<UMaterial>(Directory, Name))
+    {
+        return Existing;
+    }
+
+    EBlendMode BlendMode = BLEND_Opaque;
+    if (Template == TEXT("Masked"))
+    {
+        BlendMode = BLEND_Masked;
+    }
+    else if (Template == TEXT("Translucent"))
+    {
+        BlendMode = BLEND_Translucent;
+    }
+    else if (Template != TEXT("Opaque"))
+    {
+        UE_LOG(LogBlendImporter, Warning, TEXT("Unknown material template %s"), *Template);
+        return nullptr;
+    }
+
+    IAssetTools& AssetTools = FModuleManager::LoadModuleChecked<FAssetToolsModule>("AssetTools").Get();
+    UMaterial* Master = Cast<UMaterial>(AssetTools.CreateAsset(Name, Directory, UMaterial::StaticClass(), NewObject<UMaterialFactoryNew>()));
+    if (!Master)
+    {
+        UE_LOG(LogBlendImporter, Error, TEXT("Failed to create master material %s in %s"), *Name, *Directory);
+        return nullptr;
+    }
+
+    Master->BlendMode = BlendMode;
+    if (BlendMode == BLEND_Masked)
+    {
+        // Blender's default alpha clip threshold
+        Master->OpacityMaskClipValue = 0.5f;
+    }
+
+    int32 Row = 0;
+    for (const FMasterParameter& Parameter : MasterParameters)
+    {
+        if (Parameter.Property != MP_Opacity || BlendMode != BLEND_Opaque)
+        {
+            AddParameter(Master, Parameter.Name, Row++);
+        }
+    }
+    UMaterialEditingLibrary::RecompileMaterial(Master);
+
+    // Saved straight away, as every instance depends on it
+    SavePackages({ Master });
+    UE_LOG(LogBlendImporter, Log, TEXT("Created master material %s"), *Master->GetPathName());
+    return Master;
+}
+
+FBlendMasterMaterials::ETextureUsage FBlendMasterMaterials::GetTextureUsage(const FString& Parameter)
+{
+    if (Parameter == TEXT("Normal"))
+    {
+        return ETextureUsage::Normal;
+    }
+    if (Parameter == TEXT("Metallic") || Parameter == TEXT("Roughness"))
+    {
+        return ETextureUsage::Linear;
+    }
+    return ETextureUsage::Color;
+}
+
+FString FBlendMasterMaterials::ResolveTextureFilename(const FBlendTemplateTexture& Texture)
+{
+    if (Texture.PackedHash.IsEmpty())
+    {
+        return FPaths::FileExists(Texture.Filename) ? Texture.Filename : FString();
+    }
+
+    // Extracted by the export with the image's own extension, see ExtractPackedImages in blender_export.py
+    const FString TextureCacheDirectory = GetDefault<UBlendImporterSettings>()->GetTextureCacheDirectory();
+    TArray<FString> Found;
+    IFileManager::Get().FindFiles(Found, *FPaths::Combine(TextureCacheDirectory, TEXT("T_") + Texture.PackedHash + TEXT(".*")), true, false);
+    Found.RemoveAll([](const FString& Filename) { return Filename.EndsWith(TEXT(".tmp")); });
+    return Found.Num() > 0 ? FPaths::Combine(TextureCacheDirectory, Found[0]) : FString();
+}
+
+TMap<FString, UTexture*> FBlendMasterMaterials::FindOrImportTextures(const TMap<FString, ETextureUsage>& Filenames, const FString& PackagePath, TArray<UObject*>& OutCreatedAssets)
+{
+    TMap<FString, UTexture*> Textures;
+
+    // Named after the file like the FBX importer names textures, so either importer uses the other's textures rather than importing them again
+    TArray<UAssetImportTask*> ImportTasks;
+    TArray<TPair<FString, ETextureUsage>> ImportedFilenames;
+    for (const TPair<FString, ETextureUsage>& Filename : Filenames)
+    {
+        const FString Name = ObjectTools::SanitizeObjectName(FPaths::GetBaseFilename(Filename.Key));
+        if (UTexture* Existing = LoadAsset<UTexture>(PackagePath, Name))
+        {
+            Textures.Add(Filename.Key, Existing);
+            continue;
+        }
+
+        UAssetImportTask* ImportTask = NewObject<UAssetImportTask>();
+        ImportTask->Filename = Filename.Key;
+        ImportTask->DestinationPath = PackagePath;
+        ImportTask->DestinationName = Name;
+        ImportTask->bAutomated = true;
+        ImportTask->bReplaceExisting = false;
+        ImportTask->bSave = false;
+        ImportTasks.Add(ImportTask);
+        ImportedFilenames.Add(Filename);
+    }
+
+    if (ImportTasks.Num() == 0)
+    {
+        return Textures;
+    }
+
+    IAssetTools& AssetTools = FModuleManager::LoadModuleChecked<FAssetToolsModule>("AssetTools").Get();
+    AssetTools.ImportAssetTasks(ImportTasks);
+
+    for (int32 Index = 0; Index < ImportTasks.Num(); Index++)
+    {
+        UTexture* Texture = ImportTasks[Index]->ImportedObjectPaths.Num() > 0 ? LoadObject<UTexture>(nullptr, *ImportTasks[Index]->ImportedObjectPaths[0]) : nullptr;
+        if (!Texture)
+        {
+            UE_LOG(LogBlendImporter, Warning, TEXT("Failed to import texture '%s'"), *ImportedFilenames[Index].Key);
+            continue;
+        }
+
+        // Blender reads these as non-color data
+        if (ImportedFilenames[Index].Value != ETextureUsage::Color)
+        {
+            Texture->SRGB = false;
+            if (ImportedFilenames[Index].Value == ETextureUsage::Normal)
+            {
+                Texture->CompressionSettings = TC_Normalmap;
+                Texture->LODGroup = TEXTUREGROUP_WorldNormalMap;
+            }
+            Texture->PostEditChange();
+        }
+
+        Textures.Add(ImportedFilenames[Index].Key, Texture);
+        OutCreatedAssets.Add(Texture);
+    }
+    return Textures;
+}
+
+UTexture* FBlendMasterMaterials::FindOrCreateDefaultTexture(ETextureUsage Usage)
+{
+    const FString Directory = GetDefault<UBlendImporterSettings>()->GetMasterMaterialDirectory();
+    const FString Name = Usage == ETextureUsage::Normal ? TEXT("T_BlendDefaultNormal") : Usage == ETextureUsage::Linear ? TEXT("T_BlendDefaultLinear") : TEXT("T_BlendDefaultColor");
+    if (UTexture* Existing = LoadAsset<UTexture>(Directory, Name))
+    {
+        return Existing;
+    }
+
+    // A tiny texture of the right kind for each sampler type, as samplers must be given a texture matching their type
+    UPackage* Package = CreatePackage(*(Directory / Name));
+    UTexture2D* Texture = NewObject<UTexture2D>(Package, *Name, RF_Public | RF_Standalone);
+
+    TArray<FColor> Pixels;
+    Pixels.Init(Usage == ETextureUsage::Normal ? FColor(128, 128, 255) : FColor::White, 4 * 4);
+    Texture->Source.Init(4, 4, 1, 1, TSF_BGRA8, reinterpret_cast<const uint8*>(Pixels.GetData()));
+    Texture->SRGB = Usage == ETextureUsage::Color;
+    if (Usage == ETextureUsage::Normal)
+    {
+        Texture->CompressionSettings = TC_Normalmap;
+        Texture->LODGroup = TEXTUREGROUP_WorldNormalMap;
+    }
+    Texture->PostEditChange();
+
+    FAssetRegistryModule::AssetCreated(Texture);
+    Package->MarkPackageDirty();
+    SavePackages({ Texture });
+    return Texture;
+}
+
+void FBlendMasterMaterials::AddParameter(UMaterial* Master, const FString& ParameterName, int32 Row)
+{
+    const FMasterParameter* Parameter = Algo::FindByPredicate(MasterParameters, [&ParameterName](const FMasterParameter& Candidate) { return ParameterName == Candidate.Name; });
+    if (!Parameter)
+    {
+        return;
+    }
+
+    const int32 Y = Row * 400;
+    const ETextureUsage Usage = GetTextureUsage(ParameterName);
+
+    // Lerp(Value, Texture, TextureAmount), so instances pick the value or the texture without a static switch
+    UMaterialExpression* Value = nullptr;
+    if (Parameter->bColor)
+    {
+        UMaterialExpressionVectorParameter* VectorValue = Cast<UMaterialExpressionVectorParameter>(UMaterialEditingLibrary::CreateMaterialExpression(Master, UMaterialExpressionVectorParameter::StaticClass(), -800, Y));
+        VectorValue->ParameterName = *ParameterName;
+        VectorValue->DefaultValue = Parameter->DefaultValue;
+        VectorValue->Group = *ParameterName;
+        Value = VectorValue;
+    }
+    else
+    {
+        UMaterialExpressionScalarParameter* ScalarValue = Cast<UMaterialExpressionScalarParameter>(UMaterialEditingLibrary::CreateMaterialExpression(Master, UMaterialExpressionScalarParameter::StaticClass(), -800, Y));
+        ScalarValue->ParameterName = *ParameterName;
+        ScalarValue->DefaultValue = Parameter->DefaultValue.R;
+        ScalarValue->Group = *ParameterName;
+        Value = ScalarValue;
+    }
+
+    UMaterialExpressionTextureSampleParameter2D* Texture = Cast<UMaterialExpressionTextureSampleParameter2D>(UMaterialEditingLibrary::CreateMaterialExpression(Master, UMaterialExpressionTextureSampleParameter2D::StaticClass(), -800, Y + 100));
+    Texture->ParameterName = *(ParameterName + TEXT("Texture"));
+    Texture->Texture = FindOrCreateDefaultTexture(Usage);
+    Texture->SamplerType = Usage == ETextureUsage::Normal ? SAMPLERTYPE_Normal : Usage == ETextureUsage::Linear ? SAMPLERTYPE_LinearColor : SAMPLERTYPE_Color;
+    Texture->Group = *ParameterName;
+
+    UMaterialExpressionScalarParameter* TextureAmount = Cast<UMaterialExpressionScalarParameter>(UMaterialEditingLibrary::CreateMaterialExpression(Master, UMaterialExpressionScalarParameter::StaticClass(), -800, Y + 300));
+    TextureAmount->ParameterName = *(ParameterName + TEXT("TextureAmount"));
+    TextureAmount->DefaultValue = 0.0f;
+    TextureAmount->Group = *ParameterName;
+
+    UMaterialExpression* Lerp = UMaterialEditingLibrary::CreateMaterialExpression(Master, UMaterialExpressionLinearInterpolate::StaticClass(), -400, Y);
+    UMaterialEditingLibrary::ConnectMaterialExpressions(Value, FString(), Lerp, TEXT("A"));
+    UMaterialEditingLibrary::ConnectMaterialExpressions(Texture, Parameter->TextureOutput, Lerp, TEXT("B"));
+    UMaterialEditingLibrary::ConnectMaterialExpressions(TextureAmount, FString(), Lerp, TEXT("Alpha"));
+
+    UMaterialExpression* Output = Lerp;
+    if (Parameter->Property == MP_EmissiveColor)
+    {
+        UMaterialExpressionScalarParameter* Strength = Cast<UMaterialExpressionScalarParameter>(UMaterialEditingLibrary::CreateMaterialExpression(Master, UMaterialExpressionScalarParameter::StaticClass(), -400, Y + 150));
+        Strength->ParameterName = TEXT("EmissiveStrength");
+        Strength->DefaultValue = 1.0f;
+        Strength->Group = *ParameterName;
+
+        Output = UMaterialEditingLibrary::CreateMaterialExpression(Master, UMaterialExpressionMultiply::StaticClass(), -200, Y);
+        UMaterialEditingLibrary::ConnectMaterialExpressions(Lerp, FString(), Output, TEXT("A"));
+        UMaterialEditingLibrary::ConnectMaterialExpressions(Strength, FString(), Output, TEXT("B"));
+    }
+
+    const EMaterialProperty Property = Parameter->Property == MP_Opacity && Master->BlendMode == BLEND_Masked ? MP_OpacityMask : Parameter->Property;
+    UMaterialEditingLibrary::ConnectMaterialProperty(Output, FString(), Property);
+}
+
+void FBlendMasterMaterials::SavePackages(const TArray<UObject*>& Assets)
+{
+    TArray<UPackage*> Packages;
+    for (UObject* Asset : Assets)
+    {
+        Packages.AddUnique(Asset->GetOutermost());
+    }
+    UEditorLoadingAndSavingUtils::SavePackages(Packages, false);
+}
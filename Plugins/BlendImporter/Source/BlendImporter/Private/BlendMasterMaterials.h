@@ -0,0 +1,47 @@
+// Copyright 2022 nuclearfriend
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UMaterial;
+class UMaterialInstanceConstant;
+class UTexture;
+struct FBlendMaterialTemplate;
+struct FBlendTemplateTexture;
+
+/**
+ * The master materials for the material templates found by FBlendFileAnalysis, and the instances of them that materials are imported as.
+ * Each master parameter blends between a value and a texture by a scalar, rather than using static switches, so every instance of a master
+ * shares its shaders and importing them doesn't compile any.
+ */
+class FBlendMasterMaterials
+{
+public:
+	/**
+	 * Creates an instance in PackagePath for each template, named as the FBX importer would name the material so it uses the instance instead.
+	 * Materials that already have an asset there are left alone, as are templates with textures that can't be found.
+	 * Returns how many of the templates' materials are now in PackagePath.
+	 */
+	static int32 CreateInstances(const TArray<FBlendMaterialTemplate>& Templates, const FString& PackagePath, TArray<UObject*>& OutCreatedAssets);
+
+	/** The master material for a template (Opaque, Masked or Translucent), created in the settings' master material directory the first time it's needed */
+	static UMaterial* FindOrCreateMaster(const FString& Template);
+
+	/** Saves the assets' packages, for unattended imports that save what they import */
+	static void SavePackages(const TArray<UObject*>& Assets);
+
+private:
+	enum class ETextureUsage
+	{
+		Color,
+		Linear,
+		Normal
+	};
+
+	static ETextureUsage GetTextureUsage(const FString& Parameter);
+	static FString ResolveTextureFilename(const FBlendTemplateTexture& Texture);
+	static TMap<FString, UTexture*> FindOrImportTextures(const TMap<FString, ETextureUsage>& Filenames, const FString& PackagePath, TArray<UObject*>& OutCreatedAssets);
+	static UTexture* FindOrCreateDefaultTexture(ETextureUsage Usage);
+	static void AddParameter(UMaterial* Master, const FString& Parameter, int32 Row);
+};
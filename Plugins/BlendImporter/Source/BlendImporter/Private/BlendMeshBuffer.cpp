@@ -0,0 +1,512 @@
+// Copyright 2022 nuclearfriend
+
+#include "BlendMeshBuffer.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+#include "MeshDescription.h"
+#include "Misc/FileHelper.h"
+#include "Misc/SecureHash.h"
+#include "StaticMeshAttributes.h"
+
+#if ENGINE_MAJOR_VERSION >= 5
+	typedef FVector3f FMeshVector;
+	typedef FVector2f FMeshUV;
+	typedef FVector4f FMeshColor;
+#else
+	typedef FVector FMeshVector;
+	typedef FVector2D FMeshUV;
+	typedef FVector4 FMeshColor;
+#endif
+
+static const ANSICHAR MeshBufferMagic[8] = { 'B', 'L', 'M', 'E', 'S', 'H', 0, 0 };
+static const int64 MeshBufferHeaderSize = sizeof(MeshBufferMagic) + 2 * sizeof(uint32);
+
+// Blender's meters to Unreal's centimeters
+static const float MeshBufferScale = 100.0f;
+
+FBlendMeshBuffer::FBlendMeshBuffer()
+    : FileData(nullptr)
+    , FileSize(0)
+{
+}
+
+FBlendMeshBuffer::~FBlendMeshBuffer()
+{
+    // The mapped region must be released before the file handle it belongs to
+    MappedRegion.Reset();
+    MappedHandle.Reset();
+}
+
+bool FBlendMeshBuffer::IsMeshBuffer(const FString& Filename)
+{
+    TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*Filename, FILEREAD_Silent));
+    if (!Reader.IsValid() || Reader->TotalSize() < MeshBufferHeaderSize)
+    {
+        return false;
+    }
+
+    ANSICHAR Magic[sizeof(MeshBufferMagic)];
+    Reader->Serialize(Magic, sizeof(Magic));
+    return FMemory::Memcmp(Magic, MeshBufferMagic, sizeof(Magic)) == 0;
+}
+
+bool FBlendMeshBuffer::Open(const FString& Filename, FString& OutError)
+{
+    MappedHandle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*Filename));
+    if (MappedHandle.IsValid())
+    {
+        MappedRegion.Reset(MappedHandle->MapRegion(0, MappedHandle->GetFileSize()));
+    }
+
+    if (MappedRegion.IsValid())
+    {
+        FileData = MappedRegion->GetMappedPtr();
+        FileSize = MappedRegion->GetMappedSize();
+    }
+    else if (FFileHelper::LoadFileToArray(OwnedData, *Filename))
+    {
+        // Not every platform supports memory mapping files
+        FileData = OwnedData.GetData();
+        FileSize = OwnedData.Num();
+    }
+    else
+    {
+        OutError = TEXT("Could not open file");
+        return false;
+    }
+
+    if (FileSize < MeshBufferHeaderSize || FMemory::Memcmp(FileData, MeshBufferMagic, sizeof(MeshBufferMagic)) != 0)
+    {
+        OutError = TEXT("Not a mesh buffer");
+        return false;
+    }
+
+    uint32 FileVersion = 0;
+    FMemory::Memcpy(&FileVersion, FileData + sizeof(MeshBufferMagic), sizeof(uint32));
+    if (FileVersion != Version)
+    {
+        OutError = FString::Printf(TEXT("Mesh buffer version %u, expected %d"), FileVersion, Version);
+        return false;
+    }
+
+    return ParseObjects(OutError);
+}
+
+const TArray<FBlendMeshBufferObject>& FBlendMeshBuffer::GetObjects() const
+{
+    return Objects;
+}
+
+bool FBlendMeshBuffer::HasUninstancedObjects() const
+{
+    return Objects.ContainsByPredicate([](const FBlendMeshBufferObject& Object) { return Object.LODIndex == 0 && Object.InstanceTransforms.Num() == 0; });
+}
+
+bool FBlendMeshBuffer::HasTangents() const
+{
+    for (const FBlendMeshBufferObject& Object : Objects)
+    {
+        if (Object.Tangents.Num() == 0 && Object.NumCorners > 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FBlendMeshBuffer::ParseObjects(FString& OutError)
+{
+    int64 Offset = sizeof(MeshBufferMagic) + sizeof(uint32);
+
+    auto ReadUInt32 = [this, &Offset](uint32& OutValue)
+    {
+        if (Offset + static_cast<int64>(sizeof(uint32)) > FileSize)
+        {
+            return false;
+        }
+        FMemory::Memcpy(&OutValue, FileData + Offset, sizeof(uint32));
+        Offset += sizeof(uint32);
+        return true;
+    };
+
+    auto ReadString = [this, &Offset, &ReadUInt32](FString& OutString)
+    {
+        uint32 Length = 0;
+        if (!ReadUInt32(Length) || Offset + Length > FileSize)
+        {
+            return false;
+        }
+        FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(FileData + Offset), Length);
+        OutString = FString(Converted.Length(), Converted.Get());
+        Offset += Align(Length, 4);
+        return true;
+    };
+
+    // Arrays are used in place, which the script keeps 4 byte aligned
+    auto ReadArray = [this, &Offset](auto& OutView, int64 Num)
+    {
+        typedef typename TRemoveReference<decltype(OutView)>::Type::ElementType ElementType;
+        const int64 Size = Num * static_cast<int64>(sizeof(ElementType));
+        if (Num < 0 || Offset + Size > FileSize)
+        {
+            return false;
+        }
+        OutView = MakeArrayView(reinterpret_cast<const ElementType*>(FileData + Offset), static_cast<int32>(Num));
+        Offset += Size;
+        return true;
+    };
+
+    uint32 NumObjects = 0;
+    if (!ReadUInt32(NumObjects))
+    {
+        OutError = TEXT("Truncated header");
+        return false;
+    }
+
+    for (uint32 ObjectIndex = 0; ObjectIndex < NumObjects; ObjectIndex++)
+    {
+        uint32 Header[10];
+        for (uint32& Value : Header)
+        {
+            if (!ReadUInt32(Value))
+            {
+                OutError = TEXT("Truncated object header");
+                return false;
+            }
+        }
+
+        FBlendMeshBufferObject& Object = Objects.AddDefaulted_GetRef();
+        Object.NumVertices = static_cast<int32>(Header[0]);
+        Object.NumCorners = static_cast<int32>(Header[1]);
+        Object.NumTriangles = static_cast<int32>(Header[2]);
+        const uint32 NumUVChannels = Header[3];
+        const bool bHasColors = Header[4] != 0;
+        const bool bHasTangents = Header[5] != 0;
+        const uint32 NumMaterials = Header[6];
+        const uint32 NumInstances = Header[7];
+        Object.LODIndex = static_cast<int32>(Header[8]);
+        Object.BaseObjectIndex = static_cast<int32>(Header[9]);
+
+        bool bValid = ReadString(Object.Name) && NumUVChannels <= MAX_MESH_TEXTURE_COORDS_MD && NumMaterials > 0;
+        for (uint32 MaterialIndex = 0; bValid && MaterialIndex < NumMaterials; MaterialIndex++)
+        {
+            bValid = ReadString(Object.MaterialNames.AddDefaulted_GetRef());
+        }
+
+        bValid = bValid
+            && ReadArray(Object.Positions, static_cast<int64>(Object.NumVertices) * 3)
+            && ReadArray(Object.CornerVertices, Object.NumCorners)
+            && ReadArray(Object.Normals, static_cast<int64>(Object.NumCorners) * 3)
+            && (!bHasTangents || (ReadArray(Object.Tangents, static_cast<int64>(Object.NumCorners) * 3) && ReadArray(Object.BitangentSigns, Object.NumCorners)));
+
+        Object.UVs.SetNum(NumUVChannels);
+        for (uint32 Channel = 0; bValid && Channel < NumUVChannels; Channel++)
+        {
+            bValid = ReadArray(Object.UVs[Channel], static_cast<int64>(Object.NumCorners) * 2);
+        }
+
+        bValid = bValid
+            && (!bHasColors || ReadArray(Object.Colors, static_cast<int64>(Object.NumCorners) * 4))
+            && ReadArray(Object.TriangleCorners, static_cast<int64>(Object.NumTriangles) * 3)
+            && ReadArray(Object.TriangleMaterials, Object.NumTriangles)
+            && ReadArray(Object.InstanceTransforms, static_cast<int64>(NumInstances) * 16);
+
+        if (!bValid)
+        {
+            OutError = FString::Printf(TEXT("Object %u is truncated or malformed"), ObjectIndex);
+            return false;
+        }
+
+        // LODs follow their LOD 0 object, in order
+        if (Object.LODIndex == 0 ? Header[9] != ObjectIndex : (Header[9] >= ObjectIndex || NumInstances > 0))
+        {
+            OutError = FString::Printf(TEXT("Object '%s' has an invalid LOD base object"), *Object.Name);
+            return false;
+        }
+        FBlendMeshBufferObject& BaseObject = Objects[Object.BaseObjectIndex];
+        if (BaseObject.LODIndex != 0 || BaseObject.LODObjectIndices.Num() != Object.LODIndex)
+        {
+            OutError = FString::Printf(TEXT("Object '%s' is out of LOD order"), *Object.Name);
+            return false;
+        }
+        BaseObject.LODObjectIndices.Add(static_cast<int32>(ObjectIndex));
+
+        // Checked once here, so building the mesh can index without checks
+        for (const int32 Vertex : Object.CornerVertices)
+        {
+            if (Vertex < 0 || Vertex >= Object.NumVertices)
+            {
+                OutError = FString::Printf(TEXT("Object '%s' has an invalid vertex index"), *Object.Name);
+                return false;
+            }
+        }
+        for (const int32 Corner : Object.TriangleCorners)
+        {
+            if (Corner < 0 || Corner >= Object.NumCorners)
+            {
+                OutError = FString::Printf(TEXT("Object '%s' has an invalid corner index"), *Object.Name);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void FBlendMeshBuffer::BuildMeshDescription(FMeshDescription& OutMeshDescription, TArray<FName>& OutMaterialSlotNames, int32 LODIndex) const
+{
+    BuildObjects(GetUninstancedObjects(LODIndex), OutMeshDescription, OutMaterialSlotNames);
+}
+
+void FBlendMeshBuffer::BuildInstancedMeshDescription(const FBlendMeshBufferObject& Object, FMeshDescription& OutMeshDescription, TArray<FName>& OutMaterialSlotNames, int32 LODIndex) const
+{
+    const FBlendMeshBufferObject* BuildObject = GetLODObject(Object, LODIndex);
+    BuildObjects(MakeArrayView(&BuildObject, 1), OutMeshDescription, OutMaterialSlotNames);
+}
+
+int32 FBlendMeshBuffer::GetNumLODs() const
+{
+    int32 NumLODs = 1;
+    for (const FBlendMeshBufferObject& Object : Objects)
+    {
+        if (Object.LODIndex == 0 && Object.InstanceTransforms.Num() == 0)
+        {
+            NumLODs = FMath::Max(NumLODs, Object.LODObjectIndices.Num());
+        }
+    }
+    return NumLODs;
+}
+
+int32 FBlendMeshBuffer::GetNumInstancedLODs(const FBlendMeshBufferObject& Object)
+{
+    return FMath::Max(Object.LODObjectIndices.Num(), 1);
+}
+
+FString FBlendMeshBuffer::GetMeshHash() const
+{
+    TArray<const FBlendMeshBufferObject*> LODObjects;
+    for (int32 LODIndex = 0; LODIndex < GetNumLODs(); LODIndex++)
+    {
+        LODObjects.Append(GetUninstancedObjects(LODIndex));
+    }
+    return HashObjects(LODObjects);
+}
+
+FString FBlendMeshBuffer::GetInstancedMeshHash(const FBlendMeshBufferObject& Object) const
+{
+    TArray<const FBlendMeshBufferObject*> LODObjects;
+    for (int32 LODIndex = 0; LODIndex < GetNumInstancedLODs(Object); LODIndex++)
+    {
+        LODObjects.Add(GetLODObject(Object, LODIndex));
+    }
+    return HashObjects(LODObjects);
+}
+
+TArray<const FBlendMeshBufferObject*> FBlendMeshBuffer::GetUninstancedObjects(int32 LODIndex) const
+{
+    TArray<const FBlendMeshBufferObject*> UninstancedObjects;
+    for (const FBlendMeshBufferObject& Object : Objects)
+    {
+        if (Object.LODIndex == 0 && Object.InstanceTransforms.Num() == 0)
+        {
+            UninstancedObjects.Add(GetLODObject(Object, LODIndex));
+        }
+    }
+    return UninstancedObjects;
+}
+
+const FBlendMeshBufferObject* FBlendMeshBuffer::GetLODObject(const FBlendMeshBufferObject& Object, int32 LODIndex) const
+{
+    if (Object.LODObjectIndices.Num() == 0)
+    {
+        return &Object;
+    }
+    return &Objects[Object.LODObjectIndices[FMath::Clamp(LODIndex, 0, Object.LODObjectIndices.Num() - 1)]];
+}
+
+FString FBlendMeshBuffer::HashObjects(TArrayView<const FBlendMeshBufferObject* const> ObjectsToHash) const
+{
+    // Everything BuildObjects reads, plus what decides the build settings, with the sizes so arrays can't run into each other
+    FSHA1 Hash;
+    auto UpdateValue = [&Hash](int32 Value)
+    {
+        Hash.Update(reinterpret_cast<const uint8*>(&Value), sizeof(Value));
+    };
+    auto UpdateArray = [&Hash, &UpdateValue](auto View)
+    {
+        UpdateValue(View.Num());
+        Hash.Update(reinterpret_cast<const uint8*>(View.GetData()), View.Num() * View.GetTypeSize());
+    };
+    auto UpdateString = [&Hash, &UpdateValue](const FString& String)
+    {
+        UpdateValue(String.Len());
+        Hash.UpdateWithString(*String, String.Len());
+    };
+
+    UpdateValue(Version);
+    UpdateValue(HasTangents());
+    for (const FBlendMeshBufferObject* Object : ObjectsToHash)
+    {
+        UpdateValue(Object->MaterialNames.Num());
+        for (const FString& MaterialName : Object->MaterialNames)
+        {
+            UpdateString(MaterialName);
+        }
+
+        UpdateArray(Object->Positions);
+        UpdateArray(Object->CornerVertices);
+        UpdateArray(Object->Normals);
+        UpdateArray(Object->Tangents);
+        UpdateArray(Object->BitangentSigns);
+        UpdateValue(Object->UVs.Num());
+        for (const TArrayView<const float>& UVs : Object->UVs)
+        {
+            UpdateArray(UVs);
+        }
+        UpdateArray(Object->Colors);
+        UpdateArray(Object->TriangleCorners);
+        UpdateArray(Object->TriangleMaterials);
+    }
+    Hash.Final();
+
+    FSHAHash Result;
+    Hash.GetHash(Result.Hash);
+    return Result.ToString();
+}
+
+TArray<FTransform> FBlendMeshBuffer::GetInstanceTransforms(const FBlendMeshBufferObject& Object)
+{
+    // Mirrored in Y like the positions, and transposed as Blender's matrices transform column vectors
+    static const float AxisSigns[3] = { 1.0f, -1.0f, 1.0f };
+
+    TArray<FTransform> Transforms;
+    for (int32 Instance = 0; Instance < Object.InstanceTransforms.Num() / 16; Instance++)
+    {
+        const float* Values = &Object.InstanceTransforms[Instance * 16];
+        FMatrix Matrix = FMatrix::Identity;
+        for (int32 Row = 0; Row < 3; Row++)
+        {
+            for (int32 Column = 0; Column < 3; Column++)
+            {
+                Matrix.M[Column][Row] = Values[Row * 4 + Column] * AxisSigns[Row] * AxisSigns[Column];
+            }
+            Matrix.M[3][Row] = Values[Row * 4 + 3] * AxisSigns[Row] * MeshBufferScale;
+        }
+        Transforms.Add(FTransform(Matrix));
+    }
+    return Transforms;
+}
+
+void FBlendMeshBuffer::BuildObjects(TArrayView<const FBlendMeshBufferObject* const> ObjectsToBuild, FMeshDescription& OutMeshDescription, TArray<FName>& OutMaterialSlotNames)
+{
+    FStaticMeshAttributes Attributes(OutMeshDescription);
+    Attributes.Register();
+
+    TVertexAttributesRef<FMeshVector> VertexPositions = Attributes.GetVertexPositions();
+    TVertexInstanceAttributesRef<FMeshVector> Normals = Attributes.GetVertexInstanceNormals();
+    TVertexInstanceAttributesRef<FMeshVector> Tangents = Attributes.GetVertexInstanceTangents();
+    TVertexInstanceAttributesRef<float> BinormalSigns = Attributes.GetVertexInstanceBinormalSigns();
+    TVertexInstanceAttributesRef<FMeshUV> UVs = Attributes.GetVertexInstanceUVs();
+    TVertexInstanceAttributesRef<FMeshColor> Colors = Attributes.GetVertexInstanceColors();
+    TPolygonGroupAttributesRef<FName> MaterialSlotNames = Attributes.GetPolygonGroupMaterialSlotNames();
+
+    int32 NumUVChannels = 1;
+    int32 NumVertices = 0;
+    int32 NumCorners = 0;
+    int32 NumTriangles = 0;
+    for (const FBlendMeshBufferObject* Object : ObjectsToBuild)
+    {
+        NumUVChannels = FMath::Max(NumUVChannels, Object->UVs.Num());
+        NumVertices += Object->NumVertices;
+        NumCorners += Object->NumCorners;
+        NumTriangles += Object->NumTriangles;
+    }
+    UVs.SetNumChannels(NumUVChannels);
+
+    OutMeshDescription.ReserveNewVertices(NumVertices);
+    OutMeshDescription.ReserveNewVertexInstances(NumCorners);
+    OutMeshDescription.ReserveNewPolygons(NumTriangles);
+    OutMeshDescription.ReserveNewEdges(NumTriangles * 3);
+
+    // Objects using the same material share a polygon group, and so a material slot
+    TMap<FString, FPolygonGroupID> PolygonGroups;
+
+    TArray<FVertexID> VertexIDs;
+    TArray<FVertexInstanceID> VertexInstanceIDs;
+    for (const FBlendMeshBufferObject* ObjectPointer : ObjectsToBuild)
+    {
+        const FBlendMeshBufferObject& Object = *ObjectPointer;
+
+        // Blender is right handed, so Y is mirrored into Unreal's left handed space, as the FBX importer does
+        VertexIDs.SetNumUninitialized(Object.NumVertices, false);
+        for (int32 Vertex = 0; Vertex < Object.NumVertices; Vertex++)
+        {
+            const float* Position = &Object.Positions[Vertex * 3];
+            VertexIDs[Vertex] = OutMeshDescription.CreateVertex();
+            VertexPositions[VertexIDs[Vertex]] = FMeshVector(Position[0], -Position[1], Position[2]) * MeshBufferScale;
+        }
+
+        VertexInstanceIDs.SetNumUninitialized(Object.NumCorners, false);
+        for (int32 Corner = 0; Corner < Object.NumCorners; Corner++)
+        {
+            const FVertexInstanceID VertexInstanceID = OutMeshDescription.CreateVertexInstance(VertexIDs[Object.CornerVertices[Corner]]);
+            VertexInstanceIDs[Corner] = VertexInstanceID;
+
+            const float* Normal = &Object.Normals[Corner * 3];
+            Normals[VertexInstanceID] = FMeshVector(Normal[0], -Normal[1], Normal[2]);
+
+            // Mirroring Y and flipping V both flip the tangent basis, so the bitangent sign stays the same
+            if (Object.Tangents.Num() > 0)
+            {
+                const float* Tangent = &Object.Tangents[Corner * 3];
+                Tangents[VertexInstanceID] = FMeshVector(Tangent[0], -Tangent[1], Tangent[2]);
+                BinormalSigns[VertexInstanceID] = Object.BitangentSigns[Corner];
+            }
+
+            for (int32 Channel = 0; Channel < Object.UVs.Num(); Channel++)
+            {
+                const float* UV = &Object.UVs[Channel][Corner * 2];
+                UVs.Set(VertexInstanceID, Channel, FMeshUV(UV[0], 1.0f - UV[1]));
+            }
+
+            if (Object.Colors.Num() > 0)
+            {
+                const float* Color = &Object.Colors[Corner * 4];
+                Colors[VertexInstanceID] = FMeshColor(Color[0], Color[1], Color[2], Color[3]);
+            }
+        }
+
+        TArray<FPolygonGroupID, TInlineAllocator<8>> ObjectPolygonGroups;
+        for (const FString& MaterialName : Object.MaterialNames)
+        {
+            const FString SlotName = MaterialName.IsEmpty() ? TEXT("DefaultMaterial") : MaterialName;
+            FPolygonGroupID* PolygonGroupID = PolygonGroups.Find(SlotName);
+            if (!PolygonGroupID)
+            {
+                PolygonGroupID = &PolygonGroups.Add(SlotName, OutMeshDescription.CreatePolygonGroup());
+                MaterialSlotNames[*PolygonGroupID] = FName(*SlotName);
+                OutMaterialSlotNames.Add(FName(*SlotName));
+            }
+            ObjectPolygonGroups.Add(*PolygonGroupID);
+        }
+
+        for (int32 Triangle = 0; Triangle < Object.NumTriangles; Triangle++)
+        {
+            const int32* Corners = &Object.TriangleCorners[Triangle * 3];
+
+            // Degenerate triangles can't be added to a mesh description
+            const int32 V0 = Object.CornerVertices[Corners[0]];
+            const int32 V1 = Object.CornerVertices[Corners[1]];
+            const int32 V2 = Object.CornerVertices[Corners[2]];
+            if (V0 == V1 || V1 == V2 || V0 == V2)
+            {
+                continue;
+            }
+
+            // Winding is reversed by the mirroring too
+            const FVertexInstanceID TriangleVertexInstances[3] = { VertexInstanceIDs[Corners[0]], VertexInstanceIDs[Corners[2]], VertexInstanceIDs[Corners[1]] };
+            const int32 MaterialIndex = FMath::Clamp(Object.TriangleMaterials[Triangle], 0, ObjectPolygonGroups.Num() - 1);
+            OutMeshDescription.CreateTriangle(ObjectPolygonGroups[MaterialIndex], MakeArrayView(TriangleVertexInstances));
+        }
+    }
+}
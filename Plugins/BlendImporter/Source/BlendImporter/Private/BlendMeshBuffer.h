@@ -0,0 +1,102 @@
+// Copyright 2022 nuclearfriend
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+struct FMeshDescription;
+
+/** One object's mesh in a mesh buffer. The arrays point into the mapped file. */
+struct FBlendMeshBufferObject
+{
+	FString Name;
+	TArray<FString> MaterialNames;
+	int32 NumVertices = 0;
+	int32 NumCorners = 0;
+	int32 NumTriangles = 0;
+
+	TArrayView<const float> Positions;
+	TArrayView<const int32> CornerVertices;
+	TArrayView<const float> Normals;
+	TArrayView<const float> Tangents;
+	TArrayView<const float> BitangentSigns;
+	TArray<TArrayView<const float>> UVs;
+	TArrayView<const float> Colors;
+	TArrayView<const int32> TriangleCorners;
+	TArrayView<const int32> TriangleMaterials;
+
+	/** If the mesh is shared by several objects, their object to world matrices, and the positions are in the mesh's own space */
+	TArrayView<const float> InstanceTransforms;
+
+	/** LOD objects reduce the LOD 0 object at the base index, and share its space and instances */
+	int32 LODIndex = 0;
+	int32 BaseObjectIndex = 0;
+
+	/** On LOD 0 objects, the indices of the object's LODs, starting with itself */
+	TArray<int32> LODObjectIndices;
+};
+
+/**
+ * Static meshes written by blender_export.py without going through FBX, read in place from a memory mapped file.
+ * The layout is documented in blender_export.py: a header, then per object flat arrays of positions, corner (vertex instance) attributes
+ * and triangles, in Blender's coordinates. Converting to Unreal's coordinates happens while building the mesh description.
+ */
+class FBlendMeshBuffer
+{
+public:
+	static const int32 Version = 3;
+
+	FBlendMeshBuffer();
+	~FBlendMeshBuffer();
+
+	/** True if the file starts with the mesh buffer header */
+	static bool IsMeshBuffer(const FString& Filename);
+
+	/** Returns false with the reason if the file isn't a valid mesh buffer */
+	bool Open(const FString& Filename, FString& OutError);
+
+	const TArray<FBlendMeshBufferObject>& GetObjects() const;
+
+	/**
+	 * Builds all objects that aren't instanced into one mesh, with a polygon group per material. Returns the material slot names in polygon group order.
+	 * Objects with fewer LODs than asked for use their last one.
+	 */
+	void BuildMeshDescription(FMeshDescription& OutMeshDescription, TArray<FName>& OutMaterialSlotNames, int32 LODIndex = 0) const;
+
+	/** Builds an instanced object's mesh on its own, in its own space */
+	void BuildInstancedMeshDescription(const FBlendMeshBufferObject& Object, FMeshDescription& OutMeshDescription, TArray<FName>& OutMaterialSlotNames, int32 LODIndex = 0) const;
+
+	/** The number of LODs of the mesh built from the objects that aren't instanced, or of an instanced object's mesh */
+	int32 GetNumLODs() const;
+	static int32 GetNumInstancedLODs(const FBlendMeshBufferObject& Object);
+
+	/** An instanced object's instance transforms, in Unreal's coordinates */
+	static TArray<FTransform> GetInstanceTransforms(const FBlendMeshBufferObject& Object);
+
+	/** Hashes of the data the meshes above are built from, all LODs included, which are the same if building them again would make the same mesh */
+	FString GetMeshHash() const;
+	FString GetInstancedMeshHash(const FBlendMeshBufferObject& Object) const;
+
+	bool HasUninstancedObjects() const;
+
+	bool HasTangents() const;
+
+private:
+	bool ParseObjects(FString& OutError);
+	TArray<const FBlendMeshBufferObject*> GetUninstancedObjects(int32 LODIndex) const;
+	const FBlendMeshBufferObject* GetLODObject(const FBlendMeshBufferObject& Object, int32 LODIndex) const;
+	FString HashObjects(TArrayView<const FBlendMeshBufferObject* const> ObjectsToHash) const;
+	static void BuildObjects(TArrayView<const FBlendMeshBufferObject* const> ObjectsToBuild, FMeshDescription& OutMeshDescription, TArray<FName>& OutMaterialSlotNames);
+
+private:
+	TUniquePtr<IMappedFileHandle> MappedHandle;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	TArray64<uint8> OwnedData;
+
+	const uint8* FileData;
+	int64 FileSize;
+
+	TArray<FBlendMeshBufferObject> Objects;
+};
@@ -0,0 +1,312 @@
+// Copyright 2022 nuclearfriend
+
+#include "BlendSourceWatcher.h"
+#include "AssetRegistryModule.h"
+#include "AutoReimport/AssetSourceFilenameCache.h"
+#include "BlendAssetFactory.h"
+#include "BlendImportQueue.h"
+#include "BlendImporter.h"
+#include "BlendImporterSettings.h"
+#include "DirectoryWatcherModule.h"
+#include "Editor.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/StaticMesh.h"
+#include "IDirectoryWatcher.h"
+#include "Misc/Paths.h"
+#include "UObject/MetaData.h"
+#include "UObject/StrongObjectPtr.h"
+
+FBlendSourceWatcher::FBlendSourceWatcher()
+    : bWatching(false)
+{
+}
+
+FBlendSourceWatcher::~FBlendSourceWatcher()
+{
+    UnwatchAll();
+
+    if (TickerHandle.IsValid())
+    {
+        #if ENGINE_MAJOR_VERSION >= 5
+            FTSTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+        #else
+            FTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+        #endif
+        TickerHandle.Reset();
+    }
+
+    if (AssetAddedHandle.IsValid() && FModuleManager::Get().IsModuleLoaded(AssetRegistryConstants::ModuleName))
+    {
+        FModuleManager::GetModuleChecked<FAssetRegistryModule>(AssetRegistryConstants::ModuleName).Get().OnAssetAdded().Remove(AssetAddedHandle);
+    }
+}
+
+void FBlendSourceWatcher::Refresh()
+{
+    const bool bShouldWatch = GetDefault<UBlendImporterSettings>()->IsWatchSourceFiles();
+    if (bShouldWatch == bWatching)
+    {
+        return;
+    }
+    bWatching = bShouldWatch;
+
+    IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>(AssetRegistryConstants::ModuleName).Get();
+
+    if (!bWatching)
+    {
+        AssetRegistry.OnAssetAdded().Remove(AssetAddedHandle);
+        AssetAddedHandle.Reset();
+        UnwatchAll();
+        ChangedFiles.Empty();
+        UE_LOG(LogBlendImporter, Log, TEXT("Stopped watching .blend source files"));
+        return;
+    }
+
+    // While the registry is still discovering assets it reports each one as added, otherwise the existing ones are gathered here
+    AssetAddedHandle = AssetRegistry.OnAssetAdded().AddSP(this, &FBlendSourceWatcher::OnAssetAdded);
+    if (!AssetRegistry.IsLoadingAssets())
+    {
+        TArray<FAssetData> Assets;
+        AssetRegistry.GetAllAssets(Assets);
+        for (const FAssetData& AssetData : Assets)
+        {
+            OnAssetAdded(AssetData);
+        }
+    }
+
+    if (!TickerHandle.IsValid())
+    {
+        #if ENGINE_MAJOR_VERSION >= 5
+            TickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateSP(this, &FBlendSourceWatcher::Tick), 0.5f);
+        #else
+            TickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateSP(this, &FBlendSourceWatcher::Tick), 0.5f);
+        #endif
+    }
+
+    UE_LOG(LogBlendImporter, Log, TEXT("Watching %d .blend source files in %d directories"), SourceFiles.Num(), WatchedDirectories.Num());
+}
+
+void FBlendSourceWatcher::WatchSourceFile(const FString& Filename)
+{
+    SourceFiles.Add(Filename);
+
+    const FString Directory = FPaths::GetPath(Filename);
+    if (WatchedDirectories.Contains(Directory))
+    {
+        return;
+    }
+
+    IDirectoryWatcher* DirectoryWatcher = FModuleManager::LoadModuleChecked<FDirectoryWatcherModule>("DirectoryWatcher").Get();
+    if (DirectoryWatcher == nullptr)
+    {
+        return;
+    }
+
+    // Only the directory itself, source files often sit near the top of large directory trees
+    FDelegateHandle Handle;
+    if (DirectoryWatcher->RegisterDirectoryChangedCallback_Handle(Directory, IDirectoryWatcher::FDirectoryChanged::CreateSP(this, &FBlendSourceWatcher::OnDirectoryChanged), Handle, IDirectoryWatcher::WatchOptions::IgnoreChangesInSubtree))
+    {
+        WatchedDirectories.Add(Directory, Handle);
+    }
+    else
+    {
+        UE_LOG(LogBlendImporter, Warning, TEXT("Could not watch '%s' for changes to .blend files"), *Directory);
+    }
+}
+
+void FBlendSourceWatcher::UnwatchAll()
+{
+    FDirectoryWatcherModule* DirectoryWatcherModule = FModuleManager::GetModulePtr<FDirectoryWatcherModule>("DirectoryWatcher");
+    IDirectoryWatcher* DirectoryWatcher = DirectoryWatcherModule ? DirectoryWatcherModule->Get() : nullptr;
+    if (DirectoryWatcher)
+    {
+        for (const TPair<FString, FDelegateHandle>& WatchedDirectory : WatchedDirectories)
+        {
+            DirectoryWatcher->UnregisterDirectoryChangedCallback_Handle(WatchedDirectory.Key, WatchedDirectory.Value);
+        }
+    }
+
+    WatchedDirectories.Empty();
+    SourceFiles.Empty();
+}
+
+void FBlendSourceWatcher::OnAssetAdded(const FAssetData& AssetData)
+{
+    for (const FString& Filename : UBlendAssetFactory::GetSourceFiles(AssetData))
+    {
+        if (FPaths::FileExists(Filename))
+        {
+            WatchSourceFile(Filename);
+        }
+    }
+}
+
+void FBlendSourceWatcher::OnDirectoryChanged(const TArray<FFileChangeData>& Changes)
+{
+    const double Now = FPlatformTime::Seconds();
+    for (const FFileChangeData& Change : Changes)
+    {
+        const FString Filename = GetSavedBlendFile(Change.Filename);
+        if (!Filename.IsEmpty() && SourceFiles.Contains(Filename))
+        {
+            ChangedFiles.Add(Filename, Now);
+        }
+    }
+}
+
+bool FBlendSourceWatcher::Tick(float DeltaTime)
+{
+    // Not while playing in the editor, Blender would compete with the game and a reimport would interrupt it
+    if (ChangedFiles.Num() == 0 || (GEditor && GEditor->PlayWorld))
+    {
+        return true;
+    }
+
+    const double SettleTime = GetDefault<UBlendImporterSettings>()->GetSourceFileSettleTime();
+    const double Now = FPlatformTime::Seconds();
+
+    TArray<FString> SettledFiles;
+    for (const TPair<FString, double>& ChangedFile : ChangedFiles)
+    {
+        if (Now - ChangedFile.Value >= SettleTime && !ExportingFiles.Contains(ChangedFile.Key))
+        {
+            SettledFiles.Add(ChangedFile.Key);
+        }
+    }
+
+    for (const FString& Filename : SettledFiles)
+    {
+        ChangedFiles.Remove(Filename);
+        if (FPaths::FileExists(Filename))
+        {
+            ExportChangedFile(Filename);
+        }
+    }
+    return true;
+}
+
+void FBlendSourceWatcher::ExportChangedFile(const FString& Filename)
+{
+    // Exported once for each set of options the file was imported with, the same as its reimports, so they find the exports in the cache
+    const TArray<FString> ImportOptionsStrings = GetImportOptions(Filename);
+    if (ImportOptionsStrings.Num() == 0)
+    {
+        return;
+    }
+
+    UE_LOG(LogBlendImporter, Log, TEXT("'%s' changed, exporting it in the background"), *Filename);
+    ExportingFiles.Add(Filename, ImportOptionsStrings.Num());
+    FailedFiles.Remove(Filename);
+
+    UBlendImportOptions* ImportOptions = NewObject<UBlendImportOptions>();
+    for (const FString& ImportOptionsString : ImportOptionsStrings)
+    {
+        FBlendQueuedImportOptions Options;
+        if (ImportOptions->FromString(ImportOptionsString))
+        {
+            Options.bUseObjectPivot = ImportOptions->bUseObjectPivot;
+            Options.EnabledCollections = ImportOptions->EnabledCollections;
+            Options.NumLODs = ImportOptions->NumLODs;
+            Options.LODReductionRatio = ImportOptions->LODReductionRatio;
+        }
+        else
+        {
+            Options.bDefaultCollections = true;
+        }
+        FBlendImporterModule::Get().GetImportQueue().EnqueueExport(Filename, Options, FBlendImportQueue::FOnExported::CreateSP(this, &FBlendSourceWatcher::OnExported, Filename));
+    }
+}
+
+TArray<FString> FBlendSourceWatcher::GetImportOptions(const FString& Filename)
+{
+    IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>(AssetRegistryConstants::ModuleName).Get();
+
+    TArray<FString> ImportOptionsStrings;
+    bool bLoadedUntagged = false;
+    for (const FAssetData& AssetData : FAssetSourceFilenameCache::Get().GetAssetsPertainingToFile(AssetRegistry, FPaths::ConvertRelativePathToFull(Filename)))
+    {
+        UClass* AssetClass = AssetData.GetClass();
+        if (!AssetClass || !(AssetClass->IsChildOf<UStaticMesh>() || AssetClass->IsChildOf<USkeletalMesh>()))
+        {
+            continue;
+        }
+
+        FString ImportOptionsString;
+        if (!UBlendImportOptions::FindAssetRegistryTag(AssetData, ImportOptionsString))
+        {
+            // Assets that haven't been saved since the tag was added only have their options in their metadata, which one asset is loaded for
+            if (bLoadedUntagged)
+            {
+                continue;
+            }
+            bLoadedUntagged = true;
+
+            UObject* Asset = AssetData.GetAsset();
+            ImportOptionsString = Asset ? Asset->GetPackage()->GetMetaData()->GetValue(Asset, TEXT("BLEND_IMPORT")) : FString();
+        }
+        ImportOptionsStrings.AddUnique(ImportOptionsString);
+    }
+    return ImportOptionsStrings;
+}
+
+void FBlendSourceWatcher::OnExported(bool bSucceeded, FString Filename)
+{
+    int32* NumExports = ExportingFiles.Find(Filename);
+    if (NumExports == nullptr)
+    {
+        return;
+    }
+
+    if (!bSucceeded)
+    {
+        FailedFiles.Add(Filename);
+    }
+    if (--(*NumExports) > 0)
+    {
+        return;
+    }
+    ExportingFiles.Remove(Filename);
+
+    // A failed export is left for the next save, reimporting would only run Blender again to fail the same way
+    if (FailedFiles.Remove(Filename) > 0 || !GetDefault<UBlendImporterSettings>()->IsReimportChangedSourceFiles())
+    {
+        return;
+    }
+
+    // Tried again once playing stops, by which time the export is in the cache
+    if (GEditor && GEditor->PlayWorld)
+    {
+        ChangedFiles.Add(Filename, FPlatformTime::Seconds());
+        return;
+    }
+
+    const TArray<UObject*> Assets = UBlendAssetFactory::FindAssetsFromSource(Filename);
+    if (Assets.Num() > 0)
+    {
+        UE_LOG(LogBlendImporter, Log, TEXT("Reimporting %d assets from changed '%s'"), Assets.Num(), *Filename);
+        // Rooted for the reimport, which can run a garbage collection
+        TStrongObjectPtr<UBlendAssetFactory> Factory(NewObject<UBlendAssetFactory>());
+        Factory->ReimportFromSource(Assets);
+    }
+}
+
+FString FBlendSourceWatcher::GetSavedBlendFile(const FString& Filename)
+{
+    // Blender saves to "name.blend@" and moves it over the file, after moving the previous file to "name.blend1" (and up)
+    FString BlendFile = FPaths::ConvertRelativePathToFull(Filename);
+    FPaths::NormalizeFilename(BlendFile);
+    BlendFile.RemoveFromEnd(TEXT("@"));
+
+    const FString Extension = FPaths::GetExtension(BlendFile);
+    if (!Extension.StartsWith(TEXT("blend"), ESearchCase::IgnoreCase))
+    {
+        return FString();
+    }
+
+    const FString Backup = Extension.RightChop(5);
+    if (!Backup.IsEmpty() && !Backup.IsNumeric())
+    {
+        return FString();
+    }
+    return FPaths::ChangeExtension(BlendFile, TEXT("blend"));
+}
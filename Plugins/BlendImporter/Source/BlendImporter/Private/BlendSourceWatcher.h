@@ -0,0 +1,61 @@
+// Copyright 2022 nuclearfriend
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+
+struct FAssetData;
+struct FFileChangeData;
+
+/**
+ * Watches the directories of the .blend files assets were imported from, and once a changed file has settled, exports it in the background
+ * through the import queue, so it's in the export cache by the time it's reimported. Optionally reimports it too.
+ * Blender saves by writing a temporary file and moving the previous one to a .blend1 backup, so changes to those count as changes to the .blend file.
+ */
+class FBlendSourceWatcher : public TSharedFromThis<FBlendSourceWatcher>
+{
+public:
+	FBlendSourceWatcher();
+	~FBlendSourceWatcher();
+
+	/** Starts or stops watching to match the settings */
+	void Refresh();
+
+private:
+	void WatchSourceFile(const FString& Filename);
+	void UnwatchAll();
+	void OnAssetAdded(const FAssetData& AssetData);
+	void OnDirectoryChanged(const TArray<FFileChangeData>& Changes);
+	bool Tick(float DeltaTime);
+	void ExportChangedFile(const FString& Filename);
+	void OnExported(bool bSucceeded, FString Filename);
+
+	/** The distinct options the file's meshes were imported with, read from their asset registry tags where they have them */
+	static TArray<FString> GetImportOptions(const FString& Filename);
+
+	/** The .blend file that Blender wrote a file for while saving it, or an empty string */
+	static FString GetSavedBlendFile(const FString& Filename);
+
+private:
+	bool bWatching;
+	TMap<FString, FDelegateHandle> WatchedDirectories;
+	TSet<FString> SourceFiles;
+
+	/** Changed files and when they last changed, exported once they haven't changed for the settle time */
+	TMap<FString, double> ChangedFiles;
+
+	/** Files being exported, with how many exports each has left, which are exported again if they change in the meantime */
+	TMap<FString, int32> ExportingFiles;
+
+	/** Files being exported where one of the exports failed */
+	TSet<FString> FailedFiles;
+
+	FDelegateHandle AssetAddedHandle;
+
+	#if ENGINE_MAJOR_VERSION >= 5
+		FTSTicker::FDelegateHandle TickerHandle;
+	#else
+		FDelegateHandle TickerHandle;
+	#endif
+};
@@ -0,0 +1,451 @@
+// Copyright 2022 nuclearfriend
+
+#include "BlenderJob.h"
+#include "BlendImporter.h"
+#include "BlendImporterSettings.h"
+#include "BlenderJobPool.h"
+#include "BlenderProcess.h"
+#include "BlenderWatchdog.h"
+#include "BlenderWorker.h"
+#include "Interfaces/IPluginManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/ScopedSlowTask.h"
+#include "Policies/CondensedJsonPrintPolicy.h"
+#include "Serialization/JsonWriter.h"
+
+#define LOCTEXT_NAMESPACE "BlenderJob"
+
+FBlenderJob::FBlenderJob(const FString& InFilename, const TArray<FString>& ScriptNames, const TMap<FString, FString>& InEnvironment)
+    : Filename(FPaths::ConvertRelativePathToFull(InFilename))
+    , Environment(InEnvironment)
+    , bOnWorker(false)
+    , bPooled(false)
+    , OutputLines(10000)
+    , bStarted(false)
+    , bFinished(false)
+    , bSucceeded(false)
+{
+    FString PluginPath = IPluginManager::Get().FindPlugin(TEXT("BlendImporter"))->GetBaseDir();
+    for (const FString& ScriptName : ScriptNames)
+    {
+        ScriptPaths.Add(FPaths::ConvertRelativePathToFull(PluginPath + FString::Printf(TEXT("/Scripts/%s.py"), *ScriptName)));
+    }
+
+    // The scripts write their results to this file, see FBlenderResultReader
+    const FString JobDirectory = FPaths::Combine(FPaths::ProjectIntermediateDir(), TEXT("BlendImporter"));
+    ResultFilename = FPaths::ConvertRelativePathToFull(FPaths::CreateTempFilename(*JobDirectory, TEXT("Result-"), TEXT(".jsonl")));
+    Environment.Add(TEXT("UNREAL_IMPORTER_RESULT_FILE"), ResultFilename);
+}
+
+FBlenderJob::~FBlenderJob()
+{
+    if (TickerHandle.IsValid())
+    {
+        #if ENGINE_MAJOR_VERSION >= 5
+            FTSTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+        #else
+            FTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+        #endif
+    }
+    Cancel();
+    DeleteEnvironmentFile();
+    IFileManager::Get().Delete(*ResultFilename, false, false, true);
+}
+
+bool FBlenderJob::Start()
+{
+    UBlendImporterSettings* Settings = GetMutableDefault<UBlendImporterSettings>();
+    FFilePath BlenderExePath = Settings->GetBlenderExecutable();
+    if (BlenderExePath.FilePath.IsEmpty())
+    {
+        UE_LOG(LogBlendImporter, Error, TEXT("Blender executable has not been set."));
+        return false;
+    }
+    ExecutablePath = BlenderExePath.FilePath;
+
+    Parameters = TEXT("-noaudio --python-exit-code 1");
+
+    if (Settings->IsDebug())
+    {
+        Parameters += TEXT(" -d");
+    }
+
+    if (Settings->IsFactoryStartup())
+    {
+        Parameters += TEXT(" --factory-startup");
+    }
+
+    if (Settings->IsRunInBackground())
+    {
+        Parameters += TEXT(" -b");
+    }
+    else
+    {
+        Parameters += TEXT(" -w --no-window-focus");
+    }
+
+    bStarted = true;
+    ResetResult();
+
+    if (Settings->IsUsePersistentWorker())
+    {
+        FBlenderWorker& Worker = FBlendImporterModule::Get().GetBlenderWorker();
+        if (Worker.IsBusy())
+        {
+            UE_LOG(LogBlendImporter, Log, TEXT("Blender worker is busy, running in a new Blender process."));
+        }
+        else if (Worker.BeginJob(ExecutablePath, Parameters, Filename, ScriptPaths, Environment))
+        {
+            bOnWorker = true;
+            return true;
+        }
+        else
+        {
+            UE_LOG(LogBlendImporter, Warning, TEXT("Blender worker is unavailable, falling back to running a new Blender process."));
+        }
+    }
+
+    if (!StartProcess())
+    {
+        Finish(false);
+        return false;
+    }
+    return true;
+}
+
+void FBlenderJob::SetPooled()
+{
+    bPooled = true;
+}
+
+bool FBlenderJob::Poll(TArray<FString>& OutLines)
+{
+    if (!bStarted || bFinished)
+    {
+        return false;
+    }
+
+    TArray<FString> NewLines;
+    if (bOnWorker)
+    {
+        switch (FBlendImporterModule::Get().GetBlenderWorker().PollJob(NewLines))
+        {
+            case EBlenderWorkerJobState::Running:
+                break;
+
+            case EBlenderWorkerJobState::Completed:
+                for (const FString& Line : NewLines)
+                {
+                    OutputLines.Add(Line);
+                }
+                UE_LOG(LogBlendImporter, Log, TEXT("Blender Output:\n%s"), *GetOutput());
+                Finish(true);
+                break;
+
+            case EBlenderWorkerJobState::Lost:
+                // Run the whole job again, so partial output from the lost worker isn't mixed with the new run's
+                UE_LOG(LogBlendImporter, Warning, TEXT("Blender worker was lost, falling back to running a new Blender process."));
+                bOnWorker = false;
+                OutputLines.Empty();
+                NewLines.Empty();
+                ResetResult();
+                if (!StartProcess())
+                {
+                    Finish(false);
+                }
+                break;
+        }
+    }
+    else
+    {
+        const bool bRunning = Process->IsRunning();
+        Process->ReadLines(NewLines, !bRunning);
+
+        if (!bRunning)
+        {
+            for (const FString& Line : NewLines)
+            {
+                OutputLines.Add(Line);
+            }
+            UE_LOG(LogBlendImporter, Log, TEXT("Blender Output:\n%s\nReturn Code: %d"), *GetOutput(), Process->GetReturnCode());
+            Finish(true);
+        }
+    }
+
+    if (!bFinished)
+    {
+        for (const FString& Line : NewLines)
+        {
+            OutputLines.Add(Line);
+        }
+    }
+    OutLines.Append(MoveTemp(NewLines));
+
+    Result.Update();
+    return !bFinished;
+}
+
+bool FBlenderJob::Wait(FString& Output)
+{
+    const bool bCompleted = WaitUntil([]() { return false; });
+    Output = GetOutput();
+    return bCompleted && bSucceeded;
+}
+
+bool FBlenderJob::WaitForResult(const FString& ScriptName)
+{
+    return WaitUntil([this, &ScriptName]() { return Result.HasCompleted(ScriptName); });
+}
+
+void FBlenderJob::Cancel()
+{
+    if (!bStarted || bFinished)
+    {
+        return;
+    }
+
+    if (bOnWorker)
+    {
+        FBlendImporterModule::Get().GetBlenderWorker().CancelJob();
+    }
+    else if (Process.IsValid())
+    {
+        Process->Terminate();
+    }
+
+    bFinished = true;
+    bSucceeded = false;
+    FBlenderJobPool::RemoveForegroundJob(*this);
+    UE_LOG(LogBlendImporter, Log, TEXT("Blender Execution - Cancelled"));
+    OnFinishedDelegate.ExecuteIfBound(false);
+    CompleteRun(false);
+}
+
+FBlenderJob::FOnFinished& FBlenderJob::OnFinished()
+{
+    return OnFinishedDelegate;
+}
+
+bool FBlenderJob::IsFinished() const
+{
+    return bFinished;
+}
+
+FString FBlenderJob::GetOutput() const
+{
+    return OutputLines.ToString();
+}
+
+const FBlenderResultReader& FBlenderJob::GetResult() const
+{
+    return Result;
+}
+
+const FString& FBlenderJob::GetFilename() const
+{
+    return Filename;
+}
+
+uint64 FBlenderJob::GetMemoryUsage() const
+{
+    // The worker's memory is mostly its earlier jobs' and Blender's own, so it isn't counted against this job
+    if (bOnWorker || !Process.IsValid() || bFinished)
+    {
+        return 0;
+    }
+    return Process->GetMemoryUsage();
+}
+
+TFuture<bool> FBlenderJob::Run()
+{
+    check(IsInGameThread());
+    RunPromise.Emplace();
+    TFuture<bool> Future = RunPromise->GetFuture();
+    if (!Start())
+    {
+        CompleteRun(false);
+        return Future;
+    }
+
+    Watchdog = MakeUnique<FBlenderWatchdog>(Filename);
+    #if ENGINE_MAJOR_VERSION >= 5
+        TickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FBlenderJob::TickRun));
+    #else
+        TickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FBlenderJob::TickRun));
+    #endif
+    return Future;
+}
+
+bool FBlenderJob::TickRun(float DeltaTime)
+{
+    TArray<FString> Lines;
+    if (Poll(Lines))
+    {
+        if (Lines.Num() > 0)
+        {
+            Watchdog->SetStatus(Lines.Last());
+        }
+
+        if (Watchdog->Tick())
+        {
+            return true;
+        }
+
+        UE_LOG(LogBlendImporter, Warning, TEXT("Terminating Blender before completion"));
+        Cancel();
+    }
+
+    Watchdog.Reset();
+    TickerHandle.Reset();
+    return false;
+}
+
+void FBlenderJob::CompleteRun(bool bSuccess)
+{
+    if (RunPromise.IsSet())
+    {
+        // Reset first, as whatever waits on the future may run straight away
+        TPromise<bool> Promise = MoveTemp(RunPromise.GetValue());
+        RunPromise.Reset();
+        Promise.SetValue(bSuccess);
+    }
+}
+
+bool FBlenderJob::WaitUntil(TFunctionRef<bool()> Condition)
+{
+    // A modal progress dialog, shown once Blender has run longer than the unresponsive warning duration, so it can be cancelled
+    // without letting the user start something else while the caller is blocked
+    TOptional<FScopedSlowTask> SlowTask;
+    if (IsInGameThread())
+    {
+        const double WarningDuration = GetDefault<UBlendImporterSettings>()->GetUnresponsiveWarningDuration();
+        SlowTask.Emplace(0.0f, FText::Format(LOCTEXT("BlenderRunning", "Blender is processing '{0}'..."), FText::FromString(FPaths::GetCleanFilename(Filename))));
+        SlowTask->MakeDialogDelayed(WarningDuration, true);
+    }
+
+    TArray<FString> Lines;
+    while (Poll(Lines) && !Condition())
+    {
+        if (SlowTask.IsSet())
+        {
+            SlowTask->EnterProgressFrame(0.0f, Lines.Num() > 0 ? FText::FromString(Lines.Last().Left(200)) : FText::GetEmpty());
+            if (SlowTask->ShouldCancel())
+            {
+                UE_LOG(LogBlendImporter, Warning, TEXT("Terminating Blender before completion"));
+                Cancel();
+                UE_LOG(LogBlendImporter, Error, TEXT("Blender Execution - Failed"));
+                return false;
+            }
+        }
+        Lines.Reset();
+
+        // Wakes up as soon as Blender writes something or exits
+        WaitForOutput(0.05);
+    }
+    return bStarted;
+}
+
+void FBlenderJob::WaitForOutput(double Timeout)
+{
+    if (bOnWorker)
+    {
+        FBlendImporterModule::Get().GetBlenderWorker().WaitForOutput(Timeout);
+    }
+    else if (Process.IsValid())
+    {
+        Process->WaitForOutput(Timeout);
+    }
+}
+
+bool FBlenderJob::StartProcess()
+{
+    // The envvars for the python scripts are passed in a file for this job, which blender_environment.py sets up before the other
+    //  scripts run. Setting them on the editor process for Blender to inherit would leak them between jobs running in parallel.
+    FString EnvironmentJson;
+    TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> Writer = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&EnvironmentJson);
+    Writer->WriteObjectStart();
+    for (const TPair<FString, FString>& Variable : Environment)
+    {
+        Writer->WriteValue(Variable.Key, Variable.Value);
+    }
+    // Lets blender_environment.py time how long Blender took to start and load the file
+    Writer->WriteValue(TEXT("UNREAL_IMPORTER_LAUNCH_TIME"), FString::Printf(TEXT("%.3f"), (FDateTime::UtcNow() - FDateTime(1970, 1, 1)).GetTotalSeconds()));
+    Writer->WriteObjectEnd();
+    Writer->Close();
+
+    DeleteEnvironmentFile();
+    EnvironmentFilename = FPaths::CreateTempFilename(*FPaths::Combine(FPaths::ProjectIntermediateDir(), TEXT("BlendImporter")), TEXT("Job-"), TEXT(".json"));
+    EnvironmentFilename = FPaths::ConvertRelativePathToFull(EnvironmentFilename);
+    if (!FFileHelper::SaveStringToFile(EnvironmentJson, *EnvironmentFilename, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM))
+    {
+        UE_LOG(LogBlendImporter, Error, TEXT("Failed to write Blender job environment to \"%s\""), *EnvironmentFilename);
+        return false;
+    }
+
+    FString PluginPath = IPluginManager::Get().FindPlugin(TEXT("BlendImporter"))->GetBaseDir();
+    FString EnvironmentScriptPath = FPaths::ConvertRelativePathToFull(PluginPath + TEXT("/Scripts/blender_environment.py"));
+
+    // Blender runs each -P script in turn within the same session, so the file is only loaded once
+    FString ProcessParameters = FString::Printf(TEXT("%s \"%s\" -P \"%s\""), *Parameters, *Filename, *EnvironmentScriptPath);
+    for (const FString& ScriptPath : ScriptPaths)
+    {
+        ProcessParameters += FString::Printf(TEXT(" -P \"%s\""), *ScriptPath);
+    }
+    ProcessParameters += FString::Printf(TEXT(" -- \"%s\""), *EnvironmentFilename);
+
+    Process = MakeUnique<FBlenderProcess>();
+    if (!Process->Launch(ExecutablePath, ProcessParameters))
+    {
+        return false;
+    }
+
+    if (!bPooled)
+    {
+        FBlenderJobPool::AddForegroundJob(*this);
+    }
+    return true;
+}
+
+void FBlenderJob::DeleteEnvironmentFile()
+{
+    if (!EnvironmentFilename.IsEmpty())
+    {
+        IFileManager::Get().Delete(*EnvironmentFilename, false, false, true);
+        EnvironmentFilename.Empty();
+    }
+}
+
+void FBlenderJob::ResetResult()
+{
+    IFileManager::Get().Delete(*ResultFilename, false, false, true);
+    IFileManager::Get().MakeDirectory(*FPaths::GetPath(ResultFilename), true);
+    Result.Reset(ResultFilename);
+}
+
+void FBlenderJob::Finish(bool bSuccess)
+{
+    bFinished = true;
+    bSucceeded = bSuccess;
+    FBlenderJobPool::RemoveForegroundJob(*this);
+    DeleteEnvironmentFile();
+
+    // Everything the scripts wrote is in the file once Blender is done with the job
+    Result.Update();
+
+    if (bSucceeded)
+    {
+        UE_LOG(LogBlendImporter, Log, TEXT("Blender Execution - Complete"));
+        if (Result.HasCompleted(TEXT("blender_export")))
+        {
+            UE_LOG(LogBlendImporter, Log, TEXT("Exported '%s': %s"), *Filename, *Result.GetExportSummary());
+        }
+    }
+    else
+    {
+        UE_LOG(LogBlendImporter, Error, TEXT("Blender Execution - Failed"));
+    }
+    OnFinishedDelegate.ExecuteIfBound(bSucceeded);
+    CompleteRun(bSucceeded);
+}
+
+#undef LOCTEXT_NAMESPACE
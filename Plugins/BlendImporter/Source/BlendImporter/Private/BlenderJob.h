@@ -0,0 +1,101 @@
+// Copyright 2022 nuclearfriend
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BlenderProcess.h"
+#include "BlenderResultReader.h"
+#include "Async/Future.h"
+#include "Containers/Ticker.h"
+
+class FBlenderWatchdog;
+
+/**
+ * One run of the plugin's Python scripts against a .blend file, loading the file once for all scripts.
+ * Runs on the persistent worker when enabled and free, otherwise (or if the worker is lost) in a new Blender process.
+ */
+class FBlenderJob
+{
+public:
+	DECLARE_DELEGATE_OneParam(FOnFinished, bool /* bSucceeded */);
+
+	FBlenderJob(const FString& Filename, const TArray<FString>& ScriptNames, const TMap<FString, FString>& Environment);
+	~FBlenderJob();
+
+	bool Start();
+
+	/**
+	 * Starts the job and polls it from the core ticker, so the caller doesn't block. The future is set once the job has finished, failed or was
+	 * cancelled, on the game thread. If Blender takes a while, a notification offers to cancel it. The job must be kept until then, and not destroyed from the future's continuation.
+	 */
+	TFuture<bool> Run();
+
+	/** Called by FBlenderJobPool before it starts the job. Other jobs are counted by every pool as foreground jobs while their Blender process runs. */
+	void SetPooled();
+
+	/** Called once the job has finished, failed or was cancelled, from whichever call noticed */
+	FOnFinished& OnFinished();
+
+	/** Collects any new output lines, returns false once the job has finished */
+	bool Poll(TArray<FString>& OutLines);
+
+	/** Blocks until the job has finished, with a progress dialog that can cancel it if Blender takes a while. Returns false if the job failed or was cancelled. Prefer Run where the caller can carry on. */
+	bool Wait(FString& Output);
+
+	/** Blocks until the given script has written all of its results or the job has finished. Returns false if the user cancelled the job. */
+	bool WaitForResult(const FString& ScriptName);
+
+	void Cancel();
+
+	bool IsFinished() const;
+	FString GetOutput() const;
+
+	/** What the scripts reported, read from their result file as the job runs */
+	const FBlenderResultReader& GetResult() const;
+
+	const FString& GetFilename() const;
+
+	/** How much memory (in bytes) the job's Blender process is using, or 0 if it's unknown or the job runs on the persistent worker */
+	uint64 GetMemoryUsage() const;
+
+private:
+	bool WaitUntil(TFunctionRef<bool()> Condition);
+	bool TickRun(float DeltaTime);
+	void CompleteRun(bool bSuccess);
+	void WaitForOutput(double Timeout);
+	bool StartProcess();
+	void DeleteEnvironmentFile();
+	void ResetResult();
+	void Finish(bool bSuccess);
+
+private:
+	FString Filename;
+	TArray<FString> ScriptPaths;
+	TMap<FString, FString> Environment;
+
+	FString ExecutablePath;
+	FString Parameters;
+
+	bool bOnWorker;
+	bool bPooled;
+	TUniquePtr<FBlenderProcess> Process;
+	FString EnvironmentFilename;
+	FString ResultFilename;
+	FBlenderResultReader Result;
+
+	FBlenderOutputBuffer OutputLines;
+	FOnFinished OnFinishedDelegate;
+
+	/** Set while the job is run by Run */
+	TOptional<TPromise<bool>> RunPromise;
+	TUniquePtr<FBlenderWatchdog> Watchdog;
+	#if ENGINE_MAJOR_VERSION >= 5
+		FTSTicker::FDelegateHandle TickerHandle;
+	#else
+		FDelegateHandle TickerHandle;
+	#endif
+
+	bool bStarted;
+	bool bFinished;
+	bool bSucceeded;
+};
@@ -0,0 +1,286 @@
+// Copyright 2022 nuclearfriend
+
+#include "BlenderJobPool.h"
+#include "BlendImporter.h"
+#include "BlendImporterSettings.h"
+#include "BlenderJob.h"
+#include "Misc/Paths.h"
+
+// Blender's own footprint, plus a multiple of the file size for the loaded and evaluated scene and the FBX being written
+static const uint64 BlenderBaseMemory = 512ull * 1024 * 1024;
+static const uint64 BlenderMemoryPerFileByte = 8;
+
+// The evaluated mesh, its normals and tangents, and the exporter's copy of it, per triangle exported
+static const uint64 BlenderMemoryPerTriangle = 1024;
+
+// The evaluated copy of each object and its FBX nodes, whatever its mesh
+static const uint64 BlenderMemoryPerObject = 64 * 1024;
+
+// How many files' exports are remembered, the least recently exported are forgotten beyond this
+static const int32 MaxJobHistory = 1024;
+
+/** What the last export of a file needed, by full filename */
+struct FBlenderJobHistory
+{
+    int64 NumTriangles = 0;
+    uint64 PeakMemoryUsage = 0;
+    uint64 Sequence = 0;
+};
+
+/** Guards the history and foreground jobs, as queued imports estimate their memory on background threads */
+static FCriticalSection JobStateLock;
+static TMap<FString, FBlenderJobHistory> JobHistory;
+static uint64 JobHistorySequence = 0;
+
+/** Jobs started outside of any pool, with the memory each was expected to need */
+static TMap<const FBlenderJob*, uint64> ForegroundJobs;
+
+FBlenderJobPool::FBlenderJobPool()
+    : bWaitingForMemory(false)
+{
+}
+
+FBlenderJobPool::~FBlenderJobPool()
+{
+    CancelAll();
+}
+
+void FBlenderJobPool::Add(TUniquePtr<FBlenderJob> Job, uint64 EstimatedMemory, FOnJobFinished OnFinished, FOnJobOutput OnOutput, EPriority Priority)
+{
+    PendingJobs.Add({ MoveTemp(Job), EstimatedMemory, MoveTemp(OnFinished), MoveTemp(OnOutput), Priority, 0, 0 });
+}
+
+bool FBlenderJobPool::Tick()
+{
+    bWaitingForMemory = false;
+    for (int32 NextIndex = GetNextPendingIndex(); NextIndex != INDEX_NONE; NextIndex = GetNextPendingIndex())
+    {
+        if (!CanStartJob(PendingJobs[NextIndex].EstimatedMemory))
+        {
+            break;
+        }
+
+        FEntry Entry = MoveTemp(PendingJobs[NextIndex]);
+        PendingJobs.RemoveAt(NextIndex);
+
+        Entry.Job->SetPooled();
+        if (Entry.Job->Start())
+        {
+            RunningJobs.Add(MoveTemp(Entry));
+        }
+        else
+        {
+            Entry.OnFinished.ExecuteIfBound(*Entry.Job, false);
+        }
+    }
+
+    for (int32 Index = 0; Index < RunningJobs.Num(); )
+    {
+        TArray<FString> Lines;
+        const bool bRunning = RunningJobs[Index].Job->Poll(Lines);
+        if (Lines.Num() > 0)
+        {
+            RunningJobs[Index].OnOutput.ExecuteIfBound(Lines);
+        }
+
+        if (bRunning)
+        {
+            FEntry& Entry = RunningJobs[Index];
+            Entry.MemoryUsage = Entry.Job->GetMemoryUsage();
+            Entry.PeakMemoryUsage = FMath::Max(Entry.PeakMemoryUsage, Entry.MemoryUsage);
+            Index++;
+            continue;
+        }
+
+        // Removed before the callback runs, as it may add more jobs
+        FEntry Entry = MoveTemp(RunningJobs[Index]);
+        RunningJobs.RemoveAt(Index);
+
+        FString Output;
+        const bool bSucceeded = Entry.Job->Wait(Output);
+        if (bSucceeded)
+        {
+            RememberJob(*Entry.Job, Entry.PeakMemoryUsage);
+        }
+        Entry.OnFinished.ExecuteIfBound(*Entry.Job, bSucceeded);
+    }
+
+    return PendingJobs.Num() > 0 || RunningJobs.Num() > 0;
+}
+
+void FBlenderJobPool::CancelAll()
+{
+    PendingJobs.Empty();
+    for (FEntry& Entry : RunningJobs)
+    {
+        Entry.Job->Cancel();
+    }
+    RunningJobs.Empty();
+    bWaitingForMemory = false;
+}
+
+int32 FBlenderJobPool::GetNumRunning() const
+{
+    return RunningJobs.Num();
+}
+
+int32 FBlenderJobPool::GetNumPending() const
+{
+    return PendingJobs.Num();
+}
+
+bool FBlenderJobPool::IsWaitingForMemory() const
+{
+    return bWaitingForMemory;
+}
+
+uint64 FBlenderJobPool::GetReservedMemory() const
+{
+    // Memory a job already uses is already missing from the free memory, so only the rest of its estimate is reserved
+    uint64 ReservedMemory = 0;
+    for (const FEntry& Entry : RunningJobs)
+    {
+        ReservedMemory += Entry.EstimatedMemory > Entry.MemoryUsage ? Entry.EstimatedMemory - Entry.MemoryUsage : 0;
+    }
+    return ReservedMemory;
+}
+
+uint64 FBlenderJobPool::EstimateJobMemory(const FString& Filename, int32 NumObjects, int64 NumTriangles)
+{
+    const FString FullFilename = FPaths::ConvertRelativePathToFull(Filename);
+    uint64 EstimatedMemory = BlenderBaseMemory + static_cast<uint64>(FMath::Max<int64>(IFileManager::Get().FileSize(*FullFilename), 0)) * BlenderMemoryPerFileByte;
+
+    // The analysis knows what's in the file before it's ever exported
+    if (NumObjects > 0 || NumTriangles > 0)
+    {
+        EstimatedMemory = FMath::Max(EstimatedMemory, BlenderBaseMemory + static_cast<uint64>(NumObjects) * BlenderMemoryPerObject + static_cast<uint64>(NumTriangles) * BlenderMemoryPerTriangle);
+    }
+
+    // A file exported before usually needs about as much again, small files with a lot of modifiers or instancing can need far more than their size suggests
+    FScopeLock Lock(&JobStateLock);
+    if (const FBlenderJobHistory* History = JobHistory.Find(FullFilename))
+    {
+        EstimatedMemory = FMath::Max(EstimatedMemory, BlenderBaseMemory + static_cast<uint64>(History->NumTriangles) * BlenderMemoryPerTriangle);
+        EstimatedMemory = FMath::Max(EstimatedMemory, History->PeakMemoryUsage + History->PeakMemoryUsage / 10);
+    }
+    return EstimatedMemory;
+}
+
+void FBlenderJobPool::AddForegroundJob(const FBlenderJob& Job)
+{
+    const uint64 EstimatedMemory = EstimateJobMemory(Job.GetFilename());
+
+    FScopeLock Lock(&JobStateLock);
+    ForegroundJobs.Add(&Job, EstimatedMemory);
+}
+
+void FBlenderJobPool::RemoveForegroundJob(const FBlenderJob& Job)
+{
+    FScopeLock Lock(&JobStateLock);
+    ForegroundJobs.Remove(&Job);
+}
+
+int32 FBlenderJobPool::GetNumForegroundJobs()
+{
+    FScopeLock Lock(&JobStateLock);
+    return ForegroundJobs.Num();
+}
+
+uint64 FBlenderJobPool::GetForegroundReservedMemory()
+{
+    // Jobs remove themselves before they're destroyed, while holding the lock
+    FScopeLock Lock(&JobStateLock);
+    uint64 ReservedMemory = 0;
+    for (const TPair<const FBlenderJob*, uint64>& ForegroundJob : ForegroundJobs)
+    {
+        const uint64 MemoryUsage = ForegroundJob.Key->GetMemoryUsage();
+        ReservedMemory += ForegroundJob.Value > MemoryUsage ? ForegroundJob.Value - MemoryUsage : 0;
+    }
+    return ReservedMemory;
+}
+
+int32 FBlenderJobPool::GetNextPendingIndex() const
+{
+    // Jobs start in the order they were added within each priority, so the callbacks run in roughly that order too
+    int32 NextIndex = INDEX_NONE;
+    for (int32 Index = 0; Index < PendingJobs.Num(); Index++)
+    {
+        if (NextIndex == INDEX_NONE || PendingJobs[Index].Priority < PendingJobs[NextIndex].Priority)
+        {
+            NextIndex = Index;
+        }
+    }
+    return NextIndex;
+}
+
+bool FBlenderJobPool::CanStartJob(uint64 EstimatedMemory)
+{
+    // Always allow one job, so a job estimated to need more than the free memory still gets to run
+    const int32 NumForegroundJobs = GetNumForegroundJobs();
+    if (RunningJobs.Num() == 0 && NumForegroundJobs == 0)
+    {
+        return true;
+    }
+
+    if (RunningJobs.Num() + NumForegroundJobs >= GetMaxRunningJobs())
+    {
+        return false;
+    }
+
+    // Running jobs may not have allocated all of their memory yet, so count the rest of their estimates against the free memory too
+    const uint64 AvailableMemory = FPlatformMemory::GetStats().AvailablePhysical;
+    if (AvailableMemory >= GetReservedMemory() + GetForegroundReservedMemory() + EstimatedMemory)
+    {
+        return true;
+    }
+
+    if (!bWaitingForMemory)
+    {
+        UE_LOG(LogBlendImporter, Verbose, TEXT("Waiting for memory to start another Blender job (%.1f GB needed, %.1f GB free, %.1f GB reserved by %d running jobs)"),
+            EstimatedMemory / (1024.0 * 1024.0 * 1024.0), AvailableMemory / (1024.0 * 1024.0 * 1024.0), GetReservedMemory() / (1024.0 * 1024.0 * 1024.0), RunningJobs.Num());
+    }
+    bWaitingForMemory = true;
+    return false;
+}
+
+int32 FBlenderJobPool::GetMaxRunningJobs() const
+{
+    UBlendImporterSettings* Settings = GetMutableDefault<UBlendImporterSettings>();
+    if (Settings->GetMaxConcurrentBlenderProcesses() > 0)
+    {
+        return Settings->GetMaxConcurrentBlenderProcesses();
+    }
+
+    // Exporting is mostly single threaded in Blender, leave a core for the editor
+    return FMath::Max(FPlatformMisc::NumberOfCores() - 1, 1);
+}
+
+void FBlenderJobPool::RememberJob(const FBlenderJob& Job, uint64 PeakMemoryUsage)
+{
+    int64 NumTriangles = 0;
+    for (const FBlendObjectStats& Object : Job.GetResult().GetExportedObjects())
+    {
+        NumTriangles += Object.NumTriangles;
+    }
+
+    FScopeLock Lock(&JobStateLock);
+    FBlenderJobHistory& History = JobHistory.FindOrAdd(Job.GetFilename());
+    History.NumTriangles = NumTriangles;
+    History.PeakMemoryUsage = PeakMemoryUsage;
+    History.Sequence = ++JobHistorySequence;
+
+    if (JobHistory.Num() > MaxJobHistory)
+    {
+        FString OldestFilename;
+        uint64 OldestSequence = MAX_uint64;
+        for (const TPair<FString, FBlenderJobHistory>& Entry : JobHistory)
+        {
+            if (Entry.Value.Sequence < OldestSequence)
+            {
+                OldestFilename = Entry.Key;
+                OldestSequence = Entry.Value.Sequence;
+            }
+        }
+        JobHistory.Remove(OldestFilename);
+    }
+}
@@ -0,0 +1,84 @@
+// Copyright 2022 nuclearfriend
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FBlenderJob;
+
+/**
+ * Runs queued Blender jobs in parallel, starting as many at once as the machine's cores and free memory allow.
+ * Driven by calling Tick, which starts jobs as others finish and runs each job's completion callback on the calling thread.
+ * Running jobs' Blender processes are measured where the platform allows, and what each file's export needed is remembered for estimating its next one.
+ * Blender processes started outside the pool are counted too, so they don't take the pool over its limits.
+ */
+class FBlenderJobPool
+{
+public:
+	DECLARE_DELEGATE_TwoParams(FOnJobFinished, FBlenderJob& /* Job */, bool /* bSucceeded */);
+	DECLARE_DELEGATE_OneParam(FOnJobOutput, const TArray<FString>& /* Lines */);
+
+	enum class EPriority : uint8
+	{
+		/** Imports someone is waiting for */
+		Interactive,
+		/** Exports ahead of reimports, only started once no interactive jobs are waiting */
+		Background,
+	};
+
+	FBlenderJobPool();
+	~FBlenderJobPool();
+
+	/** EstimatedMemory is how much memory (in bytes) the job is expected to need, used to avoid starting more jobs than fit in memory */
+	void Add(TUniquePtr<FBlenderJob> Job, uint64 EstimatedMemory, FOnJobFinished OnFinished, FOnJobOutput OnOutput = FOnJobOutput(), EPriority Priority = EPriority::Interactive);
+
+	/** Starts and polls jobs, returning false once all jobs have finished */
+	bool Tick();
+
+	void CancelAll();
+
+	int32 GetNumRunning() const;
+	int32 GetNumPending() const;
+
+	/** Whether the next pending job is held back because it doesn't fit in the free memory, rather than by the number of running jobs */
+	bool IsWaitingForMemory() const;
+
+	/** Memory (in bytes) the running jobs are expected to need on top of what they already use */
+	uint64 GetReservedMemory() const;
+
+	/**
+	 * Rough estimate of how much memory Blender needs to export the given .blend file, from its size, what its previous export needed,
+	 * and the object and triangle counts of its analysis if there is one
+	 */
+	static uint64 EstimateJobMemory(const FString& Filename, int32 NumObjects = 0, int64 NumTriangles = 0);
+
+	/** Jobs running in their own Blender process outside of any pool, such as the factory's blocking ones, which every pool counts against its limits */
+	static void AddForegroundJob(const FBlenderJob& Job);
+	static void RemoveForegroundJob(const FBlenderJob& Job);
+
+private:
+	int32 GetNextPendingIndex() const;
+	bool CanStartJob(uint64 EstimatedMemory);
+	int32 GetMaxRunningJobs() const;
+	static int32 GetNumForegroundJobs();
+	static uint64 GetForegroundReservedMemory();
+	static void RememberJob(const FBlenderJob& Job, uint64 PeakMemoryUsage);
+
+private:
+	struct FEntry
+	{
+		TUniquePtr<FBlenderJob> Job;
+		uint64 EstimatedMemory;
+		FOnJobFinished OnFinished;
+		FOnJobOutput OnOutput;
+		EPriority Priority;
+
+		/** Measured while the job runs, 0 where the platform can't measure it */
+		uint64 MemoryUsage;
+		uint64 PeakMemoryUsage;
+	};
+
+	TArray<FEntry> PendingJobs;
+	TArray<FEntry> RunningJobs;
+	bool bWaitingForMemory;
+};
@@ -0,0 +1,415 @@
+// Copyright 2022 nuclearfriend
+
+#include "BlenderProcess.h"
+#include "BlendImporter.h"
+#include "Async/Async.h"
+
+#if PLATFORM_WINDOWS
+    #include "Windows/AllowWindowsPlatformTypes.h"
+    #include <windows.h>
+    #include "Windows/HideWindowsPlatformTypes.h"
+#elif PLATFORM_LINUX
+    #include "Unix/UnixPlatformProcess.h"
+    #include <poll.h>
+#endif
+
+static const int32 BlenderReadBufferSize = 64 * 1024;
+
+FBlenderOutputBuffer::FBlenderOutputBuffer(int32 InCapacity)
+    : Capacity(FMath::Max(InCapacity, 1))
+    , Head(0)
+    , NumDropped(0)
+{
+}
+
+void FBlenderOutputBuffer::Add(FString Line)
+{
+    if (Lines.Num() < Capacity)
+    {
+        Lines.Add(MoveTemp(Line));
+        return;
+    }
+
+    // Overwrite the oldest line
+    Lines[Head] = MoveTemp(Line);
+    Head = (Head + 1) % Capacity;
+    NumDropped++;
+}
+
+void FBlenderOutputBuffer::Empty()
+{
+    Lines.Empty();
+    Head = 0;
+    NumDropped = 0;
+}
+
+TArray<FString> FBlenderOutputBuffer::GetLines() const
+{
+    TArray<FString> Ordered;
+    Ordered.Reserve(Lines.Num());
+    for (int32 Index = 0; Index < Lines.Num(); Index++)
+    {
+        Ordered.Add(Lines[(Head + Index) % Lines.Num()]);
+    }
+    return Ordered;
+}
+
+FString FBlenderOutputBuffer::ToString() const
+{
+    FString Output = FString::Join(GetLines(), TEXT("\n"));
+    if (NumDropped > 0)
+    {
+        Output = FString::Printf(TEXT("(%d earlier lines not shown)\n%s"), NumDropped, *Output);
+    }
+    return Output;
+}
+
+int32 FBlenderOutputBuffer::GetNumDropped() const
+{
+    return NumDropped;
+}
+
+FBlenderProcess::FBlenderProcess()
+    : ProcessId(0)
+    , StdOutReadPipe(nullptr)
+    , StdOutWritePipe(nullptr)
+    , StdInReadPipe(nullptr)
+    , StdInWritePipe(nullptr)
+    , ReaderThread(nullptr)
+    , bStopReader(false)
+    , bExited(false)
+    , ReturnCode(0)
+    , OutputEvent(FPlatformProcess::GetSynchEventFromPool(false))
+{
+}
+
+FBlenderProcess::~FBlenderProcess()
+{
+    Terminate();
+    FPlatformProcess::ReturnSynchEventToPool(OutputEvent);
+}
+
+bool FBlenderProcess::Launch(const FString& ExecutablePath, const FString& Parameters, bool bWithStdIn)
+{
+    Terminate();
+
+    if (!FPlatformProcess::CreatePipe(StdOutReadPipe, StdOutWritePipe))
+    {
+        UE_LOG(LogBlendImporter, Error, TEXT("Failed to create Pipes for Blender process"));
+        return false;
+    }
+
+    if (bWithStdIn && !FPlatformProcess::CreatePipe(StdInReadPipe, StdInWritePipe, /* bWritePipeLocal = */ true))
+    {
+        UE_LOG(LogBlendImporter, Error, TEXT("Failed to create Pipes for Blender process"));
+        ClosePipes();
+        return false;
+    }
+
+    ProcessHandle = FPlatformProcess::CreateProc(*ExecutablePath, *Parameters, /* bLaunchDetached = */ false, /* bLaunchHidden = */ true, /* bLaunchReallyHidden = */ true, &ProcessId, 0, nullptr, StdOutWritePipe, StdInReadPipe);
+    if (!ProcessHandle.IsValid())
+    {
+        UE_LOG(LogBlendImporter, Error, TEXT("There was an issue running Blender \"(%s)\". Check the path to the executable in your project settings."), *ExecutablePath);
+        ClosePipes();
+        return false;
+    }
+
+    // Blender has its own copy of the pipe ends it uses now, closing ours means reads see the end of the output when Blender exits
+    FPlatformProcess::ClosePipe(nullptr, StdOutWritePipe);
+    StdOutWritePipe = nullptr;
+    if (StdInReadPipe)
+    {
+        FPlatformProcess::ClosePipe(StdInReadPipe, nullptr);
+        StdInReadPipe = nullptr;
+    }
+
+    UE_LOG(LogBlendImporter, Log, TEXT("Running %s %s"), *ExecutablePath, *Parameters);
+
+    bStopReader = false;
+    bExited = false;
+    ExitPromise = MakeUnique<TPromise<int32>>();
+    ExitFuture = ExitPromise->GetFuture().Share();
+    Reader = Async(EAsyncExecution::Thread, [this]() { RunReader(); });
+    return true;
+}
+
+bool FBlenderProcess::IsRunning()
+{
+    return ProcessHandle.IsValid() && !bExited;
+}
+
+void FBlenderProcess::Terminate()
+{
+    if (ProcessHandle.IsValid())
+    {
+        if (!bExited)
+        {
+            FScopeLock Lock(&ProcessLock);
+            FPlatformProcess::TerminateProc(ProcessHandle, /* KillTree = */ true);
+        }
+
+        bStopReader = true;
+        if (Reader.IsValid())
+        {
+            #if PLATFORM_WINDOWS
+                // Blender is gone, but something it started may still hold its pipe open, so cancel the blocked read rather than wait on it
+                while (!Reader.WaitFor(FTimespan::FromMilliseconds(10)))
+                {
+                    FScopeLock Lock(&ProcessLock);
+                    if (ReaderThread)
+                    {
+                        ::CancelSynchronousIo(static_cast<HANDLE>(ReaderThread));
+                    }
+                }
+            #endif
+            Reader.Wait();
+            Reader.Reset();
+        }
+        FPlatformProcess::CloseProc(ProcessHandle);
+    }
+    ClosePipes();
+
+    FScopeLock Lock(&OutputLock);
+    PendingLines.Empty();
+    PartialLine.Empty();
+}
+
+int32 FBlenderProcess::GetReturnCode()
+{
+    return ReturnCode;
+}
+
+void FBlenderProcess::ReadLines(TArray<FString>& OutLines, bool bFlush)
+{
+    // Partial lines are only held back until the process exits, by the reader, so there's nothing more to flush here
+    FScopeLock Lock(&OutputLock);
+    OutLines.Append(MoveTemp(PendingLines));
+    PendingLines.Reset();
+}
+
+bool FBlenderProcess::WriteLine(const FString& Line)
+{
+    if (!StdInWritePipe)
+    {
+        return false;
+    }
+
+    // Written as raw UTF-8, as the FString overload of WritePipe truncates non-ASCII characters (e.g. in file paths)
+    FTCHARToUTF8 Converted(*(Line + TEXT("\n")));
+    int32 Written = 0;
+    return FPlatformProcess::WritePipe(StdInWritePipe, reinterpret_cast<const uint8*>(Converted.Get()), Converted.Length(), &Written) && Written == Converted.Length();
+}
+
+bool FBlenderProcess::WaitForOutput(double Timeout)
+{
+    {
+        FScopeLock Lock(&OutputLock);
+        if (PendingLines.Num() > 0 || bExited)
+        {
+            return true;
+        }
+    }
+    return OutputEvent->Wait(FTimespan::FromSeconds(Timeout));
+}
+
+TSharedFuture<int32> FBlenderProcess::GetExitFuture() const
+{
+    return ExitFuture;
+}
+
+FBlenderOutputBuffer FBlenderProcess::GetRecentOutput() const
+{
+    FScopeLock Lock(&OutputLock);
+    return RecentOutput;
+}
+
+uint64 FBlenderProcess::GetMemoryUsage() const
+{
+    // The id may belong to another process once this one has exited
+    SIZE_T MemoryUsage = 0;
+    if (ProcessId == 0 || bExited || !FPlatformProcess::GetApplicationMemoryUsage(ProcessId, &MemoryUsage))
+    {
+        return 0;
+    }
+    return MemoryUsage;
+}
+
+void FBlenderProcess::RunReader()
+{
+    TArray<uint8> Buffer;
+    Buffer.SetNumUninitialized(BlenderReadBufferSize);
+
+    #if PLATFORM_WINDOWS
+        {
+            FScopeLock Lock(&ProcessLock);
+            HANDLE ThreadHandle = nullptr;
+            ::DuplicateHandle(::GetCurrentProcess(), ::GetCurrentThread(), ::GetCurrentProcess(), &ThreadHandle, 0, FALSE, DUPLICATE_SAME_ACCESS);
+            ReaderThread = ThreadHandle;
+        }
+    #elif !PLATFORM_LINUX
+        float IdleSleep = 0.001f;
+    #endif
+
+    while (!bStopReader)
+    {
+        int32 BytesRead = 0;
+        bool bEndOfOutput = false;
+
+        #if PLATFORM_WINDOWS
+            // Blocks until Blender writes something, and fails once every write end is closed or Terminate cancels it
+            DWORD BytesReadFromPipe = 0;
+            if (::ReadFile(static_cast<HANDLE>(StdOutReadPipe), Buffer.GetData(), Buffer.Num(), &BytesReadFromPipe, nullptr))
+            {
+                BytesRead = BytesReadFromPipe;
+            }
+            else
+            {
+                bEndOfOutput = true;
+            }
+        #elif PLATFORM_LINUX
+            pollfd PollFd;
+            PollFd.fd = static_cast<FPipeHandle*>(StdOutReadPipe)->GetHandle();
+            PollFd.events = POLLIN;
+            PollFd.revents = 0;
+
+            // The timeout only matters if something other than Blender holds the pipe open after Blender exits
+            const int PollResult = poll(&PollFd, 1, 100);
+            if (PollResult > 0 && (PollFd.revents & POLLIN))
+            {
+                const ssize_t Result = read(PollFd.fd, Buffer.GetData(), Buffer.Num());
+                if (Result > 0)
+                {
+                    BytesRead = static_cast<int32>(Result);
+                }
+                else if (Result == 0)
+                {
+                    bEndOfOutput = true;
+                }
+            }
+            else if (PollResult > 0 && (PollFd.revents & (POLLHUP | POLLERR | POLLNVAL)))
+            {
+                bEndOfOutput = true;
+            }
+            else if (PollResult == 0 && !IsProcRunning())
+            {
+                bEndOfOutput = true;
+            }
+        #else
+            // Pipes can't be waited on here, so back off while Blender is quiet
+            TArray<uint8> Data;
+            if (FPlatformProcess::ReadPipeToArray(StdOutReadPipe, Data) && Data.Num() > 0)
+            {
+                ProcessOutput(Data.GetData(), Data.Num(), false);
+                IdleSleep = 0.001f;
+                continue;
+            }
+            else if (!IsProcRunning())
+            {
+                bEndOfOutput = true;
+            }
+            else
+            {
+                FPlatformProcess::Sleep(IdleSleep);
+                IdleSleep = FMath::Min(IdleSleep * 2.0f, 0.05f);
+            }
+        #endif
+
+        if (BytesRead > 0)
+        {
+            ProcessOutput(Buffer.GetData(), BytesRead, false);
+        }
+
+        if (bEndOfOutput)
+        {
+            break;
+        }
+    }
+
+    ProcessOutput(nullptr, 0, true);
+
+    #if PLATFORM_WINDOWS
+        {
+            FScopeLock Lock(&ProcessLock);
+            ::CloseHandle(static_cast<HANDLE>(ReaderThread));
+            ReaderThread = nullptr;
+        }
+    #endif
+
+    // Output ends when Blender closes its end of the pipe, which is at most just before it exits. Not waited on under the lock,
+    // as Terminate takes it to kill the process before it waits for this thread, which also ends this wait.
+    FPlatformProcess::WaitForProc(ProcessHandle);
+    int32 ExitCode = -1;
+    {
+        FScopeLock Lock(&ProcessLock);
+        FPlatformProcess::GetProcReturnCode(ProcessHandle, &ExitCode);
+    }
+    ReturnCode = ExitCode;
+
+    {
+        FScopeLock Lock(&OutputLock);
+        bExited = true;
+    }
+    ExitPromise->SetValue(ExitCode);
+    OutputEvent->Trigger();
+}
+
+bool FBlenderProcess::IsProcRunning()
+{
+    FScopeLock Lock(&ProcessLock);
+    return FPlatformProcess::IsProcRunning(ProcessHandle);
+}
+
+void FBlenderProcess::ProcessOutput(const uint8* Data, int32 Size, bool bFlush)
+{
+    TArray<FString> Lines;
+
+    int32 LineStart = 0;
+    for (int32 Index = 0; Index < Size; Index++)
+    {
+        if (Data[Index] == '\n')
+        {
+            PartialLine.Append(Data + LineStart, Index - LineStart);
+            LineStart = Index + 1;
+
+            if (PartialLine.Num() > 0 && PartialLine.Last() == '\r')
+            {
+                PartialLine.Pop(false);
+            }
+            FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(PartialLine.GetData()), PartialLine.Num());
+            Lines.Emplace(Converted.Length(), Converted.Get());
+            PartialLine.Reset();
+        }
+    }
+    PartialLine.Append(Data + LineStart, Size - LineStart);
+
+    if (bFlush && PartialLine.Num() > 0)
+    {
+        FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(PartialLine.GetData()), PartialLine.Num());
+        Lines.Emplace(Converted.Length(), Converted.Get());
+        PartialLine.Reset();
+    }
+
+    if (Lines.Num() > 0)
+    {
+        FScopeLock Lock(&OutputLock);
+        for (const FString& Line : Lines)
+        {
+            RecentOutput.Add(Line);
+        }
+        PendingLines.Append(MoveTemp(Lines));
+        OutputEvent->Trigger();
+    }
+}
+
+void FBlenderProcess::ClosePipes()
+{
+    if (StdOutReadPipe || StdOutWritePipe)
+    {
+        FPlatformProcess::ClosePipe(StdOutReadPipe, StdOutWritePipe);
+    }
+    if (StdInReadPipe || StdInWritePipe)
+    {
+        FPlatformProcess::ClosePipe(StdInReadPipe, StdInWritePipe);
+    }
+    StdOutReadPipe = StdOutWritePipe = StdInReadPipe = StdInWritePipe = nullptr;
+}
@@ -0,0 +1,99 @@
+// Copyright 2022 nuclearfriend
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+
+/** Keeps the most recent lines of Blender's output, for logging without holding on to everything a long run prints. */
+class FBlenderOutputBuffer
+{
+public:
+	explicit FBlenderOutputBuffer(int32 InCapacity = 1000);
+
+	void Add(FString Line);
+	void Empty();
+
+	/** The buffered lines, oldest first */
+	TArray<FString> GetLines() const;
+	FString ToString() const;
+
+	/** How many lines were dropped to stay within capacity */
+	int32 GetNumDropped() const;
+
+private:
+	TArray<FString> Lines;
+	int32 Capacity;
+	int32 Head;
+	int32 NumDropped;
+};
+
+/**
+ * A Blender child process with its console output captured line by line, and optionally a pipe to its stdin.
+ * Output is read on a dedicated thread as soon as Blender writes it (with poll() on Linux, blocking reads on Windows), so waiting on the process reacts
+ * to output and exit straight away instead of sleeping between checks.
+ */
+class FBlenderProcess
+{
+public:
+	FBlenderProcess();
+	~FBlenderProcess();
+
+	bool Launch(const FString& ExecutablePath, const FString& Parameters, bool bWithStdIn = false);
+
+	/** True until the process has exited and all of its output has been read */
+	bool IsRunning();
+	void Terminate();
+	int32 GetReturnCode();
+
+	/** Appends any complete lines Blender has written since the last call. Once the process has exited, a trailing partial line is included too. */
+	void ReadLines(TArray<FString>& OutLines, bool bFlush = false);
+	bool WriteLine(const FString& Line);
+
+	/** Blocks until Blender writes more output or exits, or the timeout passes. Returns false on timeout. */
+	bool WaitForOutput(double Timeout);
+
+	/** Set to the return code once the process has exited and all of its output has been read */
+	TSharedFuture<int32> GetExitFuture() const;
+
+	/** The most recent output, including lines already returned by ReadLines */
+	FBlenderOutputBuffer GetRecentOutput() const;
+
+	/** How much memory (in bytes) the process is using, or 0 if the platform can't tell */
+	uint64 GetMemoryUsage() const;
+
+private:
+	void RunReader();
+	void ProcessOutput(const uint8* Data, int32 Size, bool bFlush);
+	void ClosePipes();
+	bool IsProcRunning();
+
+private:
+	/** Checking on a process can change its handle's state (on Linux), and both the reader thread and Terminate do */
+	FCriticalSection ProcessLock;
+	FProcHandle ProcessHandle;
+	uint32 ProcessId;
+
+	void* StdOutReadPipe;
+	void* StdOutWritePipe;
+	void* StdInReadPipe;
+	void* StdInWritePipe;
+
+	TFuture<void> Reader;
+
+	/** The reader thread on Windows, so Terminate can cancel its blocked read. Guarded by ProcessLock. */
+	void* ReaderThread;
+	TAtomic<bool> bStopReader;
+	TAtomic<bool> bExited;
+	TAtomic<int32> ReturnCode;
+	TUniquePtr<TPromise<int32>> ExitPromise;
+	TSharedFuture<int32> ExitFuture;
+
+	/** Only touched by the reader thread */
+	TArray<uint8> PartialLine;
+
+	mutable FCriticalSection OutputLock;
+	TArray<FString> PendingLines;
+	FBlenderOutputBuffer RecentOutput;
+	FEvent* OutputEvent;
+};
@@ -0,0 +1,271 @@
+// Copyright 2022 nuclearfriend
+
+#include "BlenderResultReader.h"
+#include "BlendImporter.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+FBlenderResultReader::FBlenderResultReader(const FString& InFilename)
+{
+    Reset(InFilename);
+}
+
+void FBlenderResultReader::Reset(const FString& InFilename)
+{
+    Filename = InFilename;
+    Offset = 0;
+    PartialLine.Empty();
+    bFailed = false;
+    CurrentScript.Empty();
+    CompletedScripts.Empty();
+    Analysis = FBlendFileAnalysis();
+    AnalysedObjects.Empty();
+    ExportedObjects.Empty();
+    PackedImages.Empty();
+    Timings.Empty();
+    bUnchanged = false;
+}
+
+bool FBlenderResultReader::Update()
+{
+    if (bFailed || Filename.IsEmpty())
+    {
+        return !bFailed;
+    }
+
+    // Blender appends to the file while it's open here
+    TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*Filename, FILEREAD_AllowWrite | FILEREAD_Silent));
+    if (!Reader.IsValid() || Reader->TotalSize() <= Offset)
+    {
+        return true;
+    }
+
+    TArray<uint8> Data;
+    Data.SetNumUninitialized(Reader->TotalSize() - Offset);
+    Reader->Seek(Offset);
+    Reader->Serialize(Data.GetData(), Data.Num());
+    Reader.Reset();
+    Offset += Data.Num();
+
+    // Only complete lines are parsed, the rest is kept until the script finishes writing it
+    int32 LineStart = 0;
+    for (int32 Index = 0; Index < Data.Num() && !bFailed; Index++)
+    {
+        if (Data[Index] != '\n')
+        {
+            continue;
+        }
+
+        PartialLine.Append(Data.GetData() + LineStart, Index - LineStart);
+        LineStart = Index + 1;
+
+        FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(PartialLine.GetData()), PartialLine.Num());
+        const FString Line(Converted.Length(), Converted.Get());
+        PartialLine.Reset();
+
+        if (!Line.TrimStartAndEnd().IsEmpty() && !ParseLine(Line))
+        {
+            bFailed = true;
+        }
+    }
+    PartialLine.Append(Data.GetData() + LineStart, Data.Num() - LineStart);
+
+    return !bFailed;
+}
+
+bool FBlenderResultReader::HasCompleted(const FString& ScriptName) const
+{
+    return CompletedScripts.Contains(ScriptName);
+}
+
+const FBlendFileAnalysis& FBlenderResultReader::GetAnalysis() const
+{
+    return Analysis;
+}
+
+const TArray<FBlendObjectStats>& FBlenderResultReader::GetAnalysedObjects() const
+{
+    return AnalysedObjects;
+}
+
+const TArray<FBlendObjectStats>& FBlenderResultReader::GetExportedObjects() const
+{
+    return ExportedObjects;
+}
+
+TMap<FString, FString> FBlenderResultReader::GetExportedFingerprints() const
+{
+    TMap<FString, FString> Fingerprints;
+    for (const FBlendObjectStats& Object : ExportedObjects)
+    {
+        Fingerprints.Add(Object.Name, Object.Fingerprint);
+    }
+    return Fingerprints;
+}
+
+const TArray<FBlendPackedImage>& FBlenderResultReader::GetPackedImages() const
+{
+    return PackedImages;
+}
+
+bool FBlenderResultReader::IsUnchanged() const
+{
+    return bUnchanged;
+}
+
+const TMap<FString, double>& FBlenderResultReader::GetTimings() const
+{
+    return Timings;
+}
+
+FString FBlenderResultReader::GetExportSummary() const
+{
+    int64 NumVertices = 0;
+    int64 NumTriangles = 0;
+    for (const FBlendObjectStats& Object : ExportedObjects)
+    {
+        NumVertices += Object.NumVertices;
+        NumTriangles += Object.NumTriangles;
+    }
+
+    FString Summary = FString::Printf(TEXT("%d objects, %lld vertices, %lld triangles"), ExportedObjects.Num(), NumVertices, NumTriangles);
+    if (PackedImages.Num() > 0)
+    {
+        Summary += FString::Printf(TEXT(", %d packed images"), PackedImages.Num());
+    }
+    for (const TPair<FString, double>& Timing : Timings)
+    {
+        Summary += FString::Printf(TEXT(", %s %.2fs"), *Timing.Key, Timing.Value);
+    }
+    return Summary;
+}
+
+bool FBlenderResultReader::ParseLine(const FString& Line)
+{
+    TSharedPtr<FJsonObject> Message;
+    TSharedRef<TJsonReader<TCHAR>> JsonReader = TJsonReaderFactory<TCHAR>::Create(Line);
+    if (!FJsonSerializer::Deserialize(JsonReader, Message) || !Message.IsValid())
+    {
+        UE_LOG(LogBlendImporter, Error, TEXT("Could not read result from Blender: %s"), *Line);
+        return false;
+    }
+    return ReadMessage(Message.ToSharedRef());
+}
+
+bool FBlenderResultReader::ReadMessage(const TSharedRef<FJsonObject>& Message)
+{
+    const FString Type = Message->GetStringField(TEXT("type"));
+
+    if (Type == TEXT("begin"))
+    {
+        const int32 Version = static_cast<int32>(Message->GetNumberField(TEXT("protocol")));
+        if (Version != ProtocolVersion)
+        {
+            UE_LOG(LogBlendImporter, Error, TEXT("Blender script results use protocol version %d, but version %d is expected. Check the plugin's scripts are from the same version as the plugin."), Version, ProtocolVersion);
+            return false;
+        }
+        CurrentScript = Message->GetStringField(TEXT("script"));
+    }
+    else if (Type == TEXT("end"))
+    {
+        CompletedScripts.Add(Message->GetStringField(TEXT("script")));
+        CurrentScript.Empty();
+    }
+    else if (Type == TEXT("collections"))
+    {
+        Message->TryGetStringArrayField(TEXT("names"), Analysis.Collections);
+    }
+    else if (Type == TEXT("material_issues"))
+    {
+        FBlendMaterialIssues& Issues = Analysis.MaterialIssues.AddDefaulted_GetRef();
+        Issues.MaterialName = Message->GetStringField(TEXT("material"));
+        Message->TryGetStringArrayField(TEXT("issues"), Issues.Issues);
+    }
+    else if (Type == TEXT("packed_images"))
+    {
+        Analysis.bHasPackedImages = true;
+    }
+    else if (Type == TEXT("material_count"))
+    {
+        Analysis.NumMaterials = static_cast<int32>(Message->GetNumberField(TEXT("count")));
+    }
+    else if (Type == TEXT("material_template"))
+    {
+        FBlendMaterialTemplate& Template = Analysis.MaterialTemplates.AddDefaulted_GetRef();
+        Template.MaterialName = Message->GetStringField(TEXT("material"));
+        Template.Template = Message->GetStringField(TEXT("template"));
+
+        const TSharedPtr<FJsonObject>* Colors = nullptr;
+        if (Message->TryGetObjectField(TEXT("colors"), Colors))
+        {
+            for (const TPair<FString, TSharedPtr<FJsonValue>>& Color : (*Colors)->Values)
+            {
+                const TArray<TSharedPtr<FJsonValue>>& Values = Color.Value->AsArray();
+                if (Values.Num() == 4)
+                {
+                    Template.Colors.Add(Color.Key, FLinearColor(Values[0]->AsNumber(), Values[1]->AsNumber(), Values[2]->AsNumber(), Values[3]->AsNumber()));
+                }
+            }
+        }
+
+        const TSharedPtr<FJsonObject>* Scalars = nullptr;
+        if (Message->TryGetObjectField(TEXT("scalars"), Scalars))
+        {
+            for (const TPair<FString, TSharedPtr<FJsonValue>>& Scalar : (*Scalars)->Values)
+            {
+                Template.Scalars.Add(Scalar.Key, Scalar.Value->AsNumber());
+            }
+        }
+
+        const TSharedPtr<FJsonObject>* Textures = nullptr;
+        if (Message->TryGetObjectField(TEXT("textures"), Textures))
+        {
+            for (const TPair<FString, TSharedPtr<FJsonValue>>& Texture : (*Textures)->Values)
+            {
+                FBlendTemplateTexture& TemplateTexture = Template.Textures.Add(Texture.Key);
+                Texture.Value->AsObject()->TryGetStringField(TEXT("file"), TemplateTexture.Filename);
+                Texture.Value->AsObject()->TryGetStringField(TEXT("packed"), TemplateTexture.PackedHash);
+            }
+        }
+    }
+    else if (Type == TEXT("object"))
+    {
+        // Objects are reported by whichever script is running
+        FBlendObjectStats& Object = (CurrentScript == TEXT("blender_export") ? ExportedObjects : AnalysedObjects).AddDefaulted_GetRef();
+        Object.Name = Message->GetStringField(TEXT("name"));
+        Object.ObjectType = Message->GetStringField(TEXT("object_type"));
+        Message->TryGetStringArrayField(TEXT("collections"), Object.Collections);
+        Message->TryGetNumberField(TEXT("vertices"), Object.NumVertices);
+        Message->TryGetNumberField(TEXT("triangles"), Object.NumTriangles);
+        Message->TryGetNumberField(TEXT("materials"), Object.NumMaterials);
+        Message->TryGetStringField(TEXT("fingerprint"), Object.Fingerprint);
+
+        if (CurrentScript != TEXT("blender_export"))
+        {
+            Analysis.NumObjects++;
+            Analysis.NumTriangles += Object.NumTriangles;
+        }
+    }
+    else if (Type == TEXT("packed_image"))
+    {
+        FBlendPackedImage& Image = PackedImages.AddDefaulted_GetRef();
+        Image.Name = Message->GetStringField(TEXT("name"));
+        Image.Hash = Message->GetStringField(TEXT("hash"));
+        Image.Filename = Message->GetStringField(TEXT("file"));
+    }
+    else if (Type == TEXT("unchanged"))
+    {
+        bUnchanged = true;
+    }
+    else if (Type == TEXT("timing"))
+    {
+        Timings.Add(Message->GetStringField(TEXT("stage")), Message->GetNumberField(TEXT("seconds")));
+    }
+    else
+    {
+        // Newer scripts may send messages this version doesn't use, which is fine within the same protocol version
+        UE_LOG(LogBlendImporter, Verbose, TEXT("Ignoring Blender result '%s'"), *Type);
+    }
+    return true;
+}
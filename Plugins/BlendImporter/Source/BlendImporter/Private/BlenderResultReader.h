@@ -0,0 +1,92 @@
+// Copyright 2022 nuclearfriend
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BlendFileAnalysis.h"
+
+class FJsonObject;
+
+/** Stats for one object, as reported by the scripts, for estimating how long imports will take */
+struct FBlendObjectStats
+{
+	FString Name;
+	FString ObjectType;
+	TArray<FString> Collections;
+	int64 NumVertices = 0;
+	int64 NumTriangles = 0;
+	int32 NumMaterials = 0;
+
+	/** Changes whenever anything the export uses from the object changes. Only reported by the export. */
+	FString Fingerprint;
+};
+
+/** A packed image the export wrote to the texture cache, for the FBX to reference instead of embedding it */
+struct FBlendPackedImage
+{
+	FString Name;
+	FString Hash;
+	FString Filename;
+};
+
+/**
+ * Reads the results blender_analyse.py and blender_export.py write to their result file, one JSON object per line.
+ * The file is read incrementally while Blender is still writing it, so results can be used before the job finishes.
+ */
+class FBlenderResultReader
+{
+public:
+	/** The version of the messages this reader understands, which must match PROTOCOL_VERSION in the scripts */
+	static const int32 ProtocolVersion = 1;
+
+	explicit FBlenderResultReader(const FString& InFilename = FString());
+
+	void Reset(const FString& InFilename);
+
+	/** Reads any messages written since the last call. Returns false once a message couldn't be read, which is logged. */
+	bool Update();
+
+	/** True once the given script (e.g. "blender_analyse") has written all of its results */
+	bool HasCompleted(const FString& ScriptName) const;
+
+	const FBlendFileAnalysis& GetAnalysis() const;
+
+	/** Objects reported by the analysis, and by the export for the objects it exported */
+	const TArray<FBlendObjectStats>& GetAnalysedObjects() const;
+	const TArray<FBlendObjectStats>& GetExportedObjects() const;
+
+	/** Fingerprints of the exported objects, by object name */
+	TMap<FString, FString> GetExportedFingerprints() const;
+
+	/** Packed images the export extracted to the texture cache */
+	const TArray<FBlendPackedImage>& GetPackedImages() const;
+
+	/** True if the export was skipped, as none of the objects changed since the fingerprints it was given */
+	bool IsUnchanged() const;
+
+	/** How long (in seconds) each stage took in Blender, e.g. "startup", "open", "evaluate" and "export" */
+	const TMap<FString, double>& GetTimings() const;
+
+	/** A one line summary of the exported objects and timings, for the log */
+	FString GetExportSummary() const;
+
+private:
+	bool ParseLine(const FString& Line);
+	bool ReadMessage(const TSharedRef<FJsonObject>& Message);
+
+private:
+	FString Filename;
+	int64 Offset;
+	TArray<uint8> PartialLine;
+	bool bFailed;
+
+	FString CurrentScript;
+	TSet<FString> CompletedScripts;
+
+	FBlendFileAnalysis Analysis;
+	TArray<FBlendObjectStats> AnalysedObjects;
+	TArray<FBlendObjectStats> ExportedObjects;
+	TArray<FBlendPackedImage> PackedImages;
+	TMap<FString, double> Timings;
+	bool bUnchanged;
+};
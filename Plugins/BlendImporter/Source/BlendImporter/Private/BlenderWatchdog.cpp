@@ -0,0 +1,103 @@
+// Copyright 2022 nuclearfriend
+
+#include "BlenderWatchdog.h"
+#include "BlendImporterSettings.h"
+#include "Framework/Application/SlateApplication.h"
+#include "Framework/Notifications/NotificationManager.h"
+#include "Widgets/Notifications/SNotificationList.h"
+
+#define LOCTEXT_NAMESPACE "BlenderWatchdog"
+
+FBlenderWatchdog::FBlenderWatchdog(const FString& InFilename)
+    : Filename(InFilename)
+    , State(MakeShared<FState>())
+{
+    UBlendImporterSettings* Settings = GetMutableDefault<UBlendImporterSettings>();
+    WarningTime = FPlatformTime::Seconds() + Settings->GetUnresponsiveWarningDuration();
+}
+
+FBlenderWatchdog::~FBlenderWatchdog()
+{
+    HideNotification();
+}
+
+bool FBlenderWatchdog::Tick()
+{
+    if (State->bCancel)
+    {
+        HideNotification();
+        return false;
+    }
+
+    if (State->bKeepWaiting)
+    {
+        HideNotification();
+        State->bKeepWaiting = false;
+
+        UBlendImporterSettings* Settings = GetMutableDefault<UBlendImporterSettings>();
+        WarningTime = FPlatformTime::Seconds() + Settings->GetUnresponsiveWarningDuration();
+    }
+
+    if (!Notification.IsValid() && FPlatformTime::Seconds() > WarningTime)
+    {
+        ShowNotification();
+    }
+    return true;
+}
+
+void FBlenderWatchdog::SetStatus(const FString& Status)
+{
+    #if ENGINE_MAJOR_VERSION >= 5
+        if (Notification.IsValid() && !Status.IsEmpty())
+        {
+            Notification->SetSubText(FText::FromString(Status.Left(200)));
+        }
+    #endif
+}
+
+void FBlenderWatchdog::ShowNotification()
+{
+    if (!FSlateApplication::IsInitialized())
+    {
+        return;
+    }
+
+    FNotificationInfo Info(FText::Format(LOCTEXT("BlenderSlow", "Blender is taking a while to process '{0}'"), FText::FromString(FPaths::GetCleanFilename(Filename))));
+    #if ENGINE_MAJOR_VERSION >= 5
+        Info.SubText = LOCTEXT("BlenderSlowDetails", "If your Blender has become unresponsive, there may be a problem with your Blender setup. For large files, you can increase the unresponsive warning duration in the settings.");
+    #endif
+    Info.bFireAndForget = false;
+    Info.bUseThrobber = true;
+    Info.FadeOutDuration = 0.5f;
+    Info.ExpireDuration = 0.0f;
+
+    TSharedRef<FState> NotificationState = State;
+    Info.ButtonDetails.Add(FNotificationButtonInfo(
+        LOCTEXT("KeepWaiting", "Keep Waiting"),
+        LOCTEXT("KeepWaitingTooltip", "Hide this warning until Blender has taken another unresponsive warning duration"),
+        FSimpleDelegate::CreateLambda([NotificationState]() { NotificationState->bKeepWaiting = true; }),
+        SNotificationItem::CS_Pending));
+    Info.ButtonDetails.Add(FNotificationButtonInfo(
+        LOCTEXT("Cancel", "Cancel"),
+        LOCTEXT("CancelTooltip", "Stop Blender and cancel the import"),
+        FSimpleDelegate::CreateLambda([NotificationState]() { NotificationState->bCancel = true; }),
+        SNotificationItem::CS_Pending));
+
+    Notification = FSlateNotificationManager::Get().AddNotification(Info);
+    if (Notification.IsValid())
+    {
+        Notification->SetCompletionState(SNotificationItem::CS_Pending);
+    }
+}
+
+void FBlenderWatchdog::HideNotification()
+{
+    if (Notification.IsValid())
+    {
+        Notification->SetCompletionState(State->bCancel ? SNotificationItem::CS_Fail : SNotificationItem::CS_None);
+        Notification->ExpireAndFadeout();
+        Notification.Reset();
+    }
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,40 @@
+// Copyright 2022 nuclearfriend
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class SNotificationItem;
+
+/**
+ * Watches a Blender job running in the background, and once it has run longer than the unresponsive warning duration, shows a notification
+ * offering to keep waiting or to cancel the job. The notification is non-modal, and is ticked along with the job, so the editor stays usable.
+ */
+class FBlenderWatchdog
+{
+public:
+	explicit FBlenderWatchdog(const FString& Filename);
+	~FBlenderWatchdog();
+
+	/** Shows the notification once due. Returns false once the user has chosen to cancel. */
+	bool Tick();
+
+	/** Shows the last line Blender wrote on the notification */
+	void SetStatus(const FString& Status);
+
+private:
+	void ShowNotification();
+	void HideNotification();
+
+private:
+	struct FState
+	{
+		bool bKeepWaiting = false;
+		bool bCancel = false;
+	};
+
+	FString Filename;
+	double WarningTime;
+	TSharedRef<FState> State;
+	TSharedPtr<SNotificationItem> Notification;
+};
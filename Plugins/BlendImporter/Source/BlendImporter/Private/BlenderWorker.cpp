@@ -0,0 +1,240 @@
+// Copyright 2022 nuclearfriend
+
+#include "BlenderWorker.h"
+#include "BlendImporter.h"
+#include "BlendImporterSettings.h"
+#include "BlenderProcess.h"
+#include "Interfaces/IPluginManager.h"
+#include "Policies/CondensedJsonPrintPolicy.h"
+#include "Serialization/JsonWriter.h"
+
+static const TCHAR* WorkerMarker = TEXT("@@BLENDIMPORTER|");
+static const double WorkerHealthCheckTimeout = 5.0;
+static const int32 WorkerMaxFailedLaunches = 3;
+
+FBlenderWorker::FBlenderWorker()
+    : NextJobId(1)
+    , ActiveJobId(INDEX_NONE)
+    , bActiveJobStarted(false)
+    , FailedLaunches(0)
+{
+}
+
+FBlenderWorker::~FBlenderWorker()
+{
+    Shutdown();
+}
+
+bool FBlenderWorker::BeginJob(const FString& ExecutablePath, const FString& Parameters, const FString& Filename, const TArray<FString>& ScriptPaths, const TMap<FString, FString>& Environment)
+{
+    if (IsBusy() || !EnsureRunning(ExecutablePath, Parameters))
+    {
+        return false;
+    }
+
+    const int32 JobId = NextJobId++;
+
+    FString Job;
+    TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> Writer = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&Job);
+    Writer->WriteObjectStart();
+    Writer->WriteValue(TEXT("id"), JobId);
+    Writer->WriteValue(TEXT("file"), Filename);
+    Writer->WriteArrayStart(TEXT("scripts"));
+    for (const FString& ScriptPath : ScriptPaths)
+    {
+        Writer->WriteValue(ScriptPath);
+    }
+    Writer->WriteArrayEnd();
+    Writer->WriteObjectStart(TEXT("env"));
+    for (const TPair<FString, FString>& Variable : Environment)
+    {
+        Writer->WriteValue(Variable.Key, Variable.Value);
+    }
+    Writer->WriteObjectEnd();
+    Writer->WriteObjectEnd();
+    Writer->Close();
+
+    if (!Process->WriteLine(Job))
+    {
+        UE_LOG(LogBlendImporter, Warning, TEXT("Failed to send job to the Blender worker."));
+        Shutdown();
+        return false;
+    }
+
+    UE_LOG(LogBlendImporter, Log, TEXT("Running job %d on \"%s\" in the Blender worker"), JobId, *Filename);
+
+    ActiveJobId = JobId;
+    bActiveJobStarted = false;
+    return true;
+}
+
+EBlenderWorkerJobState FBlenderWorker::PollJob(TArray<FString>& OutLines)
+{
+    if (ActiveJobId == INDEX_NONE || !Process.IsValid())
+    {
+        ActiveJobId = INDEX_NONE;
+        return EBlenderWorkerJobState::Lost;
+    }
+
+    const FString BeginMarker = FString::Printf(TEXT("%sBEGIN|%d"), WorkerMarker, ActiveJobId);
+    const FString EndMarker = FString::Printf(TEXT("%sEND|%d|"), WorkerMarker, ActiveJobId);
+    const bool bRunning = Process->IsRunning();
+
+    TArray<FString> Lines;
+    Process->ReadLines(Lines, !bRunning);
+    for (const FString& Line : Lines)
+    {
+        if (Line == BeginMarker)
+        {
+            bActiveJobStarted = true;
+        }
+        else if (Line.StartsWith(EndMarker))
+        {
+            UE_LOG(LogBlendImporter, Log, TEXT("Blender worker job %d finished, Script Succeeded: %s"), ActiveJobId, Line.EndsWith(TEXT("|1")) ? TEXT("true") : TEXT("false"));
+            ActiveJobId = INDEX_NONE;
+            return EBlenderWorkerJobState::Completed;
+        }
+        else if (bActiveJobStarted)
+        {
+            OutLines.Add(Line);
+        }
+    }
+
+    if (!bRunning)
+    {
+        UE_LOG(LogBlendImporter, Warning, TEXT("Blender worker exited unexpectedly (Return Code: %d) while running job %d."), Process->GetReturnCode(), ActiveJobId);
+        Process.Reset();
+        ActiveJobId = INDEX_NONE;
+        return EBlenderWorkerJobState::Lost;
+    }
+
+    return EBlenderWorkerJobState::Running;
+}
+
+void FBlenderWorker::CancelJob()
+{
+    if (IsBusy())
+    {
+        UE_LOG(LogBlendImporter, Log, TEXT("Stopping Blender worker to cancel job %d"), ActiveJobId);
+        Process.Reset();
+        ActiveJobId = INDEX_NONE;
+    }
+}
+
+void FBlenderWorker::WaitForOutput(double Timeout)
+{
+    if (Process.IsValid())
+    {
+        Process->WaitForOutput(Timeout);
+    }
+}
+
+bool FBlenderWorker::IsBusy() const
+{
+    return ActiveJobId != INDEX_NONE;
+}
+
+void FBlenderWorker::Shutdown()
+{
+    ActiveJobId = INDEX_NONE;
+
+    if (Process.IsValid())
+    {
+        if (Process->IsRunning() && Process->WriteLine(TEXT("QUIT")))
+        {
+            Process->GetExitFuture().WaitFor(FTimespan::FromSeconds(2.0));
+        }
+        Process.Reset();
+    }
+}
+
+bool FBlenderWorker::EnsureRunning(const FString& ExecutablePath, const FString& Parameters)
+{
+    if (Process.IsValid() && Process->IsRunning())
+    {
+        if (ExecutablePath == LaunchedExecutablePath && Parameters == LaunchedParameters)
+        {
+            if (Process->WriteLine(TEXT("PING")) && WaitForMarker(TEXT("PONG"), WorkerHealthCheckTimeout))
+            {
+                return true;
+            }
+            UE_LOG(LogBlendImporter, Warning, TEXT("Blender worker failed its health check, restarting it."));
+        }
+        else
+        {
+            UE_LOG(LogBlendImporter, Log, TEXT("Blender settings have changed, restarting the Blender worker."));
+        }
+    }
+
+    // Stop retrying after repeated failures, so a broken Blender setup doesn't add a startup timeout to every import
+    if (FailedLaunches >= WorkerMaxFailedLaunches)
+    {
+        return false;
+    }
+
+    if (!Launch(ExecutablePath, Parameters))
+    {
+        FailedLaunches++;
+        UE_LOG(LogBlendImporter, Warning, TEXT("Failed to start the Blender worker (attempt %d of %d)."), FailedLaunches, WorkerMaxFailedLaunches);
+        return false;
+    }
+
+    FailedLaunches = 0;
+    return true;
+}
+
+bool FBlenderWorker::Launch(const FString& ExecutablePath, const FString& Parameters)
+{
+    Shutdown();
+
+    FString PluginPath = IPluginManager::Get().FindPlugin(TEXT("BlendImporter"))->GetBaseDir();
+    FString WorkerScriptPath = FPaths::ConvertRelativePathToFull(PluginPath + TEXT("/Scripts/blender_worker.py"));
+
+    Process = MakeUnique<FBlenderProcess>();
+    if (!Process->Launch(ExecutablePath, FString::Printf(TEXT("%s -P \"%s\""), *Parameters, *WorkerScriptPath), /* bWithStdIn = */ true))
+    {
+        Process.Reset();
+        return false;
+    }
+
+    UBlendImporterSettings* Settings = GetMutableDefault<UBlendImporterSettings>();
+    if (!WaitForMarker(TEXT("READY"), Settings->GetUnresponsiveWarningDuration()))
+    {
+        Process.Reset();
+        return false;
+    }
+
+    LaunchedExecutablePath = ExecutablePath;
+    LaunchedParameters = Parameters;
+    return true;
+}
+
+bool FBlenderWorker::WaitForMarker(const FString& Marker, double Timeout)
+{
+    const FString ExpectedLine = WorkerMarker + Marker;
+    const double EndTime = FPlatformTime::Seconds() + Timeout;
+
+    while (FPlatformTime::Seconds() < EndTime)
+    {
+        const bool bRunning = Process->IsRunning();
+
+        TArray<FString> Lines;
+        Process->ReadLines(Lines, !bRunning);
+        for (const FString& Line : Lines)
+        {
+            if (Line == ExpectedLine)
+            {
+                return true;
+            }
+            UE_LOG(LogBlendImporter, Verbose, TEXT("Blender worker: %s"), *Line);
+        }
+
+        if (!bRunning)
+        {
+            return false;
+        }
+
+        Process->WaitForOutput(FMath::Max(EndTime - FPlatformTime::Seconds(), 0.0));
+    }
+    return false;
+}
@@ -0,0 +1,56 @@
+// Copyright 2022 nuclearfriend
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FBlenderProcess;
+
+enum class EBlenderWorkerJobState : uint8
+{
+	Running,
+	/** The scripts ran to completion (which may still include Python errors, as with a spawned Blender) */
+	Completed,
+	/** The worker crashed or was stopped, the caller should fall back to spawning Blender itself */
+	Lost,
+};
+
+/**
+ * A long-lived Blender process running Scripts/blender_worker.py, which keeps Blender and its addons loaded between imports.
+ * Jobs are sent as single JSON lines over stdin, and their output is bracketed by marker lines on stdout.
+ * The worker runs one job at a time.
+ */
+class FBlenderWorker
+{
+public:
+	FBlenderWorker();
+	~FBlenderWorker();
+
+	/** Sends a job to the worker, starting or restarting it as needed. Returns false if the worker is unavailable. */
+	bool BeginJob(const FString& ExecutablePath, const FString& Parameters, const FString& Filename, const TArray<FString>& ScriptPaths, const TMap<FString, FString>& Environment);
+	EBlenderWorkerJobState PollJob(TArray<FString>& OutLines);
+	/** Jobs can't be interrupted, so this stops the worker, and it will be restarted for the next job */
+	void CancelJob();
+
+	/** Blocks until the worker writes more output or exits, or the timeout passes */
+	void WaitForOutput(double Timeout);
+
+	bool IsBusy() const;
+	void Shutdown();
+
+private:
+	bool EnsureRunning(const FString& ExecutablePath, const FString& Parameters);
+	bool Launch(const FString& ExecutablePath, const FString& Parameters);
+	bool WaitForMarker(const FString& Marker, double Timeout);
+
+private:
+	TUniquePtr<FBlenderProcess> Process;
+
+	FString LaunchedExecutablePath;
+	FString LaunchedParameters;
+
+	int32 NextJobId;
+	int32 ActiveJobId;
+	bool bActiveJobStarted;
+	int32 FailedLaunches;
+};
@@ -2,9 +2,11 @@
 
 
 #include "SBlendAssetImportDialog.h"
+#include "BlendAssetFactory.h"
 #include "SlateOptMacros.h"
 #include "Widgets/Layout/SUniformGridPanel.h"
 #include "Widgets/Input/SComboBox.h"
+#include "Widgets/Input/SSpinBox.h"
 #include "IStructureDetailsView.h"
 
 #if ENGINE_MAJOR_VERSION >= 5
@@ -27,6 +29,8 @@ void SBlendAssetImportDialog::Construct(const FArguments& InArgs)
 {
 	Collections = InArgs._Collections;
 	UseObjectPivot = false;
+	NumLODs = InArgs._PreviousOptions->NumLODs;
+	LODReductionRatio = InArgs._PreviousOptions->LODReductionRatio;
 
 	TSharedPtr<SComboBox<TSharedPtr<FString>>> ObjectPivotComboBox;
 	TSharedPtr<SWidget> MaterialWarning;
@@ -135,6 +139,68 @@ void SBlendAssetImportDialog::Construct(const FArguments& InArgs)
 					]
 				]
 			]
+
+			+SVerticalBox::Slot()
+			.AutoHeight()
+			.Padding(5)
+			[
+				SNew(SHorizontalBox)
+				.ToolTipText(FText::FromString("LODs\nHow many LODs to generate in Blender for each static mesh, including the mesh itself. The LODs are made with a Decimate modifier."))
+				+SHorizontalBox::Slot()
+				.VAlign(VAlign_Center)
+				[
+					SNew(STextBlock)
+					.Text(FText::FromString("LODs"))
+					.Font(GetSlateStyle().GetFontStyle("PropertyWindow.NormalFont"))
+				]
+				+ SHorizontalBox::Slot()
+				.VAlign(VAlign_Center)
+				.HAlign(HAlign_Right)
+				.AutoWidth()
+				[
+					SNew(SBox)
+					.WidthOverride(80.0f)
+					[
+						SNew(SSpinBox<int32>)
+						.MinValue(1)
+						.MaxValue(UBlendImportOptions::MaxLODs)
+						.Value_Lambda([this]() { return NumLODs; })
+						.OnValueChanged_Lambda([this](int32 InValue) { NumLODs = InValue; })
+					]
+				]
+			]
+
+			+SVerticalBox::Slot()
+			.AutoHeight()
+			.Padding(5)
+			[
+				SNew(SHorizontalBox)
+				.ToolTipText(FText::FromString("LOD Reduction\nThe fraction of the previous LOD's triangles each generated LOD keeps."))
+				.IsEnabled_Lambda([this]() { return NumLODs > 1; })
+				+SHorizontalBox::Slot()
+				.VAlign(VAlign_Center)
+				[
+					SNew(STextBlock)
+					.Text(FText::FromString("LOD Reduction"))
+					.Font(GetSlateStyle().GetFontStyle("PropertyWindow.NormalFont"))
+				]
+				+ SHorizontalBox::Slot()
+				.VAlign(VAlign_Center)
+				.HAlign(HAlign_Right)
+				.AutoWidth()
+				[
+					SNew(SBox)
+					.WidthOverride(80.0f)
+					[
+						SNew(SSpinBox<float>)
+						.MinValue(UBlendImportOptions::MinLODReductionRatio)
+						.MaxValue(UBlendImportOptions::MaxLODReductionRatio)
+						.Delta(0.05f)
+						.Value_Lambda([this]() { return LODReductionRatio; })
+						.OnValueChanged_Lambda([this](float InValue) { LODReductionRatio = InValue; })
+					]
+				]
+			]
 			
 			+SVerticalBox::Slot()
 			.VAlign(VAlign_Center)
@@ -226,15 +292,7 @@ void SBlendAssetImportDialog::Construct(const FArguments& InArgs)
 
 	if (InArgs._Collections.Num() > 0)
 	{
-		bool bSimilarCollections = false;
-		for (int32 i = 0; i < InArgs._Collections.Num(); i++)
-		{
-			if (InArgs._PreviousOptions->EnabledCollections.Find(InArgs._Collections[i]) != INDEX_NONE)
-			{
-				bSimilarCollections = true;
-				break;
-			}
-		}
+		const TArray<FString> DefaultEnabledCollections = InArgs._PreviousOptions->GetDefaultEnabledCollections(InArgs._Collections);
 
 		for (int32 i = 0; i < InArgs._Collections.Num(); i++)
 		{
@@ -260,18 +318,7 @@ void SBlendAssetImportDialog::Construct(const FArguments& InArgs)
 				]
 			];
 
-			bool IsChecked = false;
-			if (bSimilarCollections)
-			{
-				if (InArgs._PreviousOptions->EnabledCollections.Find(InArgs._Collections[i]) != INDEX_NONE)
-				{
-					IsChecked = true;
-				}
-			}
-			else
-			{
-				IsChecked = true;
-			}
+			bool IsChecked = DefaultEnabledCollections.Contains(InArgs._Collections[i]);
 			if (IsChecked)
 			{
 				EnabledCollections.Add(InArgs._Collections[i]);
@@ -309,6 +356,16 @@ TArray<FString> SBlendAssetImportDialog::GetEnabledCollections() const
 	return EnabledCollections;
 }
 
+int32 SBlendAssetImportDialog::GetNumLODs() const
+{
+	return NumLODs;
+}
+
+float SBlendAssetImportDialog::GetLODReductionRatio() const
+{
+	return LODReductionRatio;
+}
+
 FReply SBlendAssetImportDialog::OnButtonClick(EAppReturnType::Type ButtonID)
 {
 	UserResponse = ButtonID;
@@ -36,6 +36,8 @@ public:
 
 	bool IsUseObjectPivot() const;
 	TArray<FString> GetEnabledCollections() const;
+	int32 GetNumLODs() const;
+	float GetLODReductionRatio() const;
 
 protected:
 	FReply OnButtonClick(EAppReturnType::Type ButtonID);
@@ -50,4 +52,6 @@ private:
 
 	TArray<FString> EnabledCollections;
 	bool UseObjectPivot;
+	int32 NumLODs;
+	float LODReductionRatio;
 };
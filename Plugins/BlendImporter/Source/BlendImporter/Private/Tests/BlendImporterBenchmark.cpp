@@ -0,0 +1,436 @@
+// Copyright 2022 nuclearfriend
+
+#include "BlendAssetFactory.h"
+#include "BlendImporter.h"
+#include "BlendImporterSettings.h"
+#include "AssetImportTask.h"
+#include "AssetToolsModule.h"
+#if ENGINE_MAJOR_VERSION >= 5
+	#include "AssetCompilingManager.h"
+#endif
+#include "Async/Async.h"
+#include "Dom/JsonObject.h"
+#include "Interfaces/IPluginManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "ObjectTools.h"
+#include "Policies/CondensedJsonPrintPolicy.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "UObject/StrongObjectPtr.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/**
+ * Benchmarks the import pipeline against the stand-in Blender in Benchmark/StandInBlender, which exports generated scenes described in Benchmark/Corpus.json.
+ * Each scene is imported as an automated import, timing each stage of the factory and sampling the editor's memory, and the results are written to
+ * Saved/BlendImporter/Benchmark/Results.json. A scene fails if it regresses beyond Benchmark/Baseline.json (or -BlendImporterBaseline=<file>).
+ *
+ * The stand-in's files aren't real .blend files, so analysis always falls back to running Blender. -BlendImporterBenchmarkRuns=<n> keeps the fastest of n runs.
+ */
+
+/**
+ * Points the settings at the stand-in Blender, with the export cache off so every run exports, and restores them afterwards.
+ * The settings only have getters, so they're set through their properties, the way the settings editor sets them.
+ */
+class FBlendImporterBenchmarkSettings
+{
+public:
+	explicit FBlendImporterBenchmarkSettings(const FString& StandInExecutable, bool bDirectMeshTransfer)
+		: BlenderExecutable(GetSetting<FFilePath>(TEXT("BlenderExecutable")))
+		, bUseExportCache(GetSetting<bool>(TEXT("bUseExportCache")))
+		, bUseDirectMeshTransfer(GetSetting<bool>(TEXT("bDirectMeshTransfer")))
+		, SavedExecutable(BlenderExecutable)
+		, bSavedUseExportCache(bUseExportCache)
+		, bSavedDirectMeshTransfer(bUseDirectMeshTransfer)
+	{
+		BlenderExecutable.FilePath = StandInExecutable;
+		bUseExportCache = false;
+		bUseDirectMeshTransfer = bDirectMeshTransfer;
+	}
+
+	~FBlendImporterBenchmarkSettings()
+	{
+		BlenderExecutable = SavedExecutable;
+		bUseExportCache = bSavedUseExportCache;
+		bUseDirectMeshTransfer = bSavedDirectMeshTransfer;
+	}
+
+private:
+	template<typename T>
+	static T& GetSetting(const TCHAR* Name)
+	{
+		const FProperty* Property = FindFProperty<FProperty>(UBlendImporterSettings::StaticClass(), Name);
+		check(Property && Property->ElementSize == sizeof(T));
+		return *Property->ContainerPtrToValuePtr<T>(GetMutableDefault<UBlendImporterSettings>());
+	}
+
+	FFilePath& BlenderExecutable;
+	bool& bUseExportCache;
+	bool& bUseDirectMeshTransfer;
+
+	FFilePath SavedExecutable;
+	bool bSavedUseExportCache;
+	bool bSavedDirectMeshTransfer;
+};
+
+namespace BlendImporterBenchmark
+{
+	// Time and memory differences smaller than these are noise, however large the tolerance
+	static const double StageSlackMilliseconds = 20.0;
+	static const double MemorySlackMB = 16.0;
+
+	static FString GetBenchmarkDir()
+	{
+		return FPaths::ConvertRelativePathToFull(FPaths::Combine(IPluginManager::Get().FindPlugin(TEXT("BlendImporter"))->GetBaseDir(), TEXT("Benchmark")));
+	}
+
+	static FString GetStandInExecutable()
+	{
+		#if PLATFORM_WINDOWS
+			return FPaths::Combine(GetBenchmarkDir(), TEXT("StandInBlender"), TEXT("blender.bat"));
+		#else
+			return FPaths::Combine(GetBenchmarkDir(), TEXT("StandInBlender"), TEXT("blender"));
+		#endif
+	}
+
+	static TSharedPtr<FJsonObject> LoadJson(const FString& Filename)
+	{
+		FString Json;
+		TSharedPtr<FJsonObject> Object;
+		if (FFileHelper::LoadFileToString(Json, *Filename))
+		{
+			TSharedRef<TJsonReader<TCHAR>> Reader = TJsonReaderFactory<TCHAR>::Create(Json);
+			FJsonSerializer::Deserialize(Reader, Object);
+		}
+		return Object;
+	}
+
+	static bool SaveJson(const FString& Filename, const TSharedRef<FJsonObject>& Object)
+	{
+		FString Json;
+		TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+		return FJsonSerializer::Serialize(Object, Writer) && FFileHelper::SaveStringToFile(Json, *Filename);
+	}
+
+	static TArray<TSharedPtr<FJsonObject>> LoadScenes(bool bStress)
+	{
+		TArray<TSharedPtr<FJsonObject>> Scenes;
+		TSharedPtr<FJsonObject> Corpus = LoadJson(FPaths::Combine(GetBenchmarkDir(), TEXT("Corpus.json")));
+		const TArray<TSharedPtr<FJsonValue>>* Entries = nullptr;
+		if (Corpus.IsValid() && Corpus->TryGetArrayField(TEXT("scenes"), Entries))
+		{
+			for (const TSharedPtr<FJsonValue>& Entry : *Entries)
+			{
+				const TSharedPtr<FJsonObject>* Scene = nullptr;
+				bool bSceneStress = false;
+				if (Entry->TryGetObject(Scene) && ((*Scene)->TryGetBoolField(TEXT("stress"), bSceneStress), bSceneStress == bStress))
+				{
+					Scenes.Add(*Scene);
+				}
+			}
+		}
+		return Scenes;
+	}
+
+	/** Writes the scene's ".blend" file for the stand-in: its description on the first line, padded to the scene's source size */
+	static FString WriteSceneFile(const FJsonObject& Scene)
+	{
+		const FString Filename = FPaths::ConvertRelativePathToFull(FPaths::Combine(FPaths::ProjectIntermediateDir(), TEXT("BlendImporter"), TEXT("Benchmark"), Scene.GetStringField(TEXT("name")) + TEXT(".blend")));
+
+		TSharedRef<FJsonObject> Description = MakeShared<FJsonObject>(Scene);
+		Description->SetNumberField(TEXT("standin"), 1);
+		FString Header;
+		TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> Writer = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&Header);
+		FJsonSerializer::Serialize(Description, Writer);
+		Header += TEXT("\n");
+
+		FTCHARToUTF8 HeaderUTF8(*Header);
+		double SourceBytes = 0.0;
+		Scene.TryGetNumberField(TEXT("sourceBytes"), SourceBytes);
+		const int64 FileSize = FMath::Max<int64>(static_cast<int64>(SourceBytes), HeaderUTF8.Length());
+
+		// Large scenes are only written again if their description changed
+		FString ExistingHeader;
+		if (IFileManager::Get().FileSize(*Filename) == FileSize && FFileHelper::LoadFileToString(ExistingHeader, *Filename) && ExistingHeader.StartsWith(Header))
+		{
+			return Filename;
+		}
+
+		TUniquePtr<FArchive> File(IFileManager::Get().CreateFileWriter(*Filename));
+		if (!File.IsValid())
+		{
+			return FString();
+		}
+		File->Serialize(const_cast<ANSICHAR*>(HeaderUTF8.Get()), HeaderUTF8.Length());
+
+		TArray<uint8> Padding;
+		Padding.SetNumUninitialized(4 * 1024 * 1024);
+		for (int32 Index = 0; Index < Padding.Num(); Index++)
+		{
+			// Not all the same byte, so the source hash has something to chew on
+			Padding[Index] = static_cast<uint8>((Index * 2654435761u) >> 24);
+		}
+		for (int64 Remaining = FileSize - HeaderUTF8.Length(); Remaining > 0; Remaining -= Padding.Num())
+		{
+			File->Serialize(Padding.GetData(), FMath::Min<int64>(Remaining, Padding.Num()));
+		}
+		return File->Close() ? Filename : FString();
+	}
+
+	/** Samples the editor's memory on another thread while an import runs on this one */
+	class FPeakMemorySampler
+	{
+	public:
+		FPeakMemorySampler()
+			: bStop(MakeShared<TAtomic<bool>>(false))
+			, StartUsed(FPlatformMemory::GetStats().UsedPhysical)
+		{
+			TSharedRef<TAtomic<bool>> Stop = bStop;
+			const uint64 Start = StartUsed;
+			PeakUsed = Async(EAsyncExecution::Thread, [Stop, Start]()
+			{
+				uint64 Peak = Start;
+				while (!*Stop)
+				{
+					Peak = FMath::Max<uint64>(Peak, FPlatformMemory::GetStats().UsedPhysical);
+					FPlatformProcess::Sleep(0.005f);
+				}
+				return Peak;
+			});
+		}
+
+		/** How much more memory (in MB) the editor used at its peak than when sampling started */
+		double Stop()
+		{
+			*bStop = true;
+			return static_cast<double>(PeakUsed.Get() - StartUsed) / (1024.0 * 1024.0);
+		}
+
+	private:
+		TSharedRef<TAtomic<bool>> bStop;
+		uint64 StartUsed;
+		TFuture<uint64> PeakUsed;
+	};
+
+	static TSharedPtr<FJsonObject> ImportScene(FAutomationTestBase& Test, const FJsonObject& Scene, const FString& Filename)
+	{
+		bool bDirectMesh = false;
+		Scene.TryGetBoolField(TEXT("directMesh"), bDirectMesh);
+		FBlendImporterBenchmarkSettings BenchmarkSettings(GetStandInExecutable(), bDirectMesh);
+
+		// The factory reads the options for automated imports from the options object
+		UBlendImportOptions* ImportOptions = GetMutableDefault<UBlendImportOptions>();
+		const FString SavedOptions = ImportOptions->ToString();
+		ImportOptions->bUseObjectPivot = false;
+		ImportOptions->EnabledCollections.Empty();
+
+		TStrongObjectPtr<UBlendAssetFactory> Factory(NewObject<UBlendAssetFactory>());
+		UAssetImportTask* ImportTask = NewObject<UAssetImportTask>();
+		ImportTask->Filename = Filename;
+		ImportTask->DestinationPath = TEXT("/Temp/BlendImporterBenchmark/") + Scene.GetStringField(TEXT("name"));
+		ImportTask->Factory = Factory.Get();
+		ImportTask->bAutomated = true;
+		ImportTask->bReplaceExisting = true;
+		ImportTask->bSave = false;
+
+		FPeakMemorySampler MemorySampler;
+		IAssetTools& AssetTools = FModuleManager::LoadModuleChecked<FAssetToolsModule>("AssetTools").Get();
+		AssetTools.ImportAssetTasks({ ImportTask });
+
+		// Meshes can still be compiling in the background when the import returns, which is part of what's measured
+		const double CompileStartTime = FPlatformTime::Seconds();
+		#if ENGINE_MAJOR_VERSION >= 5
+			FAssetCompilingManager::Get().FinishAllCompilation();
+		#endif
+		const double CompileMilliseconds = (FPlatformTime::Seconds() - CompileStartTime) * 1000.0;
+		const double PeakMemoryMB = MemorySampler.Stop();
+
+		ImportOptions->FromString(SavedOptions);
+
+		// Deleted straight away, so later scenes aren't measured with this one's assets in memory
+		TArray<UObject*> ImportedObjects;
+		for (const FString& ObjectPath : ImportTask->ImportedObjectPaths)
+		{
+			if (UObject* Object = FindObject<UObject>(nullptr, *ObjectPath))
+			{
+				ImportedObjects.Add(Object);
+			}
+		}
+		if (ImportedObjects.Num() == 0)
+		{
+			Test.AddError(FString::Printf(TEXT("Nothing was imported from '%s'"), *Filename));
+			return nullptr;
+		}
+		ObjectTools::ForceDeleteObjects(ImportedObjects, false);
+
+		const FBlendImportSummary& Summary = Factory->GetImportSummary();
+		const double TotalSeconds = FMath::Max(Summary.GetTotalMilliseconds() / 1000.0, 0.001);
+
+		TSharedRef<FJsonObject> Result = MakeShared<FJsonObject>();
+		Result->SetNumberField(TEXT("totalMs"), Summary.GetTotalMilliseconds());
+		Result->SetNumberField(TEXT("compileMs"), CompileMilliseconds);
+		Result->SetNumberField(TEXT("peakMemoryMB"), PeakMemoryMB);
+		Result->SetNumberField(TEXT("exportedMB"), Summary.GetExportedBytes() / (1024.0 * 1024.0));
+		Result->SetNumberField(TEXT("objects"), Summary.GetNumObjects());
+		Result->SetNumberField(TEXT("triangles"), Summary.GetNumTriangles());
+		Result->SetNumberField(TEXT("throughputMBPerSecond"), Summary.GetExportedBytes() / (1024.0 * 1024.0) / TotalSeconds);
+		Result->SetNumberField(TEXT("trianglesPerSecond"), Summary.GetNumTriangles() / TotalSeconds);
+
+		TSharedRef<FJsonObject> Stages = MakeShared<FJsonObject>();
+		for (const TPair<FString, double>& Stage : Summary.GetStages())
+		{
+			Stages->SetNumberField(Stage.Key, Stage.Value);
+		}
+		Result->SetObjectField(TEXT("stagesMs"), Stages);
+		return Result;
+	}
+
+	static void CheckRegression(FAutomationTestBase& Test, const FString& What, double Value, double Baseline, double Tolerance, double Slack)
+	{
+		const double Limit = Baseline * (1.0 + Tolerance) + Slack;
+		if (Value > Limit)
+		{
+			Test.AddError(FString::Printf(TEXT("%s regressed: %.1f, baseline %.1f (limit %.1f)"), *What, Value, Baseline, Limit));
+		}
+	}
+
+	static void CompareWithBaseline(FAutomationTestBase& Test, const FString& SceneName, const FJsonObject& Result)
+	{
+		FString BaselineFilename = FPaths::Combine(GetBenchmarkDir(), TEXT("Baseline.json"));
+		FParse::Value(FCommandLine::Get(), TEXT("BlendImporterBaseline="), BaselineFilename);
+
+		TSharedPtr<FJsonObject> Baseline = LoadJson(BaselineFilename);
+		const TSharedPtr<FJsonObject>* Scenes = nullptr;
+		const TSharedPtr<FJsonObject>* SceneBaseline = nullptr;
+		if (!Baseline.IsValid() || !Baseline->TryGetObjectField(TEXT("scenes"), Scenes) || !(*Scenes)->TryGetObjectField(SceneName, SceneBaseline))
+		{
+			// Still measured, but nothing guards the scene against regressions until its results are accepted into the baseline
+			Test.AddWarning(FString::Printf(TEXT("No baseline for %s in '%s', only measured. Copy it from the results to guard against regressions."), *SceneName, *BaselineFilename));
+			return;
+		}
+
+		double Tolerance = 0.25;
+		Baseline->TryGetNumberField(TEXT("tolerance"), Tolerance);
+
+		double BaselineValue = 0.0;
+		if ((*SceneBaseline)->TryGetNumberField(TEXT("totalMs"), BaselineValue))
+		{
+			CheckRegression(Test, TEXT("Total time (ms)"), Result.GetNumberField(TEXT("totalMs")), BaselineValue, Tolerance, StageSlackMilliseconds);
+		}
+		if ((*SceneBaseline)->TryGetNumberField(TEXT("peakMemoryMB"), BaselineValue))
+		{
+			CheckRegression(Test, TEXT("Peak memory (MB)"), Result.GetNumberField(TEXT("peakMemoryMB")), BaselineValue, Tolerance, MemorySlackMB);
+		}
+
+		const TSharedPtr<FJsonObject>* BaselineStages = nullptr;
+		if ((*SceneBaseline)->TryGetObjectField(TEXT("stagesMs"), BaselineStages))
+		{
+			const TSharedPtr<FJsonObject> Stages = Result.GetObjectField(TEXT("stagesMs"));
+			for (const TPair<FString, TSharedPtr<FJsonValue>>& Stage : (*BaselineStages)->Values)
+			{
+				double StageMilliseconds = 0.0;
+				if (Stages->TryGetNumberField(Stage.Key, StageMilliseconds))
+				{
+					CheckRegression(Test, Stage.Key + TEXT(" (ms)"), StageMilliseconds, Stage.Value->AsNumber(), Tolerance, StageSlackMilliseconds);
+				}
+			}
+		}
+	}
+
+	static void SaveResult(const FString& SceneName, const TSharedRef<FJsonObject>& Result)
+	{
+		const FString ResultsFilename = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("BlendImporter"), TEXT("Benchmark"), TEXT("Results.json"));
+
+		// Laid out like the baseline, so it can be copied over it to accept the results
+		TSharedPtr<FJsonObject> Results = LoadJson(ResultsFilename);
+		if (!Results.IsValid())
+		{
+			Results = MakeShared<FJsonObject>();
+		}
+		const TSharedPtr<FJsonObject>* ExistingScenes = nullptr;
+		TSharedRef<FJsonObject> Scenes = Results->TryGetObjectField(TEXT("scenes"), ExistingScenes) ? ExistingScenes->ToSharedRef() : MakeShared<FJsonObject>();
+		Scenes->SetObjectField(SceneName, Result);
+		Results->SetObjectField(TEXT("scenes"), Scenes);
+		SaveJson(ResultsFilename, Results.ToSharedRef());
+	}
+
+	static void GetSceneTests(bool bStress, TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands)
+	{
+		for (const TSharedPtr<FJsonObject>& Scene : LoadScenes(bStress))
+		{
+			OutBeautifiedNames.Add(Scene->GetStringField(TEXT("name")));
+			OutTestCommands.Add(Scene->GetStringField(TEXT("name")));
+		}
+	}
+
+	static bool RunSceneTest(FAutomationTestBase& Test, bool bStress, const FString& SceneName)
+	{
+		const TSharedPtr<FJsonObject>* Scene = LoadScenes(bStress).FindByPredicate([&SceneName](const TSharedPtr<FJsonObject>& Candidate) { return Candidate->GetStringField(TEXT("name")) == SceneName; });
+		if (Scene == nullptr)
+		{
+			Test.AddError(FString::Printf(TEXT("Scene %s isn't in the corpus"), *SceneName));
+			return false;
+		}
+
+		const FString Filename = WriteSceneFile(**Scene);
+		if (Filename.IsEmpty())
+		{
+			Test.AddError(FString::Printf(TEXT("Could not write the scene file for %s"), *SceneName));
+			return false;
+		}
+
+		int32 NumRuns = 1;
+		FParse::Value(FCommandLine::Get(), TEXT("BlendImporterBenchmarkRuns="), NumRuns);
+
+		// The fastest run is the least disturbed by whatever else the machine was doing
+		TSharedPtr<FJsonObject> BestResult;
+		for (int32 Run = 0; Run < FMath::Max(NumRuns, 1); Run++)
+		{
+			TSharedPtr<FJsonObject> Result = ImportScene(Test, **Scene, Filename);
+			if (!Result.IsValid())
+			{
+				return false;
+			}
+			if (!BestResult.IsValid() || Result->GetNumberField(TEXT("totalMs")) < BestResult->GetNumberField(TEXT("totalMs")))
+			{
+				BestResult = Result;
+			}
+		}
+
+		Test.AddInfo(FString::Printf(TEXT("%s: %.0fms, %.1f MB exported (%.1f MB/s), %.0f triangles/s, peak memory +%.0f MB"), *SceneName,
+			BestResult->GetNumberField(TEXT("totalMs")), BestResult->GetNumberField(TEXT("exportedMB")), BestResult->GetNumberField(TEXT("throughputMBPerSecond")),
+			BestResult->GetNumberField(TEXT("trianglesPerSecond")), BestResult->GetNumberField(TEXT("peakMemoryMB"))));
+
+		SaveResult(SceneName, BestResult.ToSharedRef());
+		CompareWithBaseline(Test, SceneName, *BestResult);
+		return true;
+	}
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FBlendImporterBenchmarkTest, "BlendImporter.Benchmark.Corpus", EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+void FBlendImporterBenchmarkTest::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+	BlendImporterBenchmark::GetSceneTests(false, OutBeautifiedNames, OutTestCommands);
+}
+
+bool FBlendImporterBenchmarkTest::RunTest(const FString& Parameters)
+{
+	return BlendImporterBenchmark::RunSceneTest(*this, false, Parameters);
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FBlendImporterStressBenchmarkTest, "BlendImporter.Benchmark.Stress", EAutomationTestFlags::EditorContext | EAutomationTestFlags::StressFilter)
+
+void FBlendImporterStressBenchmarkTest::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+	BlendImporterBenchmark::GetSceneTests(true, OutBeautifiedNames, OutTestCommands);
+}
+
+bool FBlendImporterStressBenchmarkTest::RunTest(const FString& Parameters)
+{
+	return BlendImporterBenchmark::RunSceneTest(*this, true, Parameters);
+}
+
+#endif
@@ -8,6 +8,12 @@
 
 DECLARE_LOG_CATEGORY_EXTERN(LogBlendImporter, Verbose, Verbose);
 
+class FBlendExportCache;
+class FBlendFileHashes;
+class FBlendImportQueue;
+class FBlendSourceWatcher;
+class FBlenderWorker;
+
 class FBlendImporterModule : public IModuleInterface
 {
 public:
@@ -16,6 +22,23 @@ public:
 	virtual void StartupModule() override;
 	virtual void ShutdownModule() override;
 
+	static FBlendImporterModule& Get();
+
+	/** The persistent Blender worker, which is started on first use */
+	FBlenderWorker& GetBlenderWorker();
+
+	/** Created with the module, as queued imports use it from other threads */
+	FBlendExportCache& GetExportCache();
+
+	/** Hashes of .blend files, only hashed again once they change */
+	FBlendFileHashes& GetFileHashes();
+
+	/** Imports files in the background */
+	FBlendImportQueue& GetImportQueue();
+
+	/** Exports changed .blend source files in the background, null in commandlets */
+	FBlendSourceWatcher* GetSourceWatcher();
+
 private:
 	void RegisterSettings();
 	void UnregisterSettings();
@@ -26,10 +49,28 @@ private:
 	void RegisterMessageLog();
 	void UnregisterMessageLog();
 
+	void RegisterAssetRegistryTags();
+	void UnregisterAssetRegistryTags();
+
 	TSharedRef<FExtender> OnExtendContentBrowserAssetSelectionMenu(const TArray<FAssetData>& SelectedAssets);
+	TSharedRef<FExtender> OnExtendContentBrowserPathSelectionMenu(const TArray<FString>& SelectedPaths);
+	static void AddMenuExtenderBatchImport(FMenuBuilder& MenuBuilder, const TArray<FString> SelectedPaths);
+	static void BatchImportFiles(const FString& DestinationPath);
 	static void AddMenuExtenderBlendAssetImported(FMenuBuilder& MenuBuilder, const TArray<FAssetData> SelectedAssets);
 	static void OpenFilesInBlender(const TArray<FString>& Filenames);
+	static void ReimportAllFromFiles(const TArray<FString>& Filenames);
 	static void OpenFileInBlender(const FString& Filename);
 
 	FDelegateHandle ContentBrowserExtenderDelegateHandle;
+	FDelegateHandle ContentBrowserPathExtenderDelegateHandle;
+	FDelegateHandle AssetRegistryTagsDelegateHandle;
+
+	/** Set while the module is loaded, so Get works from any thread without going through the module manager */
+	static FBlendImporterModule* Instance;
+
+	TSharedPtr<FBlenderWorker> BlenderWorker;
+	TSharedPtr<FBlendExportCache> ExportCache;
+	TSharedPtr<FBlendFileHashes> FileHashes;
+	TSharedPtr<FBlendImportQueue> ImportQueue;
+	TSharedPtr<FBlendSourceWatcher> SourceWatcher;
 };